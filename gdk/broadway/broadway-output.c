@@ -429,6 +429,20 @@ broadway_output_upload_texture (BroadwayOutput *output,
   g_string_append_len (output->buf, g_bytes_get_data (texture, NULL), len);
 }
 
+void
+broadway_output_upload_texture_delta (BroadwayOutput *output,
+                                      guint32 id,
+                                      guint32 base_id,
+                                      GBytes *delta)
+{
+  gsize len = g_bytes_get_size (delta);
+  write_header (output, BROADWAY_OP_UPLOAD_TEXTURE_DELTA);
+  append_uint32 (output, id);
+  append_uint32 (output, base_id);
+  append_uint32 (output, (guint32)len);
+  g_string_append_len (output->buf, g_bytes_get_data (delta, NULL), len);
+}
+
 void
 broadway_output_release_texture (BroadwayOutput *output,
                                  guint32 id)
@@ -64,6 +64,10 @@ void            broadway_output_surface_set_nodes   (BroadwayOutput *output,
 void            broadway_output_upload_texture      (BroadwayOutput *output,
                                                      guint32         id,
                                                      GBytes         *texture);
+void            broadway_output_upload_texture_delta (BroadwayOutput *output,
+                                                     guint32         id,
+                                                     guint32         base_id,
+                                                     GBytes         *delta);
 void            broadway_output_release_texture     (BroadwayOutput *output,
                                                      guint32         id);
 void            broadway_output_grab_pointer        (BroadwayOutput *output,
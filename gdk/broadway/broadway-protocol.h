@@ -56,6 +56,7 @@ typedef enum {
   BROADWAY_EVENT_SCREEN_SIZE_CHANGED = 'd',
   BROADWAY_EVENT_FOCUS = 'f',
   BROADWAY_EVENT_ROUNDTRIP_NOTIFY = 'F',
+  BROADWAY_EVENT_REQUEST_TEXTURE = 'T',
 } BroadwayEventType;
 
 typedef enum {
@@ -77,6 +78,7 @@ typedef enum {
   BROADWAY_OP_SET_SHOW_KEYBOARD = 'k',
   BROADWAY_OP_UPLOAD_TEXTURE = 't',
   BROADWAY_OP_RELEASE_TEXTURE = 'T',
+  BROADWAY_OP_UPLOAD_TEXTURE_DELTA = 'U',
   BROADWAY_OP_SET_NODES = 'n',
   BROADWAY_OP_ROUNDTRIP = 'F',
 } BroadwayOpType;
@@ -205,6 +207,7 @@ typedef enum {
   BROADWAY_REQUEST_RELEASE_TEXTURE,
   BROADWAY_REQUEST_SET_NODES,
   BROADWAY_REQUEST_ROUNDTRIP,
+  BROADWAY_REQUEST_UPLOAD_TEXTURE_DELTA,
 } BroadwayRequestType;
 
 typedef struct {
@@ -237,6 +240,22 @@ typedef struct {
   guint32 size;
 } BroadwayRequestUploadTexture;
 
+/* The data of a texture delta starts with the number of tiles that
+ * changed relative to the base texture as a little-endian guint32.
+ * For every tile its x, y, width and height follow as little-endian
+ * guint16. The rest is a PNG of all the tiles stacked vertically,
+ * BROADWAY_TEXTURE_TILE_SIZE pixels apart.
+ */
+#define BROADWAY_TEXTURE_TILE_SIZE 32
+
+typedef struct {
+  BroadwayRequestBase base;
+  guint32 id;
+  guint32 base_id;
+  guint32 offset;
+  guint32 size;
+} BroadwayRequestUploadTextureDelta;
+
 typedef struct {
   BroadwayRequestBase base;
   guint32 id;
@@ -303,6 +322,7 @@ typedef union {
   BroadwayRequestFocusSurface focus_surface;
   BroadwayRequestSetShowKeyboard set_show_keyboard;
   BroadwayRequestUploadTexture upload_texture;
+  BroadwayRequestUploadTextureDelta upload_texture_delta;
   BroadwayRequestReleaseTexture release_texture;
   BroadwayRequestSetNodes set_nodes;
 } BroadwayRequest;
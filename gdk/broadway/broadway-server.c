@@ -128,13 +128,59 @@ struct BroadwaySurface {
   BroadwayNode *nodes;
 };
 
+typedef struct _BroadwayTexture BroadwayTexture;
+
+struct _BroadwayTexture {
+  int ref_count;
+  guint32 id;
+  GBytes *data;
+  /* For deltas, the texture the data applies to */
+  BroadwayTexture *base;
+};
+
 static void broadway_server_resync_surfaces (BroadwayServer *server);
+static void broadway_server_reupload_texture (BroadwayServer *server,
+                                              guint32         id);
 static void send_outstanding_roundtrips (BroadwayServer *server);
 
 static GType broadway_server_get_type (void);
 
 G_DEFINE_TYPE (BroadwayServer, broadway_server, G_TYPE_OBJECT)
 
+static BroadwayTexture *
+broadway_texture_new (guint32          id,
+                      GBytes          *data,
+                      BroadwayTexture *base)
+{
+  BroadwayTexture *texture;
+
+  texture = g_new0 (BroadwayTexture, 1);
+  texture->ref_count = 1;
+  texture->id = id;
+  texture->data = g_bytes_ref (data);
+  if (base)
+    {
+      texture->base = base;
+      base->ref_count++;
+    }
+
+  return texture;
+}
+
+static void
+broadway_texture_unref (BroadwayTexture *texture)
+{
+  while (texture != NULL && --texture->ref_count == 0)
+    {
+      BroadwayTexture *base = texture->base;
+
+      g_bytes_unref (texture->data);
+      g_free (texture);
+
+      texture = base;
+    }
+}
+
 static void
 broadway_node_free (BroadwayNode *node)
 {
@@ -204,7 +250,7 @@ broadway_server_init (BroadwayServer *server)
   server->surface_id_hash = g_hash_table_new (NULL, NULL);
   server->id_counter = 0;
   server->textures = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
-                                            (GDestroyNotify)g_bytes_unref);
+                                            (GDestroyNotify)broadway_texture_unref);
 
   root = g_new0 (BroadwaySurface, 1);
   root->id = server->id_counter++;
@@ -617,6 +663,11 @@ parse_input_message (BroadwayInput *input, const unsigned char *message)
     msg.screen_resize_notify.height = ntohl (*p++);
     break;
 
+  case BROADWAY_EVENT_REQUEST_TEXTURE:
+    /* Handled here, clients don't need to know */
+    broadway_server_reupload_texture (server, ntohl (*p++));
+    return;
+
   default:
     g_printerr ("parse_input_message - Unknown input command %c (%s)\n", msg.base.type, message);
     break;
@@ -1636,7 +1687,7 @@ broadway_server_upload_texture (BroadwayServer   *server,
   id = ++server->next_texture_id;
   g_hash_table_replace (server->textures,
                         GINT_TO_POINTER (id),
-                        g_bytes_ref (texture));
+                        broadway_texture_new (id, texture, NULL));
 
   if (server->output)
     broadway_output_upload_texture (server->output, id, texture);
@@ -1644,6 +1695,30 @@ broadway_server_upload_texture (BroadwayServer   *server,
   return id;
 }
 
+guint32
+broadway_server_upload_texture_delta (BroadwayServer   *server,
+                                      guint32           base_id,
+                                      GBytes           *delta)
+{
+  BroadwayTexture *base;
+  guint32 id;
+
+  base = g_hash_table_lookup (server->textures, GINT_TO_POINTER (base_id));
+  g_return_val_if_fail (base != NULL, 0);
+
+  /* The texture keeps its base alive, so that it can be sent
+   * again when a new browser connects */
+  id = ++server->next_texture_id;
+  g_hash_table_replace (server->textures,
+                        GINT_TO_POINTER (id),
+                        broadway_texture_new (id, delta, base));
+
+  if (server->output)
+    broadway_output_upload_texture_delta (server->output, id, base_id, delta);
+
+  return id;
+}
+
 void
 broadway_server_release_texture (BroadwayServer   *server,
                                  guint32           id)
@@ -1654,6 +1729,160 @@ broadway_server_release_texture (BroadwayServer   *server,
     broadway_output_release_texture (server->output, id);
 }
 
+typedef struct {
+  const guchar *data;
+  gsize size;
+} PngReader;
+
+static cairo_status_t
+read_png_cb (void          *closure,
+             unsigned char *data,
+             unsigned int   length)
+{
+  PngReader *reader = closure;
+
+  if (length > reader->size)
+    return CAIRO_STATUS_READ_ERROR;
+
+  memcpy (data, reader->data, length);
+  reader->data += length;
+  reader->size -= length;
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+write_png_cb (void                *closure,
+              const unsigned char *data,
+              unsigned int         length)
+{
+  g_byte_array_append (closure, data, length);
+
+  return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+surface_from_png (const guchar *data,
+                  gsize         size)
+{
+  cairo_surface_t *surface;
+  PngReader reader = { data, size };
+
+  surface = cairo_image_surface_create_from_png_stream (read_png_cb, &reader);
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS)
+    {
+      cairo_surface_destroy (surface);
+      return NULL;
+    }
+
+  return surface;
+}
+
+static guint16
+decode_le16 (const guchar *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+/* Returns the pixels of the texture, with all the deltas
+ * up to it applied, or NULL if some data can't be decoded */
+static cairo_surface_t *
+broadway_texture_decode (BroadwayTexture *texture)
+{
+  cairo_surface_t *surface, *atlas;
+  const guchar *data;
+  gsize size, header_size;
+  guint32 i, n_tiles;
+  cairo_t *cr;
+
+  data = g_bytes_get_data (texture->data, &size);
+
+  if (texture->base == NULL)
+    return surface_from_png (data, size);
+
+  surface = broadway_texture_decode (texture->base);
+  if (surface == NULL)
+    return NULL;
+
+  if (size < 4)
+    goto fail;
+
+  n_tiles = decode_le16 (data) | (decode_le16 (data + 2) << 16);
+  if (n_tiles == 0)
+    return surface;
+  if (n_tiles > (size - 4) / 8)
+    goto fail;
+
+  header_size = 4 + n_tiles * 8;
+  atlas = surface_from_png (data + header_size, size - header_size);
+  if (atlas == NULL)
+    goto fail;
+
+  cr = cairo_create (surface);
+  cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+  for (i = 0; i < n_tiles; i++)
+    {
+      const guchar *tile = data + 4 + i * 8;
+      int x = decode_le16 (tile);
+      int y = decode_le16 (tile + 2);
+
+      cairo_save (cr);
+      cairo_rectangle (cr, x, y, decode_le16 (tile + 4), decode_le16 (tile + 6));
+      cairo_clip (cr);
+      cairo_set_source_surface (cr, atlas, x, y - (int) i * BROADWAY_TEXTURE_TILE_SIZE);
+      cairo_paint (cr);
+      cairo_restore (cr);
+    }
+  cairo_destroy (cr);
+  cairo_surface_destroy (atlas);
+
+  return surface;
+
+ fail:
+  cairo_surface_destroy (surface);
+  return NULL;
+}
+
+/* The browser couldn't apply a delta, because the image it is based
+ * on failed to load. Send the whole texture instead. */
+static void
+broadway_server_reupload_texture (BroadwayServer *server,
+                                  guint32         id)
+{
+  BroadwayTexture *texture;
+  cairo_surface_t *surface;
+  GByteArray *png;
+  GBytes *bytes;
+
+  texture = g_hash_table_lookup (server->textures, GINT_TO_POINTER (id));
+  if (texture == NULL || server->output == NULL)
+    return;
+
+  if (texture->base == NULL)
+    {
+      broadway_output_upload_texture (server->output, id, texture->data);
+      broadway_server_flush (server);
+      return;
+    }
+
+  surface = broadway_texture_decode (texture);
+  if (surface == NULL)
+    {
+      g_warning ("Can't decode texture %u for uploading it again", id);
+      return;
+    }
+
+  png = g_byte_array_new ();
+  cairo_surface_write_to_png_stream (surface, write_png_cb, png);
+  cairo_surface_destroy (surface);
+  bytes = g_byte_array_free_to_bytes (png);
+
+  broadway_output_upload_texture (server->output, id, bytes);
+  broadway_server_flush (server);
+
+  g_bytes_unref (bytes);
+}
+
 gboolean
 broadway_server_surface_move_resize (BroadwayServer *server,
                                      gint id,
@@ -1822,22 +2051,51 @@ broadway_server_new_surface (BroadwayServer *server,
   return surface->id;
 }
 
+static void
+resync_texture (BroadwayServer  *server,
+                BroadwayTexture *texture,
+                GHashTable      *uploaded)
+{
+  if (g_hash_table_contains (uploaded, GINT_TO_POINTER (texture->id)))
+    return;
+
+  if (texture->base)
+    {
+      resync_texture (server, texture->base, uploaded);
+      broadway_output_upload_texture_delta (server->output, texture->id,
+                                            texture->base->id, texture->data);
+    }
+  else
+    broadway_output_upload_texture (server->output, texture->id, texture->data);
+
+  g_hash_table_add (uploaded, GINT_TO_POINTER (texture->id));
+}
+
 static void
 broadway_server_resync_surfaces (BroadwayServer *server)
 {
   GHashTableIter iter;
+  GHashTable *uploaded;
   gpointer key, value;
   GList *l;
 
   if (server->output == NULL)
     return;
 
-  /* First upload all textures */
+  /* First upload all textures, and the ones deltas are based on */
+  uploaded = g_hash_table_new (NULL, NULL);
   g_hash_table_iter_init (&iter, server->textures);
   while (g_hash_table_iter_next (&iter, &key, &value))
-    broadway_output_upload_texture (server->output,
-                                    GPOINTER_TO_INT (key),
-                                    (GBytes *)value);
+    resync_texture (server, value, uploaded);
+
+  /* Bases that were released already were only needed for decoding */
+  g_hash_table_iter_init (&iter, uploaded);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+      if (!g_hash_table_contains (server->textures, key))
+        broadway_output_release_texture (server->output, GPOINTER_TO_INT (key));
+    }
+  g_hash_table_destroy (uploaded);
 
   /* Then create all surfaces */
   for (l = server->surfaces; l != NULL; l = l->next)
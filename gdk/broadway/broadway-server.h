@@ -95,6 +95,9 @@ gboolean            broadway_server_surface_translate         (BroadwayServer  *
                                                                gint             dy);
 guint32             broadway_server_upload_texture            (BroadwayServer  *server,
                                                                GBytes          *texture);
+guint32             broadway_server_upload_texture_delta      (BroadwayServer  *server,
+                                                               guint32          base_id,
+                                                               GBytes          *delta);
 void                broadway_server_release_texture           (BroadwayServer  *server,
                                                                guint32          id);
 cairo_surface_t   * broadway_server_create_surface            (int              width,
@@ -82,6 +82,10 @@ var realSurfaceWithMouse = 0;
 var surfaceWithMouse = 0;
 var surfaces = {};
 var textures = {};
+var textureImages = {};
+var pendingTextureDeltas = {};
+/* Images waiting for a texture that is uploaded again */
+var requestedTextures = {};
 var stackingOrder = [];
 var outstandingCommands = new Array();
 var inputSocket = null;
@@ -441,7 +445,10 @@ SwapNodes.prototype.insertNode = function(parent, posInParent, oldNode)
             image.style["position"] = "absolute";
             set_rect_style(image, rect);
             var texture_url = textures[texture_id];
-            image.src = texture_url;
+            if (texture_url)
+                image.src = texture_url;
+            if (texture_id in requestedTextures)
+                requestedTextures[texture_id].push(image);
             newNode = image;
         }
         break;
@@ -711,14 +718,127 @@ function cmdUploadTexture(id, data)
 {
     var blob = new Blob([data],{type: "image/png"});
     var url = window.URL.createObjectURL(blob);
+    /* Textures are uploaded again if a delta can't be applied */
+    if (textures[id])
+        window.URL.revokeObjectURL(textures[id]);
     textures[id] = url;
+    delete textureImages[id];
+
+    var images = requestedTextures[id];
+    if (images) {
+        delete requestedTextures[id];
+        for (var i = 0; i < images.length; i++)
+            images[i].src = url;
+    }
 }
 
 function cmdReleaseTexture(id)
 {
     var url = textures[id];
-    window.URL.revokeObjectURL(url);
+    if (url)
+        window.URL.revokeObjectURL(url);
     delete textures[id];
+    delete textureImages[id];
+    delete requestedTextures[id];
+}
+
+/* Returns an image or canvas with the pixels of the texture,
+ * which might still be loading */
+function getTextureImage(id)
+{
+    var image = textureImages[id];
+    if (!image) {
+        image = new Image();
+        image.onload = handleOutstanding;
+        image.onerror = handleOutstanding;
+        /* Without a source, the image is complete and broken */
+        if (textures[id])
+            image.src = textures[id];
+        textureImages[id] = image;
+    }
+    return image;
+}
+
+function isImageLoaded(image)
+{
+    /* Canvases don't have the complete property and are always ready */
+    return image.complete === undefined || image.complete;
+}
+
+function isImageBroken(image)
+{
+    /* Images that failed to load are complete, but have no pixels */
+    return image.naturalWidth === 0;
+}
+
+function decodeUint16(data, pos)
+{
+    return data[pos] + (data[pos+1] << 8);
+}
+
+/* Returns false if the images it needs are still loading, the
+ * command has to be run again once they are */
+function cmdUploadTextureDelta(id, baseId, data)
+{
+    var delta = pendingTextureDeltas[id];
+    if (!delta) {
+        var nTiles = decodeUint16(data, 0) + (decodeUint16(data, 2) << 16);
+        var tiles = [];
+        var pos = 4;
+        for (var i = 0; i < nTiles; i++) {
+            tiles.push({ x: decodeUint16(data, pos),
+                         y: decodeUint16(data, pos + 2),
+                         width: decodeUint16(data, pos + 4),
+                         height: decodeUint16(data, pos + 6) });
+            pos += 8;
+        }
+
+        var atlas = null;
+        if (nTiles > 0) {
+            var blob = new Blob([data.subarray(pos)],{type: "image/png"});
+            atlas = new Image();
+            atlas.onload = handleOutstanding;
+            atlas.onerror = handleOutstanding;
+            atlas.src = window.URL.createObjectURL(blob);
+        }
+
+        delta = { base: getTextureImage(baseId), tiles: tiles, atlas: atlas };
+        pendingTextureDeltas[id] = delta;
+    }
+
+    if (!isImageLoaded(delta.base) || (delta.atlas && !isImageLoaded(delta.atlas)))
+        return false;
+
+    delete pendingTextureDeltas[id];
+
+    if (isImageBroken(delta.base) || (delta.atlas && isImageBroken(delta.atlas))) {
+        /* There is nothing to apply the delta to, ask for the whole texture */
+        if (delta.atlas)
+            window.URL.revokeObjectURL(delta.atlas.src);
+        requestedTextures[id] = [];
+        sendInput("T", [id]);
+        return true;
+    }
+
+    var canvas = document.createElement("canvas");
+    canvas.width = delta.base.naturalWidth || delta.base.width;
+    canvas.height = delta.base.naturalHeight || delta.base.height;
+    var context = canvas.getContext("2d");
+    context.drawImage(delta.base, 0, 0);
+    for (var i = 0; i < delta.tiles.length; i++) {
+        var tile = delta.tiles[i];
+        var tileSize = 32; /* BROADWAY_TEXTURE_TILE_SIZE */
+        context.clearRect(tile.x, tile.y, tile.width, tile.height);
+        context.drawImage(delta.atlas,
+                          0, i * tileSize, tile.width, tile.height,
+                          tile.x, tile.y, tile.width, tile.height);
+    }
+    if (delta.atlas)
+        window.URL.revokeObjectURL(delta.atlas.src);
+
+    textures[id] = canvas.toDataURL();
+    textureImages[id] = canvas;
+    return true;
 }
 
 function cmdGrabPointer(id, ownerEvents)
@@ -744,6 +864,7 @@ function handleCommands(cmd)
 
     while (cmd.pos < cmd.length) {
         var id, x, y, w, h, q;
+        var cmdStart = cmd.pos;
         var command = cmd.get_char();
         lastSerial = cmd.get_32();
         switch (command) {
@@ -821,6 +942,17 @@ function handleCommands(cmd)
             cmdUploadTexture(id, data);
             break;
 
+        case 'U': // Upload texture delta
+            id = cmd.get_32();
+            var baseId = cmd.get_32();
+            var data = cmd.get_data();
+            if (!cmdUploadTextureDelta(id, baseId, data)) {
+                /* Wait for the images, and then start over with this command */
+                cmd.pos = cmdStart;
+                return false;
+            }
+            break;
+
         case 'T': // Release texture
             id = cmd.get_32();
             cmdReleaseTexture(id);
@@ -325,6 +325,53 @@ decode_nodes (BroadwayClient *client,
   return node;
 }
 
+/* Reads the data passed along with a request through the next fd
+ * of the client, or returns %NULL if the client didn't pass one.
+ */
+static GBytes *
+client_read_fd_data (BroadwayClient *client,
+                     guint32         offset,
+                     guint32         size)
+{
+  char *data, *p;
+  gsize to_read;
+  gssize num_read;
+  int fd;
+
+  if (client->fds == NULL)
+    return NULL;
+
+  fd = GPOINTER_TO_INT (client->fds->data);
+  client->fds = g_list_delete_link (client->fds, client->fds);
+
+  data = g_malloc (size);
+  to_read = size;
+  lseek (fd, offset, SEEK_SET);
+
+  p = data;
+  do
+    {
+      num_read = read (fd, p, to_read);
+      if (num_read == -1 && errno == EAGAIN)
+        continue;
+
+      if (num_read > 0)
+        {
+          p += num_read;
+          to_read -= num_read;
+        }
+      else
+        {
+          g_warning ("Unexpected short read of texture");
+          break;
+        }
+    }
+  while (to_read > 0);
+  close (fd);
+
+  return g_bytes_new_take (data, size);
+}
+
 static void
 client_handle_request (BroadwayClient *client,
                        BroadwayRequest *request)
@@ -336,7 +383,7 @@ client_handle_request (BroadwayClient *client,
   BroadwayReplyUngrabPointer reply_ungrab_pointer;
   guint32 before_serial, now_serial;
   guint32 global_id;
-  int fd;
+  GBytes *texture;
 
   before_serial = broadway_server_get_next_serial (server);
 
@@ -410,50 +457,45 @@ client_handle_request (BroadwayClient *client,
       }
       break;
     case BROADWAY_REQUEST_UPLOAD_TEXTURE:
-      if (client->fds == NULL)
-        g_warning ("FD passing mismatch for texture upload %d", request->release_texture.id);
+      texture = client_read_fd_data (client,
+                                     request->upload_texture.offset,
+                                     request->upload_texture.size);
+      if (texture == NULL)
+        g_warning ("FD passing mismatch for texture upload %d", request->upload_texture.id);
       else
         {
-          char *data, *p;
-          gsize to_read;
-          gssize num_read;
-          GBytes *texture;
-
-          fd = GPOINTER_TO_INT (client->fds->data);
-          client->fds = g_list_delete_link (client->fds, client->fds);
+          global_id = broadway_server_upload_texture (server, texture);
+          g_bytes_unref (texture);
 
-          data = g_malloc (request->upload_texture.size);
-          to_read = request->upload_texture.size;
-          lseek (fd, request->upload_texture.offset, SEEK_SET);
+          g_hash_table_replace (client->textures,
+                                GINT_TO_POINTER (request->upload_texture.id),
+                                GINT_TO_POINTER (global_id));
+        }
+      break;
+    case BROADWAY_REQUEST_UPLOAD_TEXTURE_DELTA:
+      texture = client_read_fd_data (client,
+                                     request->upload_texture_delta.offset,
+                                     request->upload_texture_delta.size);
+      if (texture == NULL)
+        g_warning ("FD passing mismatch for texture upload %d", request->upload_texture_delta.id);
+      else
+        {
+          guint32 base_id;
 
-          p = data;
-          do
+          base_id = GPOINTER_TO_INT (g_hash_table_lookup (client->textures,
+                                                          GINT_TO_POINTER (request->upload_texture_delta.base_id)));
+          if (base_id == 0)
+            g_warning ("Texture delta against unknown texture %d", request->upload_texture_delta.base_id);
+          else
             {
-              num_read = read (fd, p, to_read);
-              if (num_read == -1 && errno == EAGAIN)
-                continue;
-
-              if (num_read > 0)
-                {
-                  p += num_read;
-                  to_read -= num_read;
-                }
-              else
-                {
-                  g_warning ("Unexpected short read of texture");
-                  break;
-                }
+              global_id = broadway_server_upload_texture_delta (server, base_id, texture);
+
+              g_hash_table_replace (client->textures,
+                                    GINT_TO_POINTER (request->upload_texture_delta.id),
+                                    GINT_TO_POINTER (global_id));
             }
-          while (to_read > 0);
-          close (fd);
 
-          texture = g_bytes_new_take (data, request->upload_texture.size);
-          global_id = broadway_server_upload_texture (server, texture);
           g_bytes_unref (texture);
-
-          g_hash_table_replace (client->textures,
-                                GINT_TO_POINTER (request->release_texture.id),
-                                GINT_TO_POINTER (global_id));
         }
       break;
     case BROADWAY_REQUEST_RELEASE_TEXTURE:
@@ -36,11 +36,25 @@
 
 typedef struct BroadwayInput BroadwayInput;
 
+/* Number of uploaded textures we keep the pixels of, to send new
+ * textures as a delta against them */
+#define MAX_RECENT_TEXTURES 8
+
+/* Don't let the browser chase chains of deltas longer than this */
+#define MAX_TEXTURE_DELTA_DEPTH 8
+
+typedef struct {
+  guint32 id;
+  guint depth;
+  cairo_surface_t *surface;
+} RecentTexture;
+
 struct _GdkBroadwayServer {
   GObject parent_instance;
 
   guint32 next_serial;
   guint32 next_texture_id;
+  GQueue recent_textures;
   GSocketConnection *connection;
 
   guint32 recv_buffer_size;
@@ -68,9 +82,21 @@ gdk_broadway_server_init (GdkBroadwayServer *server)
   server->next_texture_id = 1;
 }
 
+static void
+recent_texture_free (RecentTexture *recent)
+{
+  cairo_surface_destroy (recent->surface);
+  g_free (recent);
+}
+
 static void
 gdk_broadway_server_finalize (GObject *object)
 {
+  GdkBroadwayServer *server = GDK_BROADWAY_SERVER (object);
+
+  g_queue_foreach (&server->recent_textures, (GFunc) recent_texture_free, NULL);
+  g_queue_clear (&server->recent_textures);
+
   G_OBJECT_CLASS (gdk_broadway_server_parent_class)->finalize (object);
 }
 
@@ -639,28 +665,283 @@ write_png_cb (void         *closure,
   return CAIRO_STATUS_SUCCESS;
 }
 
+static gboolean
+tile_differs (cairo_surface_t *a,
+              cairo_surface_t *b,
+              int              x,
+              int              y,
+              int              width,
+              int              height)
+{
+  int stride = cairo_image_surface_get_stride (a);
+  guchar *a_data = cairo_image_surface_get_data (a) + y * stride + x * 4;
+  guchar *b_data = cairo_image_surface_get_data (b) + y * stride + x * 4;
+  int i;
+
+  for (i = 0; i < height; i++)
+    {
+      if (memcmp (a_data + i * stride, b_data + i * stride, width * 4) != 0)
+        return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Fills @tiles with the rectangles of @surface that differ from
+ * @base, giving up once there are more than @max_tiles of them.
+ */
+static gboolean
+collect_dirty_tiles (cairo_surface_t *surface,
+                     cairo_surface_t *base,
+                     guint            max_tiles,
+                     GArray          *tiles)
+{
+  int width = cairo_image_surface_get_width (surface);
+  int height = cairo_image_surface_get_height (surface);
+  int x, y;
+
+  g_array_set_size (tiles, 0);
+
+  for (y = 0; y < height; y += BROADWAY_TEXTURE_TILE_SIZE)
+    for (x = 0; x < width; x += BROADWAY_TEXTURE_TILE_SIZE)
+      {
+        cairo_rectangle_int_t tile;
+
+        tile.x = x;
+        tile.y = y;
+        tile.width = MIN (BROADWAY_TEXTURE_TILE_SIZE, width - x);
+        tile.height = MIN (BROADWAY_TEXTURE_TILE_SIZE, height - y);
+
+        if (!tile_differs (surface, base, tile.x, tile.y, tile.width, tile.height))
+          continue;
+
+        if (tiles->len == max_tiles)
+          return FALSE;
+
+        g_array_append_val (tiles, tile);
+      }
+
+  return TRUE;
+}
+
+/* Finds the recently uploaded texture that @surface differs least
+ * from, if sending a delta against it is worth it.
+ */
+static RecentTexture *
+find_delta_base (GdkBroadwayServer *server,
+                 cairo_surface_t   *surface,
+                 GArray            *tiles)
+{
+  int width = cairo_image_surface_get_width (surface);
+  int height = cairo_image_surface_get_height (surface);
+  RecentTexture *best = NULL;
+  GArray *candidate_tiles;
+  guint max_tiles;
+  GList *l;
+
+  /* A delta has to save at least half of the tiles */
+  max_tiles = ((width + BROADWAY_TEXTURE_TILE_SIZE - 1) / BROADWAY_TEXTURE_TILE_SIZE) *
+              ((height + BROADWAY_TEXTURE_TILE_SIZE - 1) / BROADWAY_TEXTURE_TILE_SIZE) / 2;
+
+  candidate_tiles = g_array_new (FALSE, FALSE, sizeof (cairo_rectangle_int_t));
+
+  for (l = server->recent_textures.head; l != NULL; l = l->next)
+    {
+      RecentTexture *recent = l->data;
+
+      if (recent->depth >= MAX_TEXTURE_DELTA_DEPTH ||
+          cairo_image_surface_get_width (recent->surface) != width ||
+          cairo_image_surface_get_height (recent->surface) != height)
+        continue;
+
+      if (!collect_dirty_tiles (surface, recent->surface, max_tiles, candidate_tiles))
+        continue;
+
+      best = recent;
+      g_array_set_size (tiles, 0);
+      g_array_append_vals (tiles, candidate_tiles->data, candidate_tiles->len);
+
+      if (tiles->len == 0)
+        break;
+
+      /* Only accept better matches from now on */
+      max_tiles = tiles->len - 1;
+    }
+
+  g_array_free (candidate_tiles, TRUE);
+
+  return best;
+}
+
+static void
+remember_texture (GdkBroadwayServer *server,
+                  guint32            id,
+                  guint              depth,
+                  cairo_surface_t   *surface)
+{
+  RecentTexture *recent;
+
+  if (g_queue_get_length (&server->recent_textures) == MAX_RECENT_TEXTURES)
+    recent_texture_free (g_queue_pop_tail (&server->recent_textures));
+
+  recent = g_new (RecentTexture, 1);
+  recent->id = id;
+  recent->depth = depth;
+  recent->surface = cairo_surface_reference (surface);
+
+  g_queue_push_head (&server->recent_textures, recent);
+}
+
+static void
+forget_texture (GdkBroadwayServer *server,
+                guint32            id)
+{
+  GList *l;
+
+  for (l = server->recent_textures.head; l != NULL; l = l->next)
+    {
+      RecentTexture *recent = l->data;
+
+      if (recent->id == id)
+        {
+          recent_texture_free (recent);
+          g_queue_delete_link (&server->recent_textures, l);
+          break;
+        }
+    }
+}
+
+static void
+append_le16 (guchar  *data,
+             guint16  v)
+{
+  data[0] = v & 0xff;
+  data[1] = (v >> 8) & 0xff;
+}
+
+static gboolean
+write_texture_delta (PngData         *data,
+                     cairo_surface_t *surface,
+                     GArray          *tiles)
+{
+  cairo_surface_t *atlas;
+  guchar *header, *p;
+  gsize header_size;
+  gboolean res;
+  guint i;
+
+  header_size = 4 + tiles->len * 8;
+  header = p = g_malloc (header_size);
+
+  append_le16 (p, tiles->len & 0xffff);
+  append_le16 (p + 2, tiles->len >> 16);
+  p += 4;
+
+  for (i = 0; i < tiles->len; i++)
+    {
+      cairo_rectangle_int_t *tile = &g_array_index (tiles, cairo_rectangle_int_t, i);
+
+      append_le16 (p, tile->x);
+      append_le16 (p + 2, tile->y);
+      append_le16 (p + 4, tile->width);
+      append_le16 (p + 6, tile->height);
+      p += 8;
+    }
+
+  res = write_png_cb (data, header, header_size) == CAIRO_STATUS_SUCCESS;
+  g_free (header);
+
+  if (!res || tiles->len == 0)
+    return res;
+
+  atlas = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+                                      BROADWAY_TEXTURE_TILE_SIZE,
+                                      BROADWAY_TEXTURE_TILE_SIZE * tiles->len);
+
+  for (i = 0; i < tiles->len; i++)
+    {
+      cairo_rectangle_int_t *tile = &g_array_index (tiles, cairo_rectangle_int_t, i);
+      int src_stride = cairo_image_surface_get_stride (surface);
+      int dst_stride = cairo_image_surface_get_stride (atlas);
+      guchar *src = cairo_image_surface_get_data (surface) + tile->y * src_stride + tile->x * 4;
+      guchar *dst = cairo_image_surface_get_data (atlas) + i * BROADWAY_TEXTURE_TILE_SIZE * dst_stride;
+      int y;
+
+      for (y = 0; y < tile->height; y++)
+        memcpy (dst + y * dst_stride, src + y * src_stride, tile->width * 4);
+    }
+
+  cairo_surface_mark_dirty (atlas);
+  res = cairo_surface_write_to_png_stream (atlas, write_png_cb, data) == CAIRO_STATUS_SUCCESS;
+  cairo_surface_destroy (atlas);
+
+  return res;
+}
+
 guint32
 gdk_broadway_server_upload_texture (GdkBroadwayServer *server,
                                     GdkTexture        *texture)
 {
   guint32 id;
   cairo_surface_t *surface = gdk_texture_download_surface (texture);
-  BroadwayRequestUploadTexture msg;
+  RecentTexture *base;
+  GArray *tiles;
   PngData data;
+  guint depth;
 
   id = server->next_texture_id++;
 
   data.fd = open_shared_memory ();
   data.size = 0;
-  cairo_surface_write_to_png_stream (surface, write_png_cb, &data);
 
-  msg.id = id;
-  msg.offset = 0;
-  msg.size = data.size;
+  /* Textures often are the next frame of an animation, so try to
+   * only send the parts that changed relative to a texture we sent
+   * before.
+   */
+  tiles = g_array_new (FALSE, FALSE, sizeof (cairo_rectangle_int_t));
+  base = find_delta_base (server, surface, tiles);
 
-  /* This passes ownership of fd */
-  gdk_broadway_server_send_fd_message (server, msg,
-                                       BROADWAY_REQUEST_UPLOAD_TEXTURE, data.fd);
+  if (base != NULL && write_texture_delta (&data, surface, tiles))
+    {
+      BroadwayRequestUploadTextureDelta msg;
+
+      msg.id = id;
+      msg.base_id = base->id;
+      msg.offset = 0;
+      msg.size = data.size;
+      depth = base->depth + 1;
+
+      /* This passes ownership of fd */
+      gdk_broadway_server_send_fd_message (server, msg,
+                                           BROADWAY_REQUEST_UPLOAD_TEXTURE_DELTA, data.fd);
+    }
+  else
+    {
+      BroadwayRequestUploadTexture msg;
+
+      if (base != NULL)
+        {
+          /* Start over if writing the delta failed half-way */
+          lseek (data.fd, 0, SEEK_SET);
+          data.size = 0;
+        }
+
+      cairo_surface_write_to_png_stream (surface, write_png_cb, &data);
+
+      msg.id = id;
+      msg.offset = 0;
+      msg.size = data.size;
+      depth = 0;
+
+      /* This passes ownership of fd */
+      gdk_broadway_server_send_fd_message (server, msg,
+                                           BROADWAY_REQUEST_UPLOAD_TEXTURE, data.fd);
+    }
+
+  remember_texture (server, id, depth, surface);
+
+  g_array_free (tiles, TRUE);
+  cairo_surface_destroy (surface);
 
   return id;
 }
@@ -672,6 +953,8 @@ gdk_broadway_server_release_texture (GdkBroadwayServer *server,
 {
   BroadwayRequestReleaseTexture msg;
 
+  forget_texture (server, id);
+
   msg.id = id;
 
   gdk_broadway_server_send_message (server, msg,
@@ -273,6 +273,252 @@ static ConversionFunc converters[GDK_MEMORY_N_FORMATS][2] =
   { convert_swizzle_opaque_3012, convert_swizzle_opaque_0321 }
 };
 
+/* Vectorized conversions
+ *
+ * Instead of one specialized function per format pair, the vector code
+ * is driven by a description of the pair that gets computed once: where
+ * every channel of the destination comes from in the source, and whether
+ * alpha needs to be multiplied in. The vector code converts as much of
+ * every row as it can and leaves the remaining pixels to the functions
+ * above, so both produce identical results.
+ */
+
+typedef struct _FormatLayout FormatLayout;
+
+struct _FormatLayout {
+  guint bytes_per_pixel;
+  gboolean premultiplied;
+  /* byte offsets of alpha, red, green and blue; alpha is -1 if opaque */
+  int channels[4];
+};
+
+static const FormatLayout format_layouts[GDK_MEMORY_N_FORMATS] = {
+  [GDK_MEMORY_B8G8R8A8_PREMULTIPLIED] = { 4, TRUE,  {  3, 2, 1, 0 } },
+  [GDK_MEMORY_A8R8G8B8_PREMULTIPLIED] = { 4, TRUE,  {  0, 1, 2, 3 } },
+  [GDK_MEMORY_B8G8R8A8]               = { 4, FALSE, {  3, 2, 1, 0 } },
+  [GDK_MEMORY_A8R8G8B8]               = { 4, FALSE, {  0, 1, 2, 3 } },
+  [GDK_MEMORY_R8G8B8A8]               = { 4, FALSE, {  3, 0, 1, 2 } },
+  [GDK_MEMORY_A8B8G8R8]               = { 4, FALSE, {  0, 3, 2, 1 } },
+  [GDK_MEMORY_R8G8B8]                 = { 3, TRUE,  { -1, 0, 1, 2 } },
+  [GDK_MEMORY_B8G8R8]                 = { 3, TRUE,  { -1, 2, 1, 0 } },
+};
+
+typedef struct _Conversion Conversion;
+
+struct _Conversion {
+  guint src_bpp;
+  gboolean premultiply;
+  /* byte offset in the source pixel for every destination byte,
+   * 0x80 if the byte is an opaque alpha value */
+  guchar shuffle[4];
+  /* offset of alpha in the destination pixel */
+  guint alpha;
+};
+
+typedef gsize (* VectorConversionFunc) (guchar           *dest_data,
+                                        const guchar     *src_data,
+                                        gsize             width,
+                                        const Conversion *conversion);
+
+static void
+conversion_init (Conversion      *conversion,
+                 GdkMemoryFormat  dest_format,
+                 GdkMemoryFormat  src_format)
+{
+  const FormatLayout *dest = &format_layouts[dest_format];
+  const FormatLayout *src = &format_layouts[src_format];
+  guint i;
+
+  conversion->src_bpp = src->bytes_per_pixel;
+  conversion->premultiply = !src->premultiplied;
+  conversion->alpha = dest->channels[0];
+
+  for (i = 0; i < 4; i++)
+    {
+      if (src->channels[i] < 0)
+        conversion->shuffle[dest->channels[i]] = 0x80;
+      else
+        conversion->shuffle[dest->channels[i]] = src->channels[i];
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_SSSE3_CONVERSION 1
+#include <tmmintrin.h>
+
+/* Same rounding as PREMULTIPLY(), on 8 16-bit values at once */
+__attribute__ ((target ("ssse3")))
+static inline __m128i
+premultiply_epi16 (__m128i c,
+                   __m128i a)
+{
+  __m128i t = _mm_add_epi16 (_mm_mullo_epi16 (c, a), _mm_set1_epi16 (0x80));
+
+  return _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+}
+
+/* Converts 4 pixels per iteration with a single byte shuffle */
+__attribute__ ((target ("ssse3")))
+static gsize
+convert_ssse3 (guchar           *dest_data,
+               const guchar     *src_data,
+               gsize             width,
+               const Conversion *conversion)
+{
+  guchar shuffle[16], alpha_shuffle[16], opaque[16];
+  __m128i shuffle_mask, alpha_mask, opaque_mask;
+  const __m128i zero = _mm_setzero_si128 ();
+  guint bpp = conversion->src_bpp;
+  gsize x, n;
+  guint i;
+
+  for (i = 0; i < 16; i++)
+    {
+      guint pixel = i / 4, byte = i % 4;
+
+      if (conversion->shuffle[byte] == 0x80)
+        shuffle[i] = 0x80;
+      else
+        shuffle[i] = pixel * bpp + conversion->shuffle[byte];
+
+      /* alpha gets multiplied with 255, which leaves it unchanged */
+      alpha_shuffle[i] = byte == conversion->alpha ? 0x80 : pixel * 4 + conversion->alpha;
+      opaque[i] = byte == conversion->alpha ? 0xFF : 0;
+    }
+
+  shuffle_mask = _mm_loadu_si128 ((const __m128i *) shuffle);
+  alpha_mask = _mm_loadu_si128 ((const __m128i *) alpha_shuffle);
+  opaque_mask = _mm_loadu_si128 ((const __m128i *) opaque);
+
+  /* Every load reads 16 bytes, even if only 12 are used for 3 byte
+   * formats, so stop early enough to not read past the row. */
+  n = bpp == 4 ? width : (width * 3 >= 16 ? (width * 3 - 16) / 12 * 4 + 4 : 0);
+  n -= n % 4;
+
+  if (bpp == 3)
+    {
+      for (x = 0; x < n; x += 4)
+        {
+          __m128i p = _mm_loadu_si128 ((const __m128i *) (src_data + 3 * x));
+
+          p = _mm_or_si128 (_mm_shuffle_epi8 (p, shuffle_mask), opaque_mask);
+          _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), p);
+        }
+    }
+  else if (!conversion->premultiply)
+    {
+      for (x = 0; x < n; x += 4)
+        {
+          __m128i p = _mm_loadu_si128 ((const __m128i *) (src_data + 4 * x));
+
+          _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), _mm_shuffle_epi8 (p, shuffle_mask));
+        }
+    }
+  else
+    {
+      for (x = 0; x < n; x += 4)
+        {
+          __m128i p, a, lo, hi;
+
+          p = _mm_loadu_si128 ((const __m128i *) (src_data + 4 * x));
+          p = _mm_shuffle_epi8 (p, shuffle_mask);
+          a = _mm_or_si128 (_mm_shuffle_epi8 (p, alpha_mask), opaque_mask);
+
+          lo = premultiply_epi16 (_mm_unpacklo_epi8 (p, zero), _mm_unpacklo_epi8 (a, zero));
+          hi = premultiply_epi16 (_mm_unpackhi_epi8 (p, zero), _mm_unpackhi_epi8 (a, zero));
+
+          _mm_storeu_si128 ((__m128i *) (dest_data + 4 * x), _mm_packus_epi16 (lo, hi));
+        }
+    }
+
+  return n;
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_CONVERSION 1
+#include <arm_neon.h>
+
+/* Same rounding as PREMULTIPLY() */
+static inline uint8x16_t
+premultiply_u8 (uint8x16_t c,
+                uint8x16_t a)
+{
+  uint16x8_t lo = vmull_u8 (vget_low_u8 (c), vget_low_u8 (a));
+  uint16x8_t hi = vmull_u8 (vget_high_u8 (c), vget_high_u8 (a));
+
+  return vcombine_u8 (vraddhn_u16 (lo, vrshrq_n_u16 (lo, 8)),
+                      vraddhn_u16 (hi, vrshrq_n_u16 (hi, 8)));
+}
+
+/* Converts 16 pixels per iteration using the deinterleaving loads */
+static gsize
+convert_neon (guchar           *dest_data,
+              const guchar     *src_data,
+              gsize             width,
+              const Conversion *conversion)
+{
+  guint a = conversion->alpha;
+  gsize x, n;
+  guint i;
+
+  n = width - width % 16;
+
+  for (x = 0; x < n; x += 16)
+    {
+      uint8x16x4_t src, dest;
+
+      if (conversion->src_bpp == 3)
+        {
+          uint8x16x3_t rgb = vld3q_u8 (src_data + 3 * x);
+
+          src.val[0] = rgb.val[0];
+          src.val[1] = rgb.val[1];
+          src.val[2] = rgb.val[2];
+          src.val[3] = vdupq_n_u8 (0xFF);
+        }
+      else
+        src = vld4q_u8 (src_data + 4 * x);
+
+      for (i = 0; i < 4; i++)
+        dest.val[i] = src.val[conversion->shuffle[i] == 0x80 ? 3 : conversion->shuffle[i]];
+
+      if (conversion->premultiply)
+        {
+          for (i = 0; i < 4; i++)
+            if (i != a)
+              dest.val[i] = premultiply_u8 (dest.val[i], dest.val[a]);
+        }
+
+      vst4q_u8 (dest_data + 4 * x, dest);
+    }
+
+  return n;
+}
+#endif
+
+static VectorConversionFunc
+get_vector_conversion_func (void)
+{
+  static VectorConversionFunc func = NULL;
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+#if defined(HAVE_SSSE3_CONVERSION)
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("ssse3"))
+        func = convert_ssse3;
+#elif defined(HAVE_NEON_CONVERSION)
+      func = convert_neon;
+#endif
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return func;
+}
+
 void
 gdk_memory_convert (guchar          *dest_data,
                     gsize            dest_stride,
@@ -283,8 +529,32 @@ gdk_memory_convert (guchar          *dest_data,
                     gsize            width,
                     gsize            height)
 {
+  VectorConversionFunc vector_func;
+  Conversion conversion;
+  gsize y, n;
+
   g_assert (dest_format < 2);
   g_assert (src_format < GDK_MEMORY_N_FORMATS);
 
-  converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
+  vector_func = get_vector_conversion_func ();
+
+  if (vector_func == NULL || converters[src_format][dest_format] == convert_memcpy)
+    {
+      converters[src_format][dest_format] (dest_data, dest_stride, src_data, src_stride, width, height);
+      return;
+    }
+
+  conversion_init (&conversion, dest_format, src_format);
+
+  for (y = 0; y < height; y++)
+    {
+      n = vector_func (dest_data, src_data, width, &conversion);
+      if (n < width)
+        converters[src_format][dest_format] (dest_data + 4 * n, dest_stride,
+                                             src_data + conversion.src_bpp * n, src_stride,
+                                             width - n, 1);
+
+      dest_data += dest_stride;
+      src_data += src_stride;
+    }
 }
@@ -2,6 +2,7 @@
 
 #include "gskgldriverprivate.h"
 
+#include "gskglskylineprivate.h"
 #include "gskdebugprivate.h"
 #include "gskprofilerprivate.h"
 #include "gdk/gdktextureprivate.h"
@@ -9,6 +10,7 @@
 
 #include <gdk/gdk.h>
 #include <epoxy/gl.h>
+#include <string.h>
 
  typedef struct {
   GLuint fbo_id;
@@ -31,6 +33,26 @@ typedef struct {
   guint n_slices;
 } Texture;
 
+/* Small textures get packed into shared atlas pages instead of getting a
+ * texture of their own, so drawing a lot of icons doesn't need a texture
+ * bind for every one of them. */
+#define ATLAS_PAGE_SIZE 1024
+#define MAX_ATLAS_PAGES 8
+#define MAX_ATLAS_ITEM_SIZE 128
+
+typedef struct {
+  GLuint texture_id;
+  GskGLSkyline skyline;
+  guint n_items;
+} AtlasPage;
+
+typedef struct {
+  GskGLDriver *driver;
+  AtlasPage *page;
+  GdkTexture *user;
+  graphene_rect_t region; /* in texture coordinates of the page */
+} AtlasItem;
+
 struct _GskGLDriver
 {
   GObject parent_instance;
@@ -47,9 +69,21 @@ struct _GskGLDriver
 
   GHashTable *textures;
 
+  /* Also used as the render data key of the textures in the atlas */
+  GPtrArray *atlas_pages;
+  GHashTable *atlas_items;
+  /* AtlasPage, once for every item released since the last frame */
+  GPtrArray *released_atlas_items;
+
   const Texture *bound_source_texture;
   const Fbo *bound_fbo;
 
+  /* Vertex data for the current frame, streamed into one persistent buffer */
+  GArray *vertices;
+  GLuint vao_id;
+  GLuint vertex_buffer_id;
+  gsize vertex_buffer_size;
+
   int max_texture_size;
 
   gboolean in_frame : 1;
@@ -99,6 +133,49 @@ texture_free (gpointer data)
   g_slice_free (Texture, t);
 }
 
+static void
+atlas_page_free (gpointer data)
+{
+  AtlasPage *page = data;
+
+  /* The GL texture is a permanent one and goes away with the others */
+  gsk_gl_skyline_finish (&page->skyline);
+  g_slice_free (AtlasPage, page);
+}
+
+/* Called when the GdkTexture goes away. This can happen in the middle
+ * of a frame, when draws that were already recorded still sample the
+ * item, so its space is only given back in the next begin_frame(). */
+static void
+atlas_item_free (gpointer data)
+{
+  AtlasItem *item = data;
+
+  g_hash_table_remove (item->driver->atlas_items, item);
+  g_ptr_array_add (item->driver->released_atlas_items, item->page);
+
+  g_slice_free (AtlasItem, item);
+}
+
+static void
+gsk_gl_driver_release_atlas_items (GskGLDriver *self)
+{
+  guint i;
+
+  for (i = 0; i < self->released_atlas_items->len; i++)
+    {
+      AtlasPage *page = g_ptr_array_index (self->released_atlas_items, i);
+
+      /* We can't reuse the space of single items, but once a page is empty
+       * it can be filled up again. */
+      page->n_items--;
+      if (page->n_items == 0)
+        gsk_gl_skyline_reset (&page->skyline);
+    }
+
+  g_ptr_array_set_size (self->released_atlas_items, 0);
+}
+
 static void
 gsk_gl_driver_set_texture_parameters (GskGLDriver *self,
                                       int          min_filter,
@@ -115,12 +192,31 @@ static void
 gsk_gl_driver_finalize (GObject *gobject)
 {
   GskGLDriver *self = GSK_GL_DRIVER (gobject);
+  GList *items, *l;
 
   gdk_gl_context_make_current (self->gl_context);
 
+  items = g_hash_table_get_keys (self->atlas_items);
+  for (l = items; l != NULL; l = l->next)
+    {
+      AtlasItem *item = l->data;
+
+      gdk_texture_clear_render_data (item->user);
+    }
+  g_list_free (items);
+
+  g_clear_pointer (&self->atlas_items, g_hash_table_unref);
+  g_clear_pointer (&self->released_atlas_items, g_ptr_array_unref);
+  g_clear_pointer (&self->atlas_pages, g_ptr_array_unref);
   g_clear_pointer (&self->textures, g_hash_table_unref);
+  g_clear_pointer (&self->vertices, g_array_unref);
   g_clear_object (&self->profiler);
 
+  if (self->vao_id != 0)
+    glDeleteVertexArrays (1, &self->vao_id);
+  if (self->vertex_buffer_id != 0)
+    glDeleteBuffers (1, &self->vertex_buffer_id);
+
   if (self->gl_context == gdk_gl_context_get_current ())
     gdk_gl_context_clear_current ();
 
@@ -139,6 +235,10 @@ static void
 gsk_gl_driver_init (GskGLDriver *self)
 {
   self->textures = g_hash_table_new_full (NULL, NULL, NULL, texture_free);
+  self->atlas_pages = g_ptr_array_new_with_free_func (atlas_page_free);
+  self->atlas_items = g_hash_table_new (NULL, NULL);
+  self->released_atlas_items = g_ptr_array_new ();
+  self->vertices = g_array_new (FALSE, FALSE, sizeof (GskQuadVertex));
 
   self->max_texture_size = -1;
 
@@ -199,6 +299,11 @@ gsk_gl_driver_begin_frame (GskGLDriver *self)
 
   glActiveTexture (GL_TEXTURE0);
 
+  g_array_set_size (self->vertices, 0);
+
+  /* Nothing from the last frame samples the atlas anymore */
+  gsk_gl_driver_release_atlas_items (self);
+
 #ifdef G_ENABLE_DEBUG
   gsk_profiler_reset (self->profiler);
 #endif
@@ -226,12 +331,81 @@ gsk_gl_driver_end_frame (GskGLDriver *self)
 #endif
 
   GSK_NOTE (OPENGL,
-            g_message ("*** Frame end: textures=%d",
-                     g_hash_table_size (self->textures)));
+            g_message ("*** Frame end: textures=%d, atlas pages=%d, atlas items=%d",
+                     g_hash_table_size (self->textures),
+                     self->atlas_pages->len,
+                     g_hash_table_size (self->atlas_items)));
 
   self->in_frame = FALSE;
 }
 
+/* Returns the index of the first of the added vertices */
+gsize
+gsk_gl_driver_add_vertices (GskGLDriver         *self,
+                            const GskQuadVertex *vertices,
+                            guint                n_vertices)
+{
+  gsize offset;
+
+  g_return_val_if_fail (GSK_IS_GL_DRIVER (self), 0);
+  g_return_val_if_fail (self->in_frame, 0);
+
+  offset = self->vertices->len;
+  g_array_append_vals (self->vertices, vertices, n_vertices);
+
+  return offset;
+}
+
+void
+gsk_gl_driver_bind_vertices (GskGLDriver *self)
+{
+  gsize size;
+
+  g_return_if_fail (GSK_IS_GL_DRIVER (self));
+  g_return_if_fail (self->in_frame);
+
+  if (self->vao_id == 0)
+    {
+      glGenVertexArrays (1, &self->vao_id);
+      glBindVertexArray (self->vao_id);
+
+      glGenBuffers (1, &self->vertex_buffer_id);
+      glBindBuffer (GL_ARRAY_BUFFER, self->vertex_buffer_id);
+
+      /* The attribute locations are the same for all our programs,
+       * and the VAO remembers the buffer, so set them up only once. */
+
+      /* 0 = position location */
+      glEnableVertexAttribArray (0);
+      glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE,
+                             sizeof (GskQuadVertex),
+                             (void *) G_STRUCT_OFFSET (GskQuadVertex, position));
+      /* 1 = texture coord location */
+      glEnableVertexAttribArray (1);
+      glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE,
+                             sizeof (GskQuadVertex),
+                             (void *) G_STRUCT_OFFSET (GskQuadVertex, uv));
+    }
+  else
+    {
+      glBindVertexArray (self->vao_id);
+      glBindBuffer (GL_ARRAY_BUFFER, self->vertex_buffer_id);
+    }
+
+  size = self->vertices->len * sizeof (GskQuadVertex);
+  if (size == 0)
+    return;
+
+  /* Respecifying the storage orphans the buffer contents of the previous
+   * frame, so the driver can hand us fresh memory instead of waiting for
+   * the GPU to be done with the old one. Only grow it if it is too small. */
+  if (size > self->vertex_buffer_size)
+    self->vertex_buffer_size = MAX (size, self->vertex_buffer_size * 2);
+
+  glBufferData (GL_ARRAY_BUFFER, self->vertex_buffer_size, NULL, GL_STREAM_DRAW);
+  glBufferSubData (GL_ARRAY_BUFFER, 0, size, self->vertices->data);
+}
+
 int
 gsk_gl_driver_collect_textures (GskGLDriver *self)
 {
@@ -520,6 +694,10 @@ gsk_gl_driver_get_texture_for_texture (GskGLDriver *self,
     }
   else
     {
+      /* Whoever asks for this needs the texture on its own, not in the atlas */
+      if (gdk_texture_get_render_data (texture, self->atlas_pages) != NULL)
+        gdk_texture_clear_render_data (texture);
+
       t = gdk_texture_get_render_data (texture, self);
 
       if (t)
@@ -547,6 +725,142 @@ gsk_gl_driver_get_texture_for_texture (GskGLDriver *self,
   return t->texture_id;
 }
 
+static AtlasPage *
+atlas_page_new (GskGLDriver *self)
+{
+  int size = MIN (ATLAS_PAGE_SIZE, self->max_texture_size);
+  AtlasPage *page;
+  Texture *t;
+
+  t = create_texture (self, size, size);
+  t->permanent = TRUE;
+  t->min_filter = GL_LINEAR;
+  t->mag_filter = GL_LINEAR;
+
+  gsk_gl_driver_bind_source_texture (self, t->texture_id);
+  gsk_gl_driver_init_texture_empty (self, t->texture_id);
+
+  page = g_slice_new0 (AtlasPage);
+  page->texture_id = t->texture_id;
+  gsk_gl_skyline_init (&page->skyline, size, size);
+
+  GSK_NOTE (OPENGL, g_message ("Created texture atlas page %d (%dx%d)",
+                               page->texture_id, size, size));
+
+  return page;
+}
+
+static AtlasItem *
+atlas_add_texture (GskGLDriver *self,
+                   GdkTexture  *texture)
+{
+  /* Every texture gets a 1px border with copies of its edge pixels,
+   * so that linear filtering doesn't pick up its neighbours. */
+  const int width = texture->width + 2;
+  const int height = texture->height + 2;
+  const gsize stride = width * 4;
+  AtlasPage *page = NULL;
+  AtlasItem *item;
+  guchar *data;
+  int x, y;
+  guint i;
+  int row;
+
+  for (i = 0; i < self->atlas_pages->len; i++)
+    {
+      page = g_ptr_array_index (self->atlas_pages, i);
+
+      if (gsk_gl_skyline_pack (&page->skyline, width, height, &x, &y))
+        break;
+    }
+
+  if (i == self->atlas_pages->len)
+    {
+      if (self->atlas_pages->len >= MAX_ATLAS_PAGES)
+        return NULL;
+
+      page = atlas_page_new (self);
+      g_ptr_array_add (self->atlas_pages, page);
+
+      if (!gsk_gl_skyline_pack (&page->skyline, width, height, &x, &y))
+        return NULL;
+    }
+
+  data = g_malloc (height * stride);
+  gdk_texture_download (texture, data + stride + 4, stride);
+
+  memcpy (data, data + stride, stride);
+  memcpy (data + (height - 1) * stride, data + (height - 2) * stride, stride);
+  for (row = 0; row < height; row++)
+    {
+      guint32 *pixels = (guint32 *) (data + row * stride);
+
+      pixels[0] = pixels[1];
+      pixels[width - 1] = pixels[width - 2];
+    }
+
+  gsk_gl_driver_bind_source_texture (self, page->texture_id);
+  glBindTexture (GL_TEXTURE_2D, page->texture_id);
+  glTexSubImage2D (GL_TEXTURE_2D, 0, x, y, width, height,
+                   GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, data);
+  g_free (data);
+
+#ifdef G_ENABLE_DEBUG
+  gsk_profiler_counter_inc (self->profiler, self->counters.surface_uploads);
+#endif
+
+  item = g_slice_new0 (AtlasItem);
+  item->driver = self;
+  item->page = page;
+  item->user = texture;
+  graphene_rect_init (&item->region,
+                      (float) (x + 1) / page->skyline.width,
+                      (float) (y + 1) / page->skyline.height,
+                      (float) texture->width / page->skyline.width,
+                      (float) texture->height / page->skyline.height);
+
+  page->n_items++;
+  g_hash_table_add (self->atlas_items, item);
+  gdk_texture_set_render_data (texture, self->atlas_pages, item, atlas_item_free);
+
+  return item;
+}
+
+/* Like gsk_gl_driver_get_texture_for_texture(), but small textures may end
+ * up sharing their GL texture with others. @out_region is set to the part
+ * of the returned texture that contains @texture, in texture coordinates. */
+int
+gsk_gl_driver_get_texture_region (GskGLDriver     *self,
+                                  GdkTexture      *texture,
+                                  int              min_filter,
+                                  int              mag_filter,
+                                  graphene_rect_t *out_region)
+{
+  AtlasItem *item;
+
+  g_return_val_if_fail (GSK_IS_GL_DRIVER (self), 0);
+  g_return_val_if_fail (self->in_frame, 0);
+
+  item = gdk_texture_get_render_data (texture, self->atlas_pages);
+  if (item == NULL &&
+      texture->render_key == NULL &&
+      !GDK_IS_GL_TEXTURE (texture) &&
+      texture->width <= MAX_ATLAS_ITEM_SIZE &&
+      texture->height <= MAX_ATLAS_ITEM_SIZE &&
+      min_filter == GL_LINEAR && mag_filter == GL_LINEAR)
+    item = atlas_add_texture (self, texture);
+
+  if (item != NULL)
+    {
+      *out_region = item->region;
+      return item->page->texture_id;
+    }
+
+  graphene_rect_init (out_region, 0, 0, 1, 1);
+
+  return gsk_gl_driver_get_texture_for_texture (self, texture, min_filter, mag_filter);
+}
+
 int
 gsk_gl_driver_create_permanent_texture (GskGLDriver *self,
                                         float        width,
@@ -33,6 +33,11 @@ int             gsk_gl_driver_get_texture_for_texture   (GskGLDriver     *driver
                                                          GdkTexture      *texture,
                                                          int              min_filter,
                                                          int              mag_filter);
+int             gsk_gl_driver_get_texture_region        (GskGLDriver     *driver,
+                                                         GdkTexture      *texture,
+                                                         int              min_filter,
+                                                         int              mag_filter,
+                                                         graphene_rect_t *out_region);
 int             gsk_gl_driver_create_permanent_texture  (GskGLDriver     *driver,
                                                          float            width,
                                                          float            height);
@@ -60,6 +65,11 @@ void            gsk_gl_driver_init_texture_with_surface (GskGLDriver     *driver
 void            gsk_gl_driver_destroy_texture           (GskGLDriver     *driver,
                                                          int              texture_id);
 
+gsize           gsk_gl_driver_add_vertices              (GskGLDriver     *driver,
+                                                         const GskQuadVertex *vertices,
+                                                         guint            n_vertices);
+void            gsk_gl_driver_bind_vertices             (GskGLDriver     *driver);
+
 int             gsk_gl_driver_collect_textures          (GskGLDriver     *driver);
 void            gsk_gl_driver_slice_texture             (GskGLDriver     *self,
                                                          GdkTexture      *texture,
@@ -22,13 +22,18 @@
 #define CHECK_INTERVAL 10
 #define MAX_OLD 0.333
 
-#define ATLAS_SIZE 512
+/* Atlases start out small and double in size when they are full, up to
+ * MAX_ATLAS_SIZE or the maximum texture size, whichever is smaller.
+ * Only then do we start a new one. */
+#define INITIAL_ATLAS_SIZE 512
+#define MAX_ATLAS_SIZE 4096
 
 typedef struct
 {
   PangoFont *font;
   PangoGlyph glyph;
   guint scale; /* times 1024 */
+  guint subpixel_x; /* in 1 / GSK_GL_GLYPH_SUBPIXEL_STEPS pixels */
 } GlyphCacheKey;
 
 typedef struct
@@ -52,15 +57,14 @@ create_atlas (GskGLGlyphCache *cache)
   GskGLGlyphAtlas *atlas;
 
   atlas = g_new0 (GskGLGlyphAtlas, 1);
-  atlas->width = ATLAS_SIZE;
-  atlas->height = ATLAS_SIZE;
-  atlas->y0 = 1;
-  atlas->y = 1;
-  atlas->x = 1;
+  atlas->width = INITIAL_ATLAS_SIZE;
+  atlas->height = INITIAL_ATLAS_SIZE;
   atlas->image = NULL;
   atlas->num_glyphs = 0;
   atlas->dirty_glyphs = NULL;
 
+  gsk_gl_skyline_init (&atlas->skyline, atlas->width, atlas->height);
+
   return atlas;
 }
 
@@ -75,9 +79,26 @@ free_atlas (gpointer v)
       g_free (atlas->image);
     }
   g_list_free_full (atlas->dirty_glyphs, dirty_glyph_free);
+  gsk_gl_skyline_finish (&atlas->skyline);
   g_free (atlas);
 }
 
+static void
+free_retired_images (GskGLGlyphCache *self)
+{
+  guint i;
+
+  for (i = 0; i < self->retired_images->len; i ++)
+    {
+      GskGLImage *image = g_ptr_array_index (self->retired_images, i);
+
+      gsk_gl_image_destroy (image, self->gl_driver);
+      g_free (image);
+    }
+
+  g_ptr_array_set_size (self->retired_images, 0);
+}
+
 void
 gsk_gl_glyph_cache_init (GskGLGlyphCache *self,
                          GskRenderer     *renderer,
@@ -87,6 +108,7 @@ gsk_gl_glyph_cache_init (GskGLGlyphCache *self,
                                             glyph_cache_key_free, glyph_cache_value_free);
   self->atlases = g_ptr_array_new_with_free_func (free_atlas);
   g_ptr_array_add (self->atlases, create_atlas (self));
+  self->retired_images = g_ptr_array_new ();
 
   self->renderer = renderer;
   self->gl_driver = gl_driver;
@@ -108,7 +130,10 @@ gsk_gl_glyph_cache_free (GskGLGlyphCache *self)
         }
     }
 
+  free_retired_images (self);
+
   g_ptr_array_unref (self->atlases);
+  g_ptr_array_unref (self->retired_images);
   g_hash_table_unref (self->hash_table);
 }
 
@@ -120,7 +145,8 @@ glyph_cache_equal (gconstpointer v1, gconstpointer v2)
 
   return key1->font == key2->font &&
          key1->glyph == key2->glyph &&
-         key1->scale == key2->scale;
+         key1->scale == key2->scale &&
+         key1->subpixel_x == key2->subpixel_x;
 }
 
 static guint
@@ -128,7 +154,7 @@ glyph_cache_hash (gconstpointer v)
 {
   const GlyphCacheKey *key = v;
 
-  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ key->scale;
+  return GPOINTER_TO_UINT (key->font) ^ key->glyph ^ key->scale ^ (key->subpixel_x << 24);
 }
 
 static void
@@ -156,50 +182,130 @@ dirty_glyph_free (gpointer v)
   g_free (glyph);
 }
 
+static int
+get_max_atlas_size (GskGLGlyphCache *cache)
+{
+  return MIN (MAX_ATLAS_SIZE, gsk_gl_driver_get_max_texture_size (cache->gl_driver));
+}
+
+/* Doubles the size of @atlas. The glyphs keep their pixel positions, but
+ * their texture coordinates change, and they all need to be uploaded to the
+ * new, bigger texture. The old texture may still be used by draw calls of
+ * the current frame, so it is only destroyed in the next one. */
+static gboolean
+grow_atlas (GskGLGlyphCache *cache,
+            GskGLGlyphAtlas *atlas)
+{
+  int max_size = get_max_atlas_size (cache);
+  int new_width, new_height;
+  GHashTableIter iter;
+  GlyphCacheKey *key;
+  GskGLCachedGlyph *value;
+
+  if (atlas->width >= max_size && atlas->height >= max_size)
+    return FALSE;
+
+  new_width = MIN (atlas->width * 2, max_size);
+  new_height = MIN (atlas->height * 2, max_size);
+
+  GSK_RENDERER_NOTE (cache->renderer, GLYPH_CACHE,
+                     g_message ("Growing atlas from %dx%d to %dx%d",
+                                atlas->width, atlas->height, new_width, new_height));
+
+  gsk_gl_skyline_resize (&atlas->skyline, new_width, new_height);
+
+  if (atlas->image)
+    {
+      g_ptr_array_add (cache->retired_images, atlas->image);
+      atlas->image = NULL;
+    }
+
+  g_list_free_full (atlas->dirty_glyphs, dirty_glyph_free);
+  atlas->dirty_glyphs = NULL;
+
+  g_hash_table_iter_init (&iter, cache->hash_table);
+  while (g_hash_table_iter_next (&iter, (gpointer *)&key, (gpointer *)&value))
+    {
+      DirtyGlyph *dirty;
+
+      if (value->atlas != atlas)
+        continue;
+
+      value->tx = value->tx * atlas->width / new_width;
+      value->ty = value->ty * atlas->height / new_height;
+      value->tw = value->tw * atlas->width / new_width;
+      value->th = value->th * atlas->height / new_height;
+
+      dirty = g_new0 (DirtyGlyph, 1);
+      dirty->key = key;
+      dirty->value = value;
+      atlas->dirty_glyphs = g_list_prepend (atlas->dirty_glyphs, dirty);
+    }
+
+  atlas->width = new_width;
+  atlas->height = new_height;
+
+  return TRUE;
+}
+
 static void
 add_to_cache (GskGLGlyphCache  *cache,
               GlyphCacheKey        *key,
               GskGLCachedGlyph *value)
 {
-  GskGLGlyphAtlas *atlas;
+  GskGLGlyphAtlas *atlas = NULL;
   int i;
   DirtyGlyph *dirty;
   int width = value->draw_width * key->scale / 1024;
   int height = value->draw_height * key->scale / 1024;
+  int max_size = get_max_atlas_size (cache);
+  int x, y;
 
-  for (i = 0; i < cache->atlases->len; i++)
+  /* Glyphs that don't fit into an atlas of the maximum size are drawn
+   * on their own, see gsk_gl_glyph_cache_get_uncached_texture(). Don't
+   * grow the atlases for them. */
+  if (width + 1 > max_size || height + 1 > max_size)
     {
-      int x, y, y0;
+      GSK_RENDERER_NOTE (cache->renderer, GLYPH_CACHE,
+                         g_message ("Glyph of %dx%d is too big for the atlas", width, height));
+      return;
+    }
 
+  for (i = 0; i < cache->atlases->len; i++)
+    {
       atlas = g_ptr_array_index (cache->atlases, i);
-      x = atlas->x;
-      y = atlas->y;
-      y0 = atlas->y0;
 
-      if (atlas->x + width + 1 >= atlas->width)
-        {
-          /* start a new row */
-          y0 = y + 1;
-          x = 1;
-        }
-
-      if (y0 + height + 1 >= atlas->height)
-        continue;
-
-      atlas->y0 = y0;
-      atlas->x = x;
-      atlas->y = y;
-      break;
+      if (gsk_gl_skyline_pack (&atlas->skyline, width + 1, height + 1, &x, &y))
+        break;
     }
 
   if (i == cache->atlases->len)
     {
+      for (i = 0; i < cache->atlases->len; i++)
+        {
+          atlas = g_ptr_array_index (cache->atlases, i);
+
+          while (grow_atlas (cache, atlas))
+            {
+              if (gsk_gl_skyline_pack (&atlas->skyline, width + 1, height + 1, &x, &y))
+                goto found;
+            }
+        }
+
       atlas = create_atlas (cache);
       g_ptr_array_add (cache->atlases, atlas);
+
+      /* The size was checked above, so this fits once the atlas is big enough */
+      while (!gsk_gl_skyline_pack (&atlas->skyline, width + 1, height + 1, &x, &y))
+        {
+          if (!grow_atlas (cache, atlas))
+            g_assert_not_reached ();
+        }
     }
 
-  value->tx = (float)atlas->x / atlas->width;
-  value->ty = (float)atlas->y0 / atlas->height;
+found:
+  value->tx = (float)x / atlas->width;
+  value->ty = (float)y / atlas->height;
   value->tw = (float)width / atlas->width;
   value->th = (float)height / atlas->height;
 
@@ -210,9 +316,6 @@ add_to_cache (GskGLGlyphCache  *cache,
   dirty->value = value;
   atlas->dirty_glyphs = g_list_prepend (atlas->dirty_glyphs, dirty);
 
-  atlas->x = atlas->x + width + 1;
-  atlas->y = MAX (atlas->y, atlas->y0 + height + 1);
-
   atlas->num_glyphs++;
 
 #ifdef G_ENABLE_DEBUG
@@ -222,23 +325,21 @@ add_to_cache (GskGLGlyphCache  *cache,
       for (i = 0; i < cache->atlases->len; i++)
         {
           atlas = g_ptr_array_index (cache->atlases, i);
-          g_print ("\tGskGLGlyphAtlas %d (%dx%d): %d glyphs (%d dirty), %.2g%% old pixels, filled to %d, %d / %d\n",
+          g_print ("\tGskGLGlyphAtlas %d (%dx%d): %d glyphs (%d dirty), %.2g%% old pixels, %d skyline nodes\n",
                    i, atlas->width, atlas->height,
                    atlas->num_glyphs, g_list_length (atlas->dirty_glyphs),
                    100.0 * (double)atlas->old_pixels / (double)(atlas->width * atlas->height),
-                   atlas->x, atlas->y0, atlas->y);
+                   atlas->skyline.nodes->len);
         }
     }
 #endif
 }
 
-static void
-render_glyph (const GskGLGlyphAtlas *atlas,
-              DirtyGlyph            *glyph,
-              GskImageRegion        *region)
+/* Draws the glyph in white into a new surface of its size in device pixels */
+static cairo_surface_t *
+render_glyph_surface (const GlyphCacheKey    *key,
+                      const GskGLCachedGlyph *value)
 {
-  GlyphCacheKey *key = glyph->key;
-  GskGLCachedGlyph *value = glyph->value;
   cairo_surface_t *surface;
   cairo_t *cr;
   cairo_scaled_font_t *scaled_font;
@@ -247,7 +348,7 @@ render_glyph (const GskGLGlyphAtlas *atlas,
 
   scaled_font = pango_cairo_font_get_scaled_font ((PangoCairoFont *)key->font);
   if (G_UNLIKELY (!scaled_font || cairo_scaled_font_status (scaled_font) != CAIRO_STATUS_SUCCESS))
-    return;
+    return NULL;
 
   surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
                                         value->draw_width * key->scale / 1024,
@@ -265,6 +366,8 @@ render_glyph (const GskGLGlyphAtlas *atlas,
     glyph_info.geometry.x_offset = 0;
   else
     glyph_info.geometry.x_offset = - value->draw_x * 1024;
+  /* Shift subpixel variants right by a fraction of a device pixel */
+  glyph_info.geometry.x_offset += (int) (key->subpixel_x * PANGO_SCALE * 1024 / (GSK_GL_GLYPH_SUBPIXEL_STEPS * key->scale));
   glyph_info.geometry.y_offset = - value->draw_y * 1024;
 
   glyph_string.num_glyphs = 1;
@@ -273,6 +376,21 @@ render_glyph (const GskGLGlyphAtlas *atlas,
   pango_cairo_show_glyph_string (cr, key->font, &glyph_string);
   cairo_destroy (cr);
 
+  return surface;
+}
+
+static gboolean
+render_glyph (const GskGLGlyphAtlas *atlas,
+              DirtyGlyph            *glyph,
+              GskImageRegion        *region)
+{
+  GskGLCachedGlyph *value = glyph->value;
+  cairo_surface_t *surface;
+
+  surface = render_glyph_surface (glyph->key, value);
+  if (surface == NULL)
+    return FALSE;
+
   glyph->surface = surface;
 
   region->data = cairo_image_surface_get_data (surface);
@@ -281,6 +399,8 @@ render_glyph (const GskGLGlyphAtlas *atlas,
   region->stride = cairo_image_surface_get_stride (surface);
   region->x = (gsize)(value->tx * atlas->width);
   region->y = (gsize)(value->ty * atlas->height);
+
+  return TRUE;
 }
 
 static void
@@ -293,16 +413,21 @@ upload_dirty_glyphs (GskGLGlyphCache *self,
   int i;
 
   num_regions = g_list_length (atlas->dirty_glyphs);
-  regions = alloca (sizeof (GskImageRegion) * num_regions);
+  /* Growing an atlas makes all of its glyphs dirty, so this can be large */
+  regions = g_new (GskImageRegion, num_regions);
 
-  for (l = atlas->dirty_glyphs, i = 0; l; l = l->next, i++)
-    render_glyph (atlas, (DirtyGlyph *)l->data, &regions[i]);
+  for (l = atlas->dirty_glyphs, i = 0; l; l = l->next)
+    {
+      if (render_glyph (atlas, (DirtyGlyph *)l->data, &regions[i]))
+        i++;
+    }
+  num_regions = i;
 
   GSK_RENDERER_NOTE (self->renderer, GLYPH_CACHE,
             g_message ("uploading %d glyphs to cache", num_regions));
 
-
   gsk_gl_image_upload_regions (atlas->image, self->gl_driver, num_regions, regions);
+  g_free (regions);
 
   g_list_free_full (atlas->dirty_glyphs, dirty_glyph_free);
   atlas->dirty_glyphs = NULL;
@@ -313,7 +438,8 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
                            gboolean         create,
                            PangoFont       *font,
                            PangoGlyph       glyph,
-                           float            scale)
+                           float            scale,
+                           guint            subpixel_x)
 {
   GskGLCachedGlyph *value;
 
@@ -321,7 +447,8 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
                                &(GlyphCacheKey) {
                                  .font = font,
                                  .glyph = glyph,
-                                 .scale = (guint)(scale * 1024)
+                                 .scale = (guint)(scale * 1024),
+                                 .subpixel_x = subpixel_x
                                });
 
   if (value)
@@ -352,12 +479,16 @@ gsk_gl_glyph_cache_lookup (GskGLGlyphCache *cache,
       value->draw_y = ink_rect.y;
       value->draw_width = ink_rect.width;
       value->draw_height = ink_rect.height;
+      /* Shifted variants need room for the extra fraction of a pixel */
+      if (subpixel_x != 0 && ink_rect.width > 0)
+        value->draw_width += 1;
       value->timestamp = cache->timestamp;
       value->atlas = NULL; /* For now */
 
       key->font = g_object_ref (font);
       key->glyph = glyph;
       key->scale = (guint)(scale * 1024);
+      key->subpixel_x = subpixel_x;
 
       if (ink_rect.width > 0 && ink_rect.height > 0)
         add_to_cache (cache, key, value);
@@ -389,6 +520,52 @@ gsk_gl_glyph_cache_get_glyph_image (GskGLGlyphCache *self,
   return atlas->image;
 }
 
+/* Draws a glyph that is too big for the atlases into a texture of its
+ * own, which is released at the end of the frame. Such glyphs are rare,
+ * so they are simply drawn again every frame. Returns 0 if the glyph
+ * can't be drawn. */
+int
+gsk_gl_glyph_cache_get_uncached_texture (GskGLGlyphCache        *self,
+                                         PangoFont              *font,
+                                         PangoGlyph              glyph,
+                                         float                   scale,
+                                         guint                   subpixel_x,
+                                         const GskGLCachedGlyph *value)
+{
+  GlyphCacheKey key = {
+    .font = font,
+    .glyph = glyph,
+    .scale = (guint)(scale * 1024),
+    .subpixel_x = subpixel_x
+  };
+  int max_size = gsk_gl_driver_get_max_texture_size (self->gl_driver);
+  cairo_surface_t *surface;
+  int texture_id;
+
+  g_assert (value->atlas == NULL);
+
+  surface = render_glyph_surface (&key, value);
+  if (surface == NULL)
+    return 0;
+
+  if (cairo_image_surface_get_width (surface) > max_size ||
+      cairo_image_surface_get_height (surface) > max_size)
+    {
+      cairo_surface_destroy (surface);
+      return 0;
+    }
+
+  texture_id = gsk_gl_driver_create_texture (self->gl_driver,
+                                             cairo_image_surface_get_width (surface),
+                                             cairo_image_surface_get_height (surface));
+  gsk_gl_driver_bind_source_texture (self->gl_driver, texture_id);
+  gsk_gl_driver_init_texture_with_surface (self->gl_driver, texture_id, surface,
+                                           GL_LINEAR, GL_LINEAR);
+  cairo_surface_destroy (surface);
+
+  return texture_id;
+}
+
 void
 gsk_gl_glyph_cache_begin_frame (GskGLGlyphCache *self)
 {
@@ -400,6 +577,7 @@ gsk_gl_glyph_cache_begin_frame (GskGLGlyphCache *self)
 
   self->timestamp++;
 
+  free_retired_images (self);
 
   if (self->timestamp % CHECK_INTERVAL != 0)
     return;
@@ -3,10 +3,14 @@
 
 #include "gskgldriverprivate.h"
 #include "gskglimageprivate.h"
+#include "gskglskylineprivate.h"
 #include "gskrendererprivate.h"
 #include <pango/pango.h>
 #include <gdk/gdk.h>
 
+/* Number of horizontal positions per pixel that glyphs get rendered at */
+#define GSK_GL_GLYPH_SUBPIXEL_STEPS 4
+
 typedef struct
 {
   GskGLDriver *gl_driver;
@@ -14,6 +18,7 @@ typedef struct
 
   GHashTable *hash_table;
   GPtrArray *atlases;
+  GPtrArray *retired_images;
 
   guint64 timestamp;
 } GskGLGlyphCache;
@@ -23,7 +28,7 @@ typedef struct
 {
   GskGLImage *image;
   int width, height;
-  int x, y, y0;
+  GskGLSkyline skyline;
   int num_glyphs;
   GList *dirty_glyphs;
   guint old_pixels;
@@ -57,6 +62,13 @@ const GskGLCachedGlyph * gsk_gl_glyph_cache_lookup          (GskGLGlyphCache
                                                              gboolean                create,
                                                              PangoFont              *font,
                                                              PangoGlyph              glyph,
-                                                             float                   scale);
+                                                             float                   scale,
+                                                             guint                   subpixel_x);
+int                      gsk_gl_glyph_cache_get_uncached_texture (GskGLGlyphCache        *self,
+                                                                  PangoFont              *font,
+                                                                  PangoGlyph              glyph,
+                                                                  float                   scale,
+                                                                  guint                   subpixel_x,
+                                                                  const GskGLCachedGlyph *value);
 
 #endif
@@ -1,6 +1,7 @@
 
 #include "gskglimageprivate.h"
 #include <epoxy/gl.h>
+#include <string.h>
 
 void
 gsk_gl_image_create (GskGLImage  *self,
@@ -11,6 +12,7 @@ gsk_gl_image_create (GskGLImage  *self,
   self->texture_id = gsk_gl_driver_create_permanent_texture (gl_driver, width, height);
   self->width = width;
   self->height = height;
+  self->pbo_id = 0;
 
   gsk_gl_driver_bind_source_texture (gl_driver, self->texture_id);
   gsk_gl_driver_init_texture_empty (gl_driver, self->texture_id);
@@ -21,6 +23,12 @@ gsk_gl_image_destroy (GskGLImage  *self,
                       GskGLDriver *gl_driver)
 {
   gsk_gl_driver_destroy_texture (gl_driver, self->texture_id);
+
+  if (self->pbo_id != 0)
+    {
+      glDeleteBuffers (1, &self->pbo_id);
+      self->pbo_id = 0;
+    }
 }
 
 void
@@ -41,6 +49,76 @@ gsk_gl_image_write_to_png (const GskGLImage *self,
   g_free (data);
 }
 
+/* Pixel buffer objects and glMapBufferRange() need GL 3 or GLES 3 */
+static gboolean
+has_pixel_buffers (void)
+{
+  static int has = -1;
+
+  if (has < 0)
+    has = epoxy_gl_version () >= 30;
+
+  return has;
+}
+
+/* Copies all regions into one pixel buffer object and uploads them from
+ * there, so the driver gets a single transfer instead of one per region. */
+static gboolean
+gsk_gl_image_upload_regions_pbo (GskGLImage           *self,
+                                 guint                 n_regions,
+                                 const GskImageRegion *regions)
+{
+  gsize *offsets;
+  gsize size = 0;
+  guchar *data;
+  guint i;
+  gsize y;
+
+  offsets = g_newa (gsize, n_regions);
+  for (i = 0; i < n_regions; i ++)
+    {
+      offsets[i] = size;
+      size += regions[i].width * 4 * regions[i].height;
+    }
+
+  if (self->pbo_id == 0)
+    glGenBuffers (1, &self->pbo_id);
+
+  glBindBuffer (GL_PIXEL_UNPACK_BUFFER, self->pbo_id);
+  glBufferData (GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+  data = glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, size,
+                           GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+  if (data == NULL)
+    {
+      glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+      return FALSE;
+    }
+
+  /* Pack the rows tightly, so we don't need GL_UNPACK_ROW_LENGTH */
+  for (i = 0; i < n_regions; i ++)
+    {
+      const GskImageRegion *region = &regions[i];
+      gsize row_size = region->width * 4;
+
+      for (y = 0; y < region->height; y ++)
+        memcpy (data + offsets[i] + y * row_size, region->data + y * region->stride, row_size);
+    }
+
+  glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+
+  for (i = 0; i < n_regions; i ++)
+    {
+      const GskImageRegion *region = &regions[i];
+
+      glTexSubImage2D (GL_TEXTURE_2D, 0, region->x, region->y, region->width, region->height,
+                       GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, GSIZE_TO_POINTER (offsets[i]));
+    }
+
+  glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+
+  return TRUE;
+}
+
 void
 gsk_gl_image_upload_regions (GskGLImage           *self,
                              GskGLDriver          *gl_driver,
@@ -49,13 +127,20 @@ gsk_gl_image_upload_regions (GskGLImage           *self,
 {
   guint i;
 
+  if (n_regions == 0)
+    return;
+
+  gsk_gl_driver_bind_source_texture (gl_driver, self->texture_id);
+  glBindTexture (GL_TEXTURE_2D, self->texture_id);
+
+  if (n_regions > 1 && has_pixel_buffers () &&
+      gsk_gl_image_upload_regions_pbo (self, n_regions, regions))
+    return;
+
   for (i = 0; i < n_regions; i ++)
     {
       const GskImageRegion *region = &regions[i];
 
-      gsk_gl_driver_bind_source_texture (gl_driver, self->texture_id);
-      glBindTexture (GL_TEXTURE_2D, self->texture_id);
-
       glTexSubImage2D (GL_TEXTURE_2D, 0, region->x, region->y, region->width, region->height,
                        GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, region->data);
     }
@@ -65,4 +150,3 @@ gsk_gl_image_upload_regions (GskGLImage           *self,
   /*gsk_gl_image_dump (self, gl_driver, "/home/baedert/atlases/test_dump.png");*/
 #endif
 }
-
@@ -9,6 +9,7 @@ typedef struct
   guint texture_id;
   int width;
   int height;
+  guint pbo_id; /* for uploading regions, created on demand */
 } GskGLImage;
 
 typedef struct
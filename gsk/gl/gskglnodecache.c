@@ -0,0 +1,168 @@
+#include "config.h"
+
+#include "gskglnodecacheprivate.h"
+#include "gskgldriverprivate.h"
+#include "gskdebugprivate.h"
+#include "gskrendernodeprivate.h"
+
+/* Parameters for our cache eviction strategy.
+ *
+ * Offscreen textures are a lot bigger than glyphs, and a node that was not drawn
+ * in the last couple of frames has most likely been replaced by a new one, so
+ * entries that have not been used for MAX_AGE frames are dropped right away.
+ *
+ * To not turn every frame of an animation into a permanent texture, a node only
+ * gets its texture cached once it shows up again in a later frame. Until then
+ * the entry just remembers that we have seen it, and the texture is taken from
+ * the driver's per-frame pool like before.
+ */
+
+#define MAX_AGE 3
+
+typedef struct
+{
+  GskGLNodeCacheKey key;
+  int texture_id;
+  guint64 timestamp;
+} CachedNode;
+
+static guint
+node_cache_hash (gconstpointer v)
+{
+  const GskGLNodeCacheKey *key = v;
+
+  return g_direct_hash (key->node) ^
+         (key->scale_factor << 24) ^
+         ((guint) key->fallback << 31) ^
+         (guint) key->bounds.size.width << 12 ^
+         (guint) key->bounds.size.height;
+}
+
+static gboolean
+node_cache_equal (gconstpointer v1,
+                  gconstpointer v2)
+{
+  const GskGLNodeCacheKey *key1 = v1;
+  const GskGLNodeCacheKey *key2 = v2;
+
+  return key1->node == key2->node &&
+         key1->scale_factor == key2->scale_factor &&
+         key1->fallback == key2->fallback &&
+         graphene_rect_equal (&key1->bounds, &key2->bounds) &&
+         key1->dx == key2->dx &&
+         key1->dy == key2->dy &&
+         key1->opacity == key2->opacity &&
+         key1->has_clip == key2->has_clip &&
+         (!key1->has_clip || memcmp (&key1->clip, &key2->clip, sizeof (GskRoundedRect)) == 0);
+}
+
+static void
+cached_node_free (gpointer v)
+{
+  CachedNode *cached = v;
+
+  gsk_render_node_unref (cached->key.node);
+  g_slice_free (CachedNode, cached);
+}
+
+void
+gsk_gl_node_cache_init (GskGLNodeCache *self,
+                        GskRenderer    *renderer,
+                        GskGLDriver    *gl_driver)
+{
+  self->hash_table = g_hash_table_new_full (node_cache_hash, node_cache_equal,
+                                            NULL, cached_node_free);
+  self->renderer = renderer;
+  self->gl_driver = gl_driver;
+  self->timestamp = 0;
+}
+
+void
+gsk_gl_node_cache_free (GskGLNodeCache *self)
+{
+  GHashTableIter iter;
+  CachedNode *cached;
+
+  g_hash_table_iter_init (&iter, self->hash_table);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&cached))
+    {
+      if (cached->texture_id != 0)
+        gsk_gl_driver_destroy_texture (self->gl_driver, cached->texture_id);
+    }
+
+  g_hash_table_unref (self->hash_table);
+}
+
+void
+gsk_gl_node_cache_begin_frame (GskGLNodeCache *self)
+{
+  GHashTableIter iter;
+  CachedNode *cached;
+  guint dropped = 0;
+
+  self->timestamp++;
+
+  g_hash_table_iter_init (&iter, self->hash_table);
+  while (g_hash_table_iter_next (&iter, NULL, (gpointer *)&cached))
+    {
+      if (self->timestamp - cached->timestamp < MAX_AGE)
+        continue;
+
+      if (cached->texture_id != 0)
+        {
+          gsk_gl_driver_destroy_texture (self->gl_driver, cached->texture_id);
+          dropped++;
+        }
+
+      g_hash_table_iter_remove (&iter);
+    }
+
+  GSK_RENDERER_NOTE (self->renderer, OPENGL, g_message ("Dropped %u cached node textures", dropped));
+}
+
+/* Returns the texture for @key, or 0 if there is none yet.
+ * In the latter case, @cacheable is set to whether the caller should render
+ * into a permanent texture and hand it to gsk_gl_node_cache_insert(). */
+int
+gsk_gl_node_cache_lookup (GskGLNodeCache          *self,
+                          const GskGLNodeCacheKey *key,
+                          gboolean                *cacheable)
+{
+  CachedNode *cached;
+
+  *cacheable = FALSE;
+
+  cached = g_hash_table_lookup (self->hash_table, key);
+  if (cached == NULL)
+    {
+      cached = g_slice_new0 (CachedNode);
+      cached->key = *key;
+      gsk_render_node_ref (cached->key.node);
+      cached->timestamp = self->timestamp;
+      g_hash_table_add (self->hash_table, cached);
+
+      return 0;
+    }
+
+  if (cached->texture_id == 0)
+    *cacheable = cached->timestamp < self->timestamp;
+
+  cached->timestamp = self->timestamp;
+
+  return cached->texture_id;
+}
+
+void
+gsk_gl_node_cache_insert (GskGLNodeCache          *self,
+                          const GskGLNodeCacheKey *key,
+                          int                      texture_id)
+{
+  CachedNode *cached;
+
+  cached = g_hash_table_lookup (self->hash_table, key);
+  g_return_if_fail (cached != NULL);
+  g_return_if_fail (cached->texture_id == 0);
+
+  cached->texture_id = texture_id;
+  cached->timestamp = self->timestamp;
+}
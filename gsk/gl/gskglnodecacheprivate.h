@@ -0,0 +1,46 @@
+#ifndef __GSK_GL_NODE_CACHE_PRIVATE_H__
+#define __GSK_GL_NODE_CACHE_PRIVATE_H__
+
+#include "gskgldriverprivate.h"
+#include "gskrendererprivate.h"
+#include "gskroundedrectprivate.h"
+#include <gdk/gdk.h>
+
+typedef struct
+{
+  GskGLDriver *gl_driver;
+  GskRenderer *renderer;
+
+  GHashTable *hash_table;
+
+  guint64 timestamp;
+} GskGLNodeCache;
+
+/* Everything the contents of an offscreen or fallback texture depend on.
+ * Render nodes are immutable, so the node pointer stands in for its whole
+ * subtree. Fields that don't apply must be zeroed. */
+typedef struct
+{
+  GskRenderNode *node;
+  int scale_factor;
+  graphene_rect_t bounds;
+  float dx, dy;
+  float opacity;
+  GskRoundedRect clip;
+  guint has_clip : 1;
+  guint fallback : 1;
+} GskGLNodeCacheKey;
+
+void                     gsk_gl_node_cache_init             (GskGLNodeCache          *self,
+                                                             GskRenderer             *renderer,
+                                                             GskGLDriver             *gl_driver);
+void                     gsk_gl_node_cache_free             (GskGLNodeCache          *self);
+void                     gsk_gl_node_cache_begin_frame      (GskGLNodeCache          *self);
+int                      gsk_gl_node_cache_lookup           (GskGLNodeCache          *self,
+                                                             const GskGLNodeCacheKey *key,
+                                                             gboolean                *cacheable);
+void                     gsk_gl_node_cache_insert           (GskGLNodeCache          *self,
+                                                             const GskGLNodeCacheKey *key,
+                                                             int                      texture_id);
+
+#endif
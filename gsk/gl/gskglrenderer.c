@@ -11,12 +11,14 @@
 #include "gskrendernodeprivate.h"
 #include "gskshaderbuilderprivate.h"
 #include "gskglglyphcacheprivate.h"
+#include "gskglnodecacheprivate.h"
 #include "gskglrenderopsprivate.h"
 #include "gskcairoblurprivate.h"
 
 #include "gskprivate.h"
 
 #include "gdk/gdkgltextureprivate.h"
+#include "gdk/gdkglcontextprivate.h"
 
 #include <epoxy/gl.h>
 #include <cairo-ft.h>
@@ -163,6 +165,7 @@ gsk_rounded_rect_shrink_to_minimum (GskRoundedRect *self)
 }
 
 static void gsk_gl_renderer_setup_render_mode (GskGLRenderer   *self);
+static void gsk_gl_renderer_free_frame_cache  (GskGLRenderer   *self);
 static void add_offscreen_ops                 (GskGLRenderer   *self,
                                                RenderOpBuilder *builder,
                                                float            min_x,
@@ -217,6 +220,7 @@ struct _GskGLRenderer
   GArray *render_ops;
 
   GskGLGlyphCache glyph_cache;
+  GskGLNodeCache node_cache;
 
 #ifdef G_ENABLE_DEBUG
   struct {
@@ -231,6 +235,18 @@ struct _GskGLRenderer
 
   RenderMode render_mode;
 
+  /* Framebuffer that rendering starts out in, and the area
+   * of it that needs to be redrawn, if not the whole clip */
+  int root_render_target;
+  const cairo_region_t *render_region;
+
+  /* Contents of the previous frames, so unchanged areas
+   * don't need to be redrawn */
+  guint frame_cache_texture_id;
+  guint frame_cache_fbo_id;
+  int frame_cache_width;
+  int frame_cache_height;
+
   gboolean has_buffers : 1;
 };
 
@@ -272,10 +288,20 @@ render_fallback_node (GskGLRenderer       *self,
                       RenderOpBuilder     *builder,
                       const GskQuadVertex *vertex_data)
 {
+  GskGLNodeCacheKey key = { 0, };
+  gboolean cacheable;
   cairo_surface_t *surface;
   cairo_t *cr;
   int texture_id;
 
+  key.node = node;
+  key.scale_factor = self->scale_factor;
+  key.fallback = TRUE;
+
+  texture_id = gsk_gl_node_cache_lookup (&self->node_cache, &key, &cacheable);
+  if (texture_id != 0)
+    goto draw;
+
   surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
                                         ceilf (node->bounds.size.width) * self->scale_factor,
                                         ceilf (node->bounds.size.height) * self->scale_factor);
@@ -299,9 +325,19 @@ render_fallback_node (GskGLRenderer       *self,
   cairo_destroy (cr);
 
   /* Upload the Cairo surface to a GL texture */
-  texture_id = gsk_gl_driver_create_texture (self->gl_driver,
-                                             node->bounds.size.width * self->scale_factor,
-                                             node->bounds.size.height * self->scale_factor);
+  if (cacheable)
+    {
+      texture_id = gsk_gl_driver_create_permanent_texture (self->gl_driver,
+                                                           node->bounds.size.width * self->scale_factor,
+                                                           node->bounds.size.height * self->scale_factor);
+      gsk_gl_node_cache_insert (&self->node_cache, &key, texture_id);
+    }
+  else
+    {
+      texture_id = gsk_gl_driver_create_texture (self->gl_driver,
+                                                 node->bounds.size.width * self->scale_factor,
+                                                 node->bounds.size.height * self->scale_factor);
+    }
 
   gsk_gl_driver_bind_source_texture (self->gl_driver, texture_id);
   gsk_gl_driver_init_texture_with_surface (self->gl_driver,
@@ -311,6 +347,7 @@ render_fallback_node (GskGLRenderer       *self,
 
   cairo_surface_destroy (surface);
 
+draw:
   ops_set_program (builder, &self->blit_program);
   ops_set_texture (builder, texture_id);
   ops_draw (builder, vertex_data);
@@ -328,7 +365,7 @@ render_text_node (GskGLRenderer   *self,
   guint num_glyphs = gsk_text_node_get_num_glyphs (node);
   int i;
   int x_position = 0;
-  int x = gsk_text_node_get_x (node) + builder->dx;
+  float x = gsk_text_node_get_x (node) + builder->dx;
   int y = gsk_text_node_get_y (node) + builder->dy;
 
   /* If the font has color glyphs, we don't need to recolor anything */
@@ -348,36 +385,74 @@ render_text_node (GskGLRenderer   *self,
     {
       const PangoGlyphInfo *gi = &glyphs[i];
       const GskGLCachedGlyph *glyph;
-      int glyph_x, glyph_y, glyph_w, glyph_h;
+      float glyph_x;
+      int glyph_y, glyph_w, glyph_h;
       float tx, ty, tx2, ty2;
       double cx;
       double cy;
+      float device_x;
+      int pixel_x;
+      guint subpixel_x;
 
       if (gi->glyph == PANGO_GLYPH_EMPTY)
         continue;
 
+      cx = (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
+      cy = (double)(gi->geometry.y_offset) / PANGO_SCALE;
+
+      /* Snap the glyph to the closest of the horizontal subpixel positions
+       * we have variants for. Integer positions always use variant 0. */
+      device_x = (x + cx) * self->scale_factor;
+      pixel_x = floorf (device_x);
+      subpixel_x = (guint) ((device_x - pixel_x) * GSK_GL_GLYPH_SUBPIXEL_STEPS + 0.5f);
+      if (subpixel_x == GSK_GL_GLYPH_SUBPIXEL_STEPS)
+        {
+          pixel_x += 1;
+          subpixel_x = 0;
+        }
+
       glyph = gsk_gl_glyph_cache_lookup (&self->glyph_cache,
                                          TRUE,
                                          (PangoFont *)font,
                                          gi->glyph,
-                                         self->scale_factor);
+                                         self->scale_factor,
+                                         subpixel_x);
 
       /* e.g. whitespace */
       if (glyph->draw_width <= 0 || glyph->draw_height <= 0)
         goto next;
 
-      cx = (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
-      cy = (double)(gi->geometry.y_offset) / PANGO_SCALE;
-
-      ops_set_texture (builder, gsk_gl_glyph_cache_get_glyph_image (&self->glyph_cache,
-                                                                   glyph)->texture_id);
+      if (glyph->atlas != NULL)
+        {
+          ops_set_texture (builder, gsk_gl_glyph_cache_get_glyph_image (&self->glyph_cache,
+                                                                       glyph)->texture_id);
 
-      tx  = glyph->tx;
-      ty  = glyph->ty;
-      tx2 = tx + glyph->tw;
-      ty2 = ty + glyph->th;
+          tx  = glyph->tx;
+          ty  = glyph->ty;
+          tx2 = tx + glyph->tw;
+          ty2 = ty + glyph->th;
+        }
+      else
+        {
+          /* Too big to be cached */
+          int texture_id = gsk_gl_glyph_cache_get_uncached_texture (&self->glyph_cache,
+                                                                    (PangoFont *)font,
+                                                                    gi->glyph,
+                                                                    self->scale_factor,
+                                                                    subpixel_x,
+                                                                    glyph);
+          if (texture_id == 0)
+            goto next;
+
+          ops_set_texture (builder, texture_id);
+
+          tx  = 0;
+          ty  = 0;
+          tx2 = 1;
+          ty2 = 1;
+        }
 
-      glyph_x = x + cx + glyph->draw_x;
+      glyph_x = (float) pixel_x / self->scale_factor + glyph->draw_x;
       glyph_y = y + cy + glyph->draw_y;
       glyph_w = glyph->draw_width;
       glyph_h = glyph->draw_height;
@@ -601,26 +676,35 @@ render_texture_node (GskGLRenderer       *self,
   else
     {
       int gl_min_filter = GL_NEAREST, gl_mag_filter = GL_NEAREST;
+      graphene_rect_t region;
+      float tx1, ty1, tx2, ty2;
       int texture_id;
 
       get_gl_scaling_filters (node, &gl_min_filter, &gl_mag_filter);
 
-      texture_id = gsk_gl_driver_get_texture_for_texture (self->gl_driver,
-                                                          texture,
-                                                          gl_min_filter,
-                                                          gl_mag_filter);
+      /* Small textures may live in an atlas, so drawing many of them in a row
+       * doesn't change the bound texture */
+      texture_id = gsk_gl_driver_get_texture_region (self->gl_driver,
+                                                     texture,
+                                                     gl_min_filter,
+                                                     gl_mag_filter,
+                                                     &region);
+      tx1 = region.origin.x;
+      ty1 = region.origin.y;
+      tx2 = tx1 + region.size.width;
+      ty2 = ty1 + region.size.height;
+
       ops_set_program (builder, &self->blit_program);
       ops_set_texture (builder, texture_id);
 
-
       ops_draw (builder, (GskQuadVertex[GL_N_VERTICES]) {
-        { { min_x, min_y }, { 0, 0 }, },
-        { { min_x, max_y }, { 0, 1 }, },
-        { { max_x, min_y }, { 1, 0 }, },
+        { { min_x, min_y }, { tx1, ty1 }, },
+        { { min_x, max_y }, { tx1, ty2 }, },
+        { { max_x, min_y }, { tx2, ty1 }, },
 
-        { { max_x, max_y }, { 1, 1 }, },
-        { { min_x, max_y }, { 0, 1 }, },
-        { { max_x, min_y }, { 1, 0 }, },
+        { { max_x, max_y }, { tx2, ty2 }, },
+        { { min_x, max_y }, { tx1, ty2 }, },
+        { { max_x, min_y }, { tx2, ty1 }, },
       });
     }
 }
@@ -1495,7 +1579,7 @@ apply_render_target_op (GskGLRenderer  *self,
 
   glBindFramebuffer (GL_FRAMEBUFFER, op->render_target_id);
 
-  if (op->render_target_id != 0)
+  if (op->render_target_id != self->root_render_target)
     glDisable (GL_SCISSOR_TEST);
   else
     gsk_gl_renderer_setup_render_mode (self); /* Reset glScissor etc. */
@@ -1908,6 +1992,7 @@ gsk_gl_renderer_realize (GskRenderer  *renderer,
     return FALSE;
 
   gsk_gl_glyph_cache_init (&self->glyph_cache, renderer, self->gl_driver);
+  gsk_gl_node_cache_init (&self->node_cache, renderer, self->gl_driver);
 
   return TRUE;
 }
@@ -1928,10 +2013,13 @@ gsk_gl_renderer_unrealize (GskRenderer *renderer)
    */
   g_array_set_size (self->render_ops, 0);
 
+  gsk_gl_renderer_free_frame_cache (self);
+
   for (i = 0; i < GL_N_PROGRAMS; i ++)
     glDeleteProgram (self->programs[i].id);
 
   gsk_gl_glyph_cache_free (&self->glyph_cache);
+  gsk_gl_node_cache_free (&self->node_cache);
 
   g_clear_object (&self->gl_profiler);
   g_clear_object (&self->gl_driver);
@@ -2032,6 +2120,23 @@ gsk_gl_renderer_clear (GskGLRenderer *self)
 static void
 gsk_gl_renderer_setup_render_mode (GskGLRenderer *self)
 {
+  if (self->render_region != NULL)
+    {
+      GdkSurface *surface = gsk_renderer_get_surface (GSK_RENDERER (self));
+      cairo_rectangle_int_t extents;
+      int surface_height;
+
+      surface_height = gdk_surface_get_height (surface) * self->scale_factor;
+      cairo_region_get_extents (self->render_region, &extents);
+
+      glEnable (GL_SCISSOR_TEST);
+      glScissor (extents.x * self->scale_factor,
+                 surface_height - (extents.height * self->scale_factor) - (extents.y * self->scale_factor),
+                 extents.width * self->scale_factor,
+                 extents.height * self->scale_factor);
+      return;
+    }
+
   switch (self->render_mode)
   {
     case RENDER_FULL:
@@ -2230,6 +2335,8 @@ add_offscreen_ops (GskGLRenderer   *self,
   graphene_rect_t prev_viewport;
   graphene_matrix_t item_proj;
   GskRoundedRect prev_clip;
+  GskGLNodeCacheKey key = { 0, };
+  gboolean cacheable;
 
   /* We need the child node as a texture. If it already is one, we don't need to draw
    * it on a framebuffer of course. */
@@ -2248,7 +2355,37 @@ add_offscreen_ops (GskGLRenderer   *self,
       return;
     }
 
-  *texture_id = gsk_gl_driver_create_texture (self->gl_driver, width, height);
+  /* The result only depends on the child and on the state that we don't
+   * override below, so we can reuse what we rendered in earlier frames. */
+  key.node = child_node;
+  key.scale_factor = self->scale_factor;
+  graphene_rect_init (&key.bounds, min_x, min_y, max_x - min_x, max_y - min_y);
+  key.dx = builder->dx;
+  key.dy = builder->dy;
+  key.opacity = builder->current_opacity;
+  if (!reset_clip)
+    {
+      key.clip = builder->current_clip;
+      key.has_clip = TRUE;
+    }
+
+  *texture_id = gsk_gl_node_cache_lookup (&self->node_cache, &key, &cacheable);
+  if (*texture_id != 0)
+    {
+      *is_offscreen = TRUE;
+      return;
+    }
+
+  if (cacheable)
+    {
+      *texture_id = gsk_gl_driver_create_permanent_texture (self->gl_driver, width, height);
+      gsk_gl_node_cache_insert (&self->node_cache, &key, *texture_id);
+    }
+  else
+    {
+      *texture_id = gsk_gl_driver_create_texture (self->gl_driver, width, height);
+    }
+
   gsk_gl_driver_bind_source_texture (self->gl_driver, *texture_id);
   gsk_gl_driver_init_texture_empty (self->gl_driver, *texture_id);
   render_target = gsk_gl_driver_create_render_target (self->gl_driver, *texture_id, TRUE, TRUE);
@@ -2290,60 +2427,19 @@ add_offscreen_ops (GskGLRenderer   *self,
 }
 
 static void
-gsk_gl_renderer_render_ops (GskGLRenderer *self,
-                            gsize          vertex_data_size)
+gsk_gl_renderer_render_ops (GskGLRenderer *self)
 {
   guint i;
   guint n_ops = self->render_ops->len;
   const Program *program = NULL;
-  gsize buffer_index = 0;
-  float *vertex_data = g_malloc (vertex_data_size);
-
-  /*g_message ("%s: Buffer size: %ld", __FUNCTION__, vertex_data_size);*/
-
-
-  GLuint buffer_id, vao_id;
-  glGenVertexArrays (1, &vao_id);
-  glBindVertexArray (vao_id);
-
-  glGenBuffers (1, &buffer_id);
-  glBindBuffer (GL_ARRAY_BUFFER, buffer_id);
-
-
-  // Fill buffer data
-  for (i = 0; i < n_ops; i ++)
-    {
-      const RenderOp *op = &g_array_index (self->render_ops, RenderOp, i);
-
-      if (op->op == OP_CHANGE_VAO)
-        {
-          memcpy (vertex_data + buffer_index, &op->vertex_data, sizeof (GskQuadVertex) * GL_N_VERTICES);
-          buffer_index += sizeof (GskQuadVertex) * GL_N_VERTICES / sizeof (float);
-        }
-    }
-
-  // Set buffer data
-  glBufferData (GL_ARRAY_BUFFER, vertex_data_size, vertex_data, GL_STATIC_DRAW);
-
-  // Describe buffer contents
 
-  /* 0 = position location */
-  glEnableVertexAttribArray (0);
-  glVertexAttribPointer (0, 2, GL_FLOAT, GL_FALSE,
-                         sizeof (GskQuadVertex),
-                         (void *) G_STRUCT_OFFSET (GskQuadVertex, position));
-  /* 1 = texture coord location */
-  glEnableVertexAttribArray (1);
-  glVertexAttribPointer (1, 2, GL_FLOAT, GL_FALSE,
-                         sizeof (GskQuadVertex),
-                         (void *) G_STRUCT_OFFSET (GskQuadVertex, uv));
+  gsk_gl_driver_bind_vertices (self->gl_driver);
 
   for (i = 0; i < n_ops; i ++)
     {
       const RenderOp *op = &g_array_index (self->render_ops, RenderOp, i);
 
-      if (op->op == OP_NONE ||
-          op->op == OP_CHANGE_VAO)
+      if (op->op == OP_NONE)
         continue;
 
       if (op->op != OP_CHANGE_PROGRAM &&
@@ -2441,6 +2537,10 @@ gsk_gl_renderer_render_ops (GskGLRenderer *self,
           OP_PRINT (" -> draw %ld, size %ld and program %d\n",
                     op->draw.vao_offset, op->draw.vao_size, program->index);
           glDrawArrays (GL_TRIANGLES, op->draw.vao_offset, op->draw.vao_size);
+#ifdef G_ENABLE_DEBUG
+          gsk_profiler_counter_inc (gsk_renderer_get_profiler (GSK_RENDERER (self)),
+                                    self->profile_counters.draw_calls);
+#endif
           break;
 
         default:
@@ -2449,12 +2549,70 @@ gsk_gl_renderer_render_ops (GskGLRenderer *self,
 
       OP_PRINT ("\n");
     }
+}
+
+static void
+gsk_gl_renderer_free_frame_cache (GskGLRenderer *self)
+{
+  if (self->frame_cache_fbo_id != 0)
+    {
+      glDeleteFramebuffers (1, &self->frame_cache_fbo_id);
+      self->frame_cache_fbo_id = 0;
+    }
+
+  if (self->frame_cache_texture_id != 0)
+    {
+      glDeleteTextures (1, &self->frame_cache_texture_id);
+      self->frame_cache_texture_id = 0;
+    }
+}
+
+static gboolean
+gsk_gl_renderer_ensure_frame_cache (GskGLRenderer *self,
+                                    int            width,
+                                    int            height)
+{
+  int max_texture_size;
+
+  /* Presenting the cache needs glBlitFramebuffer() */
+  if (!gdk_gl_context_has_framebuffer_blit (self->gl_context))
+    return FALSE;
+
+  max_texture_size = gsk_gl_driver_get_max_texture_size (self->gl_driver);
+  if (width > max_texture_size || height > max_texture_size)
+    {
+      gsk_gl_renderer_free_frame_cache (self);
+      return FALSE;
+    }
+
+  if (self->frame_cache_fbo_id != 0 &&
+      self->frame_cache_width == width &&
+      self->frame_cache_height == height)
+    return TRUE;
+
+  gsk_gl_renderer_free_frame_cache (self);
+
+  GSK_RENDERER_NOTE (GSK_RENDERER (self), OPENGL,
+                     g_message ("Creating %dx%d frame cache", width, height));
+
+  glGenTextures (1, &self->frame_cache_texture_id);
+  glBindTexture (GL_TEXTURE_2D, self->frame_cache_texture_id);
+
+  if (gdk_gl_context_get_use_es (self->gl_context))
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  else
+    glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+
+  glGenFramebuffers (1, &self->frame_cache_fbo_id);
+  glBindFramebuffer (GL_FRAMEBUFFER, self->frame_cache_fbo_id);
+  glFramebufferTexture2D (GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, self->frame_cache_texture_id, 0);
+  g_assert_cmphex (glCheckFramebufferStatus (GL_FRAMEBUFFER), ==, GL_FRAMEBUFFER_COMPLETE);
+  glBindFramebuffer (GL_FRAMEBUFFER, 0);
 
-  /* Done drawing, destroy the buffer again.
-   * TODO: Can we reuse the memory, though? */
-  g_free (vertex_data);
-  glDeleteVertexArrays (1, &vao_id);
-  glDeleteBuffers (1, &buffer_id);
+  self->frame_cache_width = width;
+  self->frame_cache_height = height;
+
+  return TRUE;
 }
 
 static void
@@ -2497,9 +2655,11 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
 
   gsk_gl_driver_begin_frame (self->gl_driver);
   gsk_gl_glyph_cache_begin_frame (&self->glyph_cache);
+  gsk_gl_node_cache_begin_frame (&self->node_cache);
 
   memset (&render_op_builder, 0, sizeof (render_op_builder));
   render_op_builder.renderer = self;
+  render_op_builder.driver = self->gl_driver;
   render_op_builder.current_projection = projection;
   render_op_builder.current_modelview = modelview;
   render_op_builder.current_viewport = *viewport;
@@ -2511,6 +2671,7 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
     ops_set_render_target (&render_op_builder, texture_id);
 
   gsk_gl_renderer_add_render_ops (self, root, &render_op_builder);
+  ops_batch (&render_op_builder);
 
   /*g_message ("Ops: %u", self->render_ops->len);*/
 
@@ -2520,6 +2681,8 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
   gsk_profiler_timer_begin (profiler, self->profile_timers.cpu_time);
 #endif
 
+  /* Creating render targets above may have changed the bound framebuffer */
+  glBindFramebuffer (GL_FRAMEBUFFER, self->root_render_target);
   gsk_gl_renderer_resize_viewport (self, viewport);
   gsk_gl_renderer_setup_render_mode (self);
   gsk_gl_renderer_clear (self);
@@ -2532,7 +2695,7 @@ gsk_gl_renderer_do_render (GskRenderer           *renderer,
   glBlendFunc (GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
   glBlendEquation (GL_FUNC_ADD);
 
-  gsk_gl_renderer_render_ops (self, render_op_builder.buffer_size);
+  gsk_gl_renderer_render_ops (self);
 
   gsk_gl_driver_end_frame (self->gl_driver);
 
@@ -2563,6 +2726,8 @@ gsk_gl_renderer_render_texture (GskRenderer           *renderer,
   g_return_val_if_fail (self->gl_context != NULL, NULL);
 
   self->render_mode = RENDER_FULL;
+  self->root_render_target = 0;
+  self->render_region = NULL;
   width = ceilf (viewport->size.width);
   height = ceilf (viewport->size.height);
 
@@ -2618,10 +2783,37 @@ gsk_gl_renderer_render (GskRenderer   *renderer,
   viewport.size.width = gdk_surface_get_width (surface) * self->scale_factor;
   viewport.size.height = gdk_surface_get_height (surface) * self->scale_factor;
 
-  gsk_gl_renderer_do_render (renderer, root, &viewport, 0, self->scale_factor);
+  if (!gsk_gl_renderer_ensure_frame_cache (self, viewport.size.width, viewport.size.height))
+    {
+      self->root_render_target = 0;
+      gsk_gl_renderer_do_render (renderer, root, &viewport, 0, self->scale_factor);
 
-  gdk_gl_context_make_current (self->gl_context);
-  gsk_gl_renderer_clear_tree (self);
+      gdk_gl_context_make_current (self->gl_context);
+      gsk_gl_renderer_clear_tree (self);
+      return;
+    }
+
+  /* Only redraw what changed since the last frame into the cache,
+   * then copy the whole clip over to the surface. */
+  self->render_region = gsk_renderer_get_render_region (renderer);
+  if (!cairo_region_is_empty (self->render_region))
+    {
+      self->root_render_target = self->frame_cache_fbo_id;
+      gsk_gl_renderer_do_render (renderer, root, &viewport, self->frame_cache_fbo_id, self->scale_factor);
+
+      gdk_gl_context_make_current (self->gl_context);
+      gsk_gl_renderer_clear_tree (self);
+    }
+  self->render_region = NULL;
+  self->root_render_target = 0;
+
+  glBindFramebuffer (GL_READ_FRAMEBUFFER, self->frame_cache_fbo_id);
+  glBindFramebuffer (GL_DRAW_FRAMEBUFFER, 0);
+  gsk_gl_renderer_setup_render_mode (self);
+  glBlitFramebuffer (0, 0, self->frame_cache_width, self->frame_cache_height,
+                     0, 0, self->frame_cache_width, self->frame_cache_height,
+                     GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  glBindFramebuffer (GL_FRAMEBUFFER, 0);
 }
 
 static void
@@ -375,6 +375,9 @@ ops_draw (RenderOpBuilder     *builder,
           const GskQuadVertex  vertex_data[GL_N_VERTICES])
 {
   RenderOp *last_op;
+  gsize offset;
+
+  offset = gsk_gl_driver_add_vertices (builder->driver, vertex_data, GL_N_VERTICES);
 
   last_op = &g_array_index (builder->render_ops, RenderOp, builder->render_ops->len - 1);
   /* If the previous op was a DRAW as well, we didn't change anything between the two calls,
@@ -382,37 +385,18 @@ ops_draw (RenderOpBuilder     *builder,
    * And the offsets into the vao are in order as well, so make it one draw call. */
   if (last_op->op == OP_DRAW)
     {
-      /* We allow ourselves a little trick here. We still have to add a CHANGE_VAO op for
-       * this draw call so we can add our vertex data there, but we want it to be placed before
-       * the last draw call, so we reorder those. */
-      RenderOp new_draw;
-      new_draw.op = OP_DRAW;
-      new_draw.draw.vao_offset = last_op->draw.vao_offset;
-      new_draw.draw.vao_size = last_op->draw.vao_size + GL_N_VERTICES;
-
-      last_op->op = OP_CHANGE_VAO;
-      memcpy (&last_op->vertex_data, vertex_data, sizeof(GskQuadVertex) * GL_N_VERTICES);
-
-      /* Now add the DRAW */
-      g_array_append_val (builder->render_ops, new_draw);
+      g_assert (last_op->draw.vao_offset + last_op->draw.vao_size == offset);
+      last_op->draw.vao_size += GL_N_VERTICES;
     }
   else
     {
       RenderOp op;
-      gsize offset = builder->buffer_size / sizeof (GskQuadVertex);
-
-      op.op = OP_CHANGE_VAO;
-      memcpy (&op.vertex_data, vertex_data, sizeof(GskQuadVertex) * GL_N_VERTICES);
-      g_array_append_val (builder->render_ops, op);
 
       op.op = OP_DRAW;
       op.draw.vao_offset = offset;
       op.draw.vao_size = GL_N_VERTICES;
       g_array_append_val (builder->render_ops, op);
     }
-
-  /* We added new vertex data in both cases so increase the buffer size */
-  builder->buffer_size += sizeof (GskQuadVertex) * GL_N_VERTICES;
 }
 
 void
@@ -430,3 +414,222 @@ ops_add (RenderOpBuilder *builder,
 {
   g_array_append_val (builder->render_ops, *op);
 }
+
+static gboolean
+render_op_equal (const RenderOp *a,
+                 const RenderOp *b)
+{
+  g_assert (a->op == b->op);
+
+  switch (a->op)
+    {
+    case OP_CHANGE_OPACITY:
+      return a->opacity == b->opacity;
+
+    case OP_CHANGE_COLOR:
+      return gdk_rgba_equal (&a->color, &b->color);
+
+    case OP_CHANGE_PROJECTION:
+      return memcmp (&a->projection, &b->projection, sizeof (graphene_matrix_t)) == 0;
+
+    case OP_CHANGE_MODELVIEW:
+      return memcmp (&a->modelview, &b->modelview, sizeof (graphene_matrix_t)) == 0;
+
+    case OP_CHANGE_CLIP:
+      return memcmp (&a->clip, &b->clip, sizeof (GskRoundedRect)) == 0;
+
+    case OP_CHANGE_VIEWPORT:
+      return graphene_rect_equal (&a->viewport, &b->viewport);
+
+    case OP_CHANGE_SOURCE_TEXTURE:
+      return a->texture_id == b->texture_id;
+
+    case OP_CHANGE_LINEAR_GRADIENT:
+      return a->linear_gradient.n_color_stops == b->linear_gradient.n_color_stops &&
+             memcmp (a->linear_gradient.color_offsets, b->linear_gradient.color_offsets,
+                     sizeof (float) * a->linear_gradient.n_color_stops) == 0 &&
+             memcmp (a->linear_gradient.color_stops, b->linear_gradient.color_stops,
+                     sizeof (float) * 4 * a->linear_gradient.n_color_stops) == 0 &&
+             graphene_point_equal (&a->linear_gradient.start_point, &b->linear_gradient.start_point) &&
+             graphene_point_equal (&a->linear_gradient.end_point, &b->linear_gradient.end_point);
+
+    case OP_CHANGE_COLOR_MATRIX:
+      return memcmp (&a->color_matrix.matrix, &b->color_matrix.matrix, sizeof (graphene_matrix_t)) == 0 &&
+             memcmp (&a->color_matrix.offset, &b->color_matrix.offset, sizeof (graphene_vec4_t)) == 0;
+
+    case OP_CHANGE_BLUR:
+      return a->blur.radius == b->blur.radius &&
+             graphene_size_equal (&a->blur.size, &b->blur.size);
+
+    case OP_CHANGE_INSET_SHADOW:
+      return memcmp (a->inset_shadow.color, b->inset_shadow.color, sizeof (float) * 4) == 0 &&
+             memcmp (a->inset_shadow.offset, b->inset_shadow.offset, sizeof (float) * 2) == 0 &&
+             a->inset_shadow.spread == b->inset_shadow.spread &&
+             memcmp (a->inset_shadow.outline, b->inset_shadow.outline, sizeof (float) * 4) == 0 &&
+             memcmp (a->inset_shadow.corner_widths, b->inset_shadow.corner_widths, sizeof (float) * 4) == 0 &&
+             memcmp (a->inset_shadow.corner_heights, b->inset_shadow.corner_heights, sizeof (float) * 4) == 0;
+
+    case OP_CHANGE_UNBLURRED_OUTSET_SHADOW:
+      return memcmp (a->unblurred_outset_shadow.color, b->unblurred_outset_shadow.color, sizeof (float) * 4) == 0 &&
+             memcmp (a->unblurred_outset_shadow.offset, b->unblurred_outset_shadow.offset, sizeof (float) * 2) == 0 &&
+             a->unblurred_outset_shadow.spread == b->unblurred_outset_shadow.spread &&
+             memcmp (a->unblurred_outset_shadow.outline, b->unblurred_outset_shadow.outline, sizeof (float) * 4) == 0 &&
+             memcmp (a->unblurred_outset_shadow.corner_widths, b->unblurred_outset_shadow.corner_widths, sizeof (float) * 4) == 0 &&
+             memcmp (a->unblurred_outset_shadow.corner_heights, b->unblurred_outset_shadow.corner_heights, sizeof (float) * 4) == 0;
+
+    case OP_CHANGE_OUTSET_SHADOW:
+      return memcmp (a->outset_shadow.outline, b->outset_shadow.outline, sizeof (float) * 4) == 0 &&
+             memcmp (a->outset_shadow.corner_widths, b->outset_shadow.corner_widths, sizeof (float) * 4) == 0 &&
+             memcmp (a->outset_shadow.corner_heights, b->outset_shadow.corner_heights, sizeof (float) * 4) == 0;
+
+    case OP_CHANGE_BORDER:
+      return memcmp (a->border.widths, b->border.widths, sizeof (float) * 4) == 0 &&
+             memcmp (&a->border.outline, &b->border.outline, sizeof (GskRoundedRect)) == 0;
+
+    case OP_CHANGE_BORDER_COLOR:
+      return memcmp (a->border.color, b->border.color, sizeof (float) * 4) == 0;
+
+    default:
+      /* Cross fades also bind a second texture unit, never consider them equal. */
+      return FALSE;
+    }
+}
+
+static inline gboolean
+render_op_is_common (guint op)
+{
+  return op == OP_CHANGE_OPACITY ||
+         op == OP_CHANGE_PROJECTION ||
+         op == OP_CHANGE_MODELVIEW ||
+         op == OP_CHANGE_CLIP ||
+         op == OP_CHANGE_VIEWPORT;
+}
+
+/* Runs over the recorded ops once before they get executed, replaces
+ * state changes that would not change anything with OP_NONE and merges
+ * draw calls that end up next to each other into one.
+ *
+ * Uniform values are part of the program object, so we remember the last
+ * value set per program and per op. The program-specific ops partially
+ * share uniform locations between them (see the union in Program), so
+ * setting one of them forgets the others. Textures, the framebuffer and
+ * glViewport() are global state. */
+void
+ops_batch (RenderOpBuilder *builder)
+{
+  const RenderOp *applied[GL_N_PROGRAMS][OP_DRAW];
+  const Program *program = NULL;
+  const RenderOp *texture = NULL;
+  const RenderOp *viewport = NULL;
+  RenderOp *last_draw = NULL;
+  int render_target = -1;
+  guint i, k;
+
+  memset (applied, 0, sizeof (applied));
+
+  for (i = 0; i < builder->render_ops->len; i ++)
+    {
+      RenderOp *op = &g_array_index (builder->render_ops, RenderOp, i);
+
+      switch (op->op)
+        {
+        case OP_NONE:
+          break;
+
+        case OP_DRAW:
+          if (program == NULL)
+            break;
+
+          if (last_draw != NULL &&
+              last_draw->draw.vao_offset + last_draw->draw.vao_size == op->draw.vao_offset)
+            {
+              last_draw->draw.vao_size += op->draw.vao_size;
+              op->op = OP_NONE;
+            }
+          else
+            {
+              last_draw = op;
+            }
+          break;
+
+        case OP_CHANGE_PROGRAM:
+          if (op->program == program)
+            {
+              op->op = OP_NONE;
+              break;
+            }
+          program = op->program;
+          last_draw = NULL;
+          break;
+
+        case OP_CHANGE_RENDER_TARGET:
+          if (op->render_target_id == render_target)
+            {
+              op->op = OP_NONE;
+              break;
+            }
+          render_target = op->render_target_id;
+          last_draw = NULL;
+          break;
+
+        case OP_CLEAR:
+          last_draw = NULL;
+          break;
+
+        case OP_CHANGE_SOURCE_TEXTURE:
+          if (program == NULL)
+            break;
+
+          if (texture != NULL && render_op_equal (texture, op))
+            {
+              op->op = OP_NONE;
+              break;
+            }
+          texture = op;
+          last_draw = NULL;
+          break;
+
+        case OP_CHANGE_VIEWPORT:
+          if (program == NULL)
+            break;
+
+          if (viewport != NULL && render_op_equal (viewport, op) &&
+              applied[program->index][op->op] != NULL &&
+              render_op_equal (applied[program->index][op->op], op))
+            {
+              op->op = OP_NONE;
+              break;
+            }
+          viewport = op;
+          applied[program->index][op->op] = op;
+          last_draw = NULL;
+          break;
+
+        default:
+          if (program == NULL)
+            break;
+
+          g_assert (op->op < OP_DRAW);
+
+          if (applied[program->index][op->op] != NULL &&
+              render_op_equal (applied[program->index][op->op], op))
+            {
+              op->op = OP_NONE;
+              break;
+            }
+
+          if (!render_op_is_common (op->op))
+            {
+              for (k = 0; k < OP_DRAW; k ++)
+                {
+                  if (!render_op_is_common (k))
+                    applied[program->index][k] = NULL;
+                }
+            }
+
+          applied[program->index][op->op] = op;
+          last_draw = NULL;
+          break;
+        }
+    }
+}
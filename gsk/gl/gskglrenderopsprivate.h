@@ -23,7 +23,6 @@ enum {
   OP_CHANGE_CLIP            =  7,
   OP_CHANGE_VIEWPORT        =  8,
   OP_CHANGE_SOURCE_TEXTURE  =  9,
-  OP_CHANGE_VAO             =  10,
   OP_CHANGE_LINEAR_GRADIENT =  11,
   OP_CHANGE_COLOR_MATRIX    =  12,
   OP_CHANGE_BLUR            =  13,
@@ -126,7 +125,6 @@ typedef struct
     int texture_id;
     int render_target_id;
     GdkRGBA color;
-    GskQuadVertex vertex_data[6];
     GskRoundedRect clip;
     graphene_rect_t viewport;
     struct {
@@ -227,10 +225,9 @@ typedef struct
   float current_opacity;
   float dx, dy;
 
-  gsize buffer_size;
-
   GArray *render_ops;
   GskGLRenderer *renderer;
+  GskGLDriver *driver;
 } RenderOpBuilder;
 
 
@@ -282,4 +279,6 @@ void              ops_offset             (RenderOpBuilder        *builder,
 void              ops_add                (RenderOpBuilder        *builder,
                                           const RenderOp         *op);
 
+void              ops_batch              (RenderOpBuilder        *builder);
+
 #endif
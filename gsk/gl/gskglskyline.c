@@ -0,0 +1,185 @@
+#include "config.h"
+
+#include "gskglskylineprivate.h"
+
+/* A segment of the top edge of the area used in an atlas */
+typedef struct
+{
+  int x;
+  int y;
+  int width;
+} SkylineNode;
+
+/* Everything gets packed with a 1px border to the top and left edges of
+ * the atlas. Users pack rectangles one pixel bigger than they need to get
+ * the same gap between neighbours, so linear filtering doesn't bleed. */
+void
+gsk_gl_skyline_init (GskGLSkyline *self,
+                     int           width,
+                     int           height)
+{
+  self->width = width;
+  self->height = height;
+  self->nodes = g_array_new (FALSE, FALSE, sizeof (SkylineNode));
+
+  gsk_gl_skyline_reset (self);
+}
+
+void
+gsk_gl_skyline_finish (GskGLSkyline *self)
+{
+  g_clear_pointer (&self->nodes, g_array_unref);
+}
+
+void
+gsk_gl_skyline_reset (GskGLSkyline *self)
+{
+  SkylineNode node;
+
+  node.x = 1;
+  node.y = 1;
+  node.width = self->width - 1;
+
+  g_array_set_size (self->nodes, 0);
+  g_array_append_val (self->nodes, node);
+}
+
+/* Makes the area bigger, keeping everything that has already been packed
+ * where it is. */
+void
+gsk_gl_skyline_resize (GskGLSkyline *self,
+                       int           width,
+                       int           height)
+{
+  SkylineNode node;
+
+  g_return_if_fail (width >= self->width);
+  g_return_if_fail (height >= self->height);
+
+  if (width > self->width)
+    {
+      node.x = self->width;
+      node.y = 1;
+      node.width = width - self->width;
+      g_array_append_val (self->nodes, node);
+    }
+
+  self->width = width;
+  self->height = height;
+}
+
+/* Checks whether a @width x @height rectangle fits with its left edge at
+ * the start of skyline node @index, and returns how far down it has to go. */
+static gboolean
+skyline_fits (const GskGLSkyline *self,
+              guint               index,
+              int                 width,
+              int                 height,
+              int                *out_y)
+{
+  const SkylineNode *node = &g_array_index (self->nodes, SkylineNode, index);
+  int width_left = width;
+  int y = node->y;
+
+  if (node->x + width > self->width)
+    return FALSE;
+
+  while (width_left > 0)
+    {
+      if (index >= self->nodes->len)
+        return FALSE;
+
+      node = &g_array_index (self->nodes, SkylineNode, index);
+      y = MAX (y, node->y);
+      if (y + height > self->height)
+        return FALSE;
+
+      width_left -= node->width;
+      index++;
+    }
+
+  *out_y = y;
+  return TRUE;
+}
+
+/* Bottom-left skyline packing: put the rectangle where its bottom edge ends
+ * up highest, preferring narrower gaps when that is a tie. */
+gboolean
+gsk_gl_skyline_pack (GskGLSkyline *self,
+                     int           width,
+                     int           height,
+                     int          *out_x,
+                     int          *out_y)
+{
+  int best_bottom = G_MAXINT;
+  int best_width = G_MAXINT;
+  int best_index = -1;
+  int best_y = 0;
+  SkylineNode new_node;
+  guint i;
+
+  for (i = 0; i < self->nodes->len; i++)
+    {
+      const SkylineNode *node = &g_array_index (self->nodes, SkylineNode, i);
+      int y;
+
+      if (!skyline_fits (self, i, width, height, &y))
+        continue;
+
+      if (y + height < best_bottom ||
+          (y + height == best_bottom && node->width < best_width))
+        {
+          best_bottom = y + height;
+          best_width = node->width;
+          best_index = i;
+          best_y = y;
+        }
+    }
+
+  if (best_index < 0)
+    return FALSE;
+
+  new_node.x = g_array_index (self->nodes, SkylineNode, best_index).x;
+  new_node.y = best_y + height;
+  new_node.width = width;
+  g_array_insert_val (self->nodes, best_index, new_node);
+
+  /* Cut the nodes that are now covered by the new one */
+  for (i = best_index + 1; i < self->nodes->len; i++)
+    {
+      SkylineNode *prev = &g_array_index (self->nodes, SkylineNode, i - 1);
+      SkylineNode *node = &g_array_index (self->nodes, SkylineNode, i);
+      int shrink;
+
+      if (node->x >= prev->x + prev->width)
+        break;
+
+      shrink = prev->x + prev->width - node->x;
+      node->x += shrink;
+      node->width -= shrink;
+
+      if (node->width > 0)
+        break;
+
+      g_array_remove_index (self->nodes, i);
+      i--;
+    }
+
+  /* Merge neighbours at the same height */
+  for (i = 0; i + 1 < self->nodes->len; i++)
+    {
+      SkylineNode *node = &g_array_index (self->nodes, SkylineNode, i);
+      SkylineNode *next = &g_array_index (self->nodes, SkylineNode, i + 1);
+
+      if (node->y == next->y)
+        {
+          node->width += next->width;
+          g_array_remove_index (self->nodes, i + 1);
+          i--;
+        }
+    }
+
+  *out_x = new_node.x;
+  *out_y = best_y;
+  return TRUE;
+}
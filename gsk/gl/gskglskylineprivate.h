@@ -0,0 +1,30 @@
+#ifndef __GSK_GL_SKYLINE_PRIVATE_H__
+#define __GSK_GL_SKYLINE_PRIVATE_H__
+
+#include <glib.h>
+
+/* Rectangle packer for texture atlases. It keeps track of the top edge
+ * of the used area, so it can't give space back; users reset it once
+ * everything packed into it is gone. */
+typedef struct
+{
+  int width;
+  int height;
+  GArray *nodes;
+} GskGLSkyline;
+
+void     gsk_gl_skyline_init   (GskGLSkyline *self,
+                                int           width,
+                                int           height);
+void     gsk_gl_skyline_finish (GskGLSkyline *self);
+void     gsk_gl_skyline_reset  (GskGLSkyline *self);
+void     gsk_gl_skyline_resize (GskGLSkyline *self,
+                                int           width,
+                                int           height);
+gboolean gsk_gl_skyline_pack   (GskGLSkyline *self,
+                                int           width,
+                                int           height,
+                                int          *out_x,
+                                int          *out_y);
+
+#endif
@@ -5,7 +5,13 @@
 #include "gskdebugprivate.h"
 
 #include <gdk/gdk.h>
+#include <glib/gstdio.h>
 #include <epoxy/gl.h>
+#include <errno.h>
+#include <string.h>
+
+/* Bump this when the layout of the cached program files changes */
+#define PROGRAM_CACHE_VERSION 2
 
 struct _GskShaderBuilder
 {
@@ -19,8 +25,14 @@ struct _GskShaderBuilder
 
   GPtrArray *defines;
 
-  /* We reuse this one for all the shaders */
-  GString *shader_code;
+  /* We reuse these for all the programs */
+  GString *vertex_code;
+  GString *fragment_code;
+
+  /* -1 until we checked whether the context can give us program binaries */
+  int use_program_cache;
+  char *program_cache_dir;
+  gboolean pruned_program_cache;
 };
 
 G_DEFINE_TYPE (GskShaderBuilder, gsk_shader_builder, G_TYPE_OBJECT)
@@ -33,7 +45,9 @@ gsk_shader_builder_finalize (GObject *gobject)
   g_free (self->resource_base_path);
   g_free (self->vertex_preamble);
   g_free (self->fragment_preamble);
-  g_string_free (self->shader_code, TRUE);
+  g_free (self->program_cache_dir);
+  g_string_free (self->vertex_code, TRUE);
+  g_string_free (self->fragment_code, TRUE);
 
   g_clear_pointer (&self->defines, g_ptr_array_unref);
 
@@ -50,7 +64,9 @@ static void
 gsk_shader_builder_init (GskShaderBuilder *self)
 {
   self->defines = g_ptr_array_new_with_free_func (g_free);
-  self->shader_code = g_string_new (NULL);
+  self->vertex_code = g_string_new (NULL);
+  self->fragment_code = g_string_new (NULL);
+  self->use_program_cache = -1;
 }
 
 GskShaderBuilder *
@@ -138,22 +154,17 @@ lookup_shader_code (GString *code,
   return TRUE;
 }
 
-static int
-gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
-                                   int               shader_type,
-                                   const char       *shader_preamble,
-                                   const char       *shader_source,
-                                   GError          **error)
+static gboolean
+gsk_shader_builder_build_shader_code (GskShaderBuilder *builder,
+                                      GString          *code,
+                                      const char       *shader_preamble,
+                                      const char       *shader_source,
+                                      GError          **error)
 {
-  GString *code;
-  const char *source;
-  int shader_id;
-  int status;
   int i;
 
   /* Clear possibly previously set shader code */
-  g_string_erase (builder->shader_code, 0, -1);
-  code = builder->shader_code;
+  g_string_erase (code, 0, -1);
 
   if (builder->version > 0)
     {
@@ -177,18 +188,26 @@ gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
   g_string_append_c (code, '\n');
 
   if (!lookup_shader_code (code, builder->resource_base_path, shader_preamble, error))
-    {
-      return -1;
-    }
+    return FALSE;
 
   g_string_append_c (code, '\n');
 
   if (!lookup_shader_code (code, builder->resource_base_path, shader_source, error))
-    {
-      return -1;
-    }
+    return FALSE;
 
-  source = code->str;
+  return TRUE;
+}
+
+static int
+gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
+                                   int               shader_type,
+                                   const char       *shader_preamble,
+                                   const char       *shader_source,
+                                   const char       *source,
+                                   GError          **error)
+{
+  int shader_id;
+  int status;
 
   shader_id = glCreateShader (shader_type);
   glShaderSource (shader_id, 1, (const GLchar **) &source, NULL);
@@ -230,6 +249,250 @@ gsk_shader_builder_compile_shader (GskShaderBuilder *builder,
   return shader_id;
 }
 
+static gboolean
+gsk_shader_builder_check_program_cache (GskShaderBuilder *builder)
+{
+  GLint n_formats = 0;
+
+  if (builder->use_program_cache >= 0)
+    return builder->use_program_cache;
+
+  builder->use_program_cache = FALSE;
+
+  /* We want to see the shaders being compiled */
+  if (GSK_DEBUG_CHECK (SHADERS))
+    return FALSE;
+
+  if (epoxy_is_desktop_gl ())
+    {
+      if (epoxy_gl_version () < 41 && !epoxy_has_gl_extension ("GL_ARB_get_program_binary"))
+        return FALSE;
+    }
+  else
+    {
+      if (epoxy_gl_version () < 30 && !epoxy_has_gl_extension ("GL_OES_get_program_binary"))
+        return FALSE;
+    }
+
+  /* Drivers are allowed to support the API without supporting any format */
+  glGetIntegerv (GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  builder->use_program_cache = n_formats > 0;
+
+  return builder->use_program_cache;
+}
+
+static void
+checksum_update_string (GChecksum  *checksum,
+                        const char *str)
+{
+  if (str == NULL)
+    str = "";
+
+  /* Include the terminating nul, so concatenations can't collide */
+  g_checksum_update (checksum, (const guchar *) str, strlen (str) + 1);
+}
+
+static char *
+get_program_cache_base_dir (void)
+{
+  return g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "gsk", "programs", NULL);
+}
+
+/* Program binaries are only valid for the driver that produced them, and
+ * the shaders change with GTK, so programs are kept in a directory named
+ * after both. Directories of other drivers or versions are stale once
+ * either of them is updated, see gsk_shader_builder_prune_program_cache(). */
+static const char *
+gsk_shader_builder_get_program_cache_dir (GskShaderBuilder *builder)
+{
+  GChecksum *checksum;
+  char *base_dir;
+  guint32 version = PROGRAM_CACHE_VERSION;
+
+  if (builder->program_cache_dir != NULL)
+    return builder->program_cache_dir;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) &version, sizeof (version));
+  checksum_update_string (checksum, PACKAGE_VERSION);
+  checksum_update_string (checksum, (const char *) glGetString (GL_VENDOR));
+  checksum_update_string (checksum, (const char *) glGetString (GL_RENDERER));
+  checksum_update_string (checksum, (const char *) glGetString (GL_VERSION));
+
+  base_dir = get_program_cache_base_dir ();
+  builder->program_cache_dir = g_build_filename (base_dir, g_checksum_get_string (checksum), NULL);
+
+  g_free (base_dir);
+  g_checksum_free (checksum);
+
+  return builder->program_cache_dir;
+}
+
+static char *
+gsk_shader_builder_get_program_cache_path (GskShaderBuilder *builder)
+{
+  GChecksum *checksum;
+  char *basename;
+  char *path;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  checksum_update_string (checksum, builder->vertex_code->str);
+  checksum_update_string (checksum, builder->fragment_code->str);
+
+  basename = g_strconcat (g_checksum_get_string (checksum), ".bin", NULL);
+  path = g_build_filename (gsk_shader_builder_get_program_cache_dir (builder), basename, NULL);
+
+  g_free (basename);
+  g_checksum_free (checksum);
+
+  return path;
+}
+
+static void
+remove_program_cache_dir (const char *dir)
+{
+  const char *name;
+  GDir *gdir;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  if (gdir == NULL)
+    return;
+
+  while ((name = g_dir_read_name (gdir)) != NULL)
+    {
+      char *path = g_build_filename (dir, name, NULL);
+
+      g_remove (path);
+      g_free (path);
+    }
+
+  g_dir_close (gdir);
+
+  g_rmdir (dir);
+}
+
+/* Removes everything but the directory of the current driver and GTK
+ * version, including files of older cache layouts. Called when a program
+ * isn't in the cache, which is the case after an update. */
+static void
+gsk_shader_builder_prune_program_cache (GskShaderBuilder *builder)
+{
+  const char *current_dir;
+  const char *name;
+  char *base_dir;
+  GDir *gdir;
+
+  if (builder->pruned_program_cache)
+    return;
+
+  builder->pruned_program_cache = TRUE;
+
+  base_dir = get_program_cache_base_dir ();
+  gdir = g_dir_open (base_dir, 0, NULL);
+  if (gdir == NULL)
+    {
+      g_free (base_dir);
+      return;
+    }
+
+  current_dir = gsk_shader_builder_get_program_cache_dir (builder);
+
+  while ((name = g_dir_read_name (gdir)) != NULL)
+    {
+      char *path = g_build_filename (base_dir, name, NULL);
+
+      if (strcmp (path, current_dir) != 0)
+        {
+          GSK_NOTE (SHADERS, g_message ("Removing stale program cache %s", path));
+
+          if (g_file_test (path, G_FILE_TEST_IS_DIR))
+            remove_program_cache_dir (path);
+          else
+            g_remove (path);
+        }
+
+      g_free (path);
+    }
+
+  g_dir_close (gdir);
+  g_free (base_dir);
+}
+
+/* The cache files contain the binary format as a native guint32,
+ * followed by the data returned by glGetProgramBinary(). */
+static int
+gsk_shader_builder_load_program (GskShaderBuilder *builder,
+                                 const char       *path)
+{
+  char *contents;
+  gsize len;
+  guint32 format;
+  int program_id;
+  int status;
+
+  if (!g_file_get_contents (path, &contents, &len, NULL))
+    return -1;
+
+  if (len <= sizeof (guint32))
+    {
+      g_free (contents);
+      return -1;
+    }
+
+  memcpy (&format, contents, sizeof (guint32));
+
+  program_id = glCreateProgram ();
+  glProgramBinary (program_id, format, contents + sizeof (guint32), len - sizeof (guint32));
+  g_free (contents);
+
+  /* The driver may reject the binary at any time, e.g. after an update
+   * that didn't change the version string. Just compile again then. */
+  glGetProgramiv (program_id, GL_LINK_STATUS, &status);
+  if (status == GL_FALSE)
+    {
+      GSK_NOTE (SHADERS, g_message ("Discarding cached program %s", path));
+      glDeleteProgram (program_id);
+      g_remove (path);
+      return -1;
+    }
+
+  return program_id;
+}
+
+static void
+gsk_shader_builder_save_program (GskShaderBuilder *builder,
+                                 int               program_id,
+                                 const char       *path)
+{
+  GError *error = NULL;
+  char *dir;
+  char *buffer;
+  GLint len = 0;
+  GLenum format;
+  guint32 format32;
+
+  glGetProgramiv (program_id, GL_PROGRAM_BINARY_LENGTH, &len);
+  if (len <= 0)
+    return;
+
+  buffer = g_malloc (sizeof (guint32) + len);
+  glGetProgramBinary (program_id, len, &len, &format, buffer + sizeof (guint32));
+  format32 = format;
+  memcpy (buffer, &format32, sizeof (guint32));
+
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0755) != 0 ||
+      !g_file_set_contents (path, buffer, sizeof (guint32) + len, &error))
+    {
+      GSK_NOTE (SHADERS, g_message ("Failed to cache program in %s: %s",
+                                    path, error ? error->message : g_strerror (errno)));
+      g_clear_error (&error);
+    }
+
+  g_free (dir);
+  g_free (buffer);
+}
+
 int
 gsk_shader_builder_create_program (GskShaderBuilder *builder,
                                    const char       *vertex_shader,
@@ -239,31 +502,61 @@ gsk_shader_builder_create_program (GskShaderBuilder *builder,
   int vertex_id, fragment_id;
   int program_id;
   int status;
+  char *cache_path = NULL;
 
   g_return_val_if_fail (GSK_IS_SHADER_BUILDER (builder), -1);
   g_return_val_if_fail (vertex_shader != NULL, -1);
   g_return_val_if_fail (fragment_shader != NULL, -1);
 
+  if (!gsk_shader_builder_build_shader_code (builder, builder->vertex_code,
+                                             builder->vertex_preamble, vertex_shader,
+                                             error) ||
+      !gsk_shader_builder_build_shader_code (builder, builder->fragment_code,
+                                             builder->fragment_preamble, fragment_shader,
+                                             error))
+    return -1;
+
+  if (gsk_shader_builder_check_program_cache (builder))
+    {
+      cache_path = gsk_shader_builder_get_program_cache_path (builder);
+      program_id = gsk_shader_builder_load_program (builder, cache_path);
+      if (program_id > 0)
+        {
+          g_free (cache_path);
+          return program_id;
+        }
+
+      gsk_shader_builder_prune_program_cache (builder);
+    }
+
   vertex_id = gsk_shader_builder_compile_shader (builder, GL_VERTEX_SHADER,
                                                  builder->vertex_preamble,
                                                  vertex_shader,
+                                                 builder->vertex_code->str,
                                                  error);
   if (vertex_id < 0)
-    return -1;
+    {
+      g_free (cache_path);
+      return -1;
+    }
 
   fragment_id = gsk_shader_builder_compile_shader (builder, GL_FRAGMENT_SHADER,
                                                    builder->fragment_preamble,
                                                    fragment_shader,
+                                                   builder->fragment_code->str,
                                                    error);
   if (fragment_id < 0)
     {
       glDeleteShader (vertex_id);
+      g_free (cache_path);
       return -1;
     }
 
   program_id = glCreateProgram ();
   glAttachShader (program_id, vertex_id);
   glAttachShader (program_id, fragment_id);
+  if (cache_path != NULL && (epoxy_is_desktop_gl () || epoxy_gl_version () >= 30))
+    glProgramParameteri (program_id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram (program_id);
 
   glGetProgramiv (program_id, GL_LINK_STATUS, &status);
@@ -287,6 +580,9 @@ gsk_shader_builder_create_program (GskShaderBuilder *builder,
       goto out;
     }
 
+  if (cache_path != NULL)
+    gsk_shader_builder_save_program (builder, program_id, cache_path);
+
 out:
   if (vertex_id > 0)
     {
@@ -300,5 +596,7 @@ out:
       glDeleteShader (fragment_id);
     }
 
+  g_free (cache_path);
+
   return program_id;
 }
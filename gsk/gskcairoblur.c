@@ -38,131 +38,435 @@
 
 #define get_box_filter_size(radius) ((int)(GAUSSIAN_SCALE_FACTOR * (radius)))
 
-/* Sadly, clang is picky about get_box_filter_size(2) not being a
- * constant expression, thus we have to use precomputed values.
+/* Box filters wider than this are always computed with the plain C
+ * kernel. Below it, the vector kernels replace the integer division by
+ * a single precision multiplication with 1/d, which gives bit-identical
+ * results as long as the sums stay well inside the float mantissa.
  */
-#define BOX_FILTER_SIZE_2 3
-#define BOX_FILTER_SIZE_3 5
-#define BOX_FILTER_SIZE_4 7
-#define BOX_FILTER_SIZE_5 9
-#define BOX_FILTER_SIZE_6 11
-#define BOX_FILTER_SIZE_7 13
-#define BOX_FILTER_SIZE_8 15
-#define BOX_FILTER_SIZE_9 16
-#define BOX_FILTER_SIZE_10 18
-
-/* This applies a single box blur pass to a horizontal range of pixels;
- * since the box blur has the same weight for all pixels, we can
+#define MAX_SIMD_FILTER_SIZE 4096
+
+/* Surfaces smaller than this are not worth the thread handoff */
+#define MIN_THREADED_PIXELS (256 * 256)
+
+/* Column ranges handed to threads are multiples of this, so that every
+ * range but the last one is covered by the vector kernels entirely.
+ */
+#define COLUMN_ALIGNMENT 32
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_KERNEL 1
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_KERNEL 1
+#include <immintrin.h>
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAVE_NEON_KERNEL 1
+#include <arm_neon.h>
+#endif
+
+/* A column kernel applies a single box blur pass to @width adjacent
+ * columns of @src and stores the result in @dst.
+ *
+ * Since the box blur has the same weight for all pixels, we can
  * implement an efficient sliding window algorithm where we add
- * in pixels coming into the window from the right and remove
- * them when they leave the windw to the left.
+ * in pixels coming into the window from below and remove them when
+ * they leave the window at the top. Keeping one running sum per
+ * column means the inner loops go along rows, which is both cache
+ * friendly and trivially vectorizable.
+ *
+ * d is the filter width; for even d offset indicates how the blurred
+ * result is aligned with the original, see get_offset().
  *
- * d is the filter width; for even d shift indicates how the blurred
- * result is aligned with the original - does ' x ' go to ' yy' (shift=1)
- * or 'yy ' (shift=-1)
+ * @sums must have room for @width values.
  */
-static void
-blur_xspan (guchar *row,
-            guchar *tmp_buffer,
-            int     row_width,
-            int     d,
-            int     shift)
+typedef void (* BlurColumnsFunc) (const guchar *src,
+                                  guchar       *dst,
+                                  guint32      *sums,
+                                  int           stride,
+                                  int           width,
+                                  int           height,
+                                  int           d,
+                                  int           offset);
+
+/* For even d shift indicates how the blurred result is aligned with
+ * the original - does ' x ' go to ' yy' (shift=1) or 'yy ' (shift=-1)
+ */
+static inline int
+get_offset (int d,
+            int shift)
 {
-  int offset;
-  int sum = 0;
-  int i;
-
   if (d % 2 == 1)
-    offset = d / 2;
+    return d / 2;
   else
-    offset = (d - shift) / 2;
-
-  /* All the conditionals in here look slow, but the branches will
-   * be well predicted and there are enough different possibilities
-   * that trying to write this as a series of unconditional loops
-   * is hard and not an obvious win. The main slow down here seems
-   * to be the integer division per pixel; one possible optimization
-   * would be to accumulate into two 16-bit integer buffers and
-   * only divide down after all three passes. (SSE parallel implementation
-   * of the divide step is possible.)
-   */
+    return (d - shift) / 2;
+}
+
+static void
+blur_columns_c (const guchar *src,
+                guchar       *dst,
+                guint32      *sums,
+                int           stride,
+                int           width,
+                int           height,
+                int           d,
+                int           offset)
+{
+  int i, x;
 
-#define BLUR_ROW_KERNEL(D)                                      \
-  for (i = -(D) + offset; i < row_width + offset; i++)		\
-    {                                                           \
-      if (i >= 0 && i < row_width)                              \
-        sum += row[i];                                          \
-                                                                \
-      if (i >= offset)						\
-	{							\
-	  if (i >= (D))						\
-	    sum -= row[i - (D)];				\
-                                                                \
-	  tmp_buffer[i - offset] = (sum + (D) / 2) / (D);	\
-	}							\
-    }								\
-  break;
-
-  /* We unroll the values for d for radius 2-10 to avoid a generic
-   * divide operation (not radius 1, because its a no-op) */
-  switch (d)
+  memset (sums, 0, width * sizeof (guint32));
+
+  for (i = 0; i < height + offset; i++)
     {
-    case BOX_FILTER_SIZE_2: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_2);
-    case BOX_FILTER_SIZE_3: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_3);
-    case BOX_FILTER_SIZE_4: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_4);
-    case BOX_FILTER_SIZE_5: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_5);
-    case BOX_FILTER_SIZE_6: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_6);
-    case BOX_FILTER_SIZE_7: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_7);
-    case BOX_FILTER_SIZE_8: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_8);
-    case BOX_FILTER_SIZE_9: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_9);
-    case BOX_FILTER_SIZE_10: BLUR_ROW_KERNEL (BOX_FILTER_SIZE_10);
-    default: BLUR_ROW_KERNEL (d);
+      if (i < height)
+        {
+          const guchar *in = src + i * stride;
+
+          for (x = 0; x < width; x++)
+            sums[x] += in[x];
+        }
+
+      if (i >= d)
+        {
+          const guchar *out = src + (i - d) * stride;
+
+          for (x = 0; x < width; x++)
+            sums[x] -= out[x];
+        }
+
+      if (i >= offset)
+        {
+          guchar *row = dst + (i - offset) * stride;
+
+          for (x = 0; x < width; x++)
+            row[x] = (sums[x] + d / 2) / d;
+        }
     }
+}
+
+#ifdef HAVE_SSE2_KERNEL
+/* Handles 16 columns per iteration, width must be a multiple of 16 */
+static void
+blur_columns_sse2 (const guchar *src,
+                   guchar       *dst,
+                   guint32      *sums,
+                   int           stride,
+                   int           width,
+                   int           height,
+                   int           d,
+                   int           offset)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128 bias = _mm_set1_ps (d / 2 + 0.5f);
+  const __m128 scale = _mm_set1_ps (1.0f / d);
+  int i, x;
+
+  memset (sums, 0, width * sizeof (guint32));
 
-  memcpy (row, tmp_buffer, row_width);
+  for (i = 0; i < height + offset; i++)
+    {
+      const guchar *in = i < height ? src + i * stride : NULL;
+      const guchar *out = i >= d ? src + (i - d) * stride : NULL;
+      guchar *row = i >= offset ? dst + (i - offset) * stride : NULL;
+
+      for (x = 0; x < width; x += 16)
+        {
+          __m128i s0 = _mm_loadu_si128 ((__m128i *) (sums + x));
+          __m128i s1 = _mm_loadu_si128 ((__m128i *) (sums + x + 4));
+          __m128i s2 = _mm_loadu_si128 ((__m128i *) (sums + x + 8));
+          __m128i s3 = _mm_loadu_si128 ((__m128i *) (sums + x + 12));
+          __m128i p, lo, hi;
+
+          if (in)
+            {
+              p = _mm_loadu_si128 ((const __m128i *) (in + x));
+              lo = _mm_unpacklo_epi8 (p, zero);
+              hi = _mm_unpackhi_epi8 (p, zero);
+              s0 = _mm_add_epi32 (s0, _mm_unpacklo_epi16 (lo, zero));
+              s1 = _mm_add_epi32 (s1, _mm_unpackhi_epi16 (lo, zero));
+              s2 = _mm_add_epi32 (s2, _mm_unpacklo_epi16 (hi, zero));
+              s3 = _mm_add_epi32 (s3, _mm_unpackhi_epi16 (hi, zero));
+            }
+
+          if (out)
+            {
+              p = _mm_loadu_si128 ((const __m128i *) (out + x));
+              lo = _mm_unpacklo_epi8 (p, zero);
+              hi = _mm_unpackhi_epi8 (p, zero);
+              s0 = _mm_sub_epi32 (s0, _mm_unpacklo_epi16 (lo, zero));
+              s1 = _mm_sub_epi32 (s1, _mm_unpackhi_epi16 (lo, zero));
+              s2 = _mm_sub_epi32 (s2, _mm_unpacklo_epi16 (hi, zero));
+              s3 = _mm_sub_epi32 (s3, _mm_unpackhi_epi16 (hi, zero));
+            }
+
+          _mm_storeu_si128 ((__m128i *) (sums + x), s0);
+          _mm_storeu_si128 ((__m128i *) (sums + x + 4), s1);
+          _mm_storeu_si128 ((__m128i *) (sums + x + 8), s2);
+          _mm_storeu_si128 ((__m128i *) (sums + x + 12), s3);
+
+          if (row)
+            {
+#define DIVIDE(s) _mm_cvttps_epi32 (_mm_mul_ps (_mm_add_ps (_mm_cvtepi32_ps (s), bias), scale))
+              lo = _mm_packs_epi32 (DIVIDE (s0), DIVIDE (s1));
+              hi = _mm_packs_epi32 (DIVIDE (s2), DIVIDE (s3));
+#undef DIVIDE
+              _mm_storeu_si128 ((__m128i *) (row + x), _mm_packus_epi16 (lo, hi));
+            }
+        }
+    }
 }
+#endif
 
+#ifdef HAVE_AVX2_KERNEL
+/* Handles 32 columns per iteration, width must be a multiple of 32 */
+__attribute__ ((target ("avx2")))
 static void
-blur_rows (guchar *dst_buffer,
-           guchar *tmp_buffer,
-           int     buffer_width,
-           int     buffer_height,
-           int     d)
+blur_columns_avx2 (const guchar *src,
+                   guchar       *dst,
+                   guint32      *sums,
+                   int           stride,
+                   int           width,
+                   int           height,
+                   int           d,
+                   int           offset)
 {
-  int i;
+  const __m256 bias = _mm256_set1_ps (d / 2 + 0.5f);
+  const __m256 scale = _mm256_set1_ps (1.0f / d);
+  /* undoes the lane interleaving of the two pack instructions */
+  const __m256i order = _mm256_setr_epi32 (0, 4, 1, 5, 2, 6, 3, 7);
+  int i, x, k;
+
+  memset (sums, 0, width * sizeof (guint32));
+
+  for (i = 0; i < height + offset; i++)
+    {
+      const guchar *in = i < height ? src + i * stride : NULL;
+      const guchar *out = i >= d ? src + (i - d) * stride : NULL;
+      guchar *row = i >= offset ? dst + (i - offset) * stride : NULL;
+
+      for (x = 0; x < width; x += 32)
+        {
+          __m256i s[4];
+
+          for (k = 0; k < 4; k++)
+            {
+              s[k] = _mm256_loadu_si256 ((__m256i *) (sums + x + 8 * k));
+              if (in)
+                s[k] = _mm256_add_epi32 (s[k], _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (in + x + 8 * k))));
+              if (out)
+                s[k] = _mm256_sub_epi32 (s[k], _mm256_cvtepu8_epi32 (_mm_loadl_epi64 ((const __m128i *) (out + x + 8 * k))));
+              _mm256_storeu_si256 ((__m256i *) (sums + x + 8 * k), s[k]);
+            }
+
+          if (row)
+            {
+              __m256i q[4];
+
+              for (k = 0; k < 4; k++)
+                q[k] = _mm256_cvttps_epi32 (_mm256_mul_ps (_mm256_add_ps (_mm256_cvtepi32_ps (s[k]), bias), scale));
+
+              q[0] = _mm256_packus_epi16 (_mm256_packs_epi32 (q[0], q[1]),
+                                          _mm256_packs_epi32 (q[2], q[3]));
+              _mm256_storeu_si256 ((__m256i *) (row + x), _mm256_permutevar8x32_epi32 (q[0], order));
+            }
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_NEON_KERNEL
+/* Handles 16 columns per iteration, width must be a multiple of 16 */
+static void
+blur_columns_neon (const guchar *src,
+                   guchar       *dst,
+                   guint32      *sums,
+                   int           stride,
+                   int           width,
+                   int           height,
+                   int           d,
+                   int           offset)
+{
+  const float32x4_t bias = vdupq_n_f32 (d / 2 + 0.5f);
+  const float32x4_t scale = vdupq_n_f32 (1.0f / d);
+  int i, x;
 
-  for (i = 0; i < buffer_height; i++)
+  memset (sums, 0, width * sizeof (guint32));
+
+  for (i = 0; i < height + offset; i++)
     {
-      guchar *row = dst_buffer + i * buffer_width;
-
-      /* We want to produce a symmetric blur that spreads a pixel
-       * equally far to the left and right. If d is odd that happens
-       * naturally, but for d even, we approximate by using a blur
-       * on either side and then a centered blur of size d + 1.
-       * (technique also from the SVG specification)
-       */
-      if (d % 2 == 1)
+      const guchar *in = i < height ? src + i * stride : NULL;
+      const guchar *out = i >= d ? src + (i - d) * stride : NULL;
+      guchar *row = i >= offset ? dst + (i - offset) * stride : NULL;
+
+      for (x = 0; x < width; x += 16)
         {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
-          blur_xspan (row, tmp_buffer, buffer_width, d, 0);
+          uint32x4_t s0 = vld1q_u32 (sums + x);
+          uint32x4_t s1 = vld1q_u32 (sums + x + 4);
+          uint32x4_t s2 = vld1q_u32 (sums + x + 8);
+          uint32x4_t s3 = vld1q_u32 (sums + x + 12);
+          uint8x16_t p;
+          uint16x8_t lo, hi;
+
+          if (in)
+            {
+              p = vld1q_u8 (in + x);
+              lo = vmovl_u8 (vget_low_u8 (p));
+              hi = vmovl_u8 (vget_high_u8 (p));
+              s0 = vaddw_u16 (s0, vget_low_u16 (lo));
+              s1 = vaddw_u16 (s1, vget_high_u16 (lo));
+              s2 = vaddw_u16 (s2, vget_low_u16 (hi));
+              s3 = vaddw_u16 (s3, vget_high_u16 (hi));
+            }
+
+          if (out)
+            {
+              p = vld1q_u8 (out + x);
+              lo = vmovl_u8 (vget_low_u8 (p));
+              hi = vmovl_u8 (vget_high_u8 (p));
+              s0 = vsubw_u16 (s0, vget_low_u16 (lo));
+              s1 = vsubw_u16 (s1, vget_high_u16 (lo));
+              s2 = vsubw_u16 (s2, vget_low_u16 (hi));
+              s3 = vsubw_u16 (s3, vget_high_u16 (hi));
+            }
+
+          vst1q_u32 (sums + x, s0);
+          vst1q_u32 (sums + x + 4, s1);
+          vst1q_u32 (sums + x + 8, s2);
+          vst1q_u32 (sums + x + 12, s3);
+
+          if (row)
+            {
+#define DIVIDE(s) vmovn_u32 (vcvtq_u32_f32 (vmulq_f32 (vaddq_f32 (vcvtq_f32_u32 (s), bias), scale)))
+              lo = vcombine_u16 (DIVIDE (s0), DIVIDE (s1));
+              hi = vcombine_u16 (DIVIDE (s2), DIVIDE (s3));
+#undef DIVIDE
+              vst1q_u8 (row + x, vcombine_u8 (vmovn_u16 (lo), vmovn_u16 (hi)));
+            }
+        }
+    }
+}
+#endif
+
+typedef struct {
+  BlurColumnsFunc func;
+  int n_columns;
+} BlurKernel;
+
+static const BlurKernel *
+get_simd_kernel (void)
+{
+  static BlurKernel kernel = { blur_columns_c, 1 };
+  static gsize initialized = 0;
+
+  if (g_once_init_enter (&initialized))
+    {
+#if defined(HAVE_AVX2_KERNEL)
+      __builtin_cpu_init ();
+      if (__builtin_cpu_supports ("avx2"))
+        {
+          kernel.func = blur_columns_avx2;
+          kernel.n_columns = 32;
         }
       else
+#endif
         {
-          blur_xspan (row, tmp_buffer, buffer_width, d, 1);
-          blur_xspan (row, tmp_buffer, buffer_width, d, -1);
-          blur_xspan (row, tmp_buffer, buffer_width, d + 1, 0);
+#if defined(HAVE_SSE2_KERNEL)
+          kernel.func = blur_columns_sse2;
+          kernel.n_columns = 16;
+#elif defined(HAVE_NEON_KERNEL)
+          kernel.func = blur_columns_neon;
+          kernel.n_columns = 16;
+#endif
         }
+
+      g_once_init_leave (&initialized, 1);
+    }
+
+  return &kernel;
+}
+
+/* Runs the best available kernel on as many columns as it can handle
+ * and does the remaining ones in plain C.
+ */
+static void
+blur_columns (const guchar *src,
+              guchar       *dst,
+              guint32      *sums,
+              int           stride,
+              int           width,
+              int           height,
+              int           d,
+              int           shift)
+{
+  int offset = get_offset (d, shift);
+  int simd_width = 0;
+
+  if (d <= MAX_SIMD_FILTER_SIZE)
+    {
+      const BlurKernel *kernel = get_simd_kernel ();
+
+      simd_width = width - width % kernel->n_columns;
+      if (simd_width > 0)
+        kernel->func (src, dst, sums, stride, simd_width, height, d, offset);
     }
+
+  if (simd_width < width)
+    blur_columns_c (src + simd_width, dst + simd_width, sums,
+                    stride, width - simd_width, height, d, offset);
 }
 
-/* Swaps width and height.
+/* Does the full triple box blur on a range of columns of @buffer,
+ * using the same columns of @tmp_buffer as scratch space.
+ */
+static void
+blur_column_range (guchar *buffer,
+                   guchar *tmp_buffer,
+                   int     stride,
+                   int     width,
+                   int     height,
+                   int     d)
+{
+  guint32 *sums = g_new (guint32, width);
+  int i;
+
+  /* We want to produce a symmetric blur that spreads a pixel
+   * equally far to the left and right. If d is odd that happens
+   * naturally, but for d even, we approximate by using a blur
+   * on either side and then a centered blur of size d + 1.
+   * (technique also from the SVG specification)
+   */
+  if (d % 2 == 1)
+    {
+      blur_columns (buffer, tmp_buffer, sums, stride, width, height, d, 0);
+      blur_columns (tmp_buffer, buffer, sums, stride, width, height, d, 0);
+      blur_columns (buffer, tmp_buffer, sums, stride, width, height, d, 0);
+    }
+  else
+    {
+      blur_columns (buffer, tmp_buffer, sums, stride, width, height, d, 1);
+      blur_columns (tmp_buffer, buffer, sums, stride, width, height, d, -1);
+      blur_columns (buffer, tmp_buffer, sums, stride, width, height, d + 1, 0);
+    }
+
+  for (i = 0; i < height; i++)
+    memcpy (buffer + i * stride, tmp_buffer + i * stride, width);
+
+  g_free (sums);
+}
+
+/* Swaps width and height of the columns [x0, x1) of @src_buffer,
+ * which end up as the rows [x0, x1) of @dst_buffer.
  */
 static void
 flip_buffer (guchar *dst_buffer,
              guchar *src_buffer,
              int     width,
-             int     height)
+             int     height,
+             int     x0,
+             int     x1)
 {
   /* Working in blocks increases cache efficiency, compared to reading
    * or writing an entire column at once
@@ -171,11 +475,11 @@ flip_buffer (guchar *dst_buffer,
 
   int i0, j0;
 
-  for (i0 = 0; i0 < width; i0 += BLOCK_SIZE)
+  for (i0 = x0; i0 < x1; i0 += BLOCK_SIZE)
     for (j0 = 0; j0 < height; j0 += BLOCK_SIZE)
       {
         int max_j = MIN(j0 + BLOCK_SIZE, height);
-        int max_i = MIN(i0 + BLOCK_SIZE, width);
+        int max_i = MIN(i0 + BLOCK_SIZE, x1);
         int i, j;
 
         for (i = i0; i < max_i; i++)
@@ -185,6 +489,148 @@ flip_buffer (guchar *dst_buffer,
 #undef BLOCK_SIZE
 }
 
+typedef enum {
+  BLUR_TASK_COLUMNS,
+  BLUR_TASK_FLIP
+} BlurTaskType;
+
+typedef struct _BlurTaskGroup BlurTaskGroup;
+
+typedef struct {
+  BlurTaskGroup *group;
+  BlurTaskType type;
+  guchar *src;
+  guchar *dst;
+  int width;
+  int height;
+  int x0;
+  int x1;
+  int d;
+} BlurTask;
+
+struct _BlurTaskGroup {
+  GMutex lock;
+  GCond cond;
+  int n_pending;
+};
+
+static void
+blur_task_run (BlurTask *task)
+{
+  switch (task->type)
+    {
+    case BLUR_TASK_COLUMNS:
+      blur_column_range (task->src + task->x0, task->dst + task->x0,
+                         task->width, task->x1 - task->x0, task->height,
+                         task->d);
+      break;
+
+    case BLUR_TASK_FLIP:
+      flip_buffer (task->dst, task->src, task->width, task->height, task->x0, task->x1);
+      break;
+
+    default:
+      g_assert_not_reached ();
+    }
+}
+
+static void
+blur_task_thread_func (gpointer data,
+                       gpointer user_data)
+{
+  BlurTask *task = data;
+  BlurTaskGroup *group = task->group;
+
+  blur_task_run (task);
+
+  g_mutex_lock (&group->lock);
+  group->n_pending--;
+  if (group->n_pending == 0)
+    g_cond_signal (&group->cond);
+  g_mutex_unlock (&group->lock);
+}
+
+static GThreadPool *
+get_thread_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *new_pool;
+
+      new_pool = g_thread_pool_new (blur_task_thread_func, NULL,
+                                    g_get_num_processors () - 1, FALSE, NULL);
+
+      g_once_init_leave (&pool, new_pool);
+    }
+
+  return pool;
+}
+
+/* Splits the @width columns into one task per processor and runs
+ * them, blocking until all are done. The calling thread takes the
+ * first range itself.
+ */
+static void
+blur_run_tasks (BlurTaskType type,
+                guchar      *src,
+                guchar      *dst,
+                int          width,
+                int          height,
+                int          d)
+{
+  BlurTaskGroup group;
+  BlurTask *tasks;
+  int n_tasks, chunk;
+  int i;
+
+  n_tasks = 1;
+  if (width * height >= MIN_THREADED_PIXELS)
+    n_tasks = CLAMP (width / COLUMN_ALIGNMENT, 1, (int) g_get_num_processors ());
+
+  chunk = (width + n_tasks - 1) / n_tasks;
+  chunk = (chunk + COLUMN_ALIGNMENT - 1) / COLUMN_ALIGNMENT * COLUMN_ALIGNMENT;
+  n_tasks = (width + chunk - 1) / chunk;
+
+  tasks = g_newa (BlurTask, n_tasks);
+  for (i = 0; i < n_tasks; i++)
+    {
+      tasks[i].group = &group;
+      tasks[i].type = type;
+      tasks[i].src = src;
+      tasks[i].dst = dst;
+      tasks[i].width = width;
+      tasks[i].height = height;
+      tasks[i].x0 = i * chunk;
+      tasks[i].x1 = MIN ((i + 1) * chunk, width);
+      tasks[i].d = d;
+    }
+
+  if (n_tasks == 1)
+    {
+      blur_task_run (&tasks[0]);
+      return;
+    }
+
+  g_mutex_init (&group.lock);
+  g_cond_init (&group.cond);
+  group.n_pending = n_tasks - 1;
+
+  for (i = 1; i < n_tasks; i++)
+    g_thread_pool_push (get_thread_pool (), &tasks[i], NULL);
+
+  blur_task_run (&tasks[0]);
+
+  g_mutex_lock (&group.lock);
+  while (group.n_pending > 0)
+    g_cond_wait (&group.cond, &group.lock);
+  g_mutex_unlock (&group.lock);
+
+  g_cond_clear (&group.cond);
+  g_mutex_clear (&group.lock);
+}
+
 static void
 _boxblur (guchar      *buffer,
           int          width,
@@ -192,30 +638,34 @@ _boxblur (guchar      *buffer,
           int          radius,
           GskBlurFlags flags)
 {
-  guchar *flipped_buffer;
+  guchar *tmp_buffer;
   int d = get_box_filter_size (radius);
 
-  flipped_buffer = g_malloc (width * height);
+  tmp_buffer = g_malloc (width * height);
 
   if (flags & GSK_BLUR_Y)
     {
-      /* Step 1: swap rows and columns */
-      flip_buffer (flipped_buffer, buffer, width, height);
-
-      /* Step 2: blur rows (really columns) */
-      blur_rows (flipped_buffer, buffer, height, width, d);
-
-      /* Step 3: swap rows and columns */
-      flip_buffer (buffer, flipped_buffer, height, width);
+      /* Step 1: blur columns */
+      blur_run_tasks (BLUR_TASK_COLUMNS, buffer, tmp_buffer, width, height, d);
     }
 
   if (flags & GSK_BLUR_X)
     {
-      /* Step 4: blur rows */
-      blur_rows (buffer, flipped_buffer, width, height, d);
+      guchar *flipped_buffer = g_malloc (width * height);
+
+      /* Step 2: swap rows and columns */
+      blur_run_tasks (BLUR_TASK_FLIP, buffer, flipped_buffer, width, height, d);
+
+      /* Step 3: blur columns (really rows) */
+      blur_run_tasks (BLUR_TASK_COLUMNS, flipped_buffer, tmp_buffer, height, width, d);
+
+      /* Step 4: swap rows and columns */
+      blur_run_tasks (BLUR_TASK_FLIP, flipped_buffer, buffer, height, width, d);
+
+      g_free (flipped_buffer);
     }
 
-  g_free (flipped_buffer);
+  g_free (tmp_buffer);
 }
 
 /*
@@ -18,6 +18,13 @@ struct _GskCairoRenderer
 {
   GskRenderer parent_instance;
 
+  /* Contents of the previous frames, so unchanged areas
+   * don't need to be redrawn */
+  cairo_surface_t *frame_cache;
+  int frame_cache_width;
+  int frame_cache_height;
+  int frame_cache_scale;
+
 #ifdef G_ENABLE_DEBUG
   ProfileTimers profile_timers;
 #endif
@@ -41,7 +48,9 @@ gsk_cairo_renderer_realize (GskRenderer  *renderer,
 static void
 gsk_cairo_renderer_unrealize (GskRenderer *renderer)
 {
+  GskCairoRenderer *self = GSK_CAIRO_RENDERER (renderer);
 
+  g_clear_pointer (&self->frame_cache, cairo_surface_destroy);
 }
 
 static void
@@ -98,15 +107,22 @@ static void
 gsk_cairo_renderer_render (GskRenderer   *renderer,
                            GskRenderNode *root)
 {
+  GskCairoRenderer *self = GSK_CAIRO_RENDERER (renderer);
   GdkDrawingContext *context = gsk_renderer_get_drawing_context (renderer);
   GdkSurface *surface = gsk_renderer_get_surface (renderer);
+  const cairo_region_t *region;
+  int width, height, scale;
 
-  cairo_t *cr;
+  cairo_t *cr, *cache_cr;
 
   cr = gdk_drawing_context_get_cairo_context (context);
 
   g_return_if_fail (cr != NULL);
 
+  width = gdk_surface_get_width (surface);
+  height = gdk_surface_get_height (surface);
+  scale = gdk_surface_get_scale_factor (surface);
+
 #ifdef G_ENABLE_DEBUG
   if (GSK_RENDERER_DEBUG_CHECK (renderer, GEOMETRY))
     {
@@ -121,7 +137,43 @@ gsk_cairo_renderer_render (GskRenderer   *renderer,
     }
 #endif
 
-  gsk_cairo_renderer_do_render (renderer, cr, root);
+  if (self->frame_cache == NULL ||
+      self->frame_cache_width != width ||
+      self->frame_cache_height != height ||
+      self->frame_cache_scale != scale)
+    {
+      g_clear_pointer (&self->frame_cache, cairo_surface_destroy);
+      self->frame_cache = gdk_surface_create_similar_image_surface (surface,
+                                                                    CAIRO_FORMAT_ARGB32,
+                                                                    width * scale,
+                                                                    height * scale,
+                                                                    scale);
+      self->frame_cache_width = width;
+      self->frame_cache_height = height;
+      self->frame_cache_scale = scale;
+    }
+
+  /* Only redraw what changed since the last frame, then copy
+   * the whole area that needs to be presented. */
+  region = gsk_renderer_get_render_region (renderer);
+  if (!cairo_region_is_empty (region))
+    {
+      cache_cr = cairo_create (self->frame_cache);
+      gdk_cairo_region (cache_cr, region);
+      cairo_clip (cache_cr);
+
+      cairo_save (cache_cr);
+      cairo_set_operator (cache_cr, CAIRO_OPERATOR_CLEAR);
+      cairo_paint (cache_cr);
+      cairo_restore (cache_cr);
+
+      gsk_cairo_renderer_do_render (renderer, cache_cr, root);
+
+      cairo_destroy (cache_cr);
+    }
+
+  cairo_set_source_surface (cr, self->frame_cache, 0, 0);
+  cairo_paint (cr);
 }
 
 static void
@@ -71,6 +71,15 @@ typedef struct
   GskRenderNode *root_node;
   GdkDisplay *display;
 
+  /* The last frame rendered with a frame cache, and the area of the
+   * cache that contains its up-to-date contents */
+  GskRenderNode *prev_node;
+  cairo_region_t *cached_region;
+  int cached_width;
+  int cached_height;
+  int cached_scale;
+  cairo_region_t *render_region;
+
   GskProfiler *profiler;
 
   GskDebugFlags debug_flags;
@@ -155,6 +164,9 @@ gsk_renderer_dispose (GObject *gobject)
    * So we insist that unrealize must be called before unreffing. */
   g_assert (!priv->is_realized);
 
+  g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+  g_clear_pointer (&priv->cached_region, cairo_region_destroy);
+
   g_clear_object (&priv->profiler);
   g_clear_object (&priv->display);
 
@@ -330,6 +342,76 @@ gsk_renderer_get_root_node (GskRenderer *renderer)
   return priv->root_node;
 }
 
+/*< private >
+ * gsk_renderer_get_render_region:
+ * @renderer: a #GskRenderer
+ *
+ * Computes the area that needs to be redrawn into the frame cache of
+ * @renderer for the current frame, by diffing the root node against
+ * the one of the previous frame.
+ *
+ * This may only be called from the #GskRendererClass.render() vfunc.
+ * Renderers that call it are expected to keep the contents of previous
+ * frames around, update them in the returned region and then present
+ * the whole clip of the drawing context. The cache is considered lost
+ * when the size or scale of the surface changes.
+ *
+ * Returns: (transfer none): the region that needs to be redrawn
+ */
+const cairo_region_t *
+gsk_renderer_get_render_region (GskRenderer *renderer)
+{
+  GskRendererPrivate *priv = gsk_renderer_get_instance_private (renderer);
+  cairo_region_t *clip;
+  int width, height, scale;
+
+  g_return_val_if_fail (GSK_IS_RENDERER (renderer), NULL);
+  g_return_val_if_fail (priv->root_node != NULL, NULL);
+  g_return_val_if_fail (priv->drawing_context != NULL, NULL);
+
+  if (priv->render_region)
+    return priv->render_region;
+
+  width = gdk_surface_get_width (priv->surface);
+  height = gdk_surface_get_height (priv->surface);
+  scale = gdk_surface_get_scale_factor (priv->surface);
+
+  if (priv->cached_region == NULL ||
+      priv->cached_width != width ||
+      priv->cached_height != height ||
+      priv->cached_scale != scale ||
+      GSK_RENDERER_DEBUG_CHECK (renderer, FULL_REDRAW))
+    {
+      g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+      g_clear_pointer (&priv->cached_region, cairo_region_destroy);
+      priv->cached_region = cairo_region_create ();
+      priv->cached_width = width;
+      priv->cached_height = height;
+      priv->cached_scale = scale;
+    }
+
+  if (priv->prev_node)
+    {
+      cairo_region_t *changed = cairo_region_create ();
+
+      gsk_render_node_diff (priv->prev_node, priv->root_node, changed);
+      cairo_region_subtract (priv->cached_region, changed);
+      cairo_region_destroy (changed);
+    }
+
+  clip = gdk_drawing_context_get_clip (priv->drawing_context);
+  if (clip == NULL)
+    clip = cairo_region_create_rectangle (&(GdkRectangle) { 0, 0, width, height });
+  cairo_region_subtract (clip, priv->cached_region);
+  priv->render_region = clip;
+
+  GSK_RENDERER_NOTE (renderer, RENDERER,
+                     g_message ("Redrawing %d rectangles of the frame cache",
+                                cairo_region_num_rectangles (priv->render_region)));
+
+  return priv->render_region;
+}
+
 /*< private >
  * gsk_renderer_get_drawing_context:
  * @renderer: a #GskRenderer
@@ -435,6 +517,9 @@ gsk_renderer_unrealize (GskRenderer *renderer)
 
   GSK_RENDERER_GET_CLASS (renderer)->unrealize (renderer);
 
+  g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+  g_clear_pointer (&priv->cached_region, cairo_region_destroy);
+
   priv->is_realized = FALSE;
 }
 
@@ -531,6 +616,29 @@ gsk_renderer_render (GskRenderer       *renderer,
 
   GSK_RENDERER_GET_CLASS (renderer)->render (renderer, root);
 
+  if (priv->render_region)
+    {
+      cairo_region_t *clip;
+
+      /* The renderer updated its frame cache for the whole clip */
+      clip = gdk_drawing_context_get_clip (context);
+      if (clip)
+        {
+          cairo_region_union (priv->cached_region, clip);
+          cairo_region_destroy (clip);
+        }
+
+      g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+      priv->prev_node = gsk_render_node_ref (root);
+
+      g_clear_pointer (&priv->render_region, cairo_region_destroy);
+    }
+  else
+    {
+      g_clear_pointer (&priv->prev_node, gsk_render_node_unref);
+      g_clear_pointer (&priv->cached_region, cairo_region_destroy);
+    }
+
 #ifdef G_ENABLE_DEBUG
   if (GSK_RENDERER_DEBUG_CHECK (renderer, RENDERER))
     {
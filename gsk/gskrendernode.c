@@ -46,6 +46,7 @@
 #include <graphene-gobject.h>
 
 #include <math.h>
+#include <string.h>
 
 #include <gobject/gvaluecollector.h>
 
@@ -61,14 +62,262 @@ G_DEFINE_BOXED_TYPE (GskRenderNode, gsk_render_node,
 
 G_DEFINE_QUARK (gsk-serialization-error-quark, gsk_serialization_error)
 
+/* Snapshots create lots of small nodes that mostly die together, so while
+ * an arena is active on a thread, nodes get carved out of big chunks of
+ * memory instead of being allocated one by one. Every node keeps its chunk
+ * alive, so nodes that outlive the snapshot don't need special treatment;
+ * a chunk is freed once its last node is gone.
+ *
+ * Nested arenas allocate from the chunk of the outermost one, so the child
+ * snapshots that widgets create while being snapshotted fill up the chunk
+ * of the frame instead of each starting a mostly empty one. */
+#define ARENA_CHUNK_SIZE (32 * 1024)
+#define ARENA_ALIGNMENT 16
+#define ARENA_ALIGN(size) (((size) + ARENA_ALIGNMENT - 1) & ~(gsize) (ARENA_ALIGNMENT - 1))
+
+typedef struct
+{
+  volatile int ref_count;
+  gsize used;
+} GskRenderNodeChunk;
+
+struct _GskRenderNodeArena
+{
+  GskRenderNodeArena *parent;
+  GskRenderNodeChunk *chunk;
+};
+
+static GPrivate current_arena = G_PRIVATE_INIT (NULL);
+
+static GskRenderNodeChunk *
+gsk_render_node_chunk_new (void)
+{
+  GskRenderNodeChunk *chunk;
+
+  chunk = g_malloc (ARENA_CHUNK_SIZE);
+  chunk->ref_count = 1;
+  chunk->used = ARENA_ALIGN (sizeof (GskRenderNodeChunk));
+
+  return chunk;
+}
+
+static void
+gsk_render_node_chunk_unref (GskRenderNodeChunk *chunk)
+{
+  if (g_atomic_int_dec_and_test (&chunk->ref_count))
+    g_free (chunk);
+}
+
+/*< private >
+ * gsk_render_node_arena_push:
+ *
+ * Makes nodes created on this thread get allocated from a new arena,
+ * until gsk_render_node_arena_pop() is called. Arenas nest, and nested
+ * arenas share the memory of the outermost one.
+ *
+ * Returns: the new arena
+ */
+GskRenderNodeArena *
+gsk_render_node_arena_push (void)
+{
+  GskRenderNodeArena *arena;
+
+  arena = g_slice_new0 (GskRenderNodeArena);
+  arena->parent = g_private_get (&current_arena);
+  g_private_set (&current_arena, arena);
+
+  return arena;
+}
+
+/*< private >
+ * gsk_render_node_arena_pop:
+ * @arena: an arena returned by gsk_render_node_arena_push() on this thread
+ *
+ * Stops allocating from @arena. Nodes that were allocated from it
+ * stay valid.
+ */
+void
+gsk_render_node_arena_pop (GskRenderNodeArena *arena)
+{
+  GskRenderNodeArena *current;
+
+  current = g_private_get (&current_arena);
+  if (current == arena)
+    {
+      g_private_set (&current_arena, arena->parent);
+    }
+  else
+    {
+      /* Not the innermost one, snapshots don't have to be freed in order */
+      while (current != NULL && current->parent != arena)
+        current = current->parent;
+
+      g_return_if_fail (current != NULL);
+
+      current->parent = arena->parent;
+    }
+
+  g_clear_pointer (&arena->chunk, gsk_render_node_chunk_unref);
+  g_slice_free (GskRenderNodeArena, arena);
+}
+
+static gpointer
+gsk_render_node_arena_alloc (gsize      size,
+                             gpointer  *out_chunk)
+{
+  GskRenderNodeArena *arena = g_private_get (&current_arena);
+  GskRenderNodeChunk *chunk;
+  gpointer result;
+
+  size = ARENA_ALIGN (size);
+
+  /* Big nodes would waste too much of a chunk */
+  if (arena == NULL ||
+      size > (ARENA_CHUNK_SIZE - ARENA_ALIGN (sizeof (GskRenderNodeChunk))) / 4)
+    return NULL;
+
+  while (arena->parent != NULL)
+    arena = arena->parent;
+
+  if (arena->chunk == NULL || arena->chunk->used + size > ARENA_CHUNK_SIZE)
+    {
+      g_clear_pointer (&arena->chunk, gsk_render_node_chunk_unref);
+      arena->chunk = gsk_render_node_chunk_new ();
+    }
+
+  chunk = arena->chunk;
+  result = (guchar *) chunk + chunk->used;
+  chunk->used += size;
+  g_atomic_int_inc (&chunk->ref_count);
+
+  *out_chunk = chunk;
+  return result;
+}
+
+/* Snapshots recreate the same leaf nodes frame after frame. Interning
+ * them makes identical nodes share one instance, so diffing and the
+ * caches in the renderers, which compare nodes by pointer, can take
+ * their fast paths. Looking nodes up isn't free, so only callers whose
+ * nodes are expensive to render ask for it. The table doesn't hold
+ * references; nodes remove themselves when they are finalized. */
+static GHashTable *intern_table;
+static GMutex intern_lock;
+
+static guint
+intern_hash (gconstpointer key)
+{
+  return gsk_render_node_hash ((GskRenderNode *) key);
+}
+
+static gboolean
+intern_equal (gconstpointer a,
+              gconstpointer b)
+{
+  return gsk_render_node_equal ((GskRenderNode *) a, (GskRenderNode *) b);
+}
+
+static gboolean
+gsk_render_node_can_intern (GskRenderNode *node)
+{
+  /* Only leaves: hashing a parent walks its whole subtree, and parents
+   * rarely match if their children weren't already shared. Cairo nodes
+   * are compared by surface, which is never shared. */
+  switch (node->node_class->node_type)
+    {
+    case GSK_COLOR_NODE:
+    case GSK_LINEAR_GRADIENT_NODE:
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+    case GSK_BORDER_NODE:
+    case GSK_TEXTURE_NODE:
+    case GSK_INSET_SHADOW_NODE:
+    case GSK_OUTSET_SHADOW_NODE:
+    case GSK_TEXT_NODE:
+      /* Names are for debugging, keep named nodes apart */
+      return node->name == NULL;
+
+    default:
+      return FALSE;
+    }
+}
+
+/*< private >
+ * gsk_render_node_intern:
+ * @node: (transfer full): a #GskRenderNode
+ *
+ * Looks for a live node that is gsk_render_node_equal() to @node and
+ * returns that one instead, dropping the reference to @node. If there
+ * is none, @node is remembered for later calls and returned.
+ *
+ * Only leaf nodes without a name are interned, other nodes are
+ * returned unchanged.
+ *
+ * Returns: (transfer full): a node equal to @node
+ */
+GskRenderNode *
+gsk_render_node_intern (GskRenderNode *node)
+{
+  GskRenderNode *existing;
+
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
+
+  if (node->interned || !gsk_render_node_can_intern (node))
+    return node;
+
+  g_mutex_lock (&intern_lock);
+
+  if (intern_table == NULL)
+    intern_table = g_hash_table_new (intern_hash, intern_equal);
+
+  existing = g_hash_table_lookup (intern_table, node);
+  if (existing != NULL)
+    {
+      int ref_count;
+
+      /* The node might have just lost its last reference and be waiting
+       * for the lock to remove itself, don't resurrect it then. */
+      do
+        {
+          ref_count = g_atomic_int_get (&existing->ref_count);
+        }
+      while (ref_count > 0 &&
+             !g_atomic_int_compare_and_exchange (&existing->ref_count, ref_count, ref_count + 1));
+
+      if (ref_count > 0)
+        {
+          g_mutex_unlock (&intern_lock);
+          gsk_render_node_unref (node);
+          return existing;
+        }
+    }
+
+  g_hash_table_replace (intern_table, node, node);
+  node->interned = TRUE;
+
+  g_mutex_unlock (&intern_lock);
+
+  return node;
+}
+
 static void
 gsk_render_node_finalize (GskRenderNode *self)
 {
+  if (self->interned)
+    {
+      g_mutex_lock (&intern_lock);
+      /* Another node might have taken our place already */
+      if (g_hash_table_lookup (intern_table, self) == self)
+        g_hash_table_remove (intern_table, self);
+      g_mutex_unlock (&intern_lock);
+    }
+
   self->node_class->finalize (self);
 
   g_clear_pointer (&self->name, g_free);
 
-  g_free (self);
+  if (self->chunk)
+    gsk_render_node_chunk_unref (self->chunk);
+  else
+    g_free (self);
 }
 
 /*< private >
@@ -81,13 +330,22 @@ GskRenderNode *
 gsk_render_node_new (const GskRenderNodeClass *node_class, gsize extra_size)
 {
   GskRenderNode *self;
+  gpointer chunk = NULL;
+  gsize size;
 
   g_return_val_if_fail (node_class != NULL, NULL);
   g_return_val_if_fail (node_class->node_type != GSK_NOT_A_RENDER_NODE, NULL);
 
-  self = g_malloc0 (node_class->struct_size + extra_size);
+  size = node_class->struct_size + extra_size;
+
+  self = gsk_render_node_arena_alloc (size, &chunk);
+  if (self != NULL)
+    memset (self, 0, size);
+  else
+    self = g_malloc0 (size);
 
   self->node_class = node_class;
+  self->chunk = chunk;
 
   self->ref_count = 1;
 
@@ -219,10 +477,22 @@ void
 gsk_render_node_draw (GskRenderNode *node,
                       cairo_t       *cr)
 {
+  double clip_x1, clip_y1, clip_x2, clip_y2;
+
   g_return_if_fail (GSK_IS_RENDER_NODE (node));
   g_return_if_fail (cr != NULL);
   g_return_if_fail (cairo_status (cr) == CAIRO_STATUS_SUCCESS);
 
+  /* Nodes never draw outside of their bounds, so there is no point
+   * in drawing them if they are completely clipped away. This is what
+   * makes redrawing small damaged areas cheap. */
+  cairo_clip_extents (cr, &clip_x1, &clip_y1, &clip_x2, &clip_y2);
+  if (node->bounds.origin.x >= clip_x2 ||
+      node->bounds.origin.y >= clip_y2 ||
+      node->bounds.origin.x + node->bounds.size.width <= clip_x1 ||
+      node->bounds.origin.y + node->bounds.size.height <= clip_y1)
+    return;
+
   cairo_save (cr);
 
 #ifdef G_ENABLE_DEBUG
@@ -266,6 +536,85 @@ gsk_render_node_draw (GskRenderNode *node,
     }
 }
 
+/*< private >
+ * gsk_render_node_union_bounds:
+ * @region: a #cairo_region_t
+ * @bounds: the rectangle to add
+ *
+ * Adds the smallest integer-aligned rectangle containing @bounds
+ * to @region.
+ */
+void
+gsk_render_node_union_bounds (cairo_region_t        *region,
+                              const graphene_rect_t *bounds)
+{
+  cairo_rectangle_int_t rect;
+
+  rect.x = floorf (bounds->origin.x);
+  rect.y = floorf (bounds->origin.y);
+  rect.width = ceilf (bounds->origin.x + bounds->size.width) - rect.x;
+  rect.height = ceilf (bounds->origin.y + bounds->size.height) - rect.y;
+
+  cairo_region_union_rectangle (region, &rect);
+}
+
+/*< private >
+ * gsk_render_node_diff_impossible:
+ * @node1: a #GskRenderNode
+ * @node2: the #GskRenderNode to compare with
+ * @region: a #cairo_region_t to add the differences to
+ *
+ * Adds the bounds of both nodes to @region. This is the fallback
+ * for nodes that cannot be compared in any smarter way.
+ */
+void
+gsk_render_node_diff_impossible (GskRenderNode  *node1,
+                                 GskRenderNode  *node2,
+                                 cairo_region_t *region)
+{
+  gsk_render_node_union_bounds (region, &node1->bounds);
+  gsk_render_node_union_bounds (region, &node2->bounds);
+}
+
+/*< private >
+ * gsk_render_node_diff:
+ * @node1: a #GskRenderNode
+ * @node2: the #GskRenderNode to compare with
+ * @region: a #cairo_region_t to add the differences to
+ *
+ * Compares @node1 and @node2 and adds the area where drawing them
+ * would produce different results to @region. In the worst case,
+ * this is the union of the bounds of @node1 and @node2.
+ *
+ * This is used to compute the area that needs to be redrawn when
+ * the previous contents were drawn from @node1 and the new contents
+ * should correspond to @node2, so it needs to be a lot faster than
+ * actually drawing.
+ *
+ * Note that @region may already contain results from previous
+ * comparisons, this function will only add to it.
+ */
+void
+gsk_render_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  g_return_if_fail (GSK_IS_RENDER_NODE (node1));
+  g_return_if_fail (GSK_IS_RENDER_NODE (node2));
+  g_return_if_fail (region != NULL);
+
+  if (node1 == node2)
+    return;
+
+  if (node1->node_class != node2->node_class)
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  node1->node_class->diff (node1, node2, region);
+}
+
 #define GSK_RENDER_NODE_SERIALIZATION_VERSION 0
 #define GSK_RENDER_NODE_SERIALIZATION_ID "GskRenderNode"
 
@@ -283,6 +632,9 @@ gsk_render_node_draw (GskRenderNode *node,
  * The intended use of this functions is testing, benchmarking and debugging.
  * The format is not meant as a permanent storage format.
  *
+ * See gsk_render_node_serialize_binary() for a format that is faster
+ * to load.
+ *
  * Returns: a #GBytes representing the node.
  **/
 GBytes *
@@ -305,6 +657,27 @@ gsk_render_node_serialize (GskRenderNode *node)
   return result;
 }
 
+/**
+ * gsk_render_node_serialize_binary:
+ * @node: a #GskRenderNode
+ *
+ * Serializes the @node like gsk_render_node_serialize(), but uses a flat
+ * binary format. Nodes, textures, fonts and glyph runs that appear more
+ * than once are stored only once, and texture data is laid out so that
+ * gsk_render_node_load_from_file() can use it without copying.
+ *
+ * The same caveats as for gsk_render_node_serialize() apply to the format.
+ *
+ * Returns: a #GBytes representing the node.
+ **/
+GBytes *
+gsk_render_node_serialize_binary (GskRenderNode *node)
+{
+  g_return_val_if_fail (GSK_IS_RENDER_NODE (node), NULL);
+
+  return gsk_binary_format_serialize (node);
+}
+
 /**
  * gsk_render_node_write_to_file:
  * @node: a #GskRenderNode
@@ -316,7 +689,8 @@ gsk_render_node_serialize (GskRenderNode *node)
  * on the arguments.
  *
  * It is mostly intended for use inside a debugger to quickly dump a render
- * node to a file for later inspection.
+ * node to a file for later inspection. To save a node in the binary format,
+ * use gsk_render_node_serialize_binary() instead.
  *
  * Returns: %TRUE if saving was successful
  **/
@@ -347,8 +721,9 @@ gsk_render_node_write_to_file (GskRenderNode *node,
  * @bytes: the bytes containing the data
  * @error: (allow-none): location to store error or %NULL
  *
- * Loads data previously created via gsk_render_node_serialize(). For a
- * discussion of the supported format, see that function.
+ * Loads data previously created via gsk_render_node_serialize() or
+ * gsk_render_node_serialize_binary(). For a discussion of the supported
+ * formats, see those functions.
  *
  * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
  *     error.
@@ -362,6 +737,9 @@ gsk_render_node_deserialize (GBytes  *bytes,
   GVariant *variant, *node_variant;
   GskRenderNode *node = NULL;
 
+  if (gsk_binary_format_detect (bytes))
+    return gsk_binary_format_deserialize (bytes, error);
+
   variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(suuv)"), bytes, FALSE);
 
   g_variant_get (variant, "(suuv)", &id_string, &version, &node_type, &node_variant);
@@ -390,3 +768,42 @@ out:
   return node;
 }
 
+/**
+ * gsk_render_node_load_from_file:
+ * @filename: the file to load
+ * @error: (allow-none): location to store error or %NULL
+ *
+ * Loads a node that was saved with gsk_render_node_write_to_file()
+ * or otherwise serialized.
+ *
+ * The file is mapped into memory instead of being read, and textures
+ * in the binary format use the mapped data directly, so this is the
+ * preferred way to load large recordings.
+ *
+ * Returns: (nullable) (transfer full): a new #GskRenderNode or %NULL on
+ *     error.
+ **/
+GskRenderNode *
+gsk_render_node_load_from_file (const char  *filename,
+                                GError     **error)
+{
+  GMappedFile *file;
+  GskRenderNode *node;
+  GBytes *bytes;
+
+  g_return_val_if_fail (filename != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  file = g_mapped_file_new (filename, FALSE, error);
+  if (file == NULL)
+    return NULL;
+
+  bytes = g_mapped_file_get_bytes (file);
+  g_mapped_file_unref (file);
+
+  node = gsk_render_node_deserialize (bytes, error);
+  g_bytes_unref (bytes);
+
+  return node;
+}
+
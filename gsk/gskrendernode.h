@@ -82,12 +82,17 @@ void                    gsk_render_node_draw                    (GskRenderNode *
 GDK_AVAILABLE_IN_ALL
 GBytes *                gsk_render_node_serialize               (GskRenderNode *node);
 GDK_AVAILABLE_IN_ALL
+GBytes *                gsk_render_node_serialize_binary        (GskRenderNode *node);
+GDK_AVAILABLE_IN_ALL
 gboolean                gsk_render_node_write_to_file           (GskRenderNode *node,
                                                                  const char    *filename,
                                                                  GError       **error);
 GDK_AVAILABLE_IN_ALL
 GskRenderNode *         gsk_render_node_deserialize             (GBytes        *bytes,
                                                                  GError       **error);
+GDK_AVAILABLE_IN_ALL
+GskRenderNode *         gsk_render_node_load_from_file          (const char    *filename,
+                                                                 GError       **error);
 
 GDK_AVAILABLE_IN_ALL
 GskRenderNode *         gsk_color_node_new                      (const GdkRGBA            *rgba,
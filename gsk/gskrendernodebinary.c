@@ -0,0 +1,1130 @@
+/* GSK - The GTK Scene Kit
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include "gskrendernodebinaryprivate.h"
+
+#include "gskrendernodeprivate.h"
+
+#include <pango/pangocairo.h>
+#include <string.h>
+
+/* The binary node format is a flat alternative to the GVariant format
+ * used by gsk_render_node_serialize(). All numbers are little-endian.
+ *
+ * The file starts with a fixed size header:
+ *
+ *   0  char[8]  magic, GSK_BINARY_MAGIC
+ *   8  u32      version, GSK_BINARY_VERSION
+ *  12  u32      index of the root node
+ *  16  u32      number of nodes
+ *  20  u32      number of images
+ *  24  u32      number of fonts
+ *  28  u32      number of glyph runs
+ *  32  u64      offset of the node table
+ *  40  u64      offset of the image table
+ *  48  u64      offset of the font table
+ *  56  u64      offset of the glyph run table
+ *
+ * Node table entries are { u32 type, u32 size, u64 offset } and point
+ * to the node payload written by the class' encode vfunc. Nodes refer
+ * to their children by index, and children always come before their
+ * parents, so the file can be decoded in a single pass. A node that
+ * appears several times in the tree is only stored once.
+ *
+ * Image table entries are { u32 width, u32 height, u32 stride, u32 0,
+ * u64 offset }, pointing to premultiplied B8G8R8A8 pixels. They are
+ * shared between all texture and cairo nodes using the same texture or
+ * surface, and are aligned so that textures can use them straight from
+ * a mapped file.
+ *
+ * Font table entries are { u64 offset, u32 length, u32 0 }, pointing
+ * to a font description string. Glyph run table entries are { u64
+ * offset, u32 n_glyphs, u32 0 }, pointing to n_glyphs times { u32 glyph,
+ * i32 width, i32 x_offset, i32 y_offset, u32 is_cluster_start }. Equal
+ * glyph runs are stored only once.
+ */
+
+#define GSK_BINARY_MAGIC "\211GSKNODE"
+#define GSK_BINARY_VERSION 1
+
+#define HEADER_SIZE 64
+#define NODE_ENTRY_SIZE 16
+#define IMAGE_ENTRY_SIZE 24
+#define FONT_ENTRY_SIZE 16
+#define GLYPH_RUN_ENTRY_SIZE 16
+#define GLYPH_SIZE 20
+
+#define PAYLOAD_ALIGNMENT 8
+#define IMAGE_ALIGNMENT 64
+
+#define NO_INDEX G_MAXUINT32
+
+typedef struct {
+  guint32 type;
+  guint32 size;
+  guint64 offset;
+} NodeEntry;
+
+typedef struct {
+  guint32 width;
+  guint32 height;
+  guint32 stride;
+  guint64 offset;
+} ImageEntry;
+
+typedef struct {
+  guint64 offset;
+  guint32 length;
+} DataEntry;
+
+struct _GskBinaryWriter
+{
+  GByteArray *data;             /* the whole file */
+  GByteArray *payload;          /* payload of the node being encoded */
+
+  GArray *nodes;                /* NodeEntry */
+  GArray *images;               /* ImageEntry */
+  GArray *fonts;                /* DataEntry */
+  GArray *glyph_runs;           /* DataEntry */
+
+  GHashTable *node_indexes;     /* GskRenderNode => index */
+  GHashTable *image_indexes;    /* GdkTexture or cairo_surface_t => index */
+  GHashTable *font_indexes;     /* font description string => index */
+  GHashTable *glyph_run_indexes; /* GBytes of the glyphs => index */
+};
+
+struct _GskBinaryReader
+{
+  GBytes *bytes;
+  const guchar *data;
+  gsize size;
+
+  guint32 n_nodes;
+  guint32 n_images;
+  guint32 n_fonts;
+  guint32 n_glyph_runs;
+  guint64 nodes_offset;
+  guint64 images_offset;
+  guint64 fonts_offset;
+  guint64 glyph_runs_offset;
+
+  GskRenderNode **nodes;
+  guint32 n_decoded;            /* nodes that can be referenced */
+  GdkTexture **textures;
+  cairo_surface_t **surfaces;
+  PangoFont **fonts;
+  PangoContext *context;
+
+  const guchar *pos;            /* read position in the current payload */
+  const guchar *end;
+
+  GError *error;
+};
+
+static inline void
+append_uint32 (GByteArray *array,
+               guint32     value)
+{
+  value = GUINT32_TO_LE (value);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+static inline void
+append_uint64 (GByteArray *array,
+               guint64     value)
+{
+  value = GUINT64_TO_LE (value);
+  g_byte_array_append (array, (const guint8 *) &value, sizeof (value));
+}
+
+static inline guint32
+read_uint32 (const guchar *data)
+{
+  guint32 value;
+
+  memcpy (&value, data, sizeof (value));
+
+  return GUINT32_FROM_LE (value);
+}
+
+static inline guint64
+read_uint64 (const guchar *data)
+{
+  guint64 value;
+
+  memcpy (&value, data, sizeof (value));
+
+  return GUINT64_FROM_LE (value);
+}
+
+/* Appends @size bytes of @data to the file, aligned to @alignment,
+ * and returns their offset. */
+static guint64
+gsk_binary_writer_append_data (GskBinaryWriter *writer,
+                               gconstpointer    data,
+                               gsize            size,
+                               gsize            alignment)
+{
+  static const guint8 zeros[IMAGE_ALIGNMENT] = { 0, };
+  guint64 offset;
+
+  if (writer->data->len % alignment)
+    g_byte_array_append (writer->data, zeros, alignment - writer->data->len % alignment);
+
+  offset = writer->data->len;
+  g_byte_array_append (writer->data, data, size);
+
+  return offset;
+}
+
+void
+gsk_binary_writer_put_uint32 (GskBinaryWriter *writer,
+                              guint32          value)
+{
+  append_uint32 (writer->payload, value);
+}
+
+void
+gsk_binary_writer_put_float (GskBinaryWriter *writer,
+                             float            value)
+{
+  union { float f; guint32 u; } u = { value };
+
+  append_uint32 (writer->payload, u.u);
+}
+
+void
+gsk_binary_writer_put_double (GskBinaryWriter *writer,
+                              double           value)
+{
+  union { double d; guint64 u; } u = { value };
+
+  append_uint64 (writer->payload, u.u);
+}
+
+void
+gsk_binary_writer_put_rect (GskBinaryWriter       *writer,
+                            const graphene_rect_t *rect)
+{
+  gsk_binary_writer_put_float (writer, rect->origin.x);
+  gsk_binary_writer_put_float (writer, rect->origin.y);
+  gsk_binary_writer_put_float (writer, rect->size.width);
+  gsk_binary_writer_put_float (writer, rect->size.height);
+}
+
+void
+gsk_binary_writer_put_rounded_rect (GskBinaryWriter      *writer,
+                                    const GskRoundedRect *rect)
+{
+  guint i;
+
+  gsk_binary_writer_put_rect (writer, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      gsk_binary_writer_put_float (writer, rect->corner[i].width);
+      gsk_binary_writer_put_float (writer, rect->corner[i].height);
+    }
+}
+
+void
+gsk_binary_writer_put_rgba (GskBinaryWriter *writer,
+                            const GdkRGBA   *rgba)
+{
+  gsk_binary_writer_put_double (writer, rgba->red);
+  gsk_binary_writer_put_double (writer, rgba->green);
+  gsk_binary_writer_put_double (writer, rgba->blue);
+  gsk_binary_writer_put_double (writer, rgba->alpha);
+}
+
+void
+gsk_binary_writer_put_matrix (GskBinaryWriter         *writer,
+                              const graphene_matrix_t *matrix)
+{
+  float values[16];
+  guint i;
+
+  graphene_matrix_to_float (matrix, values);
+  for (i = 0; i < 16; i++)
+    gsk_binary_writer_put_float (writer, values[i]);
+}
+
+static guint32
+gsk_binary_writer_add_node (GskBinaryWriter *writer,
+                            GskRenderNode   *node)
+{
+  GByteArray *parent_payload;
+  NodeEntry entry;
+  gpointer index;
+
+  if (g_hash_table_lookup_extended (writer->node_indexes, node, NULL, &index))
+    return GPOINTER_TO_UINT (index);
+
+  /* Children get added while the parent is being encoded, so
+   * give every node its own payload buffer. */
+  parent_payload = writer->payload;
+  writer->payload = g_byte_array_new ();
+
+  gsk_render_node_encode_node (node, writer);
+
+  entry.type = gsk_render_node_get_node_type (node);
+  entry.size = writer->payload->len;
+  entry.offset = gsk_binary_writer_append_data (writer,
+                                                writer->payload->data,
+                                                writer->payload->len,
+                                                PAYLOAD_ALIGNMENT);
+  g_byte_array_unref (writer->payload);
+  writer->payload = parent_payload;
+
+  g_array_append_val (writer->nodes, entry);
+  g_hash_table_insert (writer->node_indexes, node, GUINT_TO_POINTER (writer->nodes->len - 1));
+
+  return writer->nodes->len - 1;
+}
+
+void
+gsk_binary_writer_put_node (GskBinaryWriter *writer,
+                            GskRenderNode   *node)
+{
+  gsk_binary_writer_put_uint32 (writer, gsk_binary_writer_add_node (writer, node));
+}
+
+/* @data is in the native cairo ARGB32 layout */
+static guint32
+gsk_binary_writer_add_image (GskBinaryWriter *writer,
+                             gpointer         key,
+                             const guchar    *data,
+                             int              width,
+                             int              height,
+                             int              stride)
+{
+  ImageEntry entry;
+  int y;
+
+  entry.width = width;
+  entry.height = height;
+  entry.stride = width * 4;
+  entry.offset = gsk_binary_writer_append_data (writer, NULL, 0, IMAGE_ALIGNMENT);
+
+  for (y = 0; y < height; y++)
+    {
+      g_byte_array_append (writer->data, data + y * stride, width * 4);
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+      {
+        guint32 *row = (guint32 *) (writer->data->data + writer->data->len - width * 4);
+        int x;
+
+        for (x = 0; x < width; x++)
+          row[x] = GUINT32_SWAP_LE_BE (row[x]);
+      }
+#endif
+    }
+
+  g_array_append_val (writer->images, entry);
+  g_hash_table_insert (writer->image_indexes, key, GUINT_TO_POINTER (writer->images->len - 1));
+
+  return writer->images->len - 1;
+}
+
+void
+gsk_binary_writer_put_texture (GskBinaryWriter *writer,
+                               GdkTexture      *texture)
+{
+  gpointer index;
+
+  if (!g_hash_table_lookup_extended (writer->image_indexes, texture, NULL, &index))
+    {
+      int width, height;
+      guchar *data;
+
+      width = gdk_texture_get_width (texture);
+      height = gdk_texture_get_height (texture);
+      data = g_malloc (width * height * 4);
+      gdk_texture_download (texture, data, width * 4);
+
+      index = GUINT_TO_POINTER (gsk_binary_writer_add_image (writer, texture, data, width, height, width * 4));
+
+      g_free (data);
+    }
+
+  gsk_binary_writer_put_uint32 (writer, GPOINTER_TO_UINT (index));
+}
+
+void
+gsk_binary_writer_put_surface (GskBinaryWriter       *writer,
+                               cairo_surface_t       *surface,
+                               const graphene_rect_t *area)
+{
+  gpointer index;
+
+  if (surface == NULL)
+    {
+      gsk_binary_writer_put_uint32 (writer, NO_INDEX);
+      return;
+    }
+
+  if (!g_hash_table_lookup_extended (writer->image_indexes, surface, NULL, &index))
+    {
+      cairo_surface_t *image;
+
+      image = cairo_surface_map_to_image (surface,
+                                          &(cairo_rectangle_int_t) {
+                                              area->origin.x, area->origin.y,
+                                              area->size.width, area->size.height
+                                          });
+      cairo_surface_flush (image);
+
+      index = GUINT_TO_POINTER (gsk_binary_writer_add_image (writer, surface,
+                                                             cairo_image_surface_get_data (image),
+                                                             cairo_image_surface_get_width (image),
+                                                             cairo_image_surface_get_height (image),
+                                                             cairo_image_surface_get_stride (image)));
+
+      cairo_surface_unmap_image (surface, image);
+    }
+
+  gsk_binary_writer_put_uint32 (writer, GPOINTER_TO_UINT (index));
+}
+
+void
+gsk_binary_writer_put_font (GskBinaryWriter *writer,
+                            PangoFont       *font)
+{
+  PangoFontDescription *desc;
+  gpointer index;
+  char *s;
+
+  desc = pango_font_describe (font);
+  s = pango_font_description_to_string (desc);
+  pango_font_description_free (desc);
+
+  if (!g_hash_table_lookup_extended (writer->font_indexes, s, NULL, &index))
+    {
+      DataEntry entry;
+
+      entry.length = strlen (s);
+      entry.offset = gsk_binary_writer_append_data (writer, s, entry.length, 1);
+      g_array_append_val (writer->fonts, entry);
+
+      index = GUINT_TO_POINTER (writer->fonts->len - 1);
+      g_hash_table_insert (writer->font_indexes, s, index);
+    }
+  else
+    g_free (s);
+
+  gsk_binary_writer_put_uint32 (writer, GPOINTER_TO_UINT (index));
+}
+
+void
+gsk_binary_writer_put_glyphs (GskBinaryWriter      *writer,
+                              const PangoGlyphInfo *glyphs,
+                              guint                 n_glyphs)
+{
+  GByteArray *run;
+  GBytes *bytes;
+  gpointer index;
+  guint i;
+
+  run = g_byte_array_sized_new (n_glyphs * GLYPH_SIZE);
+  for (i = 0; i < n_glyphs; i++)
+    {
+      append_uint32 (run, glyphs[i].glyph);
+      append_uint32 (run, glyphs[i].geometry.width);
+      append_uint32 (run, glyphs[i].geometry.x_offset);
+      append_uint32 (run, glyphs[i].geometry.y_offset);
+      append_uint32 (run, glyphs[i].attr.is_cluster_start);
+    }
+  bytes = g_byte_array_free_to_bytes (run);
+
+  if (!g_hash_table_lookup_extended (writer->glyph_run_indexes, bytes, NULL, &index))
+    {
+      DataEntry entry;
+
+      entry.length = n_glyphs;
+      entry.offset = gsk_binary_writer_append_data (writer,
+                                                    g_bytes_get_data (bytes, NULL),
+                                                    g_bytes_get_size (bytes),
+                                                    4);
+      g_array_append_val (writer->glyph_runs, entry);
+
+      index = GUINT_TO_POINTER (writer->glyph_runs->len - 1);
+      g_hash_table_insert (writer->glyph_run_indexes, bytes, index);
+    }
+  else
+    g_bytes_unref (bytes);
+
+  gsk_binary_writer_put_uint32 (writer, GPOINTER_TO_UINT (index));
+}
+
+static guint64
+gsk_binary_writer_write_data_table (GskBinaryWriter *writer,
+                                    GArray          *entries)
+{
+  guint64 offset;
+  guint i;
+
+  offset = gsk_binary_writer_append_data (writer, NULL, 0, PAYLOAD_ALIGNMENT);
+  for (i = 0; i < entries->len; i++)
+    {
+      DataEntry *entry = &g_array_index (entries, DataEntry, i);
+
+      append_uint64 (writer->data, entry->offset);
+      append_uint32 (writer->data, entry->length);
+      append_uint32 (writer->data, 0);
+    }
+
+  return offset;
+}
+
+/**
+ * gsk_binary_format_serialize:
+ * @node: a #GskRenderNode
+ *
+ * Serializes @node in the binary node format described above.
+ *
+ * Returns: the serialized data
+ */
+GBytes *
+gsk_binary_format_serialize (GskRenderNode *node)
+{
+  GskBinaryWriter writer;
+  guint64 nodes_offset, images_offset, fonts_offset, glyph_runs_offset;
+  guint32 root;
+  GByteArray *header;
+  guint i;
+
+  writer.data = g_byte_array_new ();
+  writer.payload = NULL;
+  writer.nodes = g_array_new (FALSE, FALSE, sizeof (NodeEntry));
+  writer.images = g_array_new (FALSE, FALSE, sizeof (ImageEntry));
+  writer.fonts = g_array_new (FALSE, FALSE, sizeof (DataEntry));
+  writer.glyph_runs = g_array_new (FALSE, FALSE, sizeof (DataEntry));
+  writer.node_indexes = g_hash_table_new (NULL, NULL);
+  writer.image_indexes = g_hash_table_new (NULL, NULL);
+  writer.font_indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  writer.glyph_run_indexes = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+                                                    (GDestroyNotify) g_bytes_unref, NULL);
+
+  /* The header gets filled in at the end */
+  g_byte_array_set_size (writer.data, HEADER_SIZE);
+
+  root = gsk_binary_writer_add_node (&writer, node);
+
+  nodes_offset = gsk_binary_writer_append_data (&writer, NULL, 0, PAYLOAD_ALIGNMENT);
+  for (i = 0; i < writer.nodes->len; i++)
+    {
+      NodeEntry *entry = &g_array_index (writer.nodes, NodeEntry, i);
+
+      append_uint32 (writer.data, entry->type);
+      append_uint32 (writer.data, entry->size);
+      append_uint64 (writer.data, entry->offset);
+    }
+
+  images_offset = gsk_binary_writer_append_data (&writer, NULL, 0, PAYLOAD_ALIGNMENT);
+  for (i = 0; i < writer.images->len; i++)
+    {
+      ImageEntry *entry = &g_array_index (writer.images, ImageEntry, i);
+
+      append_uint32 (writer.data, entry->width);
+      append_uint32 (writer.data, entry->height);
+      append_uint32 (writer.data, entry->stride);
+      append_uint32 (writer.data, 0);
+      append_uint64 (writer.data, entry->offset);
+    }
+
+  fonts_offset = gsk_binary_writer_write_data_table (&writer, writer.fonts);
+  glyph_runs_offset = gsk_binary_writer_write_data_table (&writer, writer.glyph_runs);
+
+  header = g_byte_array_sized_new (HEADER_SIZE);
+  g_byte_array_append (header, (const guint8 *) GSK_BINARY_MAGIC, 8);
+  append_uint32 (header, GSK_BINARY_VERSION);
+  append_uint32 (header, root);
+  append_uint32 (header, writer.nodes->len);
+  append_uint32 (header, writer.images->len);
+  append_uint32 (header, writer.fonts->len);
+  append_uint32 (header, writer.glyph_runs->len);
+  append_uint64 (header, nodes_offset);
+  append_uint64 (header, images_offset);
+  append_uint64 (header, fonts_offset);
+  append_uint64 (header, glyph_runs_offset);
+  g_assert (header->len == HEADER_SIZE);
+  memcpy (writer.data->data, header->data, HEADER_SIZE);
+  g_byte_array_unref (header);
+
+  g_array_unref (writer.nodes);
+  g_array_unref (writer.images);
+  g_array_unref (writer.fonts);
+  g_array_unref (writer.glyph_runs);
+  g_hash_table_unref (writer.node_indexes);
+  g_hash_table_unref (writer.image_indexes);
+  g_hash_table_unref (writer.font_indexes);
+  g_hash_table_unref (writer.glyph_run_indexes);
+
+  return g_byte_array_free_to_bytes (writer.data);
+}
+
+gboolean
+gsk_binary_format_detect (GBytes *bytes)
+{
+  gsize size;
+  const guchar *data;
+
+  data = g_bytes_get_data (bytes, &size);
+
+  return size >= HEADER_SIZE && memcmp (data, GSK_BINARY_MAGIC, 8) == 0;
+}
+
+gboolean
+gsk_binary_reader_has_error (GskBinaryReader *reader)
+{
+  return reader->error != NULL;
+}
+
+void
+gsk_binary_reader_set_error (GskBinaryReader *reader,
+                             const char      *format,
+                             ...)
+{
+  va_list args;
+
+  /* Keep the first error, everything after it is fallout */
+  if (reader->error)
+    return;
+
+  va_start (args, format);
+  reader->error = g_error_new_valist (GSK_SERIALIZATION_ERROR,
+                                      GSK_SERIALIZATION_INVALID_DATA,
+                                      format, args);
+  va_end (args);
+}
+
+static const guchar *
+gsk_binary_reader_read (GskBinaryReader *reader,
+                        gsize            size)
+{
+  const guchar *data;
+
+  if ((gsize) (reader->end - reader->pos) < size)
+    {
+      gsk_binary_reader_set_error (reader, "Unexpected end of node data");
+      reader->pos = reader->end;
+      return NULL;
+    }
+
+  data = reader->pos;
+  reader->pos += size;
+
+  return data;
+}
+
+/* Checks that @count entries of @size bytes at @offset are inside the data */
+static gboolean
+gsk_binary_reader_check_range (GskBinaryReader *reader,
+                               guint64          offset,
+                               guint64          count,
+                               guint64          size)
+{
+  if (offset > reader->size ||
+      (size > 0 && count > (reader->size - offset) / size))
+    {
+      gsk_binary_reader_set_error (reader, "Data at offset %"G_GUINT64_FORMAT" exceeds the file size", offset);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+guint32
+gsk_binary_reader_get_uint32 (GskBinaryReader *reader)
+{
+  const guchar *data = gsk_binary_reader_read (reader, 4);
+
+  return data ? read_uint32 (data) : 0;
+}
+
+/**
+ * gsk_binary_reader_get_count:
+ * @reader: a #GskBinaryReader
+ * @element_size: the size of each element in the payload
+ *
+ * Reads the number of elements of an array that follows in the
+ * payload and makes sure that there is enough data for them.
+ *
+ * Returns: the number of elements or 0 on error
+ */
+guint32
+gsk_binary_reader_get_count (GskBinaryReader *reader,
+                             gsize            element_size)
+{
+  guint32 count;
+
+  count = gsk_binary_reader_get_uint32 (reader);
+  if (count > (reader->end - reader->pos) / element_size)
+    {
+      gsk_binary_reader_set_error (reader, "Array of %u elements exceeds the node data", count);
+      return 0;
+    }
+
+  return count;
+}
+
+float
+gsk_binary_reader_get_float (GskBinaryReader *reader)
+{
+  union { float f; guint32 u; } u;
+
+  u.u = gsk_binary_reader_get_uint32 (reader);
+
+  return u.f;
+}
+
+double
+gsk_binary_reader_get_double (GskBinaryReader *reader)
+{
+  const guchar *data = gsk_binary_reader_read (reader, 8);
+  union { double d; guint64 u; } u;
+
+  u.u = data ? read_uint64 (data) : 0;
+
+  return u.d;
+}
+
+void
+gsk_binary_reader_get_rect (GskBinaryReader *reader,
+                            graphene_rect_t *rect)
+{
+  float x, y, width, height;
+
+  x = gsk_binary_reader_get_float (reader);
+  y = gsk_binary_reader_get_float (reader);
+  width = gsk_binary_reader_get_float (reader);
+  height = gsk_binary_reader_get_float (reader);
+
+  graphene_rect_init (rect, x, y, width, height);
+}
+
+void
+gsk_binary_reader_get_rounded_rect (GskBinaryReader *reader,
+                                    GskRoundedRect  *rect)
+{
+  guint i;
+
+  gsk_binary_reader_get_rect (reader, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      rect->corner[i].width = gsk_binary_reader_get_float (reader);
+      rect->corner[i].height = gsk_binary_reader_get_float (reader);
+    }
+}
+
+void
+gsk_binary_reader_get_rgba (GskBinaryReader *reader,
+                            GdkRGBA         *rgba)
+{
+  rgba->red = gsk_binary_reader_get_double (reader);
+  rgba->green = gsk_binary_reader_get_double (reader);
+  rgba->blue = gsk_binary_reader_get_double (reader);
+  rgba->alpha = gsk_binary_reader_get_double (reader);
+}
+
+void
+gsk_binary_reader_get_matrix (GskBinaryReader   *reader,
+                              graphene_matrix_t *matrix)
+{
+  float values[16];
+  guint i;
+
+  for (i = 0; i < 16; i++)
+    values[i] = gsk_binary_reader_get_float (reader);
+
+  graphene_matrix_init_from_float (matrix, values);
+}
+
+/**
+ * gsk_binary_reader_get_node:
+ * @reader: a #GskBinaryReader
+ *
+ * Reads a reference to a child node.
+ *
+ * Returns: (transfer none) (nullable): the node or %NULL on error
+ */
+GskRenderNode *
+gsk_binary_reader_get_node (GskBinaryReader *reader)
+{
+  guint32 index;
+
+  index = gsk_binary_reader_get_uint32 (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  if (index >= reader->n_decoded)
+    {
+      gsk_binary_reader_set_error (reader, "Node %u references node %u that has not been decoded",
+                                   reader->n_decoded, index);
+      return NULL;
+    }
+
+  return reader->nodes[index];
+}
+
+/* Returns the index of the image if it is valid */
+static gboolean
+gsk_binary_reader_get_image (GskBinaryReader *reader,
+                             guint32         *index,
+                             ImageEntry      *entry)
+{
+  const guchar *data;
+
+  *index = gsk_binary_reader_get_uint32 (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return FALSE;
+
+  if (*index >= reader->n_images)
+    {
+      gsk_binary_reader_set_error (reader, "Invalid image %u", *index);
+      return FALSE;
+    }
+
+  data = reader->data + reader->images_offset + *index * IMAGE_ENTRY_SIZE;
+  entry->width = read_uint32 (data);
+  entry->height = read_uint32 (data + 4);
+  entry->stride = read_uint32 (data + 8);
+  entry->offset = read_uint64 (data + 16);
+
+  if (entry->width == 0 || entry->height == 0 ||
+      entry->width > G_MAXINT / 4 || entry->height > G_MAXINT ||
+      entry->stride < entry->width * 4 || entry->stride % 4 != 0 ||
+      !gsk_binary_reader_check_range (reader, entry->offset, entry->height, entry->stride))
+    {
+      gsk_binary_reader_set_error (reader, "Invalid %ux%u image with stride %u",
+                                   entry->width, entry->height, entry->stride);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/**
+ * gsk_binary_reader_get_texture:
+ * @reader: a #GskBinaryReader
+ *
+ * Reads a reference to an image as a texture. On little-endian
+ * machines, the texture uses the data of the file without copying it.
+ *
+ * Returns: (transfer none) (nullable): the texture or %NULL on error
+ */
+GdkTexture *
+gsk_binary_reader_get_texture (GskBinaryReader *reader)
+{
+  ImageEntry entry;
+  guint32 index;
+  GBytes *bytes;
+
+  if (!gsk_binary_reader_get_image (reader, &index, &entry))
+    return NULL;
+
+  if (reader->textures[index])
+    return reader->textures[index];
+
+  bytes = g_bytes_new_from_bytes (reader->bytes, entry.offset, (gsize) entry.stride * entry.height);
+  reader->textures[index] = gdk_memory_texture_new (entry.width, entry.height,
+                                                    GDK_MEMORY_B8G8R8A8_PREMULTIPLIED,
+                                                    bytes,
+                                                    entry.stride);
+  g_bytes_unref (bytes);
+
+  return reader->textures[index];
+}
+
+/**
+ * gsk_binary_reader_get_surface:
+ * @reader: a #GskBinaryReader
+ *
+ * Reads a reference to an image as a cairo surface. Unlike textures,
+ * surfaces can be drawn to, so they get their own copy of the data.
+ *
+ * Returns: (transfer none) (nullable): the surface or %NULL if there
+ *     is none or on error
+ */
+cairo_surface_t *
+gsk_binary_reader_get_surface (GskBinaryReader *reader)
+{
+  cairo_surface_t *surface;
+  ImageEntry entry;
+  guint32 index;
+  guchar *data;
+  int stride;
+  guint y;
+
+  if (reader->end - reader->pos >= 4 && read_uint32 (reader->pos) == NO_INDEX)
+    {
+      reader->pos += 4;
+      return NULL;
+    }
+
+  if (!gsk_binary_reader_get_image (reader, &index, &entry))
+    return NULL;
+
+  if (reader->surfaces[index])
+    return reader->surfaces[index];
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, entry.width, entry.height);
+  data = cairo_image_surface_get_data (surface);
+  stride = cairo_image_surface_get_stride (surface);
+
+  for (y = 0; y < entry.height; y++)
+    {
+      memcpy (data + y * stride, reader->data + entry.offset + y * entry.stride, entry.width * 4);
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+      {
+        guint32 *row = (guint32 *) (data + y * stride);
+        guint x;
+
+        for (x = 0; x < entry.width; x++)
+          row[x] = GUINT32_SWAP_LE_BE (row[x]);
+      }
+#endif
+    }
+
+  cairo_surface_mark_dirty (surface);
+  reader->surfaces[index] = surface;
+
+  return surface;
+}
+
+/**
+ * gsk_binary_reader_get_font:
+ * @reader: a #GskBinaryReader
+ *
+ * Reads a reference to a font. Every font is only loaded once per file.
+ *
+ * Returns: (transfer none) (nullable): the font or %NULL on error
+ */
+PangoFont *
+gsk_binary_reader_get_font (GskBinaryReader *reader)
+{
+  PangoFontDescription *desc;
+  const guchar *data;
+  guint32 index;
+  guint64 offset;
+  guint32 length;
+  char *s;
+
+  index = gsk_binary_reader_get_uint32 (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  if (index >= reader->n_fonts)
+    {
+      gsk_binary_reader_set_error (reader, "Invalid font %u", index);
+      return NULL;
+    }
+
+  if (reader->fonts[index])
+    return reader->fonts[index];
+
+  data = reader->data + reader->fonts_offset + index * FONT_ENTRY_SIZE;
+  offset = read_uint64 (data);
+  length = read_uint32 (data + 8);
+  if (!gsk_binary_reader_check_range (reader, offset, length, 1))
+    return NULL;
+
+  if (reader->context == NULL)
+    reader->context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+
+  s = g_strndup ((const char *) reader->data + offset, length);
+  desc = pango_font_description_from_string (s);
+  reader->fonts[index] = pango_font_map_load_font (pango_context_get_font_map (reader->context),
+                                                   reader->context,
+                                                   desc);
+  pango_font_description_free (desc);
+  g_free (s);
+
+  if (reader->fonts[index] == NULL)
+    gsk_binary_reader_set_error (reader, "Could not load font %u", index);
+
+  return reader->fonts[index];
+}
+
+/**
+ * gsk_binary_reader_get_glyphs:
+ * @reader: a #GskBinaryReader
+ *
+ * Reads a reference to a glyph run.
+ *
+ * Returns: (transfer full) (nullable): a new glyph string or %NULL
+ *     on error
+ */
+PangoGlyphString *
+gsk_binary_reader_get_glyphs (GskBinaryReader *reader)
+{
+  PangoGlyphString *glyphs;
+  const guchar *data;
+  guint32 index, n_glyphs;
+  guint64 offset;
+  guint i;
+
+  index = gsk_binary_reader_get_uint32 (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  if (index >= reader->n_glyph_runs)
+    {
+      gsk_binary_reader_set_error (reader, "Invalid glyph run %u", index);
+      return NULL;
+    }
+
+  data = reader->data + reader->glyph_runs_offset + index * GLYPH_RUN_ENTRY_SIZE;
+  offset = read_uint64 (data);
+  n_glyphs = read_uint32 (data + 8);
+  if (n_glyphs > G_MAXINT ||
+      !gsk_binary_reader_check_range (reader, offset, n_glyphs, GLYPH_SIZE))
+    return NULL;
+
+  glyphs = pango_glyph_string_new ();
+  pango_glyph_string_set_size (glyphs, n_glyphs);
+
+  data = reader->data + offset;
+  for (i = 0; i < n_glyphs; i++, data += GLYPH_SIZE)
+    {
+      glyphs->glyphs[i].glyph = read_uint32 (data);
+      glyphs->glyphs[i].geometry.width = (gint32) read_uint32 (data + 4);
+      glyphs->glyphs[i].geometry.x_offset = (gint32) read_uint32 (data + 8);
+      glyphs->glyphs[i].geometry.y_offset = (gint32) read_uint32 (data + 12);
+      glyphs->glyphs[i].attr.is_cluster_start = read_uint32 (data + 16) ? 1 : 0;
+    }
+
+  return glyphs;
+}
+
+/**
+ * gsk_binary_format_deserialize:
+ * @bytes: data in the binary node format
+ * @error: return location for an error
+ *
+ * Loads a node from @bytes. Textures in the result keep a reference to
+ * @bytes and use its data directly, so passing the contents of a mapped
+ * file avoids copying the image data.
+ *
+ * Returns: (transfer full) (nullable): the node or %NULL on error
+ */
+GskRenderNode *
+gsk_binary_format_deserialize (GBytes  *bytes,
+                               GError **error)
+{
+  GskBinaryReader reader = { NULL, };
+  GskRenderNode *result = NULL;
+  guint32 version, root;
+  guint i;
+
+  if (!gsk_binary_format_detect (bytes))
+    {
+      g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_FORMAT,
+                   "Data not in the binary GskRenderNode format.");
+      return NULL;
+    }
+
+  reader.bytes = bytes;
+  reader.data = g_bytes_get_data (bytes, &reader.size);
+
+  version = read_uint32 (reader.data + 8);
+  if (version != GSK_BINARY_VERSION)
+    {
+      g_set_error (error, GSK_SERIALIZATION_ERROR, GSK_SERIALIZATION_UNSUPPORTED_VERSION,
+                   "Format version %u not supported.", version);
+      return NULL;
+    }
+
+  root = read_uint32 (reader.data + 12);
+  reader.n_nodes = read_uint32 (reader.data + 16);
+  reader.n_images = read_uint32 (reader.data + 20);
+  reader.n_fonts = read_uint32 (reader.data + 24);
+  reader.n_glyph_runs = read_uint32 (reader.data + 28);
+  reader.nodes_offset = read_uint64 (reader.data + 32);
+  reader.images_offset = read_uint64 (reader.data + 40);
+  reader.fonts_offset = read_uint64 (reader.data + 48);
+  reader.glyph_runs_offset = read_uint64 (reader.data + 56);
+
+  if (!gsk_binary_reader_check_range (&reader, reader.nodes_offset, reader.n_nodes, NODE_ENTRY_SIZE) ||
+      !gsk_binary_reader_check_range (&reader, reader.images_offset, reader.n_images, IMAGE_ENTRY_SIZE) ||
+      !gsk_binary_reader_check_range (&reader, reader.fonts_offset, reader.n_fonts, FONT_ENTRY_SIZE) ||
+      !gsk_binary_reader_check_range (&reader, reader.glyph_runs_offset, reader.n_glyph_runs, GLYPH_RUN_ENTRY_SIZE))
+    goto out;
+
+  if (root >= reader.n_nodes)
+    {
+      gsk_binary_reader_set_error (&reader, "Invalid root node %u", root);
+      goto out;
+    }
+
+  reader.nodes = g_new0 (GskRenderNode *, reader.n_nodes);
+  reader.textures = g_new0 (GdkTexture *, reader.n_images);
+  reader.surfaces = g_new0 (cairo_surface_t *, reader.n_images);
+  reader.fonts = g_new0 (PangoFont *, reader.n_fonts);
+
+  for (i = 0; i < reader.n_nodes; i++)
+    {
+      const guchar *entry = reader.data + reader.nodes_offset + i * NODE_ENTRY_SIZE;
+      guint32 type, size;
+      guint64 offset;
+
+      type = read_uint32 (entry);
+      size = read_uint32 (entry + 4);
+      offset = read_uint64 (entry + 8);
+      if (!gsk_binary_reader_check_range (&reader, offset, size, 1))
+        break;
+
+      reader.pos = reader.data + offset;
+      reader.end = reader.pos + size;
+
+      reader.nodes[i] = gsk_render_node_decode_node (type, &reader);
+      if (reader.nodes[i] == NULL)
+        {
+          gsk_binary_reader_set_error (&reader, "Could not decode node %u of type %u", i, type);
+          break;
+        }
+
+      reader.n_decoded = i + 1;
+    }
+
+  if (reader.error == NULL)
+    result = gsk_render_node_ref (reader.nodes[root]);
+
+  for (i = 0; i < reader.n_decoded; i++)
+    gsk_render_node_unref (reader.nodes[i]);
+  for (i = 0; i < reader.n_images; i++)
+    {
+      g_clear_object (&reader.textures[i]);
+      g_clear_pointer (&reader.surfaces[i], cairo_surface_destroy);
+    }
+  for (i = 0; i < reader.n_fonts; i++)
+    g_clear_object (&reader.fonts[i]);
+
+  g_free (reader.nodes);
+  g_free (reader.textures);
+  g_free (reader.surfaces);
+  g_free (reader.fonts);
+  g_clear_object (&reader.context);
+
+out:
+  if (reader.error)
+    g_propagate_error (error, reader.error);
+
+  return result;
+}
@@ -0,0 +1,71 @@
+#ifndef __GSK_RENDER_NODE_BINARY_PRIVATE_H__
+#define __GSK_RENDER_NODE_BINARY_PRIVATE_H__
+
+#include "gskrendernode.h"
+#include "gskroundedrect.h"
+#include <cairo.h>
+#include <pango/pango.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GskBinaryWriter GskBinaryWriter;
+typedef struct _GskBinaryReader GskBinaryReader;
+
+gboolean        gsk_binary_format_detect                (GBytes                 *bytes);
+GBytes *        gsk_binary_format_serialize             (GskRenderNode          *node);
+GskRenderNode * gsk_binary_format_deserialize           (GBytes                 *bytes,
+                                                         GError                **error);
+
+void            gsk_binary_writer_put_uint32            (GskBinaryWriter        *writer,
+                                                         guint32                 value);
+void            gsk_binary_writer_put_float             (GskBinaryWriter        *writer,
+                                                         float                   value);
+void            gsk_binary_writer_put_double            (GskBinaryWriter        *writer,
+                                                         double                  value);
+void            gsk_binary_writer_put_rect              (GskBinaryWriter        *writer,
+                                                         const graphene_rect_t  *rect);
+void            gsk_binary_writer_put_rounded_rect      (GskBinaryWriter        *writer,
+                                                         const GskRoundedRect   *rect);
+void            gsk_binary_writer_put_rgba              (GskBinaryWriter        *writer,
+                                                         const GdkRGBA          *rgba);
+void            gsk_binary_writer_put_matrix            (GskBinaryWriter        *writer,
+                                                         const graphene_matrix_t *matrix);
+void            gsk_binary_writer_put_node              (GskBinaryWriter        *writer,
+                                                         GskRenderNode          *node);
+void            gsk_binary_writer_put_texture           (GskBinaryWriter        *writer,
+                                                         GdkTexture             *texture);
+void            gsk_binary_writer_put_surface           (GskBinaryWriter        *writer,
+                                                         cairo_surface_t        *surface,
+                                                         const graphene_rect_t  *area);
+void            gsk_binary_writer_put_font              (GskBinaryWriter        *writer,
+                                                         PangoFont              *font);
+void            gsk_binary_writer_put_glyphs            (GskBinaryWriter        *writer,
+                                                         const PangoGlyphInfo   *glyphs,
+                                                         guint                   n_glyphs);
+
+gboolean        gsk_binary_reader_has_error             (GskBinaryReader        *reader);
+void            gsk_binary_reader_set_error             (GskBinaryReader        *reader,
+                                                         const char             *format,
+                                                         ...) G_GNUC_PRINTF (2, 3);
+guint32         gsk_binary_reader_get_uint32            (GskBinaryReader        *reader);
+guint32         gsk_binary_reader_get_count             (GskBinaryReader        *reader,
+                                                         gsize                   element_size);
+float           gsk_binary_reader_get_float             (GskBinaryReader        *reader);
+double          gsk_binary_reader_get_double            (GskBinaryReader        *reader);
+void            gsk_binary_reader_get_rect              (GskBinaryReader        *reader,
+                                                         graphene_rect_t        *rect);
+void            gsk_binary_reader_get_rounded_rect      (GskBinaryReader        *reader,
+                                                         GskRoundedRect         *rect);
+void            gsk_binary_reader_get_rgba              (GskBinaryReader        *reader,
+                                                         GdkRGBA                *rgba);
+void            gsk_binary_reader_get_matrix            (GskBinaryReader        *reader,
+                                                         graphene_matrix_t      *matrix);
+GskRenderNode * gsk_binary_reader_get_node              (GskBinaryReader        *reader);
+GdkTexture *    gsk_binary_reader_get_texture           (GskBinaryReader        *reader);
+cairo_surface_t *gsk_binary_reader_get_surface          (GskBinaryReader        *reader);
+PangoFont *     gsk_binary_reader_get_font              (GskBinaryReader        *reader);
+PangoGlyphString *gsk_binary_reader_get_glyphs          (GskBinaryReader        *reader);
+
+G_END_DECLS
+
+#endif /* __GSK_RENDER_NODE_BINARY_PRIVATE_H__ */
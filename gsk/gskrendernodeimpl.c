@@ -27,6 +27,9 @@
 
 #include "gdk/gdktextureprivate.h"
 
+#include <math.h>
+#include <string.h>
+
 static gboolean
 check_variant_type (GVariant *variant,
                     const char *type_string,
@@ -43,6 +46,192 @@ check_variant_type (GVariant *variant,
   return TRUE;
 }
 
+static gboolean
+gsk_color_stops_equal (const GskColorStop *stops1,
+                       const GskColorStop *stops2,
+                       gsize               n_stops)
+{
+  gsize i;
+
+  for (i = 0; i < n_stops; i++)
+    {
+      if (stops1[i].offset != stops2[i].offset ||
+          !gdk_rgba_equal (&stops1[i].color, &stops2[i].color))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+graphene_matrix_equal_fast (const graphene_matrix_t *matrix1,
+                            const graphene_matrix_t *matrix2)
+{
+  float m1[16], m2[16];
+
+  graphene_matrix_to_float (matrix1, m1);
+  graphene_matrix_to_float (matrix2, m2);
+
+  return memcmp (m1, m2, sizeof (m1)) == 0;
+}
+
+/* Helpers for the structural hash functions. Each of them folds a value
+ * into @hash. Zeroes get normalized, because -0.0 == 0.0 and things that
+ * compare equal need to hash the same. */
+#define HASH_COMBINE(hash, value) (((hash) << 5) + (hash) + (guint) (value))
+
+static guint
+hash_float (guint hash,
+            float value)
+{
+  guint32 bits;
+
+  if (value == 0.0f)
+    value = 0.0f;
+
+  memcpy (&bits, &value, sizeof (bits));
+
+  return HASH_COMBINE (hash, bits);
+}
+
+static guint
+hash_double (guint  hash,
+             double value)
+{
+  guint64 bits;
+
+  if (value == 0.0)
+    value = 0.0;
+
+  memcpy (&bits, &value, sizeof (bits));
+
+  return HASH_COMBINE (hash, bits ^ (bits >> 32));
+}
+
+static guint
+hash_point (guint                   hash,
+            const graphene_point_t *point)
+{
+  hash = hash_float (hash, point->x);
+  hash = hash_float (hash, point->y);
+
+  return hash;
+}
+
+static guint
+hash_rect (guint                  hash,
+           const graphene_rect_t *rect)
+{
+  hash = hash_float (hash, rect->origin.x);
+  hash = hash_float (hash, rect->origin.y);
+  hash = hash_float (hash, rect->size.width);
+  hash = hash_float (hash, rect->size.height);
+
+  return hash;
+}
+
+static guint
+hash_rounded_rect (guint                 hash,
+                   const GskRoundedRect *rect)
+{
+  guint i;
+
+  hash = hash_rect (hash, &rect->bounds);
+  for (i = 0; i < 4; i++)
+    {
+      hash = hash_float (hash, rect->corner[i].width);
+      hash = hash_float (hash, rect->corner[i].height);
+    }
+
+  return hash;
+}
+
+static guint
+hash_rgba (guint          hash,
+           const GdkRGBA *rgba)
+{
+  hash = hash_double (hash, rgba->red);
+  hash = hash_double (hash, rgba->green);
+  hash = hash_double (hash, rgba->blue);
+  hash = hash_double (hash, rgba->alpha);
+
+  return hash;
+}
+
+static guint
+hash_matrix (guint                    hash,
+             const graphene_matrix_t *matrix)
+{
+  float m[16];
+  guint i;
+
+  graphene_matrix_to_float (matrix, m);
+  for (i = 0; i < 16; i++)
+    hash = hash_float (hash, m[i]);
+
+  return hash;
+}
+
+static guint
+hash_vec4 (guint                  hash,
+           const graphene_vec4_t *vec)
+{
+  float v[4];
+  guint i;
+
+  graphene_vec4_to_float (vec, v);
+  for (i = 0; i < 4; i++)
+    hash = hash_float (hash, v[i]);
+
+  return hash;
+}
+
+/* Adds the rectangles of @sub, transformed by @transform, to @region */
+static void
+region_union_transformed (cairo_region_t          *region,
+                          const cairo_region_t    *sub,
+                          const graphene_matrix_t *transform)
+{
+  cairo_rectangle_int_t rect;
+  graphene_rect_t bounds;
+  int i, n;
+
+  n = cairo_region_num_rectangles (sub);
+  for (i = 0; i < n; i++)
+    {
+      cairo_region_get_rectangle (sub, i, &rect);
+      graphene_matrix_transform_bounds (transform,
+                                        &GRAPHENE_RECT_INIT (rect.x, rect.y, rect.width, rect.height),
+                                        &bounds);
+      gsk_render_node_union_bounds (region, &bounds);
+    }
+}
+
+/* Diffs the children of two nodes that only differ in their children
+ * and whose output is limited to @clip.
+ */
+static void
+gsk_render_node_diff_clipped (GskRenderNode         *child1,
+                              GskRenderNode         *child2,
+                              const graphene_rect_t *clip,
+                              cairo_region_t        *region)
+{
+  cairo_region_t *sub;
+  cairo_rectangle_int_t clip_rect;
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (child1, child2, sub);
+
+  clip_rect.x = floorf (clip->origin.x);
+  clip_rect.y = floorf (clip->origin.y);
+  clip_rect.width = ceilf (clip->origin.x + clip->size.width) - clip_rect.x;
+  clip_rect.height = ceilf (clip->origin.y + clip->size.height) - clip_rect.y;
+  cairo_region_intersect_rectangle (sub, &clip_rect);
+
+  cairo_region_union (region, sub);
+  cairo_region_destroy (sub);
+}
+
 /*** GSK_COLOR_NODE ***/
 
 typedef struct _GskColorNode GskColorNode;
@@ -73,6 +262,21 @@ gsk_color_node_draw (GskRenderNode *node,
   cairo_fill (cr);
 }
 
+static void
+gsk_color_node_diff (GskRenderNode  *node1,
+                     GskRenderNode  *node2,
+                     cairo_region_t *region)
+{
+  GskColorNode *self1 = (GskColorNode *) node1;
+  GskColorNode *self2 = (GskColorNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      gdk_rgba_equal (&self1->color, &self2->color))
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_COLOR_NODE_VARIANT_TYPE "(dddddddd)"
 
 static GVariant *
@@ -104,14 +308,61 @@ gsk_color_node_deserialize (GVariant  *variant,
   return gsk_color_node_new (&color, &GRAPHENE_RECT_INIT (x, y, w, h));
 }
 
+static void
+gsk_color_node_encode (GskRenderNode   *node,
+                       GskBinaryWriter *writer)
+{
+  GskColorNode *self = (GskColorNode *) node;
+
+  gsk_binary_writer_put_rect (writer, &node->bounds);
+  gsk_binary_writer_put_rgba (writer, &self->color);
+}
+
+static GskRenderNode *
+gsk_color_node_decode (GskBinaryReader *reader)
+{
+  graphene_rect_t bounds;
+  GdkRGBA color;
+
+  gsk_binary_reader_get_rect (reader, &bounds);
+  gsk_binary_reader_get_rgba (reader, &color);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_color_node_new (&color, &bounds);
+}
+
+static guint
+gsk_color_node_hash (GskRenderNode *node)
+{
+  GskColorNode *self = (GskColorNode *) node;
+
+  return hash_rgba (0, &self->color);
+}
+
+static gboolean
+gsk_color_node_equal (GskRenderNode *node1,
+                      GskRenderNode *node2)
+{
+  GskColorNode *self1 = (GskColorNode *) node1;
+  GskColorNode *self2 = (GskColorNode *) node2;
+
+  return gdk_rgba_equal (&self1->color, &self2->color);
+}
+
 static const GskRenderNodeClass GSK_COLOR_NODE_CLASS = {
   GSK_COLOR_NODE,
   sizeof (GskColorNode),
   "GskColorNode",
   gsk_color_node_finalize,
   gsk_color_node_draw,
+  gsk_color_node_diff,
   gsk_color_node_serialize,
   gsk_color_node_deserialize,
+  gsk_color_node_encode,
+  gsk_color_node_decode,
+  gsk_color_node_hash,
+  gsk_color_node_equal
 };
 
 const GdkRGBA *
@@ -202,6 +453,24 @@ gsk_linear_gradient_node_draw (GskRenderNode *node,
   cairo_fill (cr);
 }
 
+static void
+gsk_linear_gradient_node_diff (GskRenderNode  *node1,
+                               GskRenderNode  *node2,
+                               cairo_region_t *region)
+{
+  GskLinearGradientNode *self1 = (GskLinearGradientNode *) node1;
+  GskLinearGradientNode *self2 = (GskLinearGradientNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      graphene_point_equal (&self1->start, &self2->start) &&
+      graphene_point_equal (&self1->end, &self2->end) &&
+      self1->n_stops == self2->n_stops &&
+      gsk_color_stops_equal (self1->stops, self2->stops, self1->n_stops))
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_LINEAR_GRADIENT_NODE_VARIANT_TYPE "(dddddddda(ddddd))"
 
 static GVariant *
@@ -280,14 +549,123 @@ gsk_repeating_linear_gradient_node_deserialize (GVariant  *variant,
   return gsk_linear_gradient_node_real_deserialize (variant, TRUE, error);
 }
 
+static void
+gsk_linear_gradient_node_encode (GskRenderNode   *node,
+                                 GskBinaryWriter *writer)
+{
+  GskLinearGradientNode *self = (GskLinearGradientNode *) node;
+  gsize i;
+
+  gsk_binary_writer_put_rect (writer, &node->bounds);
+  gsk_binary_writer_put_float (writer, self->start.x);
+  gsk_binary_writer_put_float (writer, self->start.y);
+  gsk_binary_writer_put_float (writer, self->end.x);
+  gsk_binary_writer_put_float (writer, self->end.y);
+  gsk_binary_writer_put_uint32 (writer, self->n_stops);
+  for (i = 0; i < self->n_stops; i++)
+    {
+      gsk_binary_writer_put_double (writer, self->stops[i].offset);
+      gsk_binary_writer_put_rgba (writer, &self->stops[i].color);
+    }
+}
+
+static GskRenderNode *
+gsk_linear_gradient_node_real_decode (GskBinaryReader *reader,
+                                      gboolean         repeating)
+{
+  graphene_rect_t bounds;
+  graphene_point_t start, end;
+  GskRenderNode *result;
+  GskColorStop *stops;
+  gsize i, n_stops;
+
+  gsk_binary_reader_get_rect (reader, &bounds);
+  start.x = gsk_binary_reader_get_float (reader);
+  start.y = gsk_binary_reader_get_float (reader);
+  end.x = gsk_binary_reader_get_float (reader);
+  end.y = gsk_binary_reader_get_float (reader);
+  n_stops = gsk_binary_reader_get_count (reader, 5 * sizeof (double));
+  if (n_stops < 2)
+    {
+      gsk_binary_reader_set_error (reader, "Gradients need at least 2 color stops");
+      return NULL;
+    }
+
+  stops = g_new (GskColorStop, n_stops);
+  for (i = 0; i < n_stops; i++)
+    {
+      stops[i].offset = gsk_binary_reader_get_double (reader);
+      gsk_binary_reader_get_rgba (reader, &stops[i].color);
+    }
+
+  if (gsk_binary_reader_has_error (reader))
+    result = NULL;
+  else
+    result = (repeating ? gsk_repeating_linear_gradient_node_new : gsk_linear_gradient_node_new)
+                          (&bounds, &start, &end, stops, n_stops);
+
+  g_free (stops);
+
+  return result;
+}
+
+static GskRenderNode *
+gsk_linear_gradient_node_decode (GskBinaryReader *reader)
+{
+  return gsk_linear_gradient_node_real_decode (reader, FALSE);
+}
+
+static GskRenderNode *
+gsk_repeating_linear_gradient_node_decode (GskBinaryReader *reader)
+{
+  return gsk_linear_gradient_node_real_decode (reader, TRUE);
+}
+
+static guint
+gsk_linear_gradient_node_hash (GskRenderNode *node)
+{
+  GskLinearGradientNode *self = (GskLinearGradientNode *) node;
+  guint hash;
+  gsize i;
+
+  hash = hash_point (0, &self->start);
+  hash = hash_point (hash, &self->end);
+  hash = HASH_COMBINE (hash, self->n_stops);
+  for (i = 0; i < self->n_stops; i++)
+    {
+      hash = hash_double (hash, self->stops[i].offset);
+      hash = hash_rgba (hash, &self->stops[i].color);
+    }
+
+  return hash;
+}
+
+static gboolean
+gsk_linear_gradient_node_equal (GskRenderNode *node1,
+                                GskRenderNode *node2)
+{
+  GskLinearGradientNode *self1 = (GskLinearGradientNode *) node1;
+  GskLinearGradientNode *self2 = (GskLinearGradientNode *) node2;
+
+  return graphene_point_equal (&self1->start, &self2->start) &&
+         graphene_point_equal (&self1->end, &self2->end) &&
+         self1->n_stops == self2->n_stops &&
+         gsk_color_stops_equal (self1->stops, self2->stops, self1->n_stops);
+}
+
 static const GskRenderNodeClass GSK_LINEAR_GRADIENT_NODE_CLASS = {
   GSK_LINEAR_GRADIENT_NODE,
   sizeof (GskLinearGradientNode),
   "GskLinearGradientNode",
   gsk_linear_gradient_node_finalize,
   gsk_linear_gradient_node_draw,
+  gsk_linear_gradient_node_diff,
   gsk_linear_gradient_node_serialize,
   gsk_linear_gradient_node_deserialize,
+  gsk_linear_gradient_node_encode,
+  gsk_linear_gradient_node_decode,
+  gsk_linear_gradient_node_hash,
+  gsk_linear_gradient_node_equal
 };
 
 static const GskRenderNodeClass GSK_REPEATING_LINEAR_GRADIENT_NODE_CLASS = {
@@ -296,8 +674,13 @@ static const GskRenderNodeClass GSK_REPEATING_LINEAR_GRADIENT_NODE_CLASS = {
   "GskRepeatingLinearGradientNode",
   gsk_linear_gradient_node_finalize,
   gsk_linear_gradient_node_draw,
+  gsk_linear_gradient_node_diff,
   gsk_linear_gradient_node_serialize,
   gsk_repeating_linear_gradient_node_deserialize,
+  gsk_linear_gradient_node_encode,
+  gsk_repeating_linear_gradient_node_decode,
+  gsk_linear_gradient_node_hash,
+  gsk_linear_gradient_node_equal
 };
 
 /**
@@ -520,6 +903,25 @@ gsk_border_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
+static void
+gsk_border_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  GskBorderNode *self1 = (GskBorderNode *) node1;
+  GskBorderNode *self2 = (GskBorderNode *) node2;
+
+  if (gsk_rounded_rect_equal (&self1->outline, &self2->outline) &&
+      memcmp (self1->border_width, self2->border_width, sizeof (self1->border_width)) == 0 &&
+      gdk_rgba_equal (&self1->border_color[0], &self2->border_color[0]) &&
+      gdk_rgba_equal (&self1->border_color[1], &self2->border_color[1]) &&
+      gdk_rgba_equal (&self1->border_color[2], &self2->border_color[2]) &&
+      gdk_rgba_equal (&self1->border_color[3], &self2->border_color[3]))
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_BORDER_NODE_VARIANT_TYPE "(dddddddddddddddddddddddddddddddd)"
 
 static GVariant *
@@ -579,14 +981,90 @@ gsk_border_node_deserialize (GVariant  *variant,
                               colors);
 }
 
+static void
+gsk_border_node_encode (GskRenderNode   *node,
+                        GskBinaryWriter *writer)
+{
+  GskBorderNode *self = (GskBorderNode *) node;
+  guint i;
+
+  gsk_binary_writer_put_rounded_rect (writer, &self->outline);
+  for (i = 0; i < 4; i++)
+    gsk_binary_writer_put_float (writer, self->border_width[i]);
+  for (i = 0; i < 4; i++)
+    gsk_binary_writer_put_rgba (writer, &self->border_color[i]);
+}
+
+static GskRenderNode *
+gsk_border_node_decode (GskBinaryReader *reader)
+{
+  GskRoundedRect outline;
+  float border_width[4];
+  GdkRGBA border_color[4];
+  guint i;
+
+  gsk_binary_reader_get_rounded_rect (reader, &outline);
+  for (i = 0; i < 4; i++)
+    border_width[i] = gsk_binary_reader_get_float (reader);
+  for (i = 0; i < 4; i++)
+    gsk_binary_reader_get_rgba (reader, &border_color[i]);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_border_node_new (&outline, border_width, border_color);
+}
+
+static guint
+gsk_border_node_hash (GskRenderNode *node)
+{
+  GskBorderNode *self = (GskBorderNode *) node;
+  guint hash;
+  guint i;
+
+  hash = hash_rounded_rect (0, &self->outline);
+  for (i = 0; i < 4; i++)
+    {
+      hash = hash_float (hash, self->border_width[i]);
+      hash = hash_rgba (hash, &self->border_color[i]);
+    }
+
+  return hash;
+}
+
+static gboolean
+gsk_border_node_equal (GskRenderNode *node1,
+                       GskRenderNode *node2)
+{
+  GskBorderNode *self1 = (GskBorderNode *) node1;
+  GskBorderNode *self2 = (GskBorderNode *) node2;
+  guint i;
+
+  if (!gsk_rounded_rect_equal (&self1->outline, &self2->outline))
+    return FALSE;
+
+  for (i = 0; i < 4; i++)
+    {
+      if (self1->border_width[i] != self2->border_width[i] ||
+          !gdk_rgba_equal (&self1->border_color[i], &self2->border_color[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static const GskRenderNodeClass GSK_BORDER_NODE_CLASS = {
   GSK_BORDER_NODE,
   sizeof (GskBorderNode),
   "GskBorderNode",
   gsk_border_node_finalize,
   gsk_border_node_draw,
+  gsk_border_node_diff,
   gsk_border_node_serialize,
-  gsk_border_node_deserialize
+  gsk_border_node_deserialize,
+  gsk_border_node_encode,
+  gsk_border_node_decode,
+  gsk_border_node_hash,
+  gsk_border_node_equal
 };
 
 const GskRoundedRect *
@@ -691,6 +1169,21 @@ gsk_texture_node_draw (GskRenderNode *node,
   cairo_surface_destroy (surface);
 }
 
+static void
+gsk_texture_node_diff (GskRenderNode  *node1,
+                       GskRenderNode  *node2,
+                       cairo_region_t *region)
+{
+  GskTextureNode *self1 = (GskTextureNode *) node1;
+  GskTextureNode *self2 = (GskTextureNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      self1->texture == self2->texture)
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_TEXTURE_NODE_VARIANT_TYPE "(dddduuau)"
 
 static GVariant *
@@ -766,14 +1259,61 @@ gsk_texture_node_deserialize (GVariant  *variant,
   return node;
 }
 
+static void
+gsk_texture_node_encode (GskRenderNode   *node,
+                         GskBinaryWriter *writer)
+{
+  GskTextureNode *self = (GskTextureNode *) node;
+
+  gsk_binary_writer_put_rect (writer, &node->bounds);
+  gsk_binary_writer_put_texture (writer, self->texture);
+}
+
+static GskRenderNode *
+gsk_texture_node_decode (GskBinaryReader *reader)
+{
+  graphene_rect_t bounds;
+  GdkTexture *texture;
+
+  gsk_binary_reader_get_rect (reader, &bounds);
+  texture = gsk_binary_reader_get_texture (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_texture_node_new (texture, &bounds);
+}
+
+static guint
+gsk_texture_node_hash (GskRenderNode *node)
+{
+  GskTextureNode *self = (GskTextureNode *) node;
+
+  return g_direct_hash (self->texture);
+}
+
+static gboolean
+gsk_texture_node_equal (GskRenderNode *node1,
+                        GskRenderNode *node2)
+{
+  GskTextureNode *self1 = (GskTextureNode *) node1;
+  GskTextureNode *self2 = (GskTextureNode *) node2;
+
+  return self1->texture == self2->texture;
+}
+
 static const GskRenderNodeClass GSK_TEXTURE_NODE_CLASS = {
   GSK_TEXTURE_NODE,
   sizeof (GskTextureNode),
   "GskTextureNode",
   gsk_texture_node_finalize,
   gsk_texture_node_draw,
+  gsk_texture_node_diff,
   gsk_texture_node_serialize,
-  gsk_texture_node_deserialize
+  gsk_texture_node_deserialize,
+  gsk_texture_node_encode,
+  gsk_texture_node_decode,
+  gsk_texture_node_hash,
+  gsk_texture_node_equal
 };
 
 /**
@@ -1223,7 +1763,26 @@ gsk_inset_shadow_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
-#define GSK_INSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
+static void
+gsk_inset_shadow_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
+{
+  GskInsetShadowNode *self1 = (GskInsetShadowNode *) node1;
+  GskInsetShadowNode *self2 = (GskInsetShadowNode *) node2;
+
+  if (gsk_rounded_rect_equal (&self1->outline, &self2->outline) &&
+      gdk_rgba_equal (&self1->color, &self2->color) &&
+      self1->dx == self2->dx &&
+      self1->dy == self2->dy &&
+      self1->spread == self2->spread &&
+      self1->blur_radius == self2->blur_radius)
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
+#define GSK_INSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
 
 static GVariant *
 gsk_inset_shadow_node_serialize (GskRenderNode *node)
@@ -1272,14 +1831,83 @@ gsk_inset_shadow_node_deserialize (GVariant  *variant,
                                     &color, dx, dy, spread, radius);
 }
 
+static void
+gsk_inset_shadow_node_encode (GskRenderNode   *node,
+                              GskBinaryWriter *writer)
+{
+  GskInsetShadowNode *self = (GskInsetShadowNode *) node;
+
+  gsk_binary_writer_put_rounded_rect (writer, &self->outline);
+  gsk_binary_writer_put_rgba (writer, &self->color);
+  gsk_binary_writer_put_float (writer, self->dx);
+  gsk_binary_writer_put_float (writer, self->dy);
+  gsk_binary_writer_put_float (writer, self->spread);
+  gsk_binary_writer_put_float (writer, self->blur_radius);
+}
+
+static GskRenderNode *
+gsk_inset_shadow_node_decode (GskBinaryReader *reader)
+{
+  GskRoundedRect outline;
+  GdkRGBA color;
+  float dx, dy, spread, blur_radius;
+
+  gsk_binary_reader_get_rounded_rect (reader, &outline);
+  gsk_binary_reader_get_rgba (reader, &color);
+  dx = gsk_binary_reader_get_float (reader);
+  dy = gsk_binary_reader_get_float (reader);
+  spread = gsk_binary_reader_get_float (reader);
+  blur_radius = gsk_binary_reader_get_float (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_inset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+}
+
+static guint
+gsk_inset_shadow_node_hash (GskRenderNode *node)
+{
+  GskInsetShadowNode *self = (GskInsetShadowNode *) node;
+  guint hash;
+
+  hash = hash_rounded_rect (0, &self->outline);
+  hash = hash_rgba (hash, &self->color);
+  hash = hash_float (hash, self->dx);
+  hash = hash_float (hash, self->dy);
+  hash = hash_float (hash, self->spread);
+  hash = hash_float (hash, self->blur_radius);
+
+  return hash;
+}
+
+static gboolean
+gsk_inset_shadow_node_equal (GskRenderNode *node1,
+                             GskRenderNode *node2)
+{
+  GskInsetShadowNode *self1 = (GskInsetShadowNode *) node1;
+  GskInsetShadowNode *self2 = (GskInsetShadowNode *) node2;
+
+  return gsk_rounded_rect_equal (&self1->outline, &self2->outline) &&
+         gdk_rgba_equal (&self1->color, &self2->color) &&
+         self1->dx == self2->dx &&
+         self1->dy == self2->dy &&
+         self1->spread == self2->spread &&
+         self1->blur_radius == self2->blur_radius;
+}
+
 static const GskRenderNodeClass GSK_INSET_SHADOW_NODE_CLASS = {
   GSK_INSET_SHADOW_NODE,
   sizeof (GskInsetShadowNode),
   "GskInsetShadowNode",
   gsk_inset_shadow_node_finalize,
   gsk_inset_shadow_node_draw,
+  gsk_inset_shadow_node_diff,
   gsk_inset_shadow_node_serialize,
-  gsk_inset_shadow_node_deserialize
+  gsk_inset_shadow_node_deserialize,
+  gsk_inset_shadow_node_encode,
+  gsk_inset_shadow_node_decode,
+  gsk_inset_shadow_node_hash,
+  gsk_inset_shadow_node_equal
 };
 
 /**
@@ -1524,6 +2152,25 @@ gsk_outset_shadow_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
+static void
+gsk_outset_shadow_node_diff (GskRenderNode  *node1,
+                             GskRenderNode  *node2,
+                             cairo_region_t *region)
+{
+  GskOutsetShadowNode *self1 = (GskOutsetShadowNode *) node1;
+  GskOutsetShadowNode *self2 = (GskOutsetShadowNode *) node2;
+
+  if (gsk_rounded_rect_equal (&self1->outline, &self2->outline) &&
+      gdk_rgba_equal (&self1->color, &self2->color) &&
+      self1->dx == self2->dx &&
+      self1->dy == self2->dy &&
+      self1->spread == self2->spread &&
+      self1->blur_radius == self2->blur_radius)
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_OUTSET_SHADOW_NODE_VARIANT_TYPE "(dddddddddddddddddddd)"
 
 static GVariant *
@@ -1573,14 +2220,83 @@ gsk_outset_shadow_node_deserialize (GVariant  *variant,
                                      &color, dx, dy, spread, radius);
 }
 
+static void
+gsk_outset_shadow_node_encode (GskRenderNode   *node,
+                               GskBinaryWriter *writer)
+{
+  GskOutsetShadowNode *self = (GskOutsetShadowNode *) node;
+
+  gsk_binary_writer_put_rounded_rect (writer, &self->outline);
+  gsk_binary_writer_put_rgba (writer, &self->color);
+  gsk_binary_writer_put_float (writer, self->dx);
+  gsk_binary_writer_put_float (writer, self->dy);
+  gsk_binary_writer_put_float (writer, self->spread);
+  gsk_binary_writer_put_float (writer, self->blur_radius);
+}
+
+static GskRenderNode *
+gsk_outset_shadow_node_decode (GskBinaryReader *reader)
+{
+  GskRoundedRect outline;
+  GdkRGBA color;
+  float dx, dy, spread, blur_radius;
+
+  gsk_binary_reader_get_rounded_rect (reader, &outline);
+  gsk_binary_reader_get_rgba (reader, &color);
+  dx = gsk_binary_reader_get_float (reader);
+  dy = gsk_binary_reader_get_float (reader);
+  spread = gsk_binary_reader_get_float (reader);
+  blur_radius = gsk_binary_reader_get_float (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_outset_shadow_node_new (&outline, &color, dx, dy, spread, blur_radius);
+}
+
+static guint
+gsk_outset_shadow_node_hash (GskRenderNode *node)
+{
+  GskOutsetShadowNode *self = (GskOutsetShadowNode *) node;
+  guint hash;
+
+  hash = hash_rounded_rect (0, &self->outline);
+  hash = hash_rgba (hash, &self->color);
+  hash = hash_float (hash, self->dx);
+  hash = hash_float (hash, self->dy);
+  hash = hash_float (hash, self->spread);
+  hash = hash_float (hash, self->blur_radius);
+
+  return hash;
+}
+
+static gboolean
+gsk_outset_shadow_node_equal (GskRenderNode *node1,
+                              GskRenderNode *node2)
+{
+  GskOutsetShadowNode *self1 = (GskOutsetShadowNode *) node1;
+  GskOutsetShadowNode *self2 = (GskOutsetShadowNode *) node2;
+
+  return gsk_rounded_rect_equal (&self1->outline, &self2->outline) &&
+         gdk_rgba_equal (&self1->color, &self2->color) &&
+         self1->dx == self2->dx &&
+         self1->dy == self2->dy &&
+         self1->spread == self2->spread &&
+         self1->blur_radius == self2->blur_radius;
+}
+
 static const GskRenderNodeClass GSK_OUTSET_SHADOW_NODE_CLASS = {
   GSK_OUTSET_SHADOW_NODE,
   sizeof (GskOutsetShadowNode),
   "GskOutsetShadowNode",
   gsk_outset_shadow_node_finalize,
   gsk_outset_shadow_node_draw,
+  gsk_outset_shadow_node_diff,
   gsk_outset_shadow_node_serialize,
-  gsk_outset_shadow_node_deserialize
+  gsk_outset_shadow_node_deserialize,
+  gsk_outset_shadow_node_encode,
+  gsk_outset_shadow_node_decode,
+  gsk_outset_shadow_node_hash,
+  gsk_outset_shadow_node_equal
 };
 
 /**
@@ -1725,6 +2441,21 @@ gsk_cairo_node_draw (GskRenderNode *node,
   cairo_paint (cr);
 }
 
+static void
+gsk_cairo_node_diff (GskRenderNode  *node1,
+                     GskRenderNode  *node2,
+                     cairo_region_t *region)
+{
+  GskCairoNode *self1 = (GskCairoNode *) node1;
+  GskCairoNode *self2 = (GskCairoNode *) node2;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      self1->surface == self2->surface)
+    return;
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_CAIRO_NODE_VARIANT_TYPE "(dddduuau)"
 
 static GVariant *
@@ -1840,14 +2571,65 @@ gsk_cairo_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_cairo_node_encode (GskRenderNode   *node,
+                       GskBinaryWriter *writer)
+{
+  GskCairoNode *self = (GskCairoNode *) node;
+
+  gsk_binary_writer_put_rect (writer, &node->bounds);
+  gsk_binary_writer_put_surface (writer, self->surface, &node->bounds);
+}
+
+static GskRenderNode *
+gsk_cairo_node_decode (GskBinaryReader *reader)
+{
+  graphene_rect_t bounds;
+  cairo_surface_t *surface;
+
+  gsk_binary_reader_get_rect (reader, &bounds);
+  surface = gsk_binary_reader_get_surface (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  if (surface == NULL)
+    return gsk_cairo_node_new (&bounds);
+
+  return gsk_cairo_node_new_for_surface (&bounds, surface);
+}
+
+static guint
+gsk_cairo_node_hash (GskRenderNode *node)
+{
+  GskCairoNode *self = (GskCairoNode *) node;
+
+  /* Surfaces are compared by identity, looking at pixels is too expensive */
+  return g_direct_hash (self->surface);
+}
+
+static gboolean
+gsk_cairo_node_equal (GskRenderNode *node1,
+                      GskRenderNode *node2)
+{
+  GskCairoNode *self1 = (GskCairoNode *) node1;
+  GskCairoNode *self2 = (GskCairoNode *) node2;
+
+  return self1->surface == self2->surface;
+}
+
 static const GskRenderNodeClass GSK_CAIRO_NODE_CLASS = {
   GSK_CAIRO_NODE,
   sizeof (GskCairoNode),
   "GskCairoNode",
   gsk_cairo_node_finalize,
   gsk_cairo_node_draw,
+  gsk_cairo_node_diff,
   gsk_cairo_node_serialize,
-  gsk_cairo_node_deserialize
+  gsk_cairo_node_deserialize,
+  gsk_cairo_node_encode,
+  gsk_cairo_node_decode,
+  gsk_cairo_node_hash,
+  gsk_cairo_node_equal
 };
 
 const cairo_surface_t *
@@ -2006,6 +2788,41 @@ gsk_container_node_get_bounds (GskContainerNode *container,
     graphene_rect_union (bounds, &container->children[i]->bounds, bounds);
 }
 
+static void
+gsk_container_node_diff (GskRenderNode  *node1,
+                         GskRenderNode  *node2,
+                         cairo_region_t *region)
+{
+  GskContainerNode *self1 = (GskContainerNode *) node1;
+  GskContainerNode *self2 = (GskContainerNode *) node2;
+  guint start, end1, end2, i, j;
+
+  /* Children that were reused as-is are the common case, so skip the
+   * identical ones at both ends and only compare what's in between. */
+  start = 0;
+  while (start < self1->n_children && start < self2->n_children &&
+         self1->children[start] == self2->children[start])
+    start++;
+
+  end1 = self1->n_children;
+  end2 = self2->n_children;
+  while (end1 > start && end2 > start &&
+         self1->children[end1 - 1] == self2->children[end2 - 1])
+    {
+      end1--;
+      end2--;
+    }
+
+  for (i = start; i < end1 && i < end2; i++)
+    gsk_render_node_diff (self1->children[i], self2->children[i], region);
+
+  for (j = i; j < end1; j++)
+    gsk_render_node_union_bounds (region, &self1->children[j]->bounds);
+
+  for (j = i; j < end2; j++)
+    gsk_render_node_union_bounds (region, &self2->children[j]->bounds);
+}
+
 #define GSK_CONTAINER_NODE_VARIANT_TYPE "a(uv)"
 
 static GVariant *
@@ -2069,14 +2886,87 @@ gsk_container_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_container_node_encode (GskRenderNode   *node,
+                           GskBinaryWriter *writer)
+{
+  GskContainerNode *self = (GskContainerNode *) node;
+  guint i;
+
+  gsk_binary_writer_put_uint32 (writer, self->n_children);
+  for (i = 0; i < self->n_children; i++)
+    gsk_binary_writer_put_node (writer, self->children[i]);
+}
+
+static GskRenderNode *
+gsk_container_node_decode (GskBinaryReader *reader)
+{
+  GskRenderNode *result;
+  GskRenderNode **children;
+  guint i, n_children;
+
+  n_children = gsk_binary_reader_get_count (reader, sizeof (guint32));
+  children = g_new (GskRenderNode *, n_children);
+  for (i = 0; i < n_children; i++)
+    children[i] = gsk_binary_reader_get_node (reader);
+
+  if (gsk_binary_reader_has_error (reader))
+    result = NULL;
+  else
+    result = gsk_container_node_new (children, n_children);
+
+  g_free (children);
+
+  return result;
+}
+
+static guint
+gsk_container_node_hash (GskRenderNode *node)
+{
+  GskContainerNode *self = (GskContainerNode *) node;
+  guint hash;
+  guint i;
+
+  hash = self->n_children;
+  for (i = 0; i < self->n_children; i++)
+    hash = HASH_COMBINE (hash, gsk_render_node_hash (self->children[i]));
+
+  return hash;
+}
+
+static gboolean
+gsk_container_node_equal (GskRenderNode *node1,
+                          GskRenderNode *node2)
+{
+  GskContainerNode *self1 = (GskContainerNode *) node1;
+  GskContainerNode *self2 = (GskContainerNode *) node2;
+  guint i;
+
+  if (self1->n_children != self2->n_children)
+    return FALSE;
+
+  for (i = 0; i < self1->n_children; i++)
+    {
+      if (!gsk_render_node_equal (self1->children[i], self2->children[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static const GskRenderNodeClass GSK_CONTAINER_NODE_CLASS = {
   GSK_CONTAINER_NODE,
   sizeof (GskContainerNode),
   "GskContainerNode",
   gsk_container_node_finalize,
   gsk_container_node_draw,
+  gsk_container_node_diff,
   gsk_container_node_serialize,
-  gsk_container_node_deserialize
+  gsk_container_node_deserialize,
+  gsk_container_node_encode,
+  gsk_container_node_decode,
+  gsk_container_node_hash,
+  gsk_container_node_equal
 };
 
 /**
@@ -2192,6 +3082,27 @@ gsk_transform_node_draw (GskRenderNode *node,
     }
 }
 
+static void
+gsk_transform_node_diff (GskRenderNode  *node1,
+                         GskRenderNode  *node2,
+                         cairo_region_t *region)
+{
+  GskTransformNode *self1 = (GskTransformNode *) node1;
+  GskTransformNode *self2 = (GskTransformNode *) node2;
+  cairo_region_t *sub;
+
+  if (!graphene_matrix_equal_fast (&self1->transform, &self2->transform))
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (self1->child, self2->child, sub);
+  region_union_transformed (region, sub, &self1->transform);
+  cairo_region_destroy (sub);
+}
+
 #define GSK_TRANSFORM_NODE_VARIANT_TYPE "(dddddddddddddddduv)"
 
 static GVariant *
@@ -2252,14 +3163,62 @@ gsk_transform_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_transform_node_encode (GskRenderNode   *node,
+                           GskBinaryWriter *writer)
+{
+  GskTransformNode *self = (GskTransformNode *) node;
+
+  gsk_binary_writer_put_matrix (writer, &self->transform);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_transform_node_decode (GskBinaryReader *reader)
+{
+  graphene_matrix_t transform;
+  GskRenderNode *child;
+
+  gsk_binary_reader_get_matrix (reader, &transform);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_transform_node_new (child, &transform);
+}
+
+static guint
+gsk_transform_node_hash (GskRenderNode *node)
+{
+  GskTransformNode *self = (GskTransformNode *) node;
+
+  return hash_matrix (gsk_render_node_hash (self->child), &self->transform);
+}
+
+static gboolean
+gsk_transform_node_equal (GskRenderNode *node1,
+                          GskRenderNode *node2)
+{
+  GskTransformNode *self1 = (GskTransformNode *) node1;
+  GskTransformNode *self2 = (GskTransformNode *) node2;
+
+  return graphene_matrix_equal_fast (&self1->transform, &self2->transform) &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_TRANSFORM_NODE_CLASS = {
   GSK_TRANSFORM_NODE,
   sizeof (GskTransformNode),
   "GskTransformNode",
   gsk_transform_node_finalize,
   gsk_transform_node_draw,
+  gsk_transform_node_diff,
   gsk_transform_node_serialize,
-  gsk_transform_node_deserialize
+  gsk_transform_node_deserialize,
+  gsk_transform_node_encode,
+  gsk_transform_node_decode,
+  gsk_transform_node_hash,
+  gsk_transform_node_equal
 };
 
 /**
@@ -2351,6 +3310,41 @@ gsk_offset_node_draw (GskRenderNode *node,
   gsk_render_node_draw (self->child, cr);
 }
 
+static void
+gsk_offset_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  GskOffsetNode *self1 = (GskOffsetNode *) node1;
+  GskOffsetNode *self2 = (GskOffsetNode *) node2;
+  cairo_region_t *sub;
+  cairo_rectangle_int_t rect;
+  graphene_rect_t bounds;
+  int i, n;
+
+  if (self1->x_offset != self2->x_offset ||
+      self1->y_offset != self2->y_offset)
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (self1->child, self2->child, sub);
+
+  n = cairo_region_num_rectangles (sub);
+  for (i = 0; i < n; i++)
+    {
+      cairo_region_get_rectangle (sub, i, &rect);
+      graphene_rect_offset_r (&GRAPHENE_RECT_INIT (rect.x, rect.y, rect.width, rect.height),
+                              self1->x_offset, self1->y_offset,
+                              &bounds);
+      gsk_render_node_union_bounds (region, &bounds);
+    }
+
+  cairo_region_destroy (sub);
+}
+
 #define GSK_OFFSET_NODE_VARIANT_TYPE "(dduv)"
 
 static GVariant *
@@ -2394,14 +3388,70 @@ gsk_offset_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_offset_node_encode (GskRenderNode   *node,
+                        GskBinaryWriter *writer)
+{
+  GskOffsetNode *self = (GskOffsetNode *) node;
+
+  gsk_binary_writer_put_double (writer, self->x_offset);
+  gsk_binary_writer_put_double (writer, self->y_offset);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_offset_node_decode (GskBinaryReader *reader)
+{
+  double x_offset, y_offset;
+  GskRenderNode *child;
+
+  x_offset = gsk_binary_reader_get_double (reader);
+  y_offset = gsk_binary_reader_get_double (reader);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_offset_node_new (child, x_offset, y_offset);
+}
+
+static guint
+gsk_offset_node_hash (GskRenderNode *node)
+{
+  GskOffsetNode *self = (GskOffsetNode *) node;
+  guint hash;
+
+  hash = gsk_render_node_hash (self->child);
+  hash = hash_double (hash, self->x_offset);
+  hash = hash_double (hash, self->y_offset);
+
+  return hash;
+}
+
+static gboolean
+gsk_offset_node_equal (GskRenderNode *node1,
+                       GskRenderNode *node2)
+{
+  GskOffsetNode *self1 = (GskOffsetNode *) node1;
+  GskOffsetNode *self2 = (GskOffsetNode *) node2;
+
+  return self1->x_offset == self2->x_offset &&
+         self1->y_offset == self2->y_offset &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_OFFSET_NODE_CLASS = {
   GSK_OFFSET_NODE,
   sizeof (GskOffsetNode),
   "GskOffsetNode",
   gsk_offset_node_finalize,
   gsk_offset_node_draw,
+  gsk_offset_node_diff,
   gsk_offset_node_serialize,
-  gsk_offset_node_deserialize
+  gsk_offset_node_deserialize,
+  gsk_offset_node_encode,
+  gsk_offset_node_decode,
+  gsk_offset_node_hash,
+  gsk_offset_node_equal
 };
 
 /**
@@ -2521,6 +3571,20 @@ gsk_opacity_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
+static void
+gsk_opacity_node_diff (GskRenderNode  *node1,
+                       GskRenderNode  *node2,
+                       cairo_region_t *region)
+{
+  GskOpacityNode *self1 = (GskOpacityNode *) node1;
+  GskOpacityNode *self2 = (GskOpacityNode *) node2;
+
+  if (self1->opacity == self2->opacity)
+    gsk_render_node_diff (self1->child, self2->child, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_OPACITY_NODE_VARIANT_TYPE "(duv)"
 
 static GVariant *
@@ -2563,14 +3627,62 @@ gsk_opacity_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_opacity_node_encode (GskRenderNode   *node,
+                         GskBinaryWriter *writer)
+{
+  GskOpacityNode *self = (GskOpacityNode *) node;
+
+  gsk_binary_writer_put_double (writer, self->opacity);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_opacity_node_decode (GskBinaryReader *reader)
+{
+  GskRenderNode *child;
+  double opacity;
+
+  opacity = gsk_binary_reader_get_double (reader);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_opacity_node_new (child, opacity);
+}
+
+static guint
+gsk_opacity_node_hash (GskRenderNode *node)
+{
+  GskOpacityNode *self = (GskOpacityNode *) node;
+
+  return hash_double (gsk_render_node_hash (self->child), self->opacity);
+}
+
+static gboolean
+gsk_opacity_node_equal (GskRenderNode *node1,
+                        GskRenderNode *node2)
+{
+  GskOpacityNode *self1 = (GskOpacityNode *) node1;
+  GskOpacityNode *self2 = (GskOpacityNode *) node2;
+
+  return self1->opacity == self2->opacity &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_OPACITY_NODE_CLASS = {
   GSK_OPACITY_NODE,
   sizeof (GskOpacityNode),
   "GskOpacityNode",
   gsk_opacity_node_finalize,
   gsk_opacity_node_draw,
+  gsk_opacity_node_diff,
   gsk_opacity_node_serialize,
-  gsk_opacity_node_deserialize
+  gsk_opacity_node_deserialize,
+  gsk_opacity_node_encode,
+  gsk_opacity_node_decode,
+  gsk_opacity_node_hash,
+  gsk_opacity_node_equal
 };
 
 /**
@@ -2733,10 +3845,25 @@ gsk_color_matrix_node_draw (GskRenderNode *node,
   cairo_pattern_destroy (pattern);
 }
 
-#define GSK_COLOR_MATRIX_NODE_VARIANT_TYPE "(dddddddddddddddddddduv)"
-
-static GVariant *
-gsk_color_matrix_node_serialize (GskRenderNode *node)
+static void
+gsk_color_matrix_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
+{
+  GskColorMatrixNode *self1 = (GskColorMatrixNode *) node1;
+  GskColorMatrixNode *self2 = (GskColorMatrixNode *) node2;
+
+  if (graphene_matrix_equal_fast (&self1->color_matrix, &self2->color_matrix) &&
+      graphene_vec4_equal (&self1->color_offset, &self2->color_offset))
+    gsk_render_node_diff (self1->child, self2->child, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
+}
+
+#define GSK_COLOR_MATRIX_NODE_VARIANT_TYPE "(dddddddddddddddddddduv)"
+
+static GVariant *
+gsk_color_matrix_node_serialize (GskRenderNode *node)
 {
   GskColorMatrixNode *self = (GskColorMatrixNode *) node;
   float mat[16], vec[4];
@@ -2798,14 +3925,81 @@ gsk_color_matrix_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_color_matrix_node_encode (GskRenderNode   *node,
+                              GskBinaryWriter *writer)
+{
+  GskColorMatrixNode *self = (GskColorMatrixNode *) node;
+  float vec[4];
+  guint i;
+
+  graphene_vec4_to_float (&self->color_offset, vec);
+
+  gsk_binary_writer_put_matrix (writer, &self->color_matrix);
+  for (i = 0; i < 4; i++)
+    gsk_binary_writer_put_float (writer, vec[i]);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_color_matrix_node_decode (GskBinaryReader *reader)
+{
+  graphene_matrix_t matrix;
+  graphene_vec4_t offset;
+  GskRenderNode *child;
+  float vec[4];
+  guint i;
+
+  gsk_binary_reader_get_matrix (reader, &matrix);
+  for (i = 0; i < 4; i++)
+    vec[i] = gsk_binary_reader_get_float (reader);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  graphene_vec4_init_from_float (&offset, vec);
+
+  return gsk_color_matrix_node_new (child, &matrix, &offset);
+}
+
+static guint
+gsk_color_matrix_node_hash (GskRenderNode *node)
+{
+  GskColorMatrixNode *self = (GskColorMatrixNode *) node;
+  guint hash;
+
+  hash = gsk_render_node_hash (self->child);
+  hash = hash_matrix (hash, &self->color_matrix);
+  hash = hash_vec4 (hash, &self->color_offset);
+
+  return hash;
+}
+
+static gboolean
+gsk_color_matrix_node_equal (GskRenderNode *node1,
+                             GskRenderNode *node2)
+{
+  GskColorMatrixNode *self1 = (GskColorMatrixNode *) node1;
+  GskColorMatrixNode *self2 = (GskColorMatrixNode *) node2;
+
+  return graphene_matrix_equal_fast (&self1->color_matrix, &self2->color_matrix) &&
+         graphene_vec4_equal (&self1->color_offset, &self2->color_offset) &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_COLOR_MATRIX_NODE_CLASS = {
   GSK_COLOR_MATRIX_NODE,
   sizeof (GskColorMatrixNode),
   "GskColorMatrixNode",
   gsk_color_matrix_node_finalize,
   gsk_color_matrix_node_draw,
+  gsk_color_matrix_node_diff,
   gsk_color_matrix_node_serialize,
-  gsk_color_matrix_node_deserialize
+  gsk_color_matrix_node_deserialize,
+  gsk_color_matrix_node_encode,
+  gsk_color_matrix_node_decode,
+  gsk_color_matrix_node_hash,
+  gsk_color_matrix_node_equal
 };
 
 /**
@@ -2938,6 +4132,32 @@ gsk_repeat_node_draw (GskRenderNode *node,
   cairo_surface_destroy (surface);
 }
 
+static void
+gsk_repeat_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  GskRepeatNode *self1 = (GskRepeatNode *) node1;
+  GskRepeatNode *self2 = (GskRepeatNode *) node2;
+  cairo_region_t *sub;
+
+  if (graphene_rect_equal (&node1->bounds, &node2->bounds) &&
+      graphene_rect_equal (&self1->child_bounds, &self2->child_bounds))
+    {
+      /* Any change in the child shows up in every repetition */
+      sub = cairo_region_create ();
+      gsk_render_node_diff (self1->child, self2->child, sub);
+      if (cairo_region_is_empty (sub))
+        {
+          cairo_region_destroy (sub);
+          return;
+        }
+      cairo_region_destroy (sub);
+    }
+
+  gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_REPEAT_NODE_VARIANT_TYPE "(dddddddduv)"
 
 static GVariant *
@@ -2986,14 +4206,64 @@ gsk_repeat_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_repeat_node_encode (GskRenderNode   *node,
+                        GskBinaryWriter *writer)
+{
+  GskRepeatNode *self = (GskRepeatNode *) node;
+
+  gsk_binary_writer_put_rect (writer, &node->bounds);
+  gsk_binary_writer_put_rect (writer, &self->child_bounds);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_repeat_node_decode (GskBinaryReader *reader)
+{
+  graphene_rect_t bounds, child_bounds;
+  GskRenderNode *child;
+
+  gsk_binary_reader_get_rect (reader, &bounds);
+  gsk_binary_reader_get_rect (reader, &child_bounds);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_repeat_node_new (&bounds, child, &child_bounds);
+}
+
+static guint
+gsk_repeat_node_hash (GskRenderNode *node)
+{
+  GskRepeatNode *self = (GskRepeatNode *) node;
+
+  return hash_rect (gsk_render_node_hash (self->child), &self->child_bounds);
+}
+
+static gboolean
+gsk_repeat_node_equal (GskRenderNode *node1,
+                       GskRenderNode *node2)
+{
+  GskRepeatNode *self1 = (GskRepeatNode *) node1;
+  GskRepeatNode *self2 = (GskRepeatNode *) node2;
+
+  return graphene_rect_equal (&self1->child_bounds, &self2->child_bounds) &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_REPEAT_NODE_CLASS = {
   GSK_REPEAT_NODE,
   sizeof (GskRepeatNode),
   "GskRepeatNode",
   gsk_repeat_node_finalize,
   gsk_repeat_node_draw,
+  gsk_repeat_node_diff,
   gsk_repeat_node_serialize,
-  gsk_repeat_node_deserialize
+  gsk_repeat_node_deserialize,
+  gsk_repeat_node_encode,
+  gsk_repeat_node_decode,
+  gsk_repeat_node_hash,
+  gsk_repeat_node_equal
 };
 
 /**
@@ -3088,6 +4358,20 @@ gsk_clip_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
+static void
+gsk_clip_node_diff (GskRenderNode  *node1,
+                    GskRenderNode  *node2,
+                    cairo_region_t *region)
+{
+  GskClipNode *self1 = (GskClipNode *) node1;
+  GskClipNode *self2 = (GskClipNode *) node2;
+
+  if (graphene_rect_equal (&self1->clip, &self2->clip))
+    gsk_render_node_diff_clipped (self1->child, self2->child, &self1->clip, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_CLIP_NODE_VARIANT_TYPE "(dddduv)"
 
 static GVariant *
@@ -3131,14 +4415,62 @@ gsk_clip_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_clip_node_encode (GskRenderNode   *node,
+                      GskBinaryWriter *writer)
+{
+  GskClipNode *self = (GskClipNode *) node;
+
+  gsk_binary_writer_put_rect (writer, &self->clip);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_clip_node_decode (GskBinaryReader *reader)
+{
+  graphene_rect_t clip;
+  GskRenderNode *child;
+
+  gsk_binary_reader_get_rect (reader, &clip);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_clip_node_new (child, &clip);
+}
+
+static guint
+gsk_clip_node_hash (GskRenderNode *node)
+{
+  GskClipNode *self = (GskClipNode *) node;
+
+  return hash_rect (gsk_render_node_hash (self->child), &self->clip);
+}
+
+static gboolean
+gsk_clip_node_equal (GskRenderNode *node1,
+                     GskRenderNode *node2)
+{
+  GskClipNode *self1 = (GskClipNode *) node1;
+  GskClipNode *self2 = (GskClipNode *) node2;
+
+  return graphene_rect_equal (&self1->clip, &self2->clip) &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_CLIP_NODE_CLASS = {
   GSK_CLIP_NODE,
   sizeof (GskClipNode),
   "GskClipNode",
   gsk_clip_node_finalize,
   gsk_clip_node_draw,
+  gsk_clip_node_diff,
   gsk_clip_node_serialize,
-  gsk_clip_node_deserialize
+  gsk_clip_node_deserialize,
+  gsk_clip_node_encode,
+  gsk_clip_node_decode,
+  gsk_clip_node_hash,
+  gsk_clip_node_equal
 };
 
 /**
@@ -3234,6 +4566,20 @@ gsk_rounded_clip_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
+static void
+gsk_rounded_clip_node_diff (GskRenderNode  *node1,
+                            GskRenderNode  *node2,
+                            cairo_region_t *region)
+{
+  GskRoundedClipNode *self1 = (GskRoundedClipNode *) node1;
+  GskRoundedClipNode *self2 = (GskRoundedClipNode *) node2;
+
+  if (gsk_rounded_rect_equal (&self1->clip, &self2->clip))
+    gsk_render_node_diff_clipped (self1->child, self2->child, &self1->clip.bounds, region);
+  else
+    gsk_render_node_diff_impossible (node1, node2, region);
+}
+
 #define GSK_ROUNDED_CLIP_NODE_VARIANT_TYPE "(dddddddddddduv)"
 
 static GVariant *
@@ -3292,14 +4638,62 @@ gsk_rounded_clip_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_rounded_clip_node_encode (GskRenderNode   *node,
+                              GskBinaryWriter *writer)
+{
+  GskRoundedClipNode *self = (GskRoundedClipNode *) node;
+
+  gsk_binary_writer_put_rounded_rect (writer, &self->clip);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_rounded_clip_node_decode (GskBinaryReader *reader)
+{
+  GskRoundedRect clip;
+  GskRenderNode *child;
+
+  gsk_binary_reader_get_rounded_rect (reader, &clip);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_rounded_clip_node_new (child, &clip);
+}
+
+static guint
+gsk_rounded_clip_node_hash (GskRenderNode *node)
+{
+  GskRoundedClipNode *self = (GskRoundedClipNode *) node;
+
+  return hash_rounded_rect (gsk_render_node_hash (self->child), &self->clip);
+}
+
+static gboolean
+gsk_rounded_clip_node_equal (GskRenderNode *node1,
+                             GskRenderNode *node2)
+{
+  GskRoundedClipNode *self1 = (GskRoundedClipNode *) node1;
+  GskRoundedClipNode *self2 = (GskRoundedClipNode *) node2;
+
+  return gsk_rounded_rect_equal (&self1->clip, &self2->clip) &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_ROUNDED_CLIP_NODE_CLASS = {
   GSK_ROUNDED_CLIP_NODE,
   sizeof (GskRoundedClipNode),
   "GskRoundedClipNode",
   gsk_rounded_clip_node_finalize,
   gsk_rounded_clip_node_draw,
+  gsk_rounded_clip_node_diff,
   gsk_rounded_clip_node_serialize,
-  gsk_rounded_clip_node_deserialize
+  gsk_rounded_clip_node_deserialize,
+  gsk_rounded_clip_node_encode,
+  gsk_rounded_clip_node_decode,
+  gsk_rounded_clip_node_hash,
+  gsk_rounded_clip_node_equal
 };
 
 /**
@@ -3442,6 +4836,61 @@ gsk_shadow_node_get_bounds (GskShadowNode *self,
   bounds->size.height += top + bottom;
 }
 
+static void
+gsk_shadow_node_diff (GskRenderNode  *node1,
+                      GskRenderNode  *node2,
+                      cairo_region_t *region)
+{
+  GskShadowNode *self1 = (GskShadowNode *) node1;
+  GskShadowNode *self2 = (GskShadowNode *) node2;
+  cairo_region_t *sub;
+  cairo_rectangle_int_t rect;
+  gsize i;
+  int j, n;
+
+  if (self1->n_shadows != self2->n_shadows)
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  for (i = 0; i < self1->n_shadows; i++)
+    {
+      if (!gdk_rgba_equal (&self1->shadows[i].color, &self2->shadows[i].color) ||
+          self1->shadows[i].dx != self2->shadows[i].dx ||
+          self1->shadows[i].dy != self2->shadows[i].dy ||
+          self1->shadows[i].radius != self2->shadows[i].radius)
+        {
+          gsk_render_node_diff_impossible (node1, node2, region);
+          return;
+        }
+    }
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (self1->child, self2->child, sub);
+
+  /* Every change in the child also changes the shadows cast by it */
+  n = cairo_region_num_rectangles (sub);
+  for (j = 0; j < n; j++)
+    {
+      cairo_region_get_rectangle (sub, j, &rect);
+      cairo_region_union_rectangle (region, &rect);
+
+      for (i = 0; i < self1->n_shadows; i++)
+        {
+          float clip_radius = gsk_cairo_blur_compute_pixels (self1->shadows[i].radius);
+          graphene_rect_t bounds = GRAPHENE_RECT_INIT (rect.x + self1->shadows[i].dx - clip_radius,
+                                                       rect.y + self1->shadows[i].dy - clip_radius,
+                                                       rect.width + 2 * clip_radius,
+                                                       rect.height + 2 * clip_radius);
+
+          gsk_render_node_union_bounds (region, &bounds);
+        }
+    }
+
+  cairo_region_destroy (sub);
+}
+
 #define GSK_SHADOW_NODE_VARIANT_TYPE "(uva(ddddddd))"
 
 static GVariant *
@@ -3515,14 +4964,116 @@ gsk_shadow_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_shadow_node_encode (GskRenderNode   *node,
+                        GskBinaryWriter *writer)
+{
+  GskShadowNode *self = (GskShadowNode *) node;
+  gsize i;
+
+  gsk_binary_writer_put_uint32 (writer, self->n_shadows);
+  for (i = 0; i < self->n_shadows; i++)
+    {
+      gsk_binary_writer_put_rgba (writer, &self->shadows[i].color);
+      gsk_binary_writer_put_float (writer, self->shadows[i].dx);
+      gsk_binary_writer_put_float (writer, self->shadows[i].dy);
+      gsk_binary_writer_put_float (writer, self->shadows[i].radius);
+    }
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_shadow_node_decode (GskBinaryReader *reader)
+{
+  GskRenderNode *result, *child;
+  GskShadow *shadows;
+  gsize i, n_shadows;
+
+  n_shadows = gsk_binary_reader_get_count (reader, 4 * sizeof (double) + 3 * sizeof (float));
+  if (n_shadows == 0)
+    {
+      gsk_binary_reader_set_error (reader, "Shadow nodes need at least 1 shadow");
+      return NULL;
+    }
+
+  shadows = g_new (GskShadow, n_shadows);
+  for (i = 0; i < n_shadows; i++)
+    {
+      gsk_binary_reader_get_rgba (reader, &shadows[i].color);
+      shadows[i].dx = gsk_binary_reader_get_float (reader);
+      shadows[i].dy = gsk_binary_reader_get_float (reader);
+      shadows[i].radius = gsk_binary_reader_get_float (reader);
+    }
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    result = NULL;
+  else
+    result = gsk_shadow_node_new (child, shadows, n_shadows);
+
+  g_free (shadows);
+
+  return result;
+}
+
+static guint
+gsk_shadow_node_hash (GskRenderNode *node)
+{
+  GskShadowNode *self = (GskShadowNode *) node;
+  guint hash;
+  gsize i;
+
+  hash = gsk_render_node_hash (self->child);
+  hash = HASH_COMBINE (hash, self->n_shadows);
+  for (i = 0; i < self->n_shadows; i++)
+    {
+      hash = hash_rgba (hash, &self->shadows[i].color);
+      hash = hash_float (hash, self->shadows[i].dx);
+      hash = hash_float (hash, self->shadows[i].dy);
+      hash = hash_float (hash, self->shadows[i].radius);
+    }
+
+  return hash;
+}
+
+static gboolean
+gsk_shadow_node_equal (GskRenderNode *node1,
+                       GskRenderNode *node2)
+{
+  GskShadowNode *self1 = (GskShadowNode *) node1;
+  GskShadowNode *self2 = (GskShadowNode *) node2;
+  gsize i;
+
+  if (self1->n_shadows != self2->n_shadows)
+    return FALSE;
+
+  for (i = 0; i < self1->n_shadows; i++)
+    {
+      GskShadow *shadow1 = &self1->shadows[i];
+      GskShadow *shadow2 = &self2->shadows[i];
+
+      if (!gdk_rgba_equal (&shadow1->color, &shadow2->color) ||
+          shadow1->dx != shadow2->dx ||
+          shadow1->dy != shadow2->dy ||
+          shadow1->radius != shadow2->radius)
+        return FALSE;
+    }
+
+  return gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_SHADOW_NODE_CLASS = {
   GSK_SHADOW_NODE,
   sizeof (GskShadowNode),
   "GskShadowNode",
   gsk_shadow_node_finalize,
   gsk_shadow_node_draw,
+  gsk_shadow_node_diff,
   gsk_shadow_node_serialize,
-  gsk_shadow_node_deserialize
+  gsk_shadow_node_deserialize,
+  gsk_shadow_node_encode,
+  gsk_shadow_node_decode,
+  gsk_shadow_node_hash,
+  gsk_shadow_node_equal
 };
 
 /**
@@ -3674,6 +5225,27 @@ gsk_blend_node_draw (GskRenderNode *node,
   cairo_paint (cr);
 }
 
+static void
+gsk_blend_node_diff (GskRenderNode  *node1,
+                     GskRenderNode  *node2,
+                     cairo_region_t *region)
+{
+  GskBlendNode *self1 = (GskBlendNode *) node1;
+  GskBlendNode *self2 = (GskBlendNode *) node2;
+
+  /* Blending is done per pixel, so only changed pixels of either
+   * child can change the result */
+  if (self1->blend_mode == self2->blend_mode)
+    {
+      gsk_render_node_diff (self1->bottom, self2->bottom, region);
+      gsk_render_node_diff (self1->top, self2->top, region);
+    }
+  else
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+    }
+}
+
 #define GSK_BLEND_NODE_VARIANT_TYPE "(uvuvu)"
 
 static GVariant *
@@ -3729,14 +5301,76 @@ gsk_blend_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_blend_node_encode (GskRenderNode   *node,
+                       GskBinaryWriter *writer)
+{
+  GskBlendNode *self = (GskBlendNode *) node;
+
+  gsk_binary_writer_put_uint32 (writer, self->blend_mode);
+  gsk_binary_writer_put_node (writer, self->bottom);
+  gsk_binary_writer_put_node (writer, self->top);
+}
+
+static GskRenderNode *
+gsk_blend_node_decode (GskBinaryReader *reader)
+{
+  GskRenderNode *bottom, *top;
+  guint32 blend_mode;
+
+  blend_mode = gsk_binary_reader_get_uint32 (reader);
+  bottom = gsk_binary_reader_get_node (reader);
+  top = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  if (blend_mode > GSK_BLEND_MODE_LUMINOSITY)
+    {
+      gsk_binary_reader_set_error (reader, "Invalid blend mode %u", blend_mode);
+      return NULL;
+    }
+
+  return gsk_blend_node_new (bottom, top, blend_mode);
+}
+
+static guint
+gsk_blend_node_hash (GskRenderNode *node)
+{
+  GskBlendNode *self = (GskBlendNode *) node;
+  guint hash;
+
+  hash = gsk_render_node_hash (self->bottom);
+  hash = HASH_COMBINE (hash, gsk_render_node_hash (self->top));
+  hash = HASH_COMBINE (hash, self->blend_mode);
+
+  return hash;
+}
+
+static gboolean
+gsk_blend_node_equal (GskRenderNode *node1,
+                      GskRenderNode *node2)
+{
+  GskBlendNode *self1 = (GskBlendNode *) node1;
+  GskBlendNode *self2 = (GskBlendNode *) node2;
+
+  return self1->blend_mode == self2->blend_mode &&
+         gsk_render_node_equal (self1->bottom, self2->bottom) &&
+         gsk_render_node_equal (self1->top, self2->top);
+}
+
 static const GskRenderNodeClass GSK_BLEND_NODE_CLASS = {
   GSK_BLEND_NODE,
   sizeof (GskBlendNode),
   "GskBlendNode",
   gsk_blend_node_finalize,
   gsk_blend_node_draw,
+  gsk_blend_node_diff,
   gsk_blend_node_serialize,
-  gsk_blend_node_deserialize
+  gsk_blend_node_deserialize,
+  gsk_blend_node_encode,
+  gsk_blend_node_decode,
+  gsk_blend_node_hash,
+  gsk_blend_node_equal
 };
 
 /**
@@ -3843,6 +5477,25 @@ gsk_cross_fade_node_draw (GskRenderNode *node,
   cairo_paint (cr);
 }
 
+static void
+gsk_cross_fade_node_diff (GskRenderNode  *node1,
+                          GskRenderNode  *node2,
+                          cairo_region_t *region)
+{
+  GskCrossFadeNode *self1 = (GskCrossFadeNode *) node1;
+  GskCrossFadeNode *self2 = (GskCrossFadeNode *) node2;
+
+  if (self1->progress == self2->progress)
+    {
+      gsk_render_node_diff (self1->start, self2->start, region);
+      gsk_render_node_diff (self1->end, self2->end, region);
+    }
+  else
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+    }
+}
+
 #define GSK_CROSS_FADE_NODE_VARIANT_TYPE "(uvuvd)"
 
 static GVariant *
@@ -3899,14 +5552,70 @@ gsk_cross_fade_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_cross_fade_node_encode (GskRenderNode   *node,
+                            GskBinaryWriter *writer)
+{
+  GskCrossFadeNode *self = (GskCrossFadeNode *) node;
+
+  gsk_binary_writer_put_double (writer, self->progress);
+  gsk_binary_writer_put_node (writer, self->start);
+  gsk_binary_writer_put_node (writer, self->end);
+}
+
+static GskRenderNode *
+gsk_cross_fade_node_decode (GskBinaryReader *reader)
+{
+  GskRenderNode *start, *end;
+  double progress;
+
+  progress = gsk_binary_reader_get_double (reader);
+  start = gsk_binary_reader_get_node (reader);
+  end = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_cross_fade_node_new (start, end, progress);
+}
+
+static guint
+gsk_cross_fade_node_hash (GskRenderNode *node)
+{
+  GskCrossFadeNode *self = (GskCrossFadeNode *) node;
+  guint hash;
+
+  hash = gsk_render_node_hash (self->start);
+  hash = HASH_COMBINE (hash, gsk_render_node_hash (self->end));
+  hash = hash_double (hash, self->progress);
+
+  return hash;
+}
+
+static gboolean
+gsk_cross_fade_node_equal (GskRenderNode *node1,
+                           GskRenderNode *node2)
+{
+  GskCrossFadeNode *self1 = (GskCrossFadeNode *) node1;
+  GskCrossFadeNode *self2 = (GskCrossFadeNode *) node2;
+
+  return self1->progress == self2->progress &&
+         gsk_render_node_equal (self1->start, self2->start) &&
+         gsk_render_node_equal (self1->end, self2->end);
+}
+
 static const GskRenderNodeClass GSK_CROSS_FADE_NODE_CLASS = {
   GSK_CROSS_FADE_NODE,
   sizeof (GskCrossFadeNode),
   "GskCrossFadeNode",
   gsk_cross_fade_node_finalize,
   gsk_cross_fade_node_draw,
+  gsk_cross_fade_node_diff,
   gsk_cross_fade_node_serialize,
-  gsk_cross_fade_node_deserialize
+  gsk_cross_fade_node_deserialize,
+  gsk_cross_fade_node_encode,
+  gsk_cross_fade_node_decode,
+  gsk_cross_fade_node_hash,
+  gsk_cross_fade_node_equal
 };
 
 /**
@@ -4023,6 +5732,43 @@ gsk_text_node_draw (GskRenderNode *node,
   cairo_restore (cr);
 }
 
+static void
+gsk_text_node_diff (GskRenderNode  *node1,
+                    GskRenderNode  *node2,
+                    cairo_region_t *region)
+{
+  GskTextNode *self1 = (GskTextNode *) node1;
+  GskTextNode *self2 = (GskTextNode *) node2;
+  guint i;
+
+  if (!graphene_rect_equal (&node1->bounds, &node2->bounds) ||
+      self1->font != self2->font ||
+      !gdk_rgba_equal (&self1->color, &self2->color) ||
+      self1->x != self2->x ||
+      self1->y != self2->y ||
+      self1->num_glyphs != self2->num_glyphs)
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  for (i = 0; i < self1->num_glyphs; i++)
+    {
+      PangoGlyphInfo *info1 = &self1->glyphs[i];
+      PangoGlyphInfo *info2 = &self2->glyphs[i];
+
+      if (info1->glyph != info2->glyph ||
+          info1->geometry.width != info2->geometry.width ||
+          info1->geometry.x_offset != info2->geometry.x_offset ||
+          info1->geometry.y_offset != info2->geometry.y_offset ||
+          info1->attr.is_cluster_start != info2->attr.is_cluster_start)
+        {
+          gsk_render_node_diff_impossible (node1, node2, region);
+          return;
+        }
+    }
+}
+
 #define GSK_TEXT_NODE_VARIANT_TYPE "(sdddddda(uiiii))"
 
 static GVariant *
@@ -4120,14 +5866,116 @@ gsk_text_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_text_node_encode (GskRenderNode   *node,
+                      GskBinaryWriter *writer)
+{
+  GskTextNode *self = (GskTextNode *) node;
+
+  gsk_binary_writer_put_rect (writer, &node->bounds);
+  gsk_binary_writer_put_rgba (writer, &self->color);
+  gsk_binary_writer_put_double (writer, self->x);
+  gsk_binary_writer_put_double (writer, self->y);
+  gsk_binary_writer_put_font (writer, self->font);
+  gsk_binary_writer_put_glyphs (writer, self->glyphs, self->num_glyphs);
+}
+
+static GskRenderNode *
+gsk_text_node_decode (GskBinaryReader *reader)
+{
+  graphene_rect_t bounds;
+  PangoGlyphString *glyphs;
+  GskRenderNode *result;
+  PangoFont *font;
+  GdkRGBA color;
+  double x, y;
+
+  gsk_binary_reader_get_rect (reader, &bounds);
+  gsk_binary_reader_get_rgba (reader, &color);
+  x = gsk_binary_reader_get_double (reader);
+  y = gsk_binary_reader_get_double (reader);
+  font = gsk_binary_reader_get_font (reader);
+  glyphs = gsk_binary_reader_get_glyphs (reader);
+  if (gsk_binary_reader_has_error (reader))
+    {
+      if (glyphs)
+        pango_glyph_string_free (glyphs);
+      return NULL;
+    }
+
+  /* The bounds are stored, so there is no need to measure the glyphs again */
+  result = gsk_text_node_new_with_bounds (font, glyphs, &color, x, y, &bounds);
+
+  pango_glyph_string_free (glyphs);
+
+  return result;
+}
+
+static guint
+gsk_text_node_hash (GskRenderNode *node)
+{
+  GskTextNode *self = (GskTextNode *) node;
+  guint hash;
+  guint i;
+
+  hash = g_direct_hash (self->font);
+  hash = hash_rgba (hash, &self->color);
+  hash = hash_double (hash, self->x);
+  hash = hash_double (hash, self->y);
+  hash = HASH_COMBINE (hash, self->num_glyphs);
+  for (i = 0; i < self->num_glyphs; i++)
+    {
+      hash = HASH_COMBINE (hash, self->glyphs[i].glyph);
+      hash = HASH_COMBINE (hash, self->glyphs[i].geometry.width);
+    }
+
+  return hash;
+}
+
+static gboolean
+gsk_text_node_equal (GskRenderNode *node1,
+                     GskRenderNode *node2)
+{
+  GskTextNode *self1 = (GskTextNode *) node1;
+  GskTextNode *self2 = (GskTextNode *) node2;
+  guint i;
+
+  if (self1->font != self2->font ||
+      !gdk_rgba_equal (&self1->color, &self2->color) ||
+      self1->x != self2->x ||
+      self1->y != self2->y ||
+      self1->num_glyphs != self2->num_glyphs)
+    return FALSE;
+
+  for (i = 0; i < self1->num_glyphs; i++)
+    {
+      PangoGlyphInfo *info1 = &self1->glyphs[i];
+      PangoGlyphInfo *info2 = &self2->glyphs[i];
+
+      if (info1->glyph != info2->glyph ||
+          info1->geometry.width != info2->geometry.width ||
+          info1->geometry.x_offset != info2->geometry.x_offset ||
+          info1->geometry.y_offset != info2->geometry.y_offset ||
+          info1->attr.is_cluster_start != info2->attr.is_cluster_start)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static const GskRenderNodeClass GSK_TEXT_NODE_CLASS = {
   GSK_TEXT_NODE,
   sizeof (GskTextNode),
   "GskTextNode",
   gsk_text_node_finalize,
   gsk_text_node_draw,
+  gsk_text_node_diff,
   gsk_text_node_serialize,
-  gsk_text_node_deserialize
+  gsk_text_node_deserialize,
+  gsk_text_node_encode,
+  gsk_text_node_decode,
+  gsk_text_node_hash,
+  gsk_text_node_equal
 };
 
 /**
@@ -4467,6 +6315,43 @@ gsk_blur_node_draw (GskRenderNode *node,
   cairo_pattern_destroy (pattern);
 }
 
+static void
+gsk_blur_node_diff (GskRenderNode  *node1,
+                    GskRenderNode  *node2,
+                    cairo_region_t *region)
+{
+  GskBlurNode *self1 = (GskBlurNode *) node1;
+  GskBlurNode *self2 = (GskBlurNode *) node2;
+  cairo_region_t *sub;
+  cairo_rectangle_int_t rect;
+  float clip_radius;
+  int i, n;
+
+  if (self1->radius != self2->radius)
+    {
+      gsk_render_node_diff_impossible (node1, node2, region);
+      return;
+    }
+
+  sub = cairo_region_create ();
+  gsk_render_node_diff (self1->child, self2->child, sub);
+
+  /* Changed pixels bleed into their surroundings */
+  clip_radius = gsk_cairo_blur_compute_pixels (self1->radius);
+  n = cairo_region_num_rectangles (sub);
+  for (i = 0; i < n; i++)
+    {
+      cairo_region_get_rectangle (sub, i, &rect);
+      gsk_render_node_union_bounds (region,
+                                    &GRAPHENE_RECT_INIT (rect.x - clip_radius,
+                                                         rect.y - clip_radius,
+                                                         rect.width + 2 * clip_radius,
+                                                         rect.height + 2 * clip_radius));
+    }
+
+  cairo_region_destroy (sub);
+}
+
 #define GSK_BLUR_NODE_VARIANT_TYPE "(duv)"
 
 static GVariant *
@@ -4505,14 +6390,62 @@ gsk_blur_node_deserialize (GVariant  *variant,
   return result;
 }
 
+static void
+gsk_blur_node_encode (GskRenderNode   *node,
+                      GskBinaryWriter *writer)
+{
+  GskBlurNode *self = (GskBlurNode *) node;
+
+  gsk_binary_writer_put_double (writer, self->radius);
+  gsk_binary_writer_put_node (writer, self->child);
+}
+
+static GskRenderNode *
+gsk_blur_node_decode (GskBinaryReader *reader)
+{
+  GskRenderNode *child;
+  double radius;
+
+  radius = gsk_binary_reader_get_double (reader);
+  child = gsk_binary_reader_get_node (reader);
+  if (gsk_binary_reader_has_error (reader))
+    return NULL;
+
+  return gsk_blur_node_new (child, radius);
+}
+
+static guint
+gsk_blur_node_hash (GskRenderNode *node)
+{
+  GskBlurNode *self = (GskBlurNode *) node;
+
+  return hash_double (gsk_render_node_hash (self->child), self->radius);
+}
+
+static gboolean
+gsk_blur_node_equal (GskRenderNode *node1,
+                     GskRenderNode *node2)
+{
+  GskBlurNode *self1 = (GskBlurNode *) node1;
+  GskBlurNode *self2 = (GskBlurNode *) node2;
+
+  return self1->radius == self2->radius &&
+         gsk_render_node_equal (self1->child, self2->child);
+}
+
 static const GskRenderNodeClass GSK_BLUR_NODE_CLASS = {
   GSK_BLUR_NODE,
   sizeof (GskBlurNode),
   "GskBlurNode",
   gsk_blur_node_finalize,
   gsk_blur_node_draw,
+  gsk_blur_node_diff,
   gsk_blur_node_serialize,
-  gsk_blur_node_deserialize
+  gsk_blur_node_deserialize,
+  gsk_blur_node_encode,
+  gsk_blur_node_decode,
+  gsk_blur_node_hash,
+  gsk_blur_node_equal
 };
 
 /**
@@ -4618,3 +6551,77 @@ gsk_render_node_serialize_node (GskRenderNode *node)
   return node->node_class->serialize (node);
 }
 
+GskRenderNode *
+gsk_render_node_decode_node (GskRenderNodeType  type,
+                             GskBinaryReader   *reader)
+{
+  const GskRenderNodeClass *klass;
+
+  if (type < G_N_ELEMENTS (klasses))
+    klass = klasses[type];
+  else
+    klass = NULL;
+
+  if (klass == NULL)
+    {
+      gsk_binary_reader_set_error (reader, "Type %u is not a valid render node type", type);
+      return NULL;
+    }
+
+  return klass->decode (reader);
+}
+
+void
+gsk_render_node_encode_node (GskRenderNode   *node,
+                             GskBinaryWriter *writer)
+{
+  node->node_class->encode (node, writer);
+}
+
+
+/*< private >
+ * gsk_render_node_hash:
+ * @node: a #GskRenderNode
+ *
+ * Computes a hash of the contents of @node, so that nodes that are
+ * gsk_render_node_equal() hash the same. Container-like nodes hash
+ * their children, so this walks the whole subtree.
+ *
+ * Returns: the hash
+ */
+guint
+gsk_render_node_hash (GskRenderNode *node)
+{
+  guint hash;
+
+  hash = node->node_class->node_type;
+  hash = hash_rect (hash, &node->bounds);
+  hash = HASH_COMBINE (hash, node->node_class->hash (node));
+
+  return hash;
+}
+
+/*< private >
+ * gsk_render_node_equal:
+ * @node1: a #GskRenderNode
+ * @node2: another #GskRenderNode
+ *
+ * Checks whether the two nodes draw the same thing, by comparing their
+ * contents and the contents of their children. Textures, surfaces and
+ * fonts are compared by identity.
+ *
+ * Returns: %TRUE if the nodes are equal
+ */
+gboolean
+gsk_render_node_equal (GskRenderNode *node1,
+                       GskRenderNode *node2)
+{
+  if (node1 == node2)
+    return TRUE;
+
+  if (node1->node_class != node2->node_class ||
+      !graphene_rect_equal (&node1->bounds, &node2->bounds))
+    return FALSE;
+
+  return node1->node_class->equal (node1, node2);
+}
@@ -2,6 +2,7 @@
 #define __GSK_RENDER_NODE_PRIVATE_H__
 
 #include "gskrendernode.h"
+#include "gskrendernodebinaryprivate.h"
 #include <cairo.h>
 
 G_BEGIN_DECLS
@@ -16,6 +17,12 @@ struct _GskRenderNode
 
   volatile int ref_count;
 
+  /* The arena chunk the node was allocated from, or %NULL */
+  gpointer chunk;
+
+  /* Whether the node is in the intern table */
+  guint interned : 1;
+
   /* Use for debugging */
   char *name;
 
@@ -31,18 +38,51 @@ struct _GskRenderNodeClass
   void            (* finalize)    (GskRenderNode  *node);
   void            (* draw)        (GskRenderNode  *node,
                                    cairo_t        *cr);
+  void            (* diff)        (GskRenderNode  *node1,
+                                   GskRenderNode  *node2,
+                                   cairo_region_t *region);
   GVariant *      (* serialize)   (GskRenderNode  *node);
   GskRenderNode * (* deserialize) (GVariant       *variant,
                                    GError        **error);
+  void            (* encode)      (GskRenderNode   *node,
+                                   GskBinaryWriter *writer);
+  GskRenderNode * (* decode)      (GskBinaryReader *reader);
+  guint           (* hash)        (GskRenderNode  *node);
+  gboolean        (* equal)       (GskRenderNode  *node1,
+                                   GskRenderNode  *node2);
 };
 
+typedef struct _GskRenderNodeArena GskRenderNodeArena;
+
 GskRenderNode * gsk_render_node_new              (const GskRenderNodeClass  *node_class,
                                                   gsize                      extra_size);
 
+GskRenderNodeArena *
+                gsk_render_node_arena_push       (void);
+void            gsk_render_node_arena_pop        (GskRenderNodeArena        *arena);
+
+guint           gsk_render_node_hash             (GskRenderNode             *node);
+gboolean        gsk_render_node_equal            (GskRenderNode             *node1,
+                                                  GskRenderNode             *node2);
+GskRenderNode * gsk_render_node_intern           (GskRenderNode             *node);
+
+void            gsk_render_node_diff             (GskRenderNode             *node1,
+                                                  GskRenderNode             *node2,
+                                                  cairo_region_t            *region);
+void            gsk_render_node_diff_impossible  (GskRenderNode             *node1,
+                                                  GskRenderNode             *node2,
+                                                  cairo_region_t            *region);
+void            gsk_render_node_union_bounds     (cairo_region_t            *region,
+                                                  const graphene_rect_t     *bounds);
+
 GVariant *      gsk_render_node_serialize_node   (GskRenderNode             *node);
 GskRenderNode * gsk_render_node_deserialize_node (GskRenderNodeType          type,
                                                   GVariant                  *variant,
                                                   GError                   **error);
+void            gsk_render_node_encode_node      (GskRenderNode             *node,
+                                                  GskBinaryWriter           *writer);
+GskRenderNode * gsk_render_node_decode_node      (GskRenderNodeType          type,
+                                                  GskBinaryReader           *reader);
 
 GskRenderNode * gsk_cairo_node_new_for_surface   (const graphene_rect_t    *bounds,
                                                   cairo_surface_t          *surface);
@@ -522,3 +522,33 @@ gsk_rounded_rect_to_float (const GskRoundedRect *self,
     }
 }
 
+
+/*< private >
+ * gsk_rounded_rect_equal:
+ * @rect1: a #GskRoundedRect
+ * @rect2: another #GskRoundedRect
+ *
+ * Checks if the two rounded rects describe the same shape.
+ * This function is suitable as a #GEqualFunc.
+ *
+ * Returns: %TRUE if the two rects are equal
+ */
+gboolean
+gsk_rounded_rect_equal (gconstpointer rect1,
+                        gconstpointer rect2)
+{
+  const GskRoundedRect *self1 = rect1;
+  const GskRoundedRect *self2 = rect2;
+  guint i;
+
+  if (!graphene_rect_equal (&self1->bounds, &self2->bounds))
+    return FALSE;
+
+  for (i = 0; i < 4; i++)
+    {
+      if (!graphene_size_equal (&self1->corner[i], &self2->corner[i]))
+        return FALSE;
+    }
+
+  return TRUE;
+}
@@ -15,6 +15,7 @@ GskVulkanBuffer *       gsk_vulkan_buffer_new_download                  (GdkVulk
                                                                          gsize                   size);
 void                    gsk_vulkan_buffer_free                          (GskVulkanBuffer        *buffer);
 
+gsize                   gsk_vulkan_buffer_get_size                      (GskVulkanBuffer        *self);
 VkBuffer                gsk_vulkan_buffer_get_buffer                    (GskVulkanBuffer        *self);
 
 guchar *                gsk_vulkan_buffer_map                           (GskVulkanBuffer        *self);
@@ -95,16 +95,14 @@ gsk_vulkan_color_text_pipeline_count_vertex_data (GskVulkanColorTextPipeline *pi
 void
 gsk_vulkan_color_text_pipeline_collect_vertex_data (GskVulkanColorTextPipeline *pipeline,
                                                     guchar                     *data,
-                                                    GskVulkanRenderer          *renderer,
                                                     const graphene_rect_t      *rect,
-                                                    PangoFont                  *font,
                                                     guint                       total_glyphs,
                                                     const PangoGlyphInfo       *glyphs,
+                                                    GskVulkanCachedGlyph      **cached_glyphs,
                                                     float                       x,
                                                     float                       y,
                                                     guint                       start_glyph,
-                                                    guint                       num_glyphs,
-                                                    float                       scale)
+                                                    guint                       num_glyphs)
 {
   GskVulkanColorTextInstance *instances = (GskVulkanColorTextInstance *) data;
   int i;
@@ -123,9 +121,7 @@ gsk_vulkan_color_text_pipeline_collect_vertex_data (GskVulkanColorTextPipeline *
           double cx = (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
           double cy = (double)(gi->geometry.y_offset) / PANGO_SCALE;
           GskVulkanColorTextInstance *instance = &instances[count];
-          GskVulkanCachedGlyph *glyph;
-
-          glyph = gsk_vulkan_renderer_get_cached_glyph (renderer, font, gi->glyph, scale);
+          GskVulkanCachedGlyph *glyph = cached_glyphs[i];
 
           instance->tex_rect[0] = glyph->tx;
           instance->tex_rect[1] = glyph->ty;
@@ -23,16 +23,14 @@ gsize                   gsk_vulkan_color_text_pipeline_count_vertex_data     (Gs
                                                                               int                             num_instances);
 void                    gsk_vulkan_color_text_pipeline_collect_vertex_data   (GskVulkanColorTextPipeline     *pipeline,
                                                                               guchar                         *data,
-                                                                              GskVulkanRenderer              *renderer,
                                                                               const graphene_rect_t          *rect,
-                                                                              PangoFont                      *font,
                                                                               guint                           total_glyphs,
                                                                               const PangoGlyphInfo           *glyphs,
+                                                                              GskVulkanCachedGlyph          **cached_glyphs,
                                                                               float                           x,
                                                                               float                           y,
                                                                               guint                           start_glyph,
-                                                                              guint                           num_glyphs,
-                                                                              float                           scale);
+                                                                              guint                           num_glyphs);
 gsize                   gsk_vulkan_color_text_pipeline_draw                  (GskVulkanColorTextPipeline     *pipeline,
                                                                               VkCommandBuffer                 command_buffer,
                                                                               gsize                           offset,
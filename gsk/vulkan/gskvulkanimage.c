@@ -239,14 +239,13 @@ gsk_vulkan_image_new (GdkVulkanContext      *context,
                                 &requirements);
 
   self->memory = gsk_vulkan_memory_new (context,
-                                        requirements.memoryTypeBits,
-                                        memory,
-                                        requirements.size);
+                                        &requirements,
+                                        memory);
 
   GSK_VK_CHECK (vkBindImageMemory, gdk_vulkan_context_get_device (context),
                                    self->vk_image,
                                    gsk_vulkan_memory_get_device_memory (self->memory),
-                                   0);
+                                   gsk_vulkan_memory_get_offset (self->memory));
   return self;
 }
 
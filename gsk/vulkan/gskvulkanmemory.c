@@ -3,52 +3,333 @@
 #include "gskvulkanpipelineprivate.h"
 #include "gskvulkanmemoryprivate.h"
 
-struct _GskVulkanMemory
-{
-  GdkVulkanContext *vulkan;
+#include "gskdebugprivate.h"
+
+/* Implementations limit the number of allocations, and allocating is slow,
+ * so we allocate big blocks of device memory per memory type and hand out
+ * ranges of them. Anything that would take up a big part of a block gets
+ * a block of its own. */
+#define BLOCK_SIZE (16 * 1024 * 1024)
+#define MAX_POOLED_SIZE (BLOCK_SIZE / 4)
 
+typedef struct _GskVulkanAllocator GskVulkanAllocator;
+typedef struct _GskVulkanMemoryBlock GskVulkanMemoryBlock;
+
+typedef struct
+{
+  gsize offset;
   gsize size;
+} FreeRange;
 
+struct _GskVulkanMemoryBlock
+{
   VkDeviceMemory vk_memory;
+  uint32_t type;
+  gsize size;
+  guint dedicated : 1;
+
+  /* host visible blocks stay mapped once they have been mapped, as
+   * Vulkan doesn't allow mapping the same memory more than once */
+  guchar *map;
+
+  /* sorted by offset, neighbours are always merged */
+  GArray *free_ranges;
+  guint n_allocations;
 };
 
-GskVulkanMemory *
-gsk_vulkan_memory_new (GdkVulkanContext      *context,
-                       uint32_t               allowed_types,
-                       VkMemoryPropertyFlags  flags,
-                       gsize                  size)
+struct _GskVulkanAllocator
 {
+  GdkVulkanContext *vulkan;
+
   VkPhysicalDeviceMemoryProperties properties;
-  GskVulkanMemory *self;
-  uint32_t i;
+  VkDeviceSize granularity;
 
-  self = g_slice_new0 (GskVulkanMemory);
+  GPtrArray *blocks;
+  guint n_allocations;
+};
 
-  self->vulkan = g_object_ref (context);
-  self->size = size;
+struct _GskVulkanMemory
+{
+  GdkVulkanContext *vulkan;
+
+  GskVulkanAllocator *allocator;
+  GskVulkanMemoryBlock *block;
 
-  vkGetPhysicalDeviceMemoryProperties (gdk_vulkan_context_get_physical_device (context),
-                                       &properties);
+  gsize offset;
+  gsize size;
+};
+
+static GQuark
+gsk_vulkan_allocator_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("gsk-vulkan-allocator");
+
+  return quark;
+}
+
+static void
+gsk_vulkan_memory_block_free (GskVulkanAllocator   *allocator,
+                              GskVulkanMemoryBlock *block)
+{
+  VkDevice device = gdk_vulkan_context_get_device (allocator->vulkan);
 
-  for (i = 0; i < properties.memoryTypeCount; i++)
+  if (block->map)
+    vkUnmapMemory (device, block->vk_memory);
+
+  vkFreeMemory (device, block->vk_memory, NULL);
+
+  g_array_unref (block->free_ranges);
+  g_slice_free (GskVulkanMemoryBlock, block);
+}
+
+/* There is one allocator per context. It only lives as long as there is
+ * memory allocated from it, so it never outlives the device. */
+static GskVulkanAllocator *
+gsk_vulkan_allocator_get (GdkVulkanContext *context)
+{
+  GskVulkanAllocator *self;
+  VkPhysicalDeviceProperties device_properties;
+  VkPhysicalDevice physical_device;
+
+  self = g_object_get_qdata (G_OBJECT (context), gsk_vulkan_allocator_quark ());
+  if (self)
+    return self;
+
+  self = g_slice_new0 (GskVulkanAllocator);
+  self->vulkan = context;
+  self->blocks = g_ptr_array_new ();
+
+  physical_device = gdk_vulkan_context_get_physical_device (context);
+  vkGetPhysicalDeviceMemoryProperties (physical_device, &self->properties);
+  vkGetPhysicalDeviceProperties (physical_device, &device_properties);
+  self->granularity = device_properties.limits.bufferImageGranularity;
+
+  g_object_set_qdata (G_OBJECT (context), gsk_vulkan_allocator_quark (), self);
+
+  return self;
+}
+
+static void
+gsk_vulkan_allocator_free (GskVulkanAllocator *self)
+{
+  guint i;
+
+  g_object_set_qdata (G_OBJECT (self->vulkan), gsk_vulkan_allocator_quark (), NULL);
+
+  for (i = 0; i < self->blocks->len; i++)
+    gsk_vulkan_memory_block_free (self, g_ptr_array_index (self->blocks, i));
+
+  g_ptr_array_unref (self->blocks);
+  g_slice_free (GskVulkanAllocator, self);
+}
+
+static uint32_t
+gsk_vulkan_allocator_find_type (GskVulkanAllocator    *self,
+                                uint32_t               allowed_types,
+                                VkMemoryPropertyFlags  flags)
+{
+  uint32_t i;
+
+  for (i = 0; i < self->properties.memoryTypeCount; i++)
     {
       if (!(allowed_types & (1 << i)))
         continue;
 
-      if ((properties.memoryTypes[i].propertyFlags & flags) == flags)
+      if ((self->properties.memoryTypes[i].propertyFlags & flags) == flags)
         break;
   }
 
-  g_assert (i < properties.memoryTypeCount);
+  g_assert (i < self->properties.memoryTypeCount);
 
-  GSK_VK_CHECK (vkAllocateMemory, gdk_vulkan_context_get_device (context),
+  return i;
+}
+
+static GskVulkanMemoryBlock *
+gsk_vulkan_allocator_add_block (GskVulkanAllocator *self,
+                                uint32_t            type,
+                                gsize               size,
+                                gboolean            dedicated)
+{
+  GskVulkanMemoryBlock *block;
+  FreeRange range;
+
+  block = g_slice_new0 (GskVulkanMemoryBlock);
+  block->type = type;
+  block->size = size;
+  block->dedicated = dedicated;
+  block->free_ranges = g_array_new (FALSE, FALSE, sizeof (FreeRange));
+
+  range.offset = 0;
+  range.size = size;
+  g_array_append_val (block->free_ranges, range);
+
+  GSK_VK_CHECK (vkAllocateMemory, gdk_vulkan_context_get_device (self->vulkan),
                                   &(VkMemoryAllocateInfo) {
                                       .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
                                       .allocationSize = size,
-                                      .memoryTypeIndex = i
+                                      .memoryTypeIndex = type
                                   },
                                   NULL,
-                                  &self->vk_memory);
+                                  &block->vk_memory);
+
+  g_ptr_array_add (self->blocks, block);
+
+  GSK_NOTE (VULKAN, g_message ("Allocated %s memory block of %" G_GSIZE_FORMAT " bytes for type %u, %u blocks total",
+                               dedicated ? "dedicated" : "shared", size, type, self->blocks->len));
+
+  return block;
+}
+
+/* First fit. Returns FALSE if there is no free range big enough. */
+static gboolean
+gsk_vulkan_memory_block_alloc (GskVulkanMemoryBlock *block,
+                               gsize                 size,
+                               gsize                 alignment,
+                               gsize                *out_offset)
+{
+  guint i;
+
+  for (i = 0; i < block->free_ranges->len; i++)
+    {
+      FreeRange *range = &g_array_index (block->free_ranges, FreeRange, i);
+      gsize offset = (range->offset + alignment - 1) / alignment * alignment;
+      gsize padding = offset - range->offset;
+      gsize end;
+
+      if (padding + size > range->size)
+        continue;
+
+      end = range->offset + range->size;
+
+      /* The padding stays free; only the rest after our allocation
+       * needs a new range */
+      if (padding > 0)
+        {
+          range->size = padding;
+          if (offset + size < end)
+            {
+              FreeRange rest = { offset + size, end - offset - size };
+              g_array_insert_val (block->free_ranges, i + 1, rest);
+            }
+        }
+      else if (offset + size < end)
+        {
+          range->offset = offset + size;
+          range->size = end - offset - size;
+        }
+      else
+        {
+          g_array_remove_index (block->free_ranges, i);
+        }
+
+      block->n_allocations++;
+      *out_offset = offset;
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+static void
+gsk_vulkan_memory_block_release (GskVulkanMemoryBlock *block,
+                                 gsize                 offset,
+                                 gsize                 size)
+{
+  FreeRange new_range = { offset, size };
+  FreeRange *prev, *next;
+  guint i;
+
+  for (i = 0; i < block->free_ranges->len; i++)
+    {
+      if (g_array_index (block->free_ranges, FreeRange, i).offset > offset)
+        break;
+    }
+  g_array_insert_val (block->free_ranges, i, new_range);
+
+  if (i + 1 < block->free_ranges->len)
+    {
+      FreeRange *range = &g_array_index (block->free_ranges, FreeRange, i);
+      next = &g_array_index (block->free_ranges, FreeRange, i + 1);
+
+      if (range->offset + range->size == next->offset)
+        {
+          range->size += next->size;
+          g_array_remove_index (block->free_ranges, i + 1);
+        }
+    }
+
+  if (i > 0)
+    {
+      FreeRange *range = &g_array_index (block->free_ranges, FreeRange, i);
+      prev = &g_array_index (block->free_ranges, FreeRange, i - 1);
+
+      if (prev->offset + prev->size == range->offset)
+        {
+          prev->size += range->size;
+          g_array_remove_index (block->free_ranges, i);
+        }
+    }
+
+  block->n_allocations--;
+}
+
+GskVulkanMemory *
+gsk_vulkan_memory_new (GdkVulkanContext           *context,
+                       const VkMemoryRequirements *requirements,
+                       VkMemoryPropertyFlags       flags)
+{
+  GskVulkanAllocator *allocator;
+  GskVulkanMemoryBlock *block = NULL;
+  GskVulkanMemory *self;
+  uint32_t type;
+  gsize alignment;
+  guint i;
+
+  allocator = gsk_vulkan_allocator_get (context);
+
+  self = g_slice_new0 (GskVulkanMemory);
+
+  self->vulkan = g_object_ref (context);
+  self->allocator = allocator;
+  self->size = requirements->size;
+
+  type = gsk_vulkan_allocator_find_type (allocator, requirements->memoryTypeBits, flags);
+
+  /* Linear and optimally tiled resources must not share a page of
+   * bufferImageGranularity, and we don't track which is which. */
+  alignment = MAX (requirements->alignment, allocator->granularity);
+  alignment = MAX (alignment, 1);
+
+  if (requirements->size > MAX_POOLED_SIZE)
+    {
+      block = gsk_vulkan_allocator_add_block (allocator, type, requirements->size, TRUE);
+      gsk_vulkan_memory_block_alloc (block, requirements->size, 1, &self->offset);
+    }
+  else
+    {
+      for (i = 0; i < allocator->blocks->len; i++)
+        {
+          block = g_ptr_array_index (allocator->blocks, i);
+
+          if (block->type != type || block->dedicated)
+            continue;
+
+          if (gsk_vulkan_memory_block_alloc (block, requirements->size, alignment, &self->offset))
+            break;
+        }
+
+      if (i == allocator->blocks->len)
+        {
+          block = gsk_vulkan_allocator_add_block (allocator, type, BLOCK_SIZE, FALSE);
+          gsk_vulkan_memory_block_alloc (block, requirements->size, alignment, &self->offset);
+        }
+    }
+
+  self->block = block;
+  allocator->n_allocations++;
 
   return self;
 }
@@ -56,9 +337,37 @@ gsk_vulkan_memory_new (GdkVulkanContext      *context,
 void
 gsk_vulkan_memory_free (GskVulkanMemory *self)
 {
-  vkFreeMemory (gdk_vulkan_context_get_device (self->vulkan),
-                self->vk_memory,
-                NULL);
+  GskVulkanAllocator *allocator = self->allocator;
+  GskVulkanMemoryBlock *block = self->block;
+  guint i;
+
+  gsk_vulkan_memory_block_release (block, self->offset, self->size);
+  allocator->n_allocations--;
+
+  if (allocator->n_allocations == 0)
+    {
+      gsk_vulkan_allocator_free (allocator);
+    }
+  else if (block->n_allocations == 0)
+    {
+      gboolean keep = !block->dedicated;
+
+      /* Keep one empty block per type around for the next frame */
+      for (i = 0; keep && i < allocator->blocks->len; i++)
+        {
+          GskVulkanMemoryBlock *other = g_ptr_array_index (allocator->blocks, i);
+
+          if (other != block && other->type == block->type &&
+              !other->dedicated && other->n_allocations == 0)
+            keep = FALSE;
+        }
+
+      if (!keep)
+        {
+          g_ptr_array_remove (allocator->blocks, block);
+          gsk_vulkan_memory_block_free (allocator, block);
+        }
+    }
 
   g_object_unref (self->vulkan);
 
@@ -68,28 +377,55 @@ gsk_vulkan_memory_free (GskVulkanMemory *self)
 VkDeviceMemory
 gsk_vulkan_memory_get_device_memory (GskVulkanMemory *self)
 {
-  return self->vk_memory;
+  return self->block->vk_memory;
+}
+
+gsize
+gsk_vulkan_memory_get_offset (GskVulkanMemory *self)
+{
+  return self->offset;
 }
 
 guchar *
 gsk_vulkan_memory_map (GskVulkanMemory *self)
 {
-  void *data;
+  GskVulkanMemoryBlock *block = self->block;
+
+  if (block->map == NULL)
+    {
+      void *data;
+
+      GSK_VK_CHECK (vkMapMemory, gdk_vulkan_context_get_device (self->vulkan),
+                                 block->vk_memory,
+                                 0,
+                                 VK_WHOLE_SIZE,
+                                 0,
+                                 &data);
 
-  GSK_VK_CHECK (vkMapMemory, gdk_vulkan_context_get_device (self->vulkan),
-                             self->vk_memory,
-                             0,
-                             self->size,
-                             0,
-                             &data);
+      block->map = data;
+    }
 
-  return data;
+  return block->map + self->offset;
 }
 
 void
 gsk_vulkan_memory_unmap (GskVulkanMemory *self)
 {
-  vkUnmapMemory (gdk_vulkan_context_get_device (self->vulkan),
-                 self->vk_memory);
-}
+  GskVulkanMemoryBlock *block = self->block;
+  VkMemoryPropertyFlags flags;
+
+  /* The block stays mapped, but writes to memory that isn't coherent
+   * need to be made visible to the device */
+  flags = self->allocator->properties.memoryTypes[block->type].propertyFlags;
+  if (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+    return;
 
+  GSK_VK_CHECK (vkFlushMappedMemoryRanges, gdk_vulkan_context_get_device (self->vulkan),
+                                           1,
+                                           &(VkMappedMemoryRange) {
+                                               .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+                                               .memory = block->vk_memory,
+                                               .offset = 0,
+                                               .size = VK_WHOLE_SIZE
+                                           });
+}
@@ -8,12 +8,12 @@ G_BEGIN_DECLS
 typedef struct _GskVulkanMemory GskVulkanMemory;
 
 GskVulkanMemory *       gsk_vulkan_memory_new                           (GdkVulkanContext       *context,
-                                                                         uint32_t                allowed_types,
-                                                                         VkMemoryPropertyFlags   properties,
-                                                                         gsize                   size);
+                                                                         const VkMemoryRequirements *requirements,
+                                                                         VkMemoryPropertyFlags   properties);
 void                    gsk_vulkan_memory_free                          (GskVulkanMemory        *memory);
 
 VkDeviceMemory          gsk_vulkan_memory_get_device_memory             (GskVulkanMemory        *self);
+gsize                   gsk_vulkan_memory_get_offset                    (GskVulkanMemory        *self);
 
 guchar *                gsk_vulkan_memory_map                           (GskVulkanMemory        *self);
 void                    gsk_vulkan_memory_unmap                         (GskVulkanMemory        *self);
@@ -5,6 +5,7 @@
 #include "gskvulkanrenderprivate.h"
 
 #include "gskrendererprivate.h"
+#include "gskvulkanrendererprivate.h"
 #include "gskvulkanbufferprivate.h"
 #include "gskvulkancommandpoolprivate.h"
 #include "gskvulkanpipelineprivate.h"
@@ -26,6 +27,17 @@
 #define DESCRIPTOR_POOL_MAXSETS 128
 #define DESCRIPTOR_POOL_MAXSETS_INCREASE 128
 
+/* Render passes get recorded on up to this many threads, including
+ * the one calling gsk_vulkan_render_draw() */
+#define MAX_RECORD_THREADS 4
+
+typedef struct _RecordJob RecordJob;
+
+struct _RecordJob {
+  GskVulkanRender *render;
+  guint index;
+};
+
 struct _GskVulkanRender
 {
   GskRenderer *renderer;
@@ -37,6 +49,18 @@ struct _GskVulkanRender
 
   GHashTable *framebuffers;
   GskVulkanCommandPool *command_pool;
+  /* Command pools may only be used by one thread at a time, so
+   * every recording thread but ours gets its own */
+  GskVulkanCommandPool *record_command_pools[MAX_RECORD_THREADS - 1];
+  RecordJob record_jobs[MAX_RECORD_THREADS - 1];
+  guint n_record_threads;
+  guint n_recording_threads; /* for the current draw */
+  GMutex record_mutex;
+  GCond record_cond;
+  guint n_pending_records;
+  GskVulkanRenderPass **record_passes;
+  VkCommandBuffer *record_buffers;
+  guint n_record_passes;
   VkFence fence;
   VkRenderPass render_pass;
   VkDescriptorSetLayout descriptor_set_layout;
@@ -57,6 +81,7 @@ struct _GskVulkanRender
 
   GList *render_passes;
   GSList *cleanup_images;
+  GSList *vertex_buffers;
 
   GQuark render_pass_counter;
   GQuark gpu_time_timer;
@@ -111,6 +136,9 @@ gsk_vulkan_render_new (GskRenderer      *renderer,
   device = gdk_vulkan_context_get_device (self->vulkan);
 
   self->command_pool = gsk_vulkan_command_pool_new (self->vulkan);
+  self->n_record_threads = CLAMP (g_get_num_processors (), 1, MAX_RECORD_THREADS);
+  g_mutex_init (&self->record_mutex);
+  g_cond_init (&self->record_cond);
   GSK_VK_CHECK (vkCreateFence, device,
                                &(VkFenceCreateInfo) {
                                    .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
@@ -310,6 +338,19 @@ gsk_vulkan_render_add_cleanup_image (GskVulkanRender *self,
   self->cleanup_images = g_slist_prepend (self->cleanup_images, image);
 }
 
+/* The buffer belongs to the render until the GPU is done with this frame */
+GskVulkanBuffer *
+gsk_vulkan_render_get_vertex_buffer (GskVulkanRender *self,
+                                     gsize            size)
+{
+  GskVulkanBuffer *buffer;
+
+  buffer = gsk_vulkan_renderer_get_vertex_buffer (GSK_VULKAN_RENDERER (self->renderer), size);
+  self->vertex_buffers = g_slist_prepend (self->vertex_buffers, buffer);
+
+  return buffer;
+}
+
 void
 gsk_vulkan_render_add_render_pass (GskVulkanRender     *self,
                                    GskVulkanRenderPass *pass)
@@ -575,9 +616,46 @@ gsk_vulkan_render_prepare_descriptor_sets (GskVulkanRender *self)
     }
 }
 
+/* Records the passes assigned to recording thread @index */
+static void
+gsk_vulkan_render_record_passes (GskVulkanRender *self,
+                                 guint            index)
+{
+  GskVulkanCommandPool *command_pool;
+  guint i;
+
+  if (index == 0)
+    command_pool = self->command_pool;
+  else
+    command_pool = self->record_command_pools[index - 1];
+
+  for (i = index; i < self->n_record_passes; i += self->n_recording_threads)
+    {
+      self->record_buffers[i] = gsk_vulkan_command_pool_get_buffer (command_pool);
+
+      gsk_vulkan_render_pass_draw (self->record_passes[i], self, 3, self->pipeline_layout, self->record_buffers[i]);
+    }
+}
+
+static void
+gsk_vulkan_render_record_thread (gpointer data,
+                                 gpointer user_data)
+{
+  RecordJob *job = data;
+  GskVulkanRender *self = job->render;
+
+  gsk_vulkan_render_record_passes (self, job->index);
+
+  g_mutex_lock (&self->record_mutex);
+  self->n_pending_records--;
+  g_cond_signal (&self->record_cond);
+  g_mutex_unlock (&self->record_mutex);
+}
+
 void
 gsk_vulkan_render_draw (GskVulkanRender *self)
 {
+  guint i, n_threads;
   GList *l;
 
 #ifdef G_ENABLE_DEBUG
@@ -587,10 +665,53 @@ gsk_vulkan_render_draw (GskVulkanRender *self)
 
   gsk_vulkan_render_prepare_descriptor_sets (self);
 
-  for (l = self->render_passes; l; l = l->next)
+  self->n_record_passes = g_list_length (self->render_passes);
+  self->record_passes = g_new (GskVulkanRenderPass *, self->n_record_passes);
+  self->record_buffers = g_new (VkCommandBuffer, self->n_record_passes);
+
+  for (l = self->render_passes, i = 0; l; l = l->next, i++)
     {
-      GskVulkanRenderPass *pass = l->data;
-      VkCommandBuffer command_buffer;
+      self->record_passes[i] = l->data;
+      gsk_vulkan_render_pass_prepare_draw (self->record_passes[i], self);
+    }
+
+  /* Collecting the vertex data and recording the commands of a pass
+   * doesn't depend on the other passes, so do it in parallel when there
+   * are offscreens. Everything touching shared state, like the glyph
+   * cache, happened when adding the nodes and in prepare_draw() above.
+   * Submitting happens in order on this thread below. */
+  n_threads = CLAMP (self->n_record_passes, 1, self->n_record_threads);
+  self->n_recording_threads = n_threads;
+  if (n_threads > 1)
+    {
+      GThreadPool *pool;
+
+      pool = gsk_vulkan_renderer_get_record_pool (GSK_VULKAN_RENDERER (self->renderer),
+                                                  gsk_vulkan_render_record_thread,
+                                                  MAX_RECORD_THREADS - 1);
+
+      self->n_pending_records = n_threads - 1;
+      for (i = 1; i < n_threads; i++)
+        {
+          if (self->record_command_pools[i - 1] == NULL)
+            self->record_command_pools[i - 1] = gsk_vulkan_command_pool_new (self->vulkan);
+
+          self->record_jobs[i - 1].render = self;
+          self->record_jobs[i - 1].index = i;
+          g_thread_pool_push (pool, &self->record_jobs[i - 1], NULL);
+        }
+    }
+
+  gsk_vulkan_render_record_passes (self, 0);
+
+  g_mutex_lock (&self->record_mutex);
+  while (self->n_pending_records > 0)
+    g_cond_wait (&self->record_cond, &self->record_mutex);
+  g_mutex_unlock (&self->record_mutex);
+
+  for (i = 0; i < self->n_record_passes; i++)
+    {
+      GskVulkanRenderPass *pass = self->record_passes[i];
       gsize wait_semaphore_count;
       gsize signal_semaphore_count;
       VkSemaphore *wait_semaphores;
@@ -599,19 +720,18 @@ gsk_vulkan_render_draw (GskVulkanRender *self)
       wait_semaphore_count = gsk_vulkan_render_pass_get_wait_semaphores (pass, &wait_semaphores);
       signal_semaphore_count = gsk_vulkan_render_pass_get_signal_semaphores (pass, &signal_semaphores);
 
-      command_buffer = gsk_vulkan_command_pool_get_buffer (self->command_pool);
-
-      gsk_vulkan_render_pass_draw (pass, self, 3, self->pipeline_layout, command_buffer);
-
       gsk_vulkan_command_pool_submit_buffer (self->command_pool,
-                                             command_buffer,
+                                             self->record_buffers[i],
                                              wait_semaphore_count,
                                              wait_semaphores,
                                              signal_semaphore_count,
                                              signal_semaphores,
-                                             l->next != NULL ? VK_NULL_HANDLE : self->fence);
+                                             i + 1 < self->n_record_passes ? VK_NULL_HANDLE : self->fence);
     }
 
+  g_clear_pointer (&self->record_passes, g_free);
+  g_clear_pointer (&self->record_buffers, g_free);
+
 #ifdef G_ENABLE_DEBUG
   if (GSK_RENDERER_DEBUG_CHECK (self->renderer, SYNC))
     {
@@ -643,6 +763,8 @@ static void
 gsk_vulkan_render_cleanup (GskVulkanRender *self)
 {
   VkDevice device = gdk_vulkan_context_get_device (self->vulkan);
+  GSList *l;
+  guint i;
 
   /* XXX: Wait for fence here or just in reset()? */
   GSK_VK_CHECK (vkWaitForFences, device,
@@ -658,6 +780,11 @@ gsk_vulkan_render_cleanup (GskVulkanRender *self)
   gsk_vulkan_uploader_reset (self->uploader);
 
   gsk_vulkan_command_pool_reset (self->command_pool);
+  for (i = 0; i < G_N_ELEMENTS (self->record_command_pools); i++)
+    {
+      if (self->record_command_pools[i])
+        gsk_vulkan_command_pool_reset (self->record_command_pools[i]);
+    }
 
   g_hash_table_remove_all (self->descriptor_set_indexes);
   GSK_VK_CHECK (vkResetDescriptorPool, device,
@@ -668,6 +795,9 @@ gsk_vulkan_render_cleanup (GskVulkanRender *self)
   self->render_passes = NULL;
   g_slist_free_full (self->cleanup_images, g_object_unref);
   self->cleanup_images = NULL;
+  for (l = self->vertex_buffers; l; l = l->next)
+    gsk_vulkan_renderer_release_vertex_buffer (GSK_VULKAN_RENDERER (self->renderer), l->data);
+  g_clear_pointer (&self->vertex_buffers, g_slist_free);
 
   g_clear_pointer (&self->clip, cairo_region_destroy);
   g_clear_object (&self->target);
@@ -735,6 +865,11 @@ gsk_vulkan_render_free (GskVulkanRender *self)
                     self->repeating_sampler,
                     NULL);
 
+  for (i = 0; i < G_N_ELEMENTS (self->record_command_pools); i++)
+    g_clear_pointer (&self->record_command_pools[i], gsk_vulkan_command_pool_free);
+  g_mutex_clear (&self->record_mutex);
+  g_cond_clear (&self->record_cond);
+
   gsk_vulkan_command_pool_free (self->command_pool);
 
   g_slice_free (GskVulkanRender, self);
@@ -16,6 +16,11 @@
 
 #include <graphene.h>
 
+/* Vertex buffers get reused by later frames, so they are allocated in
+ * sizes that are likely to fit again. */
+#define MIN_VERTEX_BUFFER_SIZE (64 * 1024)
+#define MAX_UNUSED_VERTEX_BUFFERS 8
+
 typedef struct _GskVulkanTextureData GskVulkanTextureData;
 
 struct _GskVulkanTextureData {
@@ -53,6 +58,10 @@ struct _GskVulkanRenderer
 
   GskVulkanGlyphCache *glyph_cache;
 
+  GSList *vertex_buffers;
+
+  GThreadPool *record_pool;
+
 #ifdef G_ENABLE_DEBUG
   ProfileCounters profile_counters;
   ProfileTimers profile_timers;
@@ -151,6 +160,15 @@ gsk_vulkan_renderer_unrealize (GskRenderer *renderer)
 
   g_clear_pointer (&self->render, gsk_vulkan_render_free);
 
+  if (self->record_pool)
+    {
+      g_thread_pool_free (self->record_pool, FALSE, TRUE);
+      self->record_pool = NULL;
+    }
+
+  g_slist_free_full (self->vertex_buffers, (GDestroyNotify) gsk_vulkan_buffer_free);
+  self->vertex_buffers = NULL;
+
   gsk_vulkan_renderer_free_targets (self);
   g_signal_handlers_disconnect_by_func(self->vulkan,
                                        gsk_vulkan_renderer_update_images_cb,
@@ -210,6 +228,59 @@ gsk_vulkan_renderer_render_texture (GskRenderer           *renderer,
   return texture;
 }
 
+GskVulkanBuffer *
+gsk_vulkan_renderer_get_vertex_buffer (GskVulkanRenderer *self,
+                                       gsize              size)
+{
+  GSList *l;
+  gsize buffer_size;
+
+  for (l = self->vertex_buffers; l; l = l->next)
+    {
+      GskVulkanBuffer *buffer = l->data;
+
+      if (gsk_vulkan_buffer_get_size (buffer) >= size)
+        {
+          self->vertex_buffers = g_slist_delete_link (self->vertex_buffers, l);
+          return buffer;
+        }
+    }
+
+  buffer_size = MIN_VERTEX_BUFFER_SIZE;
+  while (buffer_size < size)
+    buffer_size *= 2;
+
+  return gsk_vulkan_buffer_new (self->vulkan, buffer_size);
+}
+
+/* All renders of a renderer, including the ones for render_texture(),
+ * share the threads they record command buffers on. @func is the same
+ * for all of them. */
+GThreadPool *
+gsk_vulkan_renderer_get_record_pool (GskVulkanRenderer *self,
+                                     GFunc              func,
+                                     guint              max_threads)
+{
+  if (self->record_pool == NULL)
+    self->record_pool = g_thread_pool_new (func, NULL, max_threads, FALSE, NULL);
+
+  return self->record_pool;
+}
+
+/* The buffer must not be in use by the GPU anymore */
+void
+gsk_vulkan_renderer_release_vertex_buffer (GskVulkanRenderer *self,
+                                           GskVulkanBuffer   *buffer)
+{
+  if (g_slist_length (self->vertex_buffers) >= MAX_UNUSED_VERTEX_BUFFERS)
+    {
+      gsk_vulkan_buffer_free (buffer);
+      return;
+    }
+
+  self->vertex_buffers = g_slist_prepend (self->vertex_buffers, buffer);
+}
+
 static void
 gsk_vulkan_renderer_render (GskRenderer   *renderer,
                             GskRenderNode *root)
@@ -348,13 +419,15 @@ gsk_vulkan_renderer_ref_texture_image (GskVulkanRenderer *self,
   return image;
 }
 
-guint
+/* Glyphs are only dropped from the cache between frames, so the
+ * result can be used for the rest of the frame */
+GskVulkanCachedGlyph *
 gsk_vulkan_renderer_cache_glyph (GskVulkanRenderer *self,
                                  PangoFont         *font,
                                  PangoGlyph         glyph,
                                  float              scale)
 {
-  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, TRUE, font, glyph, scale)->texture_index;
+  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, TRUE, font, glyph, scale);
 }
 
 GskVulkanImage *
@@ -364,12 +437,3 @@ gsk_vulkan_renderer_ref_glyph_image (GskVulkanRenderer  *self,
 {
   return g_object_ref (gsk_vulkan_glyph_cache_get_glyph_image (self->glyph_cache, uploader, index));
 }
-
-GskVulkanCachedGlyph *
-gsk_vulkan_renderer_get_cached_glyph (GskVulkanRenderer *self,
-                                      PangoFont         *font,
-                                      PangoGlyph         glyph,
-                                      float              scale)
-{
-  return gsk_vulkan_glyph_cache_lookup (self->glyph_cache, FALSE, font, glyph, scale);
-}
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.h>
 #include <gsk/gskrenderer.h>
 
+#include "gskvulkanbufferprivate.h"
 #include "gskvulkanimageprivate.h"
 
 G_BEGIN_DECLS
@@ -25,6 +26,15 @@ GskVulkanImage *        gsk_vulkan_renderer_ref_texture_image           (GskVulk
                                                                          GdkTexture             *texture,
                                                                          GskVulkanUploader      *uploader);
 
+GskVulkanBuffer *       gsk_vulkan_renderer_get_vertex_buffer           (GskVulkanRenderer      *self,
+                                                                         gsize                   size);
+void                    gsk_vulkan_renderer_release_vertex_buffer       (GskVulkanRenderer      *self,
+                                                                         GskVulkanBuffer        *buffer);
+
+GThreadPool *           gsk_vulkan_renderer_get_record_pool             (GskVulkanRenderer      *self,
+                                                                         GFunc                   func,
+                                                                         guint                   max_threads);
+
 typedef struct
 {
   guint texture_index;
@@ -42,7 +52,7 @@ typedef struct
   guint64 timestamp;
 } GskVulkanCachedGlyph;
 
-guint                  gsk_vulkan_renderer_cache_glyph      (GskVulkanRenderer *renderer,
+GskVulkanCachedGlyph * gsk_vulkan_renderer_cache_glyph      (GskVulkanRenderer *renderer,
                                                              PangoFont         *font,
                                                              PangoGlyph         glyph,
                                                              float              scale);
@@ -51,11 +61,6 @@ GskVulkanImage *       gsk_vulkan_renderer_ref_glyph_image  (GskVulkanRenderer *
                                                              GskVulkanUploader *uploader,
                                                              guint              index);
 
-GskVulkanCachedGlyph * gsk_vulkan_renderer_get_cached_glyph (GskVulkanRenderer *self,
-                                                             PangoFont         *font,
-                                                             PangoGlyph         glyph,
-                                                             float              scale);
-
 
 G_END_DECLS
 
@@ -89,7 +89,7 @@ struct _GskVulkanOpText
   guint                texture_index; /* index of the texture in the glyph cache */
   guint                start_glyph; /* the first glyph in nodes glyphstring that we render */
   guint                num_glyphs; /* number of *non-empty* glyphs (== instances) we render */
-  float                scale;
+  guint                cached_glyphs_offset; /* index of the node's first glyph in the pass's cached_glyphs */
 };
 
 struct _GskVulkanOpPushConstants
@@ -112,6 +112,9 @@ struct _GskVulkanRenderPass
   GdkVulkanContext *vulkan;
 
   GArray *render_ops;
+  /* the glyph cache entries of all glyphs of the text ops, looked up when
+   * adding the nodes so collecting the vertex data doesn't touch the cache */
+  GPtrArray *cached_glyphs;
 
   GskVulkanImage *target;
   int scale_factor;
@@ -124,6 +127,9 @@ struct _GskVulkanRenderPass
   VkSemaphore signal_semaphore;
   GArray *wait_semaphores;
   GskVulkanBuffer *vertex_data;
+  guchar *vertex_map; /* until the vertex data has been collected */
+  gsize vertex_size;
+  VkFramebuffer framebuffer;
 
   GQuark fallback_pixels;
   GQuark texture_pixels;
@@ -144,6 +150,7 @@ gsk_vulkan_render_pass_new (GdkVulkanContext  *context,
   self = g_slice_new0 (GskVulkanRenderPass);
   self->vulkan = g_object_ref (context);
   self->render_ops = g_array_new (FALSE, FALSE, sizeof (GskVulkanOp));
+  self->cached_glyphs = g_ptr_array_new ();
 
   self->target = g_object_ref (target);
   self->scale_factor = scale_factor;
@@ -217,14 +224,13 @@ void
 gsk_vulkan_render_pass_free (GskVulkanRenderPass *self)
 {
   g_array_unref (self->render_ops);
+  g_ptr_array_unref (self->cached_glyphs);
   g_object_unref (self->vulkan);
   g_object_unref (self->target);
   cairo_region_destroy (self->clip);
   vkDestroyRenderPass (gdk_vulkan_context_get_device (self->vulkan),
                        self->render_pass,
                        NULL);
-  if (self->vertex_data)
-    gsk_vulkan_buffer_free (self->vertex_data);
   if (self->signal_semaphore != VK_NULL_HANDLE)
     vkDestroySemaphore (gdk_vulkan_context_get_device (self->vulkan),
                         self->signal_semaphore,
@@ -368,7 +374,6 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
         guint num_glyphs = gsk_text_node_get_num_glyphs (node);
         int i;
         guint count;
-        guint texture_index;
         GskVulkanRenderer *renderer = GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render));
 
         if (font_has_color_glyphs (font))
@@ -399,13 +404,18 @@ gsk_vulkan_render_pass_add_node (GskVulkanRenderPass           *self,
 
         op.text.start_glyph = 0;
         op.text.texture_index = G_MAXUINT;
-        op.text.scale = self->scale_factor;
+        op.text.cached_glyphs_offset = self->cached_glyphs->len;
 
         for (i = 0, count = 0; i < num_glyphs; i++)
           {
             const PangoGlyphInfo *gi = &glyphs[i];
+            GskVulkanCachedGlyph *cached;
+            guint texture_index;
 
-            texture_index = gsk_vulkan_renderer_cache_glyph (renderer, (PangoFont *)font, gi->glyph, op.text.scale);
+            cached = gsk_vulkan_renderer_cache_glyph (renderer, (PangoFont *)font, gi->glyph, self->scale_factor);
+            g_ptr_array_add (self->cached_glyphs, cached);
+
+            texture_index = cached->texture_index;
             if (op.text.texture_index == G_MAXUINT)
               op.text.texture_index = texture_index;
             if (texture_index != op.text.texture_index)
@@ -1209,17 +1219,15 @@ gsk_vulkan_render_pass_collect_vertex_data (GskVulkanRenderPass *self,
             op->text.vertex_offset = offset + n_bytes;
             gsk_vulkan_text_pipeline_collect_vertex_data (GSK_VULKAN_TEXT_PIPELINE (op->text.pipeline),
                                                           data + n_bytes + offset,
-                                                          GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render)),
                                                           &op->text.node->bounds,
-                                                          (PangoFont *)gsk_text_node_peek_font (op->text.node),
                                                           gsk_text_node_get_num_glyphs (op->text.node),
                                                           gsk_text_node_peek_glyphs (op->text.node),
+                                                          (GskVulkanCachedGlyph **) &g_ptr_array_index (self->cached_glyphs, op->text.cached_glyphs_offset),
                                                           gsk_text_node_peek_color (op->text.node),
                                                           gsk_text_node_get_x (op->text.node),
                                                           gsk_text_node_get_y (op->text.node),
                                                           op->text.start_glyph,
-                                                          op->text.num_glyphs,
-                                                          op->text.scale);
+                                                          op->text.num_glyphs);
             n_bytes += op->text.vertex_count;
           }
           break;
@@ -1229,16 +1237,14 @@ gsk_vulkan_render_pass_collect_vertex_data (GskVulkanRenderPass *self,
             op->text.vertex_offset = offset + n_bytes;
             gsk_vulkan_color_text_pipeline_collect_vertex_data (GSK_VULKAN_COLOR_TEXT_PIPELINE (op->text.pipeline),
                                                                 data + n_bytes + offset,
-                                                                GSK_VULKAN_RENDERER (gsk_vulkan_render_get_renderer (render)),
                                                                 &op->text.node->bounds,
-                                                                (PangoFont *)gsk_text_node_peek_font (op->text.node),
                                                                 gsk_text_node_get_num_glyphs (op->text.node),
                                                                 gsk_text_node_peek_glyphs (op->text.node),
+                                                                (GskVulkanCachedGlyph **) &g_ptr_array_index (self->cached_glyphs, op->text.cached_glyphs_offset),
                                                                 gsk_text_node_get_x (op->text.node),
                                                                 gsk_text_node_get_y (op->text.node),
                                                                 op->text.start_glyph,
-                                                                op->text.num_glyphs,
-                                                                op->text.scale);
+                                                                op->text.num_glyphs);
             n_bytes += op->text.vertex_count;
           }
           break;
@@ -1399,23 +1405,19 @@ gsk_vulkan_render_pass_collect_vertex_data (GskVulkanRenderPass *self,
   return n_bytes;
 }
 
-static GskVulkanBuffer *
-gsk_vulkan_render_pass_get_vertex_data (GskVulkanRenderPass *self,
-                                        GskVulkanRender     *render)
+/* Does everything that drawing needs which touches state shared with other
+ * passes, so that gsk_vulkan_render_pass_draw() can run on any thread.
+ * Collecting the vertex data happens there, it only reads the pass and the
+ * glyphs that were looked up when the text nodes were added. */
+void
+gsk_vulkan_render_pass_prepare_draw (GskVulkanRenderPass *self,
+                                     GskVulkanRender     *render)
 {
-  if (self->vertex_data == NULL)
-    {
-      gsize n_bytes;
-      guchar *data;
-
-      n_bytes = gsk_vulkan_render_pass_count_vertex_data (self);
-      self->vertex_data = gsk_vulkan_buffer_new (self->vulkan, n_bytes);
-      data = gsk_vulkan_buffer_map (self->vertex_data);
-      gsk_vulkan_render_pass_collect_vertex_data (self, render, data, 0, n_bytes);
-      gsk_vulkan_buffer_unmap (self->vertex_data);
-    }
+  self->vertex_size = gsk_vulkan_render_pass_count_vertex_data (self);
+  self->vertex_data = gsk_vulkan_render_get_vertex_buffer (render, self->vertex_size);
+  self->vertex_map = gsk_vulkan_buffer_map (self->vertex_data);
 
-  return self->vertex_data;
+  self->framebuffer = gsk_vulkan_render_get_framebuffer (render, self->target);
 }
 
 gsize
@@ -1502,9 +1504,7 @@ gsk_vulkan_render_pass_draw_rect (GskVulkanRenderPass     *self,
   gsize current_draw_index = 0;
   GskVulkanOp *op;
   guint i, step;
-  GskVulkanBuffer *vertex_buffer;
-
-  vertex_buffer = gsk_vulkan_render_pass_get_vertex_data (self, render);
+  GskVulkanBuffer *vertex_buffer = self->vertex_data;
 
   for (i = 0; i < self->render_ops->len; i += step)
     {
@@ -1877,6 +1877,12 @@ gsk_vulkan_render_pass_draw (GskVulkanRenderPass     *self,
 {
   guint i;
 
+  g_assert (self->vertex_map != NULL);
+
+  gsk_vulkan_render_pass_collect_vertex_data (self, render, self->vertex_map, 0, self->vertex_size);
+  gsk_vulkan_buffer_unmap (self->vertex_data);
+  self->vertex_map = NULL;
+
   vkCmdSetViewport (command_buffer,
                     0,
                     1,
@@ -1907,7 +1913,7 @@ gsk_vulkan_render_pass_draw (GskVulkanRenderPass     *self,
                             &(VkRenderPassBeginInfo) {
                                 .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
                                 .renderPass = self->render_pass,
-                                .framebuffer = gsk_vulkan_render_get_framebuffer (render, self->target),
+                                .framebuffer = self->framebuffer,
                                 .renderArea = { 
                                     { rect.x * self->scale_factor, rect.y * self->scale_factor },
                                     { rect.width * self->scale_factor, rect.height * self->scale_factor }
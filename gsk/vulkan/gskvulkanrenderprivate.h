@@ -4,6 +4,7 @@
 #include <gdk/gdk.h>
 #include <gsk/gskrendernode.h>
 
+#include "gskvulkanbufferprivate.h"
 #include "gskvulkanimageprivate.h"
 #include "gskvulkanpipelineprivate.h"
 #include "gskvulkanrenderpassprivate.h"
@@ -66,6 +67,9 @@ GskRenderer *           gsk_vulkan_render_get_renderer                  (GskVulk
 void                    gsk_vulkan_render_add_cleanup_image             (GskVulkanRender        *self,
                                                                          GskVulkanImage         *image);
 
+GskVulkanBuffer *       gsk_vulkan_render_get_vertex_buffer             (GskVulkanRender        *self,
+                                                                         gsize                   size);
+
 void                    gsk_vulkan_render_add_node                      (GskVulkanRender        *self,
                                                                          GskRenderNode          *node);
 
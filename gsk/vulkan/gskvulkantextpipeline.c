@@ -102,17 +102,15 @@ gsk_vulkan_text_pipeline_count_vertex_data (GskVulkanTextPipeline *pipeline,
 void
 gsk_vulkan_text_pipeline_collect_vertex_data (GskVulkanTextPipeline  *pipeline,
                                               guchar                 *data,
-                                              GskVulkanRenderer      *renderer,
                                               const graphene_rect_t  *rect,
-                                              PangoFont              *font,
                                               guint                   total_glyphs,
                                               const PangoGlyphInfo   *glyphs,
+                                              GskVulkanCachedGlyph  **cached_glyphs,
                                               const GdkRGBA          *color,
                                               float                   x,
                                               float                   y,
                                               guint                   start_glyph,
-                                              guint                   num_glyphs,
-                                              float                   scale)
+                                              guint                   num_glyphs)
 {
   GskVulkanTextInstance *instances = (GskVulkanTextInstance *) data;
   int i;
@@ -131,9 +129,7 @@ gsk_vulkan_text_pipeline_collect_vertex_data (GskVulkanTextPipeline  *pipeline,
           double cx = (double)(x_position + gi->geometry.x_offset) / PANGO_SCALE;
           double cy = (double)(gi->geometry.y_offset) / PANGO_SCALE;
           GskVulkanTextInstance *instance = &instances[count];
-          GskVulkanCachedGlyph *glyph;
-
-          glyph = gsk_vulkan_renderer_get_cached_glyph (renderer, font, gi->glyph, scale);
+          GskVulkanCachedGlyph *glyph = cached_glyphs[i];
 
           instance->tex_rect[0] = glyph->tx;
           instance->tex_rect[1] = glyph->ty;
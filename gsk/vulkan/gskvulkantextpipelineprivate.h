@@ -23,17 +23,15 @@ gsize                   gsk_vulkan_text_pipeline_count_vertex_data     (GskVulka
                                                                         int                            num_instances);
 void                    gsk_vulkan_text_pipeline_collect_vertex_data   (GskVulkanTextPipeline         *pipeline,
                                                                         guchar                         *data,
-                                                                        GskVulkanRenderer              *renderer,
                                                                         const graphene_rect_t          *rect,
-                                                                        PangoFont                      *font,
                                                                         guint                           total_glyphs,
                                                                         const PangoGlyphInfo           *glyphs,
+                                                                        GskVulkanCachedGlyph          **cached_glyphs,
                                                                         const GdkRGBA                  *color,
                                                                         float                           x,
                                                                         float                           y,
                                                                         guint                           start_glyph,
-                                                                        guint                           num_glyphs,
-                                                                        float                           scale);
+                                                                        guint                           num_glyphs);
 gsize                   gsk_vulkan_text_pipeline_draw                  (GskVulkanTextPipeline         *pipeline,
                                                                         VkCommandBuffer                 command_buffer,
                                                                         gsize                           offset,
@@ -145,6 +145,15 @@ gtk_css_animated_style_set_animated_value (GtkCssAnimatedStyle *style,
 
 }
 
+gboolean
+gtk_css_animated_style_has_animated_value (GtkCssAnimatedStyle *style,
+                                           guint                id)
+{
+  return style->animated_values &&
+         id < style->animated_values->len &&
+         g_ptr_array_index (style->animated_values, id) != NULL;
+}
+
 GtkCssValue *
 gtk_css_animated_style_get_intrinsic_value (GtkCssAnimatedStyle *style,
                                             guint                id)
@@ -64,6 +64,8 @@ GtkCssStyle *           gtk_css_animated_style_new_advance      (GtkCssAnimatedS
 void                    gtk_css_animated_style_set_animated_value(GtkCssAnimatedStyle   *style,
                                                                  guint                   id,
                                                                  GtkCssValue            *value);
+gboolean                gtk_css_animated_style_has_animated_value(GtkCssAnimatedStyle   *style,
+                                                                 guint                   id);
                                                                         
 GtkCssValue *           gtk_css_animated_style_get_intrinsic_value (GtkCssAnimatedStyle *style,
                                                                  guint                   id);
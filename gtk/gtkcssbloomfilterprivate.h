@@ -0,0 +1,110 @@
+/* GTK - The GIMP Toolkit
+ * Copyright (C) 2019 Red Hat Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __GTK_CSS_BLOOM_FILTER_PRIVATE_H__
+#define __GTK_CSS_BLOOM_FILTER_PRIVATE_H__
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A counting Bloom filter over names, classes and ids. Keys can be
+ * removed again, which lets the filter follow a walk down the node tree.
+ * Lookups can give false positives but never false negatives.
+ *
+ * Every key sets two counters, picked from the two halves of its hash.
+ * Counters that overflow stay saturated forever, as we no longer know
+ * when they could go back to 0.
+ */
+#define GTK_CSS_BLOOM_FILTER_BITS 12
+#define GTK_CSS_BLOOM_FILTER_SIZE (1 << GTK_CSS_BLOOM_FILTER_BITS)
+#define GTK_CSS_BLOOM_FILTER_MASK (GTK_CSS_BLOOM_FILTER_SIZE - 1)
+
+typedef struct _GtkCssBloomFilter GtkCssBloomFilter;
+
+struct _GtkCssBloomFilter {
+  guint8 counters[GTK_CSS_BLOOM_FILTER_SIZE];
+};
+
+/* The MurmurHash3 finalizer, so both halves of the result are usable */
+static inline guint
+gtk_css_bloom_filter_mix (guint key)
+{
+  key ^= key >> 16;
+  key *= 0x85ebca6b;
+  key ^= key >> 13;
+  key *= 0xc2b2ae35;
+  key ^= key >> 16;
+
+  return key;
+}
+
+static inline guint
+gtk_css_bloom_filter_hash_name (/*interned*/ const char *name)
+{
+  return gtk_css_bloom_filter_mix (GPOINTER_TO_UINT (name));
+}
+
+static inline guint
+gtk_css_bloom_filter_hash_id (/*interned*/ const char *id)
+{
+  return gtk_css_bloom_filter_mix (GPOINTER_TO_UINT (id) ^ 0x5bd1e995);
+}
+
+static inline guint
+gtk_css_bloom_filter_hash_class (GQuark style_class)
+{
+  return gtk_css_bloom_filter_mix (style_class * 0x9e3779b1);
+}
+
+static inline void
+gtk_css_bloom_filter_add (GtkCssBloomFilter *filter,
+                          guint              hash)
+{
+  guint8 *first = &filter->counters[hash & GTK_CSS_BLOOM_FILTER_MASK];
+  guint8 *second = &filter->counters[(hash >> 16) & GTK_CSS_BLOOM_FILTER_MASK];
+
+  if (*first < G_MAXUINT8)
+    (*first)++;
+  if (*second < G_MAXUINT8)
+    (*second)++;
+}
+
+static inline void
+gtk_css_bloom_filter_remove (GtkCssBloomFilter *filter,
+                             guint              hash)
+{
+  guint8 *first = &filter->counters[hash & GTK_CSS_BLOOM_FILTER_MASK];
+  guint8 *second = &filter->counters[(hash >> 16) & GTK_CSS_BLOOM_FILTER_MASK];
+
+  if (*first < G_MAXUINT8)
+    (*first)--;
+  if (*second < G_MAXUINT8)
+    (*second)--;
+}
+
+static inline gboolean
+gtk_css_bloom_filter_may_contain (const GtkCssBloomFilter *filter,
+                                  guint                    hash)
+{
+  return filter->counters[hash & GTK_CSS_BLOOM_FILTER_MASK] != 0 &&
+         filter->counters[(hash >> 16) & GTK_CSS_BLOOM_FILTER_MASK] != 0;
+}
+
+G_END_DECLS
+
+#endif /* __GTK_CSS_BLOOM_FILTER_PRIVATE_H__ */
@@ -219,6 +219,11 @@ gtk_css_font_size_get_default_px (GtkStyleProvider *provider,
   if (settings == NULL)
     return DEFAULT_FONT_SIZE_PT * get_dpi (style) / 72.0;
 
+  /* Reading the font size may update GtkSettings from the display and
+   * notify, the style gets thrown away anyway */
+  if (_gtk_css_value_compute_must_defer ())
+    return DEFAULT_FONT_SIZE_PT * get_dpi (style) / 72.0;
+
   font_size = gtk_settings_get_font_size (settings);
   if (font_size == 0)
     return DEFAULT_FONT_SIZE_PT * get_dpi (style) / 72.0;
@@ -79,6 +79,10 @@ gtk_css_value_icon_theme_compute (GtkCssValue      *icon_theme,
 {
   GtkIconTheme *icontheme;
 
+  /* Icon themes are created on demand and get a signal connected */
+  if (_gtk_css_value_compute_must_defer ())
+    return _gtk_css_value_ref (icon_theme);
+
   if (icon_theme->icontheme)
     icontheme = icon_theme->icontheme;
   else
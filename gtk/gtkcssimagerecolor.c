@@ -217,6 +217,10 @@ gtk_css_image_recolor_compute (GtkCssImage      *image,
   int scale;
   GError *error = NULL;
 
+  /* Loading writes to @recolor and may emit an error */
+  if (_gtk_css_value_compute_must_defer ())
+    return g_object_ref (image);
+
   scale = gtk_style_provider_get_scale (provider);
 
   if (recolor->palette)
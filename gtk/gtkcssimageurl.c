@@ -130,6 +130,10 @@ gtk_css_image_url_compute (GtkCssImage      *image,
   GtkCssImage *copy;
   GError *error = NULL;
 
+  /* Loading writes to @url and may emit an error */
+  if (_gtk_css_value_compute_must_defer ())
+    return g_object_ref (image);
+
   copy = gtk_css_image_url_load_image (url, &error);
   if (error)
     {
@@ -49,6 +49,8 @@ gtk_css_value_initial_compute (GtkCssValue      *value,
   switch (property_id)
     {
     case GTK_CSS_PROPERTY_DPI:
+      if (_gtk_css_value_compute_must_defer ())
+        return _gtk_css_value_ref (value);
       settings = gtk_style_provider_get_settings (provider);
       if (settings)
         {
@@ -62,6 +64,8 @@ gtk_css_value_initial_compute (GtkCssValue      *value,
       break;
 
     case GTK_CSS_PROPERTY_FONT_FAMILY:
+      if (_gtk_css_value_compute_must_defer ())
+        return _gtk_css_value_ref (value);
       settings = gtk_style_provider_get_settings (provider);
       if (settings && gtk_settings_get_font_family (settings) != NULL)
         return _gtk_css_array_value_new (_gtk_css_string_value_new (gtk_settings_get_font_family (settings)));
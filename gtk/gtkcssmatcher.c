@@ -320,11 +320,25 @@ static const GtkCssMatcherClass GTK_CSS_MATCHER_NODE = {
 };
 
 void
-_gtk_css_matcher_node_init (GtkCssMatcher *matcher,
-                            GtkCssNode    *node)
+_gtk_css_matcher_node_init (GtkCssMatcher           *matcher,
+                            GtkCssNode              *node,
+                            const GtkCssBloomFilter *ancestors)
 {
   matcher->node.klass = &GTK_CSS_MATCHER_NODE;
   matcher->node.node = node;
+  matcher->node.ancestors = ancestors;
+}
+
+/* Returns a filter that contains the names, classes and ids of all
+ * the ancestors that get_parent() can reach, or %NULL if that isn't
+ * known. */
+const GtkCssBloomFilter *
+_gtk_css_matcher_get_ancestors (const GtkCssMatcher *matcher)
+{
+  if (matcher->klass != &GTK_CSS_MATCHER_NODE)
+    return NULL;
+
+  return matcher->node.ancestors;
 }
 
 /* GTK_CSS_MATCHER_WIDGET_ANY */
@@ -20,6 +20,7 @@
 
 #include <gtk/gtkenums.h>
 #include <gtk/gtktypes.h>
+#include "gtk/gtkcssbloomfilterprivate.h"
 #include "gtk/gtkcsstypesprivate.h"
 
 G_BEGIN_DECLS
@@ -60,6 +61,7 @@ struct _GtkCssMatcherWidgetPath {
 struct _GtkCssMatcherNode {
   const GtkCssMatcherClass *klass;
   GtkCssNode               *node;
+  const GtkCssBloomFilter  *ancestors;  /* names, classes and ids of all ancestors, or NULL */
 };
 
 struct _GtkCssMatcherSuperset {
@@ -79,12 +81,16 @@ gboolean          _gtk_css_matcher_init           (GtkCssMatcher          *match
                                                    const GtkWidgetPath    *path,
                                                    const GtkCssNodeDeclaration *decl) G_GNUC_WARN_UNUSED_RESULT;
 void              _gtk_css_matcher_node_init      (GtkCssMatcher          *matcher,
-                                                   GtkCssNode             *node);
+                                                   GtkCssNode             *node,
+                                                   const GtkCssBloomFilter *ancestors);
 void              _gtk_css_matcher_any_init       (GtkCssMatcher          *matcher);
 void              _gtk_css_matcher_superset_init  (GtkCssMatcher          *matcher,
                                                    const GtkCssMatcher    *subset,
                                                    GtkCssChange            relevant);
 
+const GtkCssBloomFilter *
+                  _gtk_css_matcher_get_ancestors  (const GtkCssMatcher    *matcher);
+
 
 static inline gboolean
 _gtk_css_matcher_get_parent (GtkCssMatcher       *matcher,
@@ -20,11 +20,13 @@
 #include "gtkcssnodeprivate.h"
 
 #include "gtkcssanimatedstyleprivate.h"
+#include "gtkcsspathnodeprivate.h"
 #include "gtkcsssectionprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 #include "gtkintl.h"
 #include "gtkmarshalers.h"
 #include "gtksettingsprivate.h"
+#include "gtkstyleproviderprivate.h"
 #include "gtktypebuiltins.h"
 
 /*
@@ -238,6 +240,7 @@ gtk_css_node_dispose (GObject *object)
   gtk_css_node_set_invalid (cssnode, FALSE);
   
   g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
+  g_clear_object (&cssnode->prefetched_style);
 
   G_OBJECT_CLASS (gtk_css_node_parent_class)->dispose (object);
 }
@@ -364,11 +367,16 @@ gtk_css_node_create_style (GtkCssNode *cssnode)
 
   style = lookup_in_global_parent_cache (cssnode, decl);
   if (style)
-    return g_object_ref (style);
+    {
+      g_clear_object (&cssnode->prefetched_style);
+      return g_object_ref (style);
+    }
 
   parent = cssnode->parent ? cssnode->parent->style : NULL;
 
-  if (gtk_css_node_init_matcher (cssnode, &matcher))
+  if (cssnode->prefetched_style)
+    style = g_steal_pointer (&cssnode->prefetched_style);
+  else if (gtk_css_node_init_matcher (cssnode, &matcher))
     style = gtk_css_static_style_new_compute (gtk_css_node_get_style_provider (cssnode),
                                               &matcher,
                                               parent);
@@ -459,6 +467,156 @@ gtk_css_node_real_update_style (GtkCssNode   *cssnode,
   return new_style;
 }
 
+/* While validating, the names, classes and ids of the nodes on the path
+ * from the root to the node being styled are kept in a counting Bloom
+ * filter. The matcher hands it to the selector tree, which uses it to
+ * skip rules that need an ancestor with a name, class or id that no
+ * ancestor has, without walking up the tree. The filter only gets used
+ * for the children of the innermost node in it, as long as nothing on
+ * that path changed its name, classes, id or parent.
+ */
+typedef struct _AncestorFilter AncestorFilter;
+
+struct _AncestorFilter {
+  GtkCssBloomFilter filter;
+  GPtrArray        *nodes;          /* the nodes in the filter, outermost first */
+  GArray           *keys;           /* the keys that were added, in order */
+  GArray           *n_keys;         /* how many keys each node added */
+  gboolean          stale;          /* a node on the path changed, the filter can't be trusted */
+};
+
+static AncestorFilter *ancestor_filter = NULL;
+
+static void
+ancestor_filter_add_key (AncestorFilter *af,
+                         guint           key)
+{
+  gtk_css_bloom_filter_add (&af->filter, key);
+  g_array_append_val (af->keys, key);
+}
+
+static void
+ancestor_filter_push (AncestorFilter *af,
+                      GtkCssNode     *cssnode)
+{
+  const GQuark *classes;
+  const char *name, *id;
+  guint i, n_classes, n_keys;
+
+  /* Those get matched with their widget path, which has other ancestors */
+  if (GTK_IS_CSS_PATH_NODE (cssnode))
+    af->stale = TRUE;
+
+  n_keys = af->keys->len;
+
+  name = gtk_css_node_get_name (cssnode);
+  if (name)
+    ancestor_filter_add_key (af, gtk_css_bloom_filter_hash_name (name));
+
+  id = gtk_css_node_get_id (cssnode);
+  if (id)
+    ancestor_filter_add_key (af, gtk_css_bloom_filter_hash_id (id));
+
+  classes = gtk_css_node_declaration_get_classes (cssnode->decl, &n_classes);
+  for (i = 0; i < n_classes; i++)
+    ancestor_filter_add_key (af, gtk_css_bloom_filter_hash_class (classes[i]));
+
+  n_keys = af->keys->len - n_keys;
+  g_array_append_val (af->n_keys, n_keys);
+  g_ptr_array_add (af->nodes, cssnode);
+}
+
+static void
+ancestor_filter_pop (AncestorFilter *af)
+{
+  guint i, n_keys;
+
+  n_keys = g_array_index (af->n_keys, guint, af->n_keys->len - 1);
+  g_array_set_size (af->n_keys, af->n_keys->len - 1);
+
+  /* Remove what was added, the node may have changed since */
+  for (i = af->keys->len - n_keys; i < af->keys->len; i++)
+    gtk_css_bloom_filter_remove (&af->filter, g_array_index (af->keys, guint, i));
+  g_array_set_size (af->keys, af->keys->len - n_keys);
+
+  g_ptr_array_set_size (af->nodes, af->nodes->len - 1);
+}
+
+static void
+ancestor_filter_push_ancestors (AncestorFilter *af,
+                                GtkCssNode     *cssnode)
+{
+  if (cssnode == NULL)
+    return;
+
+  ancestor_filter_push_ancestors (af, cssnode->parent);
+  ancestor_filter_push (af, cssnode);
+}
+
+static AncestorFilter *
+ancestor_filter_new (GtkCssNode *root)
+{
+  AncestorFilter *af;
+
+  af = g_new0 (AncestorFilter, 1);
+  af->nodes = g_ptr_array_new ();
+  af->keys = g_array_new (FALSE, FALSE, sizeof (guint));
+  af->n_keys = g_array_new (FALSE, FALSE, sizeof (guint));
+
+  /* Validation doesn't necessarily start at the root */
+  ancestor_filter_push_ancestors (af, root->parent);
+
+  return af;
+}
+
+static void
+ancestor_filter_free (AncestorFilter *af)
+{
+  g_ptr_array_unref (af->nodes);
+  g_array_unref (af->keys);
+  g_array_unref (af->n_keys);
+  g_free (af);
+}
+
+/* Called when @cssnode changes in a way that changes the keys it adds
+ * to the filter, or the ancestors of its children */
+static void
+gtk_css_node_ancestors_changed (GtkCssNode *cssnode)
+{
+  guint i;
+
+  if (ancestor_filter == NULL || ancestor_filter->stale)
+    return;
+
+  for (i = 0; i < ancestor_filter->nodes->len; i++)
+    {
+      if (g_ptr_array_index (ancestor_filter->nodes, i) == cssnode)
+        {
+          ancestor_filter->stale = TRUE;
+          break;
+        }
+    }
+}
+
+static const GtkCssBloomFilter *
+gtk_css_node_get_ancestor_filter (GtkCssNode *cssnode)
+{
+  GtkCssNode *innermost;
+
+  if (ancestor_filter == NULL || ancestor_filter->stale)
+    return NULL;
+
+  if (ancestor_filter->nodes->len > 0)
+    innermost = g_ptr_array_index (ancestor_filter->nodes, ancestor_filter->nodes->len - 1);
+  else
+    innermost = NULL;
+
+  if (cssnode->parent != innermost)
+    return NULL;
+
+  return &ancestor_filter->filter;
+}
+
 static void
 gtk_css_node_real_invalidate (GtkCssNode *node)
 {
@@ -483,7 +641,7 @@ static gboolean
 gtk_css_node_real_init_matcher (GtkCssNode     *cssnode,
                                 GtkCssMatcher  *matcher)
 {
-  _gtk_css_matcher_node_init (matcher, cssnode);
+  _gtk_css_matcher_node_init (matcher, cssnode, gtk_css_node_get_ancestor_filter (cssnode));
 
   return TRUE;
 }
@@ -767,6 +925,8 @@ gtk_css_node_reposition (GtkCssNode *node,
 
   if (old_parent != new_parent)
     {
+      gtk_css_node_ancestors_changed (node);
+
       if (old_parent == NULL)
         {
           gtk_css_node_parent_will_be_set (node);
@@ -1267,9 +1427,17 @@ gtk_css_node_get_declaration (GtkCssNode *cssnode)
 void
 gtk_css_node_invalidate_style_provider (GtkCssNode *cssnode)
 {
+  GtkCssMatcher matcher;
   GtkCssNode *child;
 
-  gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+  /* A provider that reloaded only part of its rules can tell us
+   * which nodes it doesn't affect */
+  if (!gtk_css_node_init_matcher (cssnode, &matcher) ||
+      gtk_style_provider_change_affects (gtk_css_node_get_style_provider (cssnode), &matcher))
+    gtk_css_node_invalidate (cssnode, GTK_CSS_CHANGE_SOURCE);
+
+  /* Styles that children looked up in here may be outdated either way */
+  g_clear_pointer (&cssnode->cache, gtk_css_node_style_cache_unref);
 
   for (child = cssnode->first_child;
        child;
@@ -1322,6 +1490,10 @@ gtk_css_node_invalidate (GtkCssNode   *cssnode,
     return;
 
   cssnode->pending_changes |= change;
+  g_clear_object (&cssnode->prefetched_style);
+
+  if (change & (GTK_CSS_CHANGE_NAME | GTK_CSS_CHANGE_ID | GTK_CSS_CHANGE_CLASS))
+    gtk_css_node_ancestors_changed (cssnode);
 
   GTK_CSS_NODE_GET_CLASS (cssnode)->invalidate (cssnode);
 
@@ -1330,6 +1502,319 @@ gtk_css_node_invalidate (GtkCssNode   *cssnode,
   gtk_css_node_invalidate_style (cssnode);
 }
 
+/* Restyling many siblings at once - think of a list with a few thousand
+ * rows after a theme change - is dominated by selector matching and value
+ * computation. Both mostly only read the node tree, the style provider
+ * and the parent's style, so once a node's own style is valid, the static
+ * styles of its children can be computed on a thread pool. They get
+ * parked in prefetched_style and picked up by gtk_css_node_create_style();
+ * the style cache, animations and ::style-changed emission still happen
+ * on the main thread, in the usual order. Any invalidation of a node
+ * drops its prefetched style again.
+ *
+ * Values whose computation has side effects, like url() images that get
+ * loaded and may emit errors, make a worker give up on the style, see
+ * _gtk_css_value_compute_must_defer(). Those styles are computed on the
+ * main thread as usual.
+ */
+#define MIN_PREFETCHED_STYLES 16
+
+typedef struct _StylePrefetch StylePrefetch;
+typedef struct _StylePrefetchGroup StylePrefetchGroup;
+
+struct _StylePrefetch {
+  GtkCssNode       *node;
+  GtkStyleProvider *provider;
+  GtkCssMatcher     matcher;
+  gboolean          has_matcher;
+  GtkCssStyle      *style;
+  GPtrArray        *duplicates;     /* siblings with an equal declaration, or NULL */
+};
+
+struct _StylePrefetchGroup {
+  GPtrArray   *prefetches;
+  GtkCssStyle *parent_style;
+  gint         next;                /* index of the next prefetch to compute */
+  guint        n_pending;           /* worker threads that did not finish yet */
+  GMutex       lock;
+  GCond        cond;
+};
+
+static StylePrefetch *
+style_prefetch_new (GtkCssNode *node)
+{
+  StylePrefetch *prefetch;
+
+  prefetch = g_slice_new0 (StylePrefetch);
+  prefetch->node = node;
+  prefetch->provider = gtk_css_node_get_style_provider (node);
+  prefetch->has_matcher = gtk_css_node_init_matcher (node, &prefetch->matcher);
+
+  return prefetch;
+}
+
+static void
+style_prefetch_free (gpointer data)
+{
+  StylePrefetch *prefetch = data;
+
+  g_clear_object (&prefetch->style);
+  if (prefetch->duplicates)
+    g_ptr_array_unref (prefetch->duplicates);
+
+  g_slice_free (StylePrefetch, prefetch);
+}
+
+static void
+style_prefetch_group_run (StylePrefetchGroup *group)
+{
+  guint i;
+
+  while ((i = g_atomic_int_add (&group->next, 1)) < group->prefetches->len)
+    {
+      StylePrefetch *prefetch = g_ptr_array_index (group->prefetches, i);
+      gboolean deferred;
+
+      _gtk_css_value_compute_begin_threaded (&deferred);
+      prefetch->style = gtk_css_static_style_new_compute (prefetch->provider,
+                                                          prefetch->has_matcher ? &prefetch->matcher : NULL,
+                                                          group->parent_style);
+      _gtk_css_value_compute_end_threaded ();
+
+      /* Some values can only be computed on the main thread, leave the
+       * whole style to gtk_css_node_create_style() */
+      if (deferred)
+        g_clear_object (&prefetch->style);
+    }
+}
+
+static void
+style_prefetch_thread_func (gpointer data,
+                            gpointer user_data)
+{
+  StylePrefetchGroup *group = data;
+
+  style_prefetch_group_run (group);
+
+  g_mutex_lock (&group->lock);
+  group->n_pending--;
+  if (group->n_pending == 0)
+    g_cond_signal (&group->cond);
+  g_mutex_unlock (&group->lock);
+}
+
+static GThreadPool *
+get_style_prefetch_pool (void)
+{
+  static GThreadPool *pool = NULL;
+
+  if (g_once_init_enter (&pool))
+    {
+      GThreadPool *new_pool;
+
+      new_pool = g_thread_pool_new (style_prefetch_thread_func, NULL,
+                                    g_get_num_processors () - 1, FALSE, NULL);
+
+      g_once_init_leave (&pool, new_pool);
+    }
+
+  return pool;
+}
+
+/* Computes the styles of all prefetches in @group, using the calling
+ * thread and the thread pool. Blocks until all are done. */
+static void
+style_prefetch_group_compute (StylePrefetchGroup *group)
+{
+  GThreadPool *pool;
+  guint i, n_workers;
+
+  pool = get_style_prefetch_pool ();
+  n_workers = MIN (g_get_num_processors () - 1, group->prefetches->len - 1);
+
+  group->next = 0;
+  group->n_pending = n_workers;
+
+  for (i = 0; i < n_workers; i++)
+    g_thread_pool_push (pool, group, NULL);
+
+  style_prefetch_group_run (group);
+
+  g_mutex_lock (&group->lock);
+  while (group->n_pending > 0)
+    g_cond_wait (&group->cond, &group->lock);
+  g_mutex_unlock (&group->lock);
+}
+
+static gboolean
+is_in_global_parent_cache (GtkCssNode *node)
+{
+  GtkCssNodeStyleCache *cache;
+
+  if (node->parent->cache == NULL ||
+      !may_use_global_parent_cache (node))
+    return FALSE;
+
+  cache = gtk_css_node_style_cache_lookup (node->parent->cache,
+                                           gtk_css_node_get_declaration (node),
+                                           gtk_css_node_is_first_child (node),
+                                           gtk_css_node_is_last_child (node));
+  if (cache == NULL)
+    return FALSE;
+
+  gtk_css_node_style_cache_unref (cache);
+
+  return TRUE;
+}
+
+/* Styles that do not depend on siblings are what the global parent cache
+ * would hand to all children with an equal declaration, so they can be
+ * shared. This mirrors may_be_stored_in_cache() in gtkcssnodestylecache.c.
+ */
+static gboolean
+style_prefetch_is_shareable (StylePrefetch *prefetch)
+{
+  GtkCssChange change;
+
+  change = gtk_css_static_style_get_change (GTK_CSS_STATIC_STYLE (prefetch->style));
+
+  return (change & (GTK_CSS_CHANGE_ANY_SIBLING | GTK_CSS_CHANGE_NTH_CHILD | GTK_CSS_CHANGE_NTH_LAST_CHILD)) == 0;
+}
+
+static void
+gtk_css_node_prefetch_child_styles (GtkCssNode *cssnode)
+{
+  StylePrefetchGroup group;
+  GHashTable *shared;
+  GPtrArray *retry;
+  GtkCssNode *child;
+  guint i, j, n_children;
+
+  if (g_get_num_processors () < 2)
+    return;
+
+  n_children = 0;
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      if (child->visible && child->invalid && child->style_is_invalid)
+        n_children++;
+    }
+
+  if (n_children < MIN_PREFETCHED_STYLES)
+    return;
+
+  group.prefetches = g_ptr_array_new_with_free_func (style_prefetch_free);
+  group.parent_style = cssnode->style;
+  g_mutex_init (&group.lock);
+  g_cond_init (&group.cond);
+
+  /* Children with equal declarations that may share a cached style only
+   * get computed once; the first and last child are never shared because
+   * the cache keys on those positions. */
+  shared = g_hash_table_new (gtk_css_node_declaration_hash,
+                             gtk_css_node_declaration_equal);
+
+  for (child = gtk_css_node_get_first_child (cssnode);
+       child;
+       child = gtk_css_node_get_next_sibling (child))
+    {
+      const GtkCssNodeDeclaration *decl;
+      StylePrefetch *prefetch;
+
+      if (!child->visible || !child->invalid || !child->style_is_invalid ||
+          child->prefetched_style != NULL ||
+          !gtk_css_style_needs_recreation (child->style, child->pending_changes) ||
+          is_in_global_parent_cache (child))
+        continue;
+
+      decl = gtk_css_node_get_declaration (child);
+
+      if (may_use_global_parent_cache (child) &&
+          !gtk_css_node_is_first_child (child) &&
+          !gtk_css_node_is_last_child (child))
+        {
+          prefetch = g_hash_table_lookup (shared, decl);
+          if (prefetch)
+            {
+              if (prefetch->duplicates == NULL)
+                prefetch->duplicates = g_ptr_array_new ();
+              g_ptr_array_add (prefetch->duplicates, child);
+              continue;
+            }
+
+          prefetch = style_prefetch_new (child);
+          g_hash_table_insert (shared, (gpointer) decl, prefetch);
+        }
+      else
+        {
+          prefetch = style_prefetch_new (child);
+        }
+
+      g_ptr_array_add (group.prefetches, prefetch);
+    }
+
+  g_hash_table_unref (shared);
+
+  if (group.prefetches->len > 0)
+    style_prefetch_group_compute (&group);
+
+  retry = NULL;
+
+  for (i = 0; i < group.prefetches->len; i++)
+    {
+      StylePrefetch *prefetch = g_ptr_array_index (group.prefetches, i);
+
+      if (prefetch->style == NULL)
+        continue;
+
+      prefetch->node->prefetched_style = g_object_ref (prefetch->style);
+
+      if (prefetch->duplicates == NULL)
+        continue;
+
+      if (style_prefetch_is_shareable (prefetch))
+        {
+          for (j = 0; j < prefetch->duplicates->len; j++)
+            {
+              child = g_ptr_array_index (prefetch->duplicates, j);
+              child->prefetched_style = g_object_ref (prefetch->style);
+            }
+        }
+      else
+        {
+          /* The style depends on the position, so every sibling needs
+           * its own one after all. */
+          if (retry == NULL)
+            retry = g_ptr_array_new_with_free_func (style_prefetch_free);
+          for (j = 0; j < prefetch->duplicates->len; j++)
+            g_ptr_array_add (retry, style_prefetch_new (g_ptr_array_index (prefetch->duplicates, j)));
+        }
+    }
+
+  g_ptr_array_unref (group.prefetches);
+
+  if (retry)
+    {
+      group.prefetches = retry;
+      style_prefetch_group_compute (&group);
+
+      for (i = 0; i < group.prefetches->len; i++)
+        {
+          StylePrefetch *prefetch = g_ptr_array_index (group.prefetches, i);
+
+          if (prefetch->style)
+            prefetch->node->prefetched_style = g_object_ref (prefetch->style);
+        }
+
+      g_ptr_array_unref (group.prefetches);
+    }
+
+  g_mutex_clear (&group.lock);
+  g_cond_clear (&group.cond);
+}
+
 static void
 gtk_css_node_validate_internal (GtkCssNode *cssnode,
                                 gint64      timestamp)
@@ -1348,6 +1833,10 @@ gtk_css_node_validate_internal (GtkCssNode *cssnode,
 
   GTK_CSS_NODE_GET_CLASS (cssnode)->validate (cssnode);
 
+  ancestor_filter_push (ancestor_filter, cssnode);
+
+  gtk_css_node_prefetch_child_styles (cssnode);
+
   for (child = gtk_css_node_get_first_child (cssnode);
        child;
        child = gtk_css_node_get_next_sibling (child))
@@ -1355,16 +1844,26 @@ gtk_css_node_validate_internal (GtkCssNode *cssnode,
       if (child->visible)
         gtk_css_node_validate_internal (child, timestamp);
     }
+
+  ancestor_filter_pop (ancestor_filter);
 }
 
 void
 gtk_css_node_validate (GtkCssNode *cssnode)
 {
+  AncestorFilter *saved_filter;
   gint64 timestamp;
 
   timestamp = gtk_css_node_get_timestamp (cssnode);
 
+  /* validate() vfuncs may validate other trees */
+  saved_filter = ancestor_filter;
+  ancestor_filter = ancestor_filter_new (cssnode);
+
   gtk_css_node_validate_internal (cssnode, timestamp);
+
+  ancestor_filter_free (ancestor_filter);
+  ancestor_filter = saved_filter;
 }
 
 gboolean
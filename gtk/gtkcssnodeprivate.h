@@ -48,6 +48,7 @@ struct _GtkCssNode
   GtkCssNodeDeclaration *decl;
   GtkCssStyle           *style;
   GtkCssNodeStyleCache  *cache;                 /* cache for children to look up styles */
+  GtkCssStyle           *prefetched_style;      /* static style computed ahead of time by a worker thread */
 
   GtkCssChange           pending_changes;       /* changes that accumulated since the style was last computed */
 
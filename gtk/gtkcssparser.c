@@ -132,6 +132,15 @@ _gtk_css_parser_get_position (GtkCssParser *parser)
   return parser->data - parser->line_start;
 }
 
+/* The text that hasn't been parsed yet */
+const char *
+_gtk_css_parser_get_data (GtkCssParser *parser)
+{
+  g_return_val_if_fail (GTK_IS_CSS_PARSER (parser), NULL);
+
+  return parser->data;
+}
+
 static GFile *
 gtk_css_parser_get_base_file (GtkCssParser *parser)
 {
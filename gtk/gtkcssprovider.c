@@ -19,6 +19,12 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <glib/gstdio.h>
+#ifdef _MSC_VER
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
 
 #include <gdk-pixbuf/gdk-pixbuf.h>
 #include <cairo-gobject.h>
@@ -33,6 +39,7 @@
 #include "gtkcsssectionprivate.h"
 #include "gtkcssselectorprivate.h"
 #include "gtkcssshorthandpropertyprivate.h"
+#include "gtkdebug.h"
 #include "gtksettingsprivate.h"
 #include "gtkstyleprovider.h"
 #include "gtkstylecontextprivate.h"
@@ -74,11 +81,18 @@
  *
  * In the same way, GTK+ tries to load a gtk-keys.css file for the current
  * key theme, as defined by #GtkSettings:gtk-key-theme-name.
+ *
+ * Style sheets loaded from files or resources are cached in
+ * `$XDG_CACHE_HOME/gtk-4.0/css`, so they don't need to be fully parsed
+ * again as long as they and the files they import don't change. Cache
+ * files that weren't used in a month are removed. Setting
+ * `GTK_DEBUG=no-css-file-cache` disables this.
  */
 
 
 typedef struct GtkCssRuleset GtkCssRuleset;
 typedef struct _GtkCssScanner GtkCssScanner;
+typedef struct _GtkCssProviderCache GtkCssProviderCache;
 typedef struct _PropertyValue PropertyValue;
 typedef enum ParserScope ParserScope;
 typedef enum ParserSymbol ParserSymbol;
@@ -106,6 +120,33 @@ struct _GtkCssScanner
   GtkCssSection *section;
   GtkCssScanner *parent;
   GSList *state;
+  guint source;
+};
+
+#define GTK_CSS_PROVIDER_CACHE_VERSION (1)
+/* Cache version, GTK version, files read as (uri, checksum),
+ * declarations, color definitions and keyframes as (file, name, text)
+ * and rulesets as (selectors, declarations). */
+#define GTK_CSS_PROVIDER_CACHE_TYPE "(usa(ss)a(uss)a(uss)a(uss)a(aa(usuii)au))"
+
+/* Cache files that weren't used for a month are removed, and only
+ * the most recently used ones are kept. Loading a cache file touches it. */
+#define GTK_CSS_PROVIDER_CACHE_MAX_AGE (30 * 24 * 60 * 60)
+#define GTK_CSS_PROVIDER_CACHE_MAX_FILES 64
+
+/* What we collect while parsing to write the cache file. Values can't be
+ * serialized, so we keep the text of each declaration instead and only
+ * store every distinct one once. */
+struct _GtkCssProviderCache
+{
+  GVariantBuilder *sources;
+  guint n_sources;
+  GHashTable *declaration_ids;
+  GVariantBuilder *declarations;
+  GVariantBuilder *colors;
+  GVariantBuilder *keyframes;
+  GVariantBuilder *rulesets;
+  GArray *ruleset_declarations;
 };
 
 struct _GtkCssProviderPrivate
@@ -119,6 +160,11 @@ struct _GtkCssProviderPrivate
   GtkCssSelectorTree *tree;
   GResource *resource;
   gchar *path;
+
+  GtkCssProviderCache *cache;     /* only while loading a cacheable file */
+
+  GtkCssSelectorTree *changes;    /* only while emitting ::changed for a reload */
+  guint keep_selectors : 1;
 };
 
 enum {
@@ -312,6 +358,117 @@ gtk_css_ruleset_add (GtkCssRuleset       *ruleset,
     ruleset->styles[i].section = NULL;
 }
 
+/* Takes ownership of @value and splits it up if @property is a shorthand */
+static void
+gtk_css_ruleset_add_declaration (GtkCssRuleset    *ruleset,
+                                 GtkStyleProperty *property,
+                                 GtkCssValue      *value,
+                                 GtkCssSection    *section)
+{
+  if (GTK_IS_CSS_SHORTHAND_PROPERTY (property))
+    {
+      GtkCssShorthandProperty *shorthand = GTK_CSS_SHORTHAND_PROPERTY (property);
+      guint i;
+
+      for (i = 0; i < _gtk_css_shorthand_property_get_n_subproperties (shorthand); i++)
+        {
+          GtkCssStyleProperty *child = _gtk_css_shorthand_property_get_subproperty (shorthand, i);
+          GtkCssValue *sub = _gtk_css_array_value_get_nth (value, i);
+
+          gtk_css_ruleset_add (ruleset, child, _gtk_css_value_ref (sub), section);
+        }
+
+      _gtk_css_value_unref (value);
+    }
+  else if (GTK_IS_CSS_STYLE_PROPERTY (property))
+    {
+      gtk_css_ruleset_add (ruleset, GTK_CSS_STYLE_PROPERTY (property), value, section);
+    }
+  else
+    {
+      g_assert_not_reached ();
+      _gtk_css_value_unref (value);
+    }
+}
+
+static guint
+gtk_css_ruleset_hash (gconstpointer data)
+{
+  const GtkCssRuleset *ruleset = data;
+  guint hash, i;
+
+  hash = _gtk_css_selector_hash (ruleset->selector);
+  for (i = 0; i < ruleset->n_styles; i++)
+    hash = hash * 31 + _gtk_css_style_property_get_id (ruleset->styles[i].property);
+
+  return hash;
+}
+
+static gboolean
+gtk_css_ruleset_equal (gconstpointer a_,
+                       gconstpointer b_)
+{
+  const GtkCssRuleset *a = a_;
+  const GtkCssRuleset *b = b_;
+  guint i;
+
+  if (a->n_styles != b->n_styles ||
+      !_gtk_css_selector_equal (a->selector, b->selector))
+    return FALSE;
+
+  for (i = 0; i < a->n_styles; i++)
+    {
+      if (a->styles[i].property != b->styles[i].property ||
+          !_gtk_css_value_equal (a->styles[i].value, b->styles[i].value))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static GtkCssProviderCache *
+gtk_css_provider_cache_new (void)
+{
+  GtkCssProviderCache *cache;
+
+  cache = g_slice_new0 (GtkCssProviderCache);
+
+  cache->sources = g_variant_builder_new (G_VARIANT_TYPE ("a(ss)"));
+  cache->declaration_ids = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  cache->declarations = g_variant_builder_new (G_VARIANT_TYPE ("a(uss)"));
+  cache->colors = g_variant_builder_new (G_VARIANT_TYPE ("a(uss)"));
+  cache->keyframes = g_variant_builder_new (G_VARIANT_TYPE ("a(uss)"));
+  cache->rulesets = g_variant_builder_new (G_VARIANT_TYPE ("a(aa(usuii)au)"));
+  cache->ruleset_declarations = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+  return cache;
+}
+
+static void
+gtk_css_provider_cache_free (GtkCssProviderCache *cache)
+{
+  g_variant_builder_unref (cache->sources);
+  g_hash_table_destroy (cache->declaration_ids);
+  g_variant_builder_unref (cache->declarations);
+  g_variant_builder_unref (cache->colors);
+  g_variant_builder_unref (cache->keyframes);
+  g_variant_builder_unref (cache->rulesets);
+  g_array_free (cache->ruleset_declarations, TRUE);
+
+  g_slice_free (GtkCssProviderCache, cache);
+}
+
+/* Called for everything that loading from the cache could not reproduce:
+ * errors need to be emitted again on every load and binding sets are
+ * registered while parsing. */
+static void
+gtk_css_provider_disable_cache (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
+  g_clear_pointer (&priv->cache, gtk_css_provider_cache_free);
+}
+
 static void
 gtk_css_scanner_destroy (GtkCssScanner *scanner)
 {
@@ -336,6 +493,8 @@ gtk_css_provider_emit_error (GtkCssProvider *provider,
                              GtkCssScanner  *scanner,
                              const GError   *error)
 {
+  gtk_css_provider_disable_cache (provider);
+
   gtk_css_style_provider_emit_error (GTK_STYLE_PROVIDER (provider),
                                      scanner ? scanner->section : NULL,
                                      error);
@@ -425,8 +584,134 @@ gtk_css_scanner_pop_section (GtkCssScanner *scanner,
   scanner->section = parent;
 }
 
+/* Records that @scanner parses @bytes, which were loaded from @file */
 static void
-gtk_css_provider_init (GtkCssProvider *css_provider)
+gtk_css_scanner_cache_source (GtkCssScanner *scanner,
+                              GFile         *file,
+                              GBytes        *bytes)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
+  GtkCssProviderCache *cache = priv->cache;
+  char *uri, *checksum;
+
+  if (cache == NULL)
+    return;
+
+  uri = g_file_get_uri (file);
+  checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+
+  g_variant_builder_add (cache->sources, "(ss)", uri, checksum);
+  scanner->source = cache->n_sources++;
+
+  g_free (checksum);
+  g_free (uri);
+}
+
+/* Returns the text between @start and the current position of the parser,
+ * or %NULL if it can't be cached */
+static char *
+gtk_css_scanner_get_cache_text (GtkCssScanner *scanner,
+                                const char    *start)
+{
+  const char *end = _gtk_css_parser_get_data (scanner->parser);
+
+  if (!g_utf8_validate (start, end - start, NULL))
+    {
+      gtk_css_provider_disable_cache (scanner->provider);
+      return NULL;
+    }
+
+  return g_strndup (start, end - start);
+}
+
+static void
+gtk_css_scanner_cache_declaration (GtkCssScanner *scanner,
+                                   const char    *name,
+                                   const char    *start)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
+  char *text, *key;
+  guint32 id;
+
+  if (priv->cache == NULL)
+    return;
+
+  text = gtk_css_scanner_get_cache_text (scanner, start);
+  if (text == NULL)
+    return;
+
+  key = g_strdup_printf ("%u:%s:%s", scanner->source, name, text);
+  id = GPOINTER_TO_UINT (g_hash_table_lookup (priv->cache->declaration_ids, key));
+  if (id == 0)
+    {
+      g_variant_builder_add (priv->cache->declarations, "(uss)", scanner->source, name, text);
+      id = g_hash_table_size (priv->cache->declaration_ids) + 1;
+      g_hash_table_insert (priv->cache->declaration_ids, key, GUINT_TO_POINTER (id));
+    }
+  else
+    g_free (key);
+
+  /* ids in the table are off by one, so 0 can mean "not found" */
+  id--;
+  g_array_append_val (priv->cache->ruleset_declarations, id);
+
+  g_free (text);
+}
+
+/* Records a color definition or keyframes */
+static void
+gtk_css_scanner_cache_definition (GtkCssScanner     *scanner,
+                                  GtkCssSectionType  type,
+                                  const char        *name,
+                                  const char        *start)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
+  char *text;
+
+  if (priv->cache == NULL)
+    return;
+
+  text = gtk_css_scanner_get_cache_text (scanner, start);
+  if (text == NULL)
+    return;
+
+  g_variant_builder_add (type == GTK_CSS_SECTION_KEYFRAMES ? priv->cache->keyframes
+                                                           : priv->cache->colors,
+                         "(uss)", scanner->source, name, text);
+
+  g_free (text);
+}
+
+/* Records a ruleset for @selectors with the declarations cached since the
+ * last call */
+static void
+gtk_css_scanner_cache_ruleset (GtkCssScanner *scanner,
+                               GSList        *selectors)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
+  GVariantBuilder builder;
+  GArray *declarations;
+  GSList *l;
+
+  if (priv->cache == NULL)
+    return;
+
+  g_variant_builder_init (&builder, G_VARIANT_TYPE ("aa(usuii)"));
+  for (l = selectors; l; l = l->next)
+    g_variant_builder_add_value (&builder, _gtk_css_selector_to_variant (l->data));
+
+  declarations = priv->cache->ruleset_declarations;
+  g_variant_builder_add (priv->cache->rulesets, "(@aa(usuii)@au)",
+                         g_variant_builder_end (&builder),
+                         g_variant_new_fixed_array (G_VARIANT_TYPE_UINT32,
+                                                    declarations->data,
+                                                    declarations->len,
+                                                    sizeof (guint32)));
+  g_array_set_size (declarations, 0);
+}
+
+static void
+gtk_css_provider_init_rules (GtkCssProvider *css_provider)
 {
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
 
@@ -440,6 +725,12 @@ gtk_css_provider_init (GtkCssProvider *css_provider)
                                            (GDestroyNotify) _gtk_css_keyframes_unref);
 }
 
+static void
+gtk_css_provider_init (GtkCssProvider *css_provider)
+{
+  gtk_css_provider_init_rules (css_provider);
+}
+
 static void
 verify_tree_match_results (GtkCssProvider *provider,
 			   const GtkCssMatcher *matcher,
@@ -614,6 +905,33 @@ gtk_css_style_provider_lookup (GtkStyleProvider    *provider,
     }
 }
 
+static gboolean
+gtk_css_style_provider_change_affects (GtkStyleProvider    *provider,
+                                       const GtkCssMatcher *matcher)
+{
+  GtkCssProvider *css_provider = GTK_CSS_PROVIDER (provider);
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GtkCssMatcher change_matcher;
+  GPtrArray *matches;
+
+  if (priv->changes == NULL)
+    return TRUE;
+
+  /* Like the change computed in lookup(), this catches the selectors
+   * that would match after a state or position change, too */
+  _gtk_css_matcher_superset_init (&change_matcher, matcher, GTK_CSS_CHANGE_NAME | GTK_CSS_CHANGE_CLASS);
+  if (_gtk_css_selector_tree_get_change_all (priv->changes, &change_matcher))
+    return TRUE;
+
+  /* Selectors like '*' have no change */
+  matches = _gtk_css_selector_tree_match_all (priv->changes, matcher);
+  if (matches == NULL)
+    return FALSE;
+
+  g_ptr_array_free (matches, TRUE);
+  return TRUE;
+}
+
 static void
 gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
 {
@@ -621,6 +939,7 @@ gtk_css_style_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_keyframes = gtk_css_style_provider_get_keyframes;
   iface->lookup = gtk_css_style_provider_lookup;
   iface->emit_error = gtk_css_style_provider_emit_error;
+  iface->change_affects = gtk_css_style_provider_change_affects;
 }
 
 static void
@@ -746,11 +1065,26 @@ css_provider_commit (GtkCssProvider *css_provider,
 }
 
 static void
-gtk_css_provider_reset (GtkCssProvider *css_provider)
+gtk_css_provider_clear_rules (GtkCssProvider *css_provider)
 {
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
   guint i;
 
+  g_hash_table_remove_all (priv->symbolic_colors);
+  g_hash_table_remove_all (priv->keyframes);
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
+  g_array_set_size (priv->rulesets, 0);
+  _gtk_css_selector_tree_free (priv->tree);
+  priv->tree = NULL;
+}
+
+static void
+gtk_css_provider_reset (GtkCssProvider *css_provider)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+
   if (priv->resource)
     {
       g_resources_unregister (priv->resource);
@@ -764,15 +1098,522 @@ gtk_css_provider_reset (GtkCssProvider *css_provider)
       priv->path = NULL;
     }
 
-  g_hash_table_remove_all (priv->symbolic_colors);
-  g_hash_table_remove_all (priv->keyframes);
+  gtk_css_provider_clear_rules (css_provider);
+}
 
-  for (i = 0; i < priv->rulesets->len; i++)
-    gtk_css_ruleset_clear (&g_array_index (priv->rulesets, GtkCssRuleset, i));
-  g_array_set_size (priv->rulesets, 0);
-  _gtk_css_selector_tree_free (priv->tree);
-  priv->tree = NULL;
+static char *
+gtk_css_provider_get_cache_path (GFile *file)
+{
+  char *uri, *checksum, *basename, *path;
+
+  uri = g_file_get_uri (file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  basename = g_strconcat (checksum, ".cache", NULL);
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", basename, NULL);
+
+  g_free (basename);
+  g_free (checksum);
+  g_free (uri);
+
+  return path;
+}
+
+typedef struct {
+  char *path;
+  time_t mtime;
+} CacheFile;
+
+static void
+cache_file_clear (gpointer data)
+{
+  CacheFile *cache_file = data;
+
+  g_free (cache_file->path);
+}
+
+static int
+compare_cache_files_newest_first (gconstpointer a,
+                                  gconstpointer b)
+{
+  const CacheFile *fa = a;
+  const CacheFile *fb = b;
+
+  if (fa->mtime > fb->mtime)
+    return -1;
+  else if (fa->mtime < fb->mtime)
+    return 1;
 
+  return 0;
+}
+
+/* Removes cache files of style sheets that weren't loaded in a
+ * long time, and the least recently used ones if there are too many */
+static void
+gtk_css_provider_prune_cache (const char *dir)
+{
+  GArray *files;
+  const char *name;
+  time_t now;
+  GDir *gdir;
+  guint i;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  if (gdir == NULL)
+    return;
+
+  now = g_get_real_time () / G_USEC_PER_SEC;
+  files = g_array_new (FALSE, FALSE, sizeof (CacheFile));
+  g_array_set_clear_func (files, cache_file_clear);
+
+  while ((name = g_dir_read_name (gdir)) != NULL)
+    {
+      CacheFile cache_file;
+      GStatBuf buf;
+
+      if (!g_str_has_suffix (name, ".cache"))
+        continue;
+
+      cache_file.path = g_build_filename (dir, name, NULL);
+      if (g_stat (cache_file.path, &buf) != 0)
+        {
+          g_free (cache_file.path);
+          continue;
+        }
+
+      if (now - buf.st_mtime > GTK_CSS_PROVIDER_CACHE_MAX_AGE)
+        {
+          g_remove (cache_file.path);
+          g_free (cache_file.path);
+          continue;
+        }
+
+      cache_file.mtime = buf.st_mtime;
+      g_array_append_val (files, cache_file);
+    }
+
+  g_dir_close (gdir);
+
+  if (files->len > GTK_CSS_PROVIDER_CACHE_MAX_FILES)
+    {
+      g_array_sort (files, compare_cache_files_newest_first);
+      for (i = GTK_CSS_PROVIDER_CACHE_MAX_FILES; i < files->len; i++)
+        g_remove (g_array_index (files, CacheFile, i).path);
+    }
+
+  g_array_free (files, TRUE);
+}
+
+static void
+gtk_css_provider_save_cache (GtkCssProvider *css_provider,
+                             GFile          *file)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GtkCssProviderCache *cache = priv->cache;
+  GError *error = NULL;
+  GVariant *variant;
+  char *path, *dir;
+
+  path = gtk_css_provider_get_cache_path (file);
+  dir = g_path_get_dirname (path);
+  if (g_mkdir_with_parents (dir, 0755) != 0)
+    {
+      g_warning ("Failed to mkdir %s", dir);
+      goto out;
+    }
+
+  variant = g_variant_new (GTK_CSS_PROVIDER_CACHE_TYPE,
+                           GTK_CSS_PROVIDER_CACHE_VERSION,
+                           GTK_VERSION,
+                           cache->sources,
+                           cache->declarations,
+                           cache->colors,
+                           cache->keyframes,
+                           cache->rulesets);
+  g_variant_ref_sink (variant);
+
+  if (!g_file_set_contents (path,
+                            g_variant_get_data (variant),
+                            g_variant_get_size (variant),
+                            &error))
+    {
+      g_warning ("Failed to save CSS cache %s: %s", path, error->message);
+      g_error_free (error);
+    }
+  else
+    {
+      gtk_css_provider_prune_cache (dir);
+    }
+
+  g_variant_unref (variant);
+
+out:
+  g_free (dir);
+  g_free (path);
+}
+
+static void
+gtk_css_provider_cache_parser_error (GtkCssParser *parser,
+                                     const GError *error,
+                                     gpointer      user_data)
+{
+  gboolean *failed = user_data;
+
+  *failed = TRUE;
+}
+
+/* Cached text was successfully parsed before, so anything but a clean
+ * parse means the cache is broken */
+static gboolean
+gtk_css_provider_cache_parser_finish (GtkCssParser *parser,
+                                      gboolean      failed)
+{
+  gboolean result;
+
+  _gtk_css_parser_skip_whitespace (parser);
+  result = !failed && _gtk_css_parser_is_eof (parser);
+  _gtk_css_parser_free (parser);
+
+  return result;
+}
+
+/* Returns the files the cache was created from if none of them changed */
+static GPtrArray *
+gtk_css_provider_cache_check_sources (GVariant *sources,
+                                      GFile    *file)
+{
+  GPtrArray *files;
+  GVariantIter iter;
+  const char *uri, *checksum;
+
+  files = g_ptr_array_new_with_free_func (g_object_unref);
+
+  g_variant_iter_init (&iter, sources);
+  while (g_variant_iter_next (&iter, "(&s&s)", &uri, &checksum))
+    {
+      GFile *source;
+      GBytes *bytes;
+      char *current;
+      gboolean changed;
+
+      source = g_file_new_for_uri (uri);
+      g_ptr_array_add (files, source);
+
+      if (files->len == 1 && !g_file_equal (source, file))
+        goto fail;
+
+      bytes = g_file_load_bytes (source, NULL, NULL, NULL);
+      if (bytes == NULL)
+        goto fail;
+
+      current = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, bytes);
+      changed = !g_str_equal (current, checksum);
+      g_free (current);
+      g_bytes_unref (bytes);
+
+      if (changed)
+        goto fail;
+    }
+
+  if (files->len == 0)
+    goto fail;
+
+  return files;
+
+fail:
+  g_ptr_array_unref (files);
+  return NULL;
+}
+
+typedef struct {
+  GtkStyleProperty *property;
+  GtkCssValue *value;
+} CachedDeclaration;
+
+static void
+cached_declaration_clear (gpointer data)
+{
+  CachedDeclaration *declaration = data;
+
+  _gtk_css_value_unref (declaration->value);
+}
+
+static GArray *
+gtk_css_provider_cache_load_declarations (GVariant  *variant,
+                                          GPtrArray *files)
+{
+  GArray *declarations;
+  GVariantIter iter;
+  const char *name, *text;
+  guint source;
+
+  declarations = g_array_sized_new (FALSE, FALSE, sizeof (CachedDeclaration),
+                                    g_variant_n_children (variant));
+  g_array_set_clear_func (declarations, cached_declaration_clear);
+
+  g_variant_iter_init (&iter, variant);
+  while (g_variant_iter_next (&iter, "(u&s&s)", &source, &name, &text))
+    {
+      CachedDeclaration declaration;
+      GtkCssParser *parser;
+      gboolean failed = FALSE;
+
+      if (source >= files->len)
+        goto fail;
+
+      declaration.property = _gtk_style_property_lookup (name);
+      if (declaration.property == NULL)
+        goto fail;
+
+      parser = _gtk_css_parser_new (text,
+                                    g_ptr_array_index (files, source),
+                                    gtk_css_provider_cache_parser_error,
+                                    &failed);
+      declaration.value = _gtk_style_property_parse_value (declaration.property, parser);
+      if (!gtk_css_provider_cache_parser_finish (parser, failed))
+        {
+          g_clear_pointer (&declaration.value, _gtk_css_value_unref);
+          goto fail;
+        }
+      if (declaration.value == NULL)
+        goto fail;
+
+      g_array_append_val (declarations, declaration);
+    }
+
+  return declarations;
+
+fail:
+  g_array_unref (declarations);
+  return NULL;
+}
+
+static gboolean
+gtk_css_provider_cache_load_colors (GtkCssProvider *css_provider,
+                                    GVariant       *variant,
+                                    GPtrArray      *files)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GVariantIter iter;
+  const char *name, *text;
+  guint source;
+
+  g_variant_iter_init (&iter, variant);
+  while (g_variant_iter_next (&iter, "(u&s&s)", &source, &name, &text))
+    {
+      GtkCssParser *parser;
+      GtkCssValue *color;
+      gboolean failed = FALSE;
+
+      if (source >= files->len)
+        return FALSE;
+
+      /* The text includes the semicolon */
+      parser = _gtk_css_parser_new (text,
+                                    g_ptr_array_index (files, source),
+                                    gtk_css_provider_cache_parser_error,
+                                    &failed);
+      color = _gtk_css_color_value_parse (parser);
+      if (!_gtk_css_parser_try (parser, ";", TRUE))
+        failed = TRUE;
+      if (!gtk_css_provider_cache_parser_finish (parser, failed))
+        {
+          g_clear_pointer (&color, _gtk_css_value_unref);
+          return FALSE;
+        }
+      if (color == NULL)
+        return FALSE;
+
+      g_hash_table_insert (priv->symbolic_colors, g_strdup (name), color);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_css_provider_cache_load_keyframes (GtkCssProvider *css_provider,
+                                       GVariant       *variant,
+                                       GPtrArray      *files)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GVariantIter iter;
+  const char *name, *text;
+  guint source;
+
+  g_variant_iter_init (&iter, variant);
+  while (g_variant_iter_next (&iter, "(u&s&s)", &source, &name, &text))
+    {
+      GtkCssParser *parser;
+      GtkCssKeyframes *keyframes;
+      gboolean failed = FALSE;
+
+      if (source >= files->len)
+        return FALSE;
+
+      /* The text includes the closing brace */
+      parser = _gtk_css_parser_new (text,
+                                    g_ptr_array_index (files, source),
+                                    gtk_css_provider_cache_parser_error,
+                                    &failed);
+      keyframes = _gtk_css_keyframes_parse (parser);
+      if (!_gtk_css_parser_try (parser, "}", TRUE))
+        failed = TRUE;
+      if (!gtk_css_provider_cache_parser_finish (parser, failed))
+        {
+          g_clear_pointer (&keyframes, _gtk_css_keyframes_unref);
+          return FALSE;
+        }
+      if (keyframes == NULL)
+        return FALSE;
+
+      g_hash_table_insert (priv->keyframes, g_strdup (name), keyframes);
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_css_provider_cache_load_rulesets (GtkCssProvider *css_provider,
+                                      GVariant       *variant,
+                                      GArray         *declarations)
+{
+  GVariantIter iter;
+  GVariant *selectors_variant, *ids_variant;
+
+  g_variant_iter_init (&iter, variant);
+  while (g_variant_iter_next (&iter, "(@aa(usuii)@au)", &selectors_variant, &ids_variant))
+    {
+      GtkCssRuleset ruleset = { 0, };
+      GSList *selectors = NULL;
+      const guint32 *ids;
+      gsize i, n_ids;
+      gboolean failed = FALSE;
+
+      ids = g_variant_get_fixed_array (ids_variant, &n_ids, sizeof (guint32));
+      for (i = 0; i < n_ids; i++)
+        {
+          CachedDeclaration *declaration;
+
+          if (ids[i] >= declarations->len)
+            {
+              failed = TRUE;
+              break;
+            }
+
+          declaration = &g_array_index (declarations, CachedDeclaration, ids[i]);
+          gtk_css_ruleset_add_declaration (&ruleset,
+                                           declaration->property,
+                                           _gtk_css_value_ref (declaration->value),
+                                           NULL);
+        }
+
+      /* Keep the order css_provider_commit() saw when parsing */
+      for (i = g_variant_n_children (selectors_variant); i > 0 && !failed; i--)
+        {
+          GVariant *child = g_variant_get_child_value (selectors_variant, i - 1);
+          GtkCssSelector *selector = _gtk_css_selector_from_variant (child);
+
+          g_variant_unref (child);
+          if (selector == NULL)
+            failed = TRUE;
+          else
+            selectors = g_slist_prepend (selectors, selector);
+        }
+
+      if (selectors == NULL)
+        failed = TRUE;
+
+      if (failed)
+        g_slist_free_full (selectors, (GDestroyNotify) _gtk_css_selector_free);
+      else
+        css_provider_commit (css_provider, selectors, &ruleset);
+
+      gtk_css_ruleset_clear (&ruleset);
+      g_variant_unref (selectors_variant);
+      g_variant_unref (ids_variant);
+
+      if (failed)
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Loads the result of parsing @file from the cache in the user's cache
+ * directory. The cache is only used if the files it was created from,
+ * including imported ones, still have the same contents. */
+static gboolean
+gtk_css_provider_load_cache (GtkCssProvider *css_provider,
+                             GFile          *file)
+{
+  GVariant *cache, *sources, *declarations, *colors, *keyframes, *rulesets;
+  GArray *cached_declarations = NULL;
+  GPtrArray *files = NULL;
+  GMappedFile *mapped;
+  GBytes *bytes;
+  const char *version;
+  char *path;
+  guint format;
+  gboolean result = FALSE;
+
+  path = gtk_css_provider_get_cache_path (file);
+  mapped = g_mapped_file_new (path, FALSE, NULL);
+  if (mapped == NULL)
+    {
+      g_free (path);
+      return FALSE;
+    }
+
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+  /* Not trusted, so a broken file just gives us empty values */
+  cache = g_variant_new_from_bytes (G_VARIANT_TYPE (GTK_CSS_PROVIDER_CACHE_TYPE), bytes, FALSE);
+  g_variant_ref_sink (cache);
+  g_bytes_unref (bytes);
+
+  g_variant_get (cache, "(u&s@a(ss)@a(uss)@a(uss)@a(uss)@a(aa(usuii)au))",
+                 &format, &version,
+                 &sources, &declarations, &colors, &keyframes, &rulesets);
+
+  if (format != GTK_CSS_PROVIDER_CACHE_VERSION ||
+      !g_str_equal (version, GTK_VERSION))
+    goto out;
+
+  files = gtk_css_provider_cache_check_sources (sources, file);
+  if (files == NULL)
+    goto out;
+
+  cached_declarations = gtk_css_provider_cache_load_declarations (declarations, files);
+  if (cached_declarations == NULL)
+    goto out;
+
+  result = gtk_css_provider_cache_load_colors (css_provider, colors, files) &&
+           gtk_css_provider_cache_load_keyframes (css_provider, keyframes, files) &&
+           gtk_css_provider_cache_load_rulesets (css_provider, rulesets, cached_declarations);
+
+  if (result)
+    {
+      /* Mark the cache as used, so it doesn't get pruned */
+      g_utime (path, NULL);
+    }
+  else
+    {
+      gtk_css_provider_clear_rules (css_provider);
+    }
+
+out:
+  g_free (path);
+  if (cached_declarations)
+    g_array_unref (cached_declarations);
+  if (files)
+    g_ptr_array_unref (files);
+  g_variant_unref (sources);
+  g_variant_unref (declarations);
+  g_variant_unref (colors);
+  g_variant_unref (keyframes);
+  g_variant_unref (rulesets);
+  g_variant_unref (cache);
+
+  return result;
 }
 
 static gboolean
@@ -845,6 +1686,7 @@ parse_color_definition (GtkCssScanner *scanner)
 {
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkCssValue *color;
+  const char *color_start;
   char *name;
 
   gtk_css_scanner_push_section (scanner, GTK_CSS_SECTION_COLOR_DEFINITION);
@@ -868,6 +1710,7 @@ parse_color_definition (GtkCssScanner *scanner)
       return TRUE;
     }
 
+  color_start = _gtk_css_parser_get_data (scanner->parser);
   color = _gtk_css_color_value_parse (scanner->parser);
   if (color == NULL)
     {
@@ -892,6 +1735,7 @@ parse_color_definition (GtkCssScanner *scanner)
       return TRUE;
     }
 
+  gtk_css_scanner_cache_definition (scanner, GTK_CSS_SECTION_COLOR_DEFINITION, name, color_start);
   g_hash_table_insert (priv->symbolic_colors, name, color);
 
   gtk_css_scanner_pop_section (scanner, GTK_CSS_SECTION_COLOR_DEFINITION);
@@ -912,6 +1756,8 @@ parse_binding_set (GtkCssScanner *scanner)
       return FALSE;
     }
 
+  gtk_css_provider_disable_cache (scanner->provider);
+
   name = _gtk_css_parser_try_ident (scanner->parser, TRUE);
   if (name == NULL)
     {
@@ -1011,6 +1857,7 @@ parse_keyframes (GtkCssScanner *scanner)
 {
   GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (scanner->provider);
   GtkCssKeyframes *keyframes;
+  const char *keyframes_start;
   char *name;
 
   gtk_css_scanner_push_section (scanner, GTK_CSS_SECTION_KEYFRAMES);
@@ -1045,6 +1892,7 @@ parse_keyframes (GtkCssScanner *scanner)
       goto exit;
     }
 
+  keyframes_start = _gtk_css_parser_get_data (scanner->parser);
   keyframes = _gtk_css_keyframes_parse (scanner->parser);
   if (keyframes == NULL)
     {
@@ -1065,6 +1913,8 @@ parse_keyframes (GtkCssScanner *scanner)
       if (!_gtk_css_parser_is_eof (scanner->parser))
         _gtk_css_parser_resync (scanner->parser, FALSE, 0);
     }
+  else
+    gtk_css_scanner_cache_definition (scanner, GTK_CSS_SECTION_KEYFRAMES, name, keyframes_start);
 
 exit:
   gtk_css_scanner_pop_section (scanner, GTK_CSS_SECTION_KEYFRAMES);
@@ -1149,11 +1999,13 @@ parse_declaration (GtkCssScanner *scanner,
   if (property)
     {
       GtkCssValue *value;
+      const char *value_start;
 
       g_free (name);
 
       gtk_css_scanner_push_section (scanner, GTK_CSS_SECTION_VALUE);
 
+      value_start = _gtk_css_parser_get_data (scanner->parser);
       value = _gtk_style_property_parse_value (property,
                                                scanner->parser);
 
@@ -1180,31 +2032,8 @@ parse_declaration (GtkCssScanner *scanner,
           return;
         }
 
-      if (GTK_IS_CSS_SHORTHAND_PROPERTY (property))
-        {
-          GtkCssShorthandProperty *shorthand = GTK_CSS_SHORTHAND_PROPERTY (property);
-          guint i;
-
-          for (i = 0; i < _gtk_css_shorthand_property_get_n_subproperties (shorthand); i++)
-            {
-              GtkCssStyleProperty *child = _gtk_css_shorthand_property_get_subproperty (shorthand, i);
-              GtkCssValue *sub = _gtk_css_array_value_get_nth (value, i);
-              
-              gtk_css_ruleset_add (ruleset, child, _gtk_css_value_ref (sub), scanner->section);
-            }
-          
-            _gtk_css_value_unref (value);
-        }
-      else if (GTK_IS_CSS_STYLE_PROPERTY (property))
-        {
-          gtk_css_ruleset_add (ruleset, GTK_CSS_STYLE_PROPERTY (property), value, scanner->section);
-        }
-      else
-        {
-          g_assert_not_reached ();
-          _gtk_css_value_unref (value);
-        }
-
+      gtk_css_scanner_cache_declaration (scanner, property->name, value_start);
+      gtk_css_ruleset_add_declaration (ruleset, property, value, scanner->section);
 
       gtk_css_scanner_pop_section (scanner, GTK_CSS_SECTION_VALUE);
     }
@@ -1286,6 +2115,7 @@ parse_ruleset (GtkCssScanner *scanner)
         }
     }
 
+  gtk_css_scanner_cache_ruleset (scanner, selectors);
   css_provider_commit (scanner->provider, selectors, &ruleset);
   gtk_css_ruleset_clear (&ruleset);
   gtk_css_scanner_pop_section (scanner, GTK_CSS_SECTION_RULESET);
@@ -1360,6 +2190,9 @@ gtk_css_provider_postprocess (GtkCssProvider *css_provider)
   _gtk_css_selector_tree_builder_free (builder);
 
 #ifndef VERIFY_TREE
+  if (priv->keep_selectors)
+    return;
+
   for (i = 0; i < priv->rulesets->len; i++)
     {
       GtkCssRuleset *ruleset;
@@ -1378,9 +2211,22 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                 GFile          *file,
                                 const char     *text)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
   GtkCssScanner *scanner;
   GBytes *bytes;
 
+  if (parent == NULL && file != NULL &&
+      !gtk_keep_css_sections && !GTK_DEBUG_CHECK (NO_CSS_FILE_CACHE))
+    {
+      if (gtk_css_provider_load_cache (css_provider, file))
+        {
+          gtk_css_provider_postprocess (css_provider);
+          return;
+        }
+
+      priv->cache = gtk_css_provider_cache_new ();
+    }
+
   if (text == NULL)
     {
       GError *load_error = NULL;
@@ -1433,19 +2279,193 @@ gtk_css_provider_load_internal (GtkCssProvider *css_provider,
                                      parent ? parent->section : NULL,
                                      file,
                                      text);
+      if (bytes)
+        gtk_css_scanner_cache_source (scanner, file, bytes);
 
       parse_stylesheet (scanner);
 
       gtk_css_scanner_destroy (scanner);
 
       if (parent == NULL)
-        gtk_css_provider_postprocess (css_provider);
+        {
+          if (priv->cache)
+            gtk_css_provider_save_cache (css_provider, file);
+
+          gtk_css_provider_postprocess (css_provider);
+        }
     }
 
+  if (parent == NULL)
+    gtk_css_provider_disable_cache (css_provider);
+
   if (bytes)
     g_bytes_unref (bytes);
 }
 
+static gboolean
+gtk_css_provider_colors_equal (GHashTable *old_colors,
+                               GHashTable *new_colors)
+{
+  GHashTableIter iter;
+  gpointer name, color, new_color;
+
+  if (g_hash_table_size (old_colors) != g_hash_table_size (new_colors))
+    return FALSE;
+
+  g_hash_table_iter_init (&iter, old_colors);
+  while (g_hash_table_iter_next (&iter, &name, &color))
+    {
+      new_color = g_hash_table_lookup (new_colors, name);
+      if (new_color == NULL || !_gtk_css_value_equal (color, new_color))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+gtk_css_provider_keyframes_equal (GHashTable *old_keyframes,
+                                  GHashTable *new_keyframes)
+{
+  GHashTableIter iter;
+  gpointer name, keyframes, new_keyframes_value;
+  GString *old_str, *new_str;
+  gboolean result = TRUE;
+
+  if (g_hash_table_size (old_keyframes) != g_hash_table_size (new_keyframes))
+    return FALSE;
+
+  old_str = g_string_new (NULL);
+  new_str = g_string_new (NULL);
+
+  g_hash_table_iter_init (&iter, old_keyframes);
+  while (result && g_hash_table_iter_next (&iter, &name, &keyframes))
+    {
+      new_keyframes_value = g_hash_table_lookup (new_keyframes, name);
+      if (new_keyframes_value == NULL)
+        {
+          result = FALSE;
+          break;
+        }
+
+      g_string_truncate (old_str, 0);
+      g_string_truncate (new_str, 0);
+      _gtk_css_keyframes_print (keyframes, old_str);
+      _gtk_css_keyframes_print (new_keyframes_value, new_str);
+      result = g_string_equal (old_str, new_str);
+    }
+
+  g_string_free (old_str, TRUE);
+  g_string_free (new_str, TRUE);
+
+  return result;
+}
+
+/* Compares the rules of a reload against the ones they replace. Returns
+ * %FALSE if we can't tell what changed, otherwise @changes is set to a
+ * tree of the selectors of all rulesets that were added, removed, edited
+ * or moved, or %NULL if nothing changed at all.
+ *
+ * Rulesets are sorted by specificity and then by source order, so a
+ * ruleset only counts as unchanged if all the unchanged ones before it
+ * still come before it.
+ */
+static gboolean
+gtk_css_provider_diff (GtkCssProvider      *css_provider,
+                       GArray              *old_rulesets,
+                       GHashTable          *old_colors,
+                       GHashTable          *old_keyframes,
+                       GtkCssSelectorTree **changes)
+{
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GtkCssSelectorTreeBuilder *builder;
+  GHashTable *unchanged;
+  gboolean *used;
+  guint i, next, n_changes;
+
+  *changes = NULL;
+
+  /* Named colors and animations can be used from anywhere */
+  if (!gtk_css_provider_colors_equal (old_colors, priv->symbolic_colors) ||
+      !gtk_css_provider_keyframes_equal (old_keyframes, priv->keyframes))
+    return FALSE;
+
+  for (i = 0; i < old_rulesets->len; i++)
+    {
+      if (g_array_index (old_rulesets, GtkCssRuleset, i).selector == NULL)
+        return FALSE;
+    }
+
+  unchanged = g_hash_table_new_full (gtk_css_ruleset_hash,
+                                     gtk_css_ruleset_equal,
+                                     NULL,
+                                     (GDestroyNotify) g_queue_free);
+  for (i = 0; i < old_rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (old_rulesets, GtkCssRuleset, i);
+      GQueue *queue;
+
+      queue = g_hash_table_lookup (unchanged, ruleset);
+      if (queue == NULL)
+        {
+          queue = g_queue_new ();
+          g_hash_table_insert (unchanged, ruleset, queue);
+        }
+      g_queue_push_tail (queue, GUINT_TO_POINTER (i));
+    }
+
+  used = g_new0 (gboolean, old_rulesets->len);
+  builder = _gtk_css_selector_tree_builder_new ();
+  n_changes = 0;
+  next = 0;
+
+  for (i = 0; i < priv->rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (priv->rulesets, GtkCssRuleset, i);
+      gboolean matched = FALSE;
+      GQueue *queue;
+      guint old;
+
+      queue = g_hash_table_lookup (unchanged, ruleset);
+      while (!matched && queue && !g_queue_is_empty (queue))
+        {
+          old = GPOINTER_TO_UINT (g_queue_pop_head (queue));
+          if (old >= next)
+            {
+              used[old] = TRUE;
+              next = old + 1;
+              matched = TRUE;
+            }
+        }
+
+      if (matched)
+        continue;
+
+      _gtk_css_selector_tree_builder_add (builder, ruleset->selector, NULL, ruleset);
+      n_changes++;
+    }
+
+  for (i = 0; i < old_rulesets->len; i++)
+    {
+      GtkCssRuleset *ruleset = &g_array_index (old_rulesets, GtkCssRuleset, i);
+
+      if (used[i])
+        continue;
+
+      _gtk_css_selector_tree_builder_add (builder, ruleset->selector, NULL, ruleset);
+      n_changes++;
+    }
+
+  if (n_changes > 0)
+    *changes = _gtk_css_selector_tree_builder_build (builder);
+
+  _gtk_css_selector_tree_builder_free (builder);
+  g_free (used);
+  g_hash_table_unref (unchanged);
+
+  return TRUE;
+}
+
 /**
  * gtk_css_provider_load_from_data:
  * @css_provider: a #GtkCssProvider
@@ -1462,7 +2482,12 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
                                  const gchar     *data,
                                  gssize           length)
 {
+  GtkCssProviderPrivate *priv = gtk_css_provider_get_instance_private (css_provider);
+  GHashTable *old_colors, *old_keyframes;
+  GtkCssSelectorTree *changes;
+  GArray *old_rulesets;
   char *free_data;
+  guint i;
 
   g_return_if_fail (GTK_IS_CSS_PROVIDER (css_provider));
   g_return_if_fail (data != NULL);
@@ -1478,13 +2503,37 @@ gtk_css_provider_load_from_data (GtkCssProvider  *css_provider,
       data = free_data;
     }
 
+  old_rulesets = priv->rulesets;
+  old_colors = priv->symbolic_colors;
+  old_keyframes = priv->keyframes;
+  gtk_css_provider_init_rules (css_provider);
+
   gtk_css_provider_reset (css_provider);
 
+  /* Data providers tend to get reloaded, keep what we need to diff them */
+  priv->keep_selectors = TRUE;
   gtk_css_provider_load_internal (css_provider, NULL, NULL, data);
+  priv->keep_selectors = FALSE;
 
   g_free (free_data);
 
-  gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+  if (!gtk_css_provider_diff (css_provider, old_rulesets, old_colors, old_keyframes, &changes))
+    {
+      gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+    }
+  else if (changes)
+    {
+      priv->changes = changes;
+      gtk_style_provider_changed (GTK_STYLE_PROVIDER (css_provider));
+      priv->changes = NULL;
+      _gtk_css_selector_tree_free (changes);
+    }
+
+  for (i = 0; i < old_rulesets->len; i++)
+    gtk_css_ruleset_clear (&g_array_index (old_rulesets, GtkCssRuleset, i));
+  g_array_free (old_rulesets, TRUE);
+  g_hash_table_destroy (old_colors);
+  g_hash_table_destroy (old_keyframes);
 }
 
 /**
@@ -1317,6 +1317,169 @@ _gtk_css_selector_to_string (const GtkCssSelector *selector)
   return g_string_free (string, FALSE);
 }
 
+/* Indexes into this table are stored in caches, so only append to it */
+static const GtkCssSelectorClass *selector_classes[] = {
+  &GTK_CSS_SELECTOR_DESCENDANT,
+  &GTK_CSS_SELECTOR_CHILD,
+  &GTK_CSS_SELECTOR_SIBLING,
+  &GTK_CSS_SELECTOR_ADJACENT,
+  &GTK_CSS_SELECTOR_ANY,
+  &GTK_CSS_SELECTOR_NOT_ANY,
+  &GTK_CSS_SELECTOR_NAME,
+  &GTK_CSS_SELECTOR_NOT_NAME,
+  &GTK_CSS_SELECTOR_CLASS,
+  &GTK_CSS_SELECTOR_NOT_CLASS,
+  &GTK_CSS_SELECTOR_ID,
+  &GTK_CSS_SELECTOR_NOT_ID,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE,
+  &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION,
+  &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION
+};
+
+static gboolean
+gtk_css_selector_is_combinator (const GtkCssSelectorClass *class)
+{
+  return class == &GTK_CSS_SELECTOR_DESCENDANT ||
+         class == &GTK_CSS_SELECTOR_CHILD ||
+         class == &GTK_CSS_SELECTOR_SIBLING ||
+         class == &GTK_CSS_SELECTOR_ADJACENT;
+}
+
+/**
+ * _gtk_css_selector_to_variant:
+ * @selector: the selector
+ *
+ * Serializes @selector into a #GVariant of type
+ * %GTK_CSS_SELECTOR_VARIANT_TYPE, with one (kind, string, state or
+ * position type, a, b) tuple for each simple selector and combinator.
+ * Names and classes are stored as strings, so the result can be
+ * loaded again by a different process.
+ *
+ * Returns: (transfer floating): the serialized selector
+ **/
+GVariant *
+_gtk_css_selector_to_variant (const GtkCssSelector *selector)
+{
+  GVariantBuilder builder;
+
+  g_return_val_if_fail (selector != NULL, NULL);
+
+  g_variant_builder_init (&builder, GTK_CSS_SELECTOR_VARIANT_TYPE);
+
+  for (; selector; selector = gtk_css_selector_previous (selector))
+    {
+      const char *string = "";
+      guint kind, data = 0;
+      gint32 a = 0, b = 0;
+
+      for (kind = 0; kind < G_N_ELEMENTS (selector_classes); kind++)
+        {
+          if (selector_classes[kind] == selector->class)
+            break;
+        }
+      g_assert (kind < G_N_ELEMENTS (selector_classes));
+
+      if (selector->class == &GTK_CSS_SELECTOR_NAME ||
+          selector->class == &GTK_CSS_SELECTOR_NOT_NAME)
+        string = selector->name.name;
+      else if (selector->class == &GTK_CSS_SELECTOR_CLASS ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        string = g_quark_to_string (selector->style_class.style_class);
+      else if (selector->class == &GTK_CSS_SELECTOR_ID ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_ID)
+        string = selector->id.name;
+      else if (selector->class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        data = selector->state.state;
+      else if (selector->class == &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION ||
+               selector->class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          data = selector->position.type;
+          a = selector->position.a;
+          b = selector->position.b;
+        }
+
+      g_variant_builder_add (&builder, "(usuii)", kind, string, data, a, b);
+    }
+
+  return g_variant_builder_end (&builder);
+}
+
+/**
+ * _gtk_css_selector_from_variant:
+ * @variant: a #GVariant of type %GTK_CSS_SELECTOR_VARIANT_TYPE
+ *
+ * Creates the selector that was serialized with
+ * _gtk_css_selector_to_variant(). As @variant usually comes from a
+ * file, it is checked to describe a valid selector.
+ *
+ * Returns: the new selector or %NULL if @variant is invalid
+ **/
+GtkCssSelector *
+_gtk_css_selector_from_variant (GVariant *variant)
+{
+  GtkCssSelector *selector;
+  gsize i, n;
+
+  g_return_val_if_fail (g_variant_is_of_type (variant, GTK_CSS_SELECTOR_VARIANT_TYPE), NULL);
+
+  n = g_variant_n_children (variant);
+  if (n == 0)
+    return NULL;
+
+  selector = g_malloc0 (sizeof (GtkCssSelector) * (n + 1) + sizeof (gpointer));
+
+  for (i = 0; i < n; i++)
+    {
+      const GtkCssSelectorClass *class;
+      const char *string;
+      guint kind, data;
+      gint32 a, b;
+
+      g_variant_get_child (variant, i, "(u&suii)", &kind, &string, &data, &a, &b);
+      if (kind >= G_N_ELEMENTS (selector_classes))
+        goto fail;
+
+      class = selector_classes[kind];
+      /* Combinators need a simple selector on both sides */
+      if (gtk_css_selector_is_combinator (class) &&
+          (i == 0 || i == n - 1 || gtk_css_selector_is_combinator (selector[i - 1].class)))
+        goto fail;
+
+      selector[i].class = class;
+
+      if (class == &GTK_CSS_SELECTOR_NAME ||
+          class == &GTK_CSS_SELECTOR_NOT_NAME)
+        selector[i].name.name = g_intern_string (string);
+      else if (class == &GTK_CSS_SELECTOR_CLASS ||
+               class == &GTK_CSS_SELECTOR_NOT_CLASS)
+        selector[i].style_class.style_class = g_quark_from_string (string);
+      else if (class == &GTK_CSS_SELECTOR_ID ||
+               class == &GTK_CSS_SELECTOR_NOT_ID)
+        selector[i].id.name = g_intern_string (string);
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_STATE ||
+               class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_STATE)
+        selector[i].state.state = data;
+      else if (class == &GTK_CSS_SELECTOR_PSEUDOCLASS_POSITION ||
+               class == &GTK_CSS_SELECTOR_NOT_PSEUDOCLASS_POSITION)
+        {
+          if (data > POSITION_ONLY)
+            goto fail;
+
+          selector[i].position.type = data;
+          selector[i].position.a = a;
+          selector[i].position.b = b;
+        }
+    }
+
+  return selector;
+
+fail:
+  g_free (selector);
+  return NULL;
+}
+
 static gboolean
 gtk_css_selector_foreach_match (const GtkCssSelector *selector,
                                 const GtkCssMatcher  *matcher,
@@ -1397,6 +1560,35 @@ _gtk_css_selector_compare (const GtkCssSelector *a,
   return a_elements - b_elements;
 }
 
+/* Unlike _gtk_css_selector_compare(), these look at the whole selector
+ * and not just its specificity */
+guint
+_gtk_css_selector_hash (const GtkCssSelector *selector)
+{
+  guint hash = 0;
+
+  for (; selector; selector = gtk_css_selector_previous (selector))
+    hash = hash * 31 + gtk_css_selector_hash_one (selector);
+
+  return hash;
+}
+
+gboolean
+_gtk_css_selector_equal (const GtkCssSelector *a,
+                         const GtkCssSelector *b)
+{
+  while (a && b)
+    {
+      if (!gtk_css_selector_equal (a, b))
+        return FALSE;
+
+      a = gtk_css_selector_previous (a);
+      b = gtk_css_selector_previous (b);
+    }
+
+  return a == NULL && b == NULL;
+}
+
 GtkCssChange
 _gtk_css_selector_get_change (const GtkCssSelector *selector)
 {
@@ -1476,23 +1668,89 @@ gtk_css_selectors_skip_initial_selector (GtkCssSelector *selector, const GtkCssS
   return (GtkCssSelector *)gtk_css_selector_previous (selector);
 }
 
+typedef struct {
+  GPtrArray *array;
+  const GtkCssBloomFilter *ancestors;
+} GtkCssSelectorTreeMatch;
+
+static gboolean
+gtk_css_selector_is_ancestor_combinator (const GtkCssSelector *selector)
+{
+  return selector->class == &GTK_CSS_SELECTOR_DESCENDANT ||
+         selector->class == &GTK_CSS_SELECTOR_CHILD;
+}
+
+/* Checks with the Bloom filter of the ancestors of the node we match
+ * whether @tree can be skipped. If @in_ancestor is set, @tree will be
+ * matched against an ancestor, so it needs that ancestor's name, class
+ * or id.
+ * The selectors after a descendant or child combinator always have to
+ * match an ancestor - the combinator may be applied to a sibling of the
+ * node or of one of its ancestors, but those have the same ancestors.
+ * So if none of them can match, the combinator can be skipped without
+ * walking up the tree.
+ */
+static gboolean
+gtk_css_selector_tree_reject (const GtkCssSelectorTree *tree,
+                              const GtkCssBloomFilter  *ancestors,
+                              gboolean                  in_ancestor)
+{
+  const GtkCssSelector *selector = &tree->selector;
+  const GtkCssSelectorTree *prev;
+
+  if (selector->class == &GTK_CSS_SELECTOR_NAME)
+    return in_ancestor &&
+           !gtk_css_bloom_filter_may_contain (ancestors, gtk_css_bloom_filter_hash_name (selector->name.name));
+  else if (selector->class == &GTK_CSS_SELECTOR_CLASS)
+    return in_ancestor &&
+           !gtk_css_bloom_filter_may_contain (ancestors, gtk_css_bloom_filter_hash_class (selector->style_class.style_class));
+  else if (selector->class == &GTK_CSS_SELECTOR_ID)
+    return in_ancestor &&
+           !gtk_css_bloom_filter_may_contain (ancestors, gtk_css_bloom_filter_hash_id (selector->id.name));
+  else if (!gtk_css_selector_is_ancestor_combinator (selector))
+    return FALSE;
+
+  if (gtk_css_selector_tree_get_matches (tree))
+    return FALSE;
+
+  for (prev = gtk_css_selector_tree_get_previous (tree);
+       prev != NULL;
+       prev = gtk_css_selector_tree_get_sibling (prev))
+    {
+      if (!gtk_css_selector_tree_reject (prev, ancestors, TRUE))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
 static gboolean
 gtk_css_selector_tree_match_foreach (const GtkCssSelector *selector,
                                      const GtkCssMatcher  *matcher,
-                                     gpointer              res)
+                                     gpointer              data)
 {
   const GtkCssSelectorTree *tree = (const GtkCssSelectorTree *) selector;
+  GtkCssSelectorTreeMatch *match = data;
   const GtkCssSelectorTree *prev;
+  gboolean in_ancestor;
 
   if (!gtk_css_selector_match (selector, matcher))
     return FALSE;
 
-  gtk_css_selector_tree_found_match (tree, res);
+  gtk_css_selector_tree_found_match (tree, &match->array);
+
+  in_ancestor = gtk_css_selector_is_ancestor_combinator (selector);
 
   for (prev = gtk_css_selector_tree_get_previous (tree);
        prev != NULL;
        prev = gtk_css_selector_tree_get_sibling (prev))
-    gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, res);
+    {
+      if (match->ancestors &&
+          gtk_css_selector_tree_reject (prev, match->ancestors, in_ancestor))
+        continue;
+
+      gtk_css_selector_foreach (&prev->selector, matcher, gtk_css_selector_tree_match_foreach, match);
+    }
 
   return FALSE;
 }
@@ -1501,13 +1759,16 @@ GPtrArray *
 _gtk_css_selector_tree_match_all (const GtkCssSelectorTree *tree,
 				  const GtkCssMatcher *matcher)
 {
-  GPtrArray *array = NULL;
+  GtkCssSelectorTreeMatch match;
+
+  match.array = NULL;
+  match.ancestors = _gtk_css_matcher_get_ancestors (matcher);
 
   for (; tree != NULL;
        tree = gtk_css_selector_tree_get_sibling (tree))
-    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &array);
+    gtk_css_selector_foreach (&tree->selector, matcher, gtk_css_selector_tree_match_foreach, &match);
 
-  return array;
+  return match.array;
 }
 
 /* When checking for changes via the tree we need to know if a rule further
@@ -27,6 +27,8 @@ typedef union _GtkCssSelector GtkCssSelector;
 typedef struct _GtkCssSelectorTree GtkCssSelectorTree;
 typedef struct _GtkCssSelectorTreeBuilder GtkCssSelectorTreeBuilder;
 
+#define GTK_CSS_SELECTOR_VARIANT_TYPE G_VARIANT_TYPE ("a(usuii)")
+
 GtkCssSelector *  _gtk_css_selector_parse           (GtkCssParser           *parser);
 void              _gtk_css_selector_free            (GtkCssSelector         *selector);
 
@@ -34,11 +36,17 @@ char *            _gtk_css_selector_to_string       (const GtkCssSelector   *sel
 void              _gtk_css_selector_print           (const GtkCssSelector   *selector,
                                                      GString                *str);
 
+GVariant *        _gtk_css_selector_to_variant      (const GtkCssSelector   *selector);
+GtkCssSelector *  _gtk_css_selector_from_variant    (GVariant               *variant);
+
 gboolean          _gtk_css_selector_matches         (const GtkCssSelector   *selector,
                                                      const GtkCssMatcher    *matcher);
 GtkCssChange      _gtk_css_selector_get_change      (const GtkCssSelector   *selector);
 int               _gtk_css_selector_compare         (const GtkCssSelector   *a,
                                                      const GtkCssSelector   *b);
+guint             _gtk_css_selector_hash            (const GtkCssSelector   *selector);
+gboolean          _gtk_css_selector_equal           (const GtkCssSelector   *a,
+                                                     const GtkCssSelector   *b);
 
 void         _gtk_css_selector_tree_free             (GtkCssSelectorTree       *tree);
 GPtrArray *  _gtk_css_selector_tree_match_all        (const GtkCssSelectorTree *tree,
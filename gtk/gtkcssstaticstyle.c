@@ -39,8 +39,250 @@
 #include "gtkstylepropertyprivate.h"
 #include "gtkstyleproviderprivate.h"
 
+#include <string.h>
+
 G_DEFINE_TYPE (GtkCssStaticStyle, gtk_css_static_style, GTK_TYPE_CSS_STYLE)
 
+struct _GtkCssValueGroup
+{
+  volatile int ref_count;
+  GtkCssValueGroupType type;
+  guint hash;                   /* only valid once the group is sealed */
+  gboolean sealed;              /* in the group table and immutable */
+
+  GtkCssValue *values[];
+};
+
+/* Which group each property belongs to. Properties that aren't listed
+ * end up in GTK_CSS_VALUE_GROUP_OTHER. */
+static const guint8 property_groups[GTK_CSS_PROPERTY_N_PROPERTIES] = {
+  [GTK_CSS_PROPERTY_DPI] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_SIZE] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_FAMILY] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_STYLE] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_WEIGHT] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_STRETCH] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_KERNING] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_LIGATURES] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_POSITION] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_CAPS] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_NUMERIC] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_ALTERNATES] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIANT_EAST_ASIAN] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_FEATURE_SETTINGS] = GTK_CSS_VALUE_GROUP_FONT,
+  [GTK_CSS_PROPERTY_FONT_VARIATION_SETTINGS] = GTK_CSS_VALUE_GROUP_FONT,
+
+  [GTK_CSS_PROPERTY_COLOR] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_LETTER_SPACING] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_TEXT_DECORATION_LINE] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_TEXT_DECORATION_COLOR] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_TEXT_DECORATION_STYLE] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_TEXT_SHADOW] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_CARET_COLOR] = GTK_CSS_VALUE_GROUP_TEXT,
+  [GTK_CSS_PROPERTY_SECONDARY_CARET_COLOR] = GTK_CSS_VALUE_GROUP_TEXT,
+
+  [GTK_CSS_PROPERTY_ICON_THEME] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_PALETTE] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_SOURCE] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_SIZE] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_SHADOW] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_STYLE] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_TRANSFORM] = GTK_CSS_VALUE_GROUP_ICON,
+  [GTK_CSS_PROPERTY_ICON_FILTER] = GTK_CSS_VALUE_GROUP_ICON,
+
+  [GTK_CSS_PROPERTY_BACKGROUND_COLOR] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_CLIP] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_ORIGIN] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_SIZE] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_POSITION] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_REPEAT] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_IMAGE] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BACKGROUND_BLEND_MODE] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+  [GTK_CSS_PROPERTY_BOX_SHADOW] = GTK_CSS_VALUE_GROUP_BACKGROUND,
+
+  [GTK_CSS_PROPERTY_BORDER_TOP_STYLE] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_WIDTH] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_LEFT_STYLE] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_LEFT_WIDTH] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_STYLE] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_WIDTH] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_RIGHT_STYLE] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_RIGHT_WIDTH] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_LEFT_RADIUS] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_RIGHT_RADIUS] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_RIGHT_RADIUS] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_LEFT_RADIUS] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_TOP_COLOR] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_RIGHT_COLOR] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_BOTTOM_COLOR] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_LEFT_COLOR] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_SOURCE] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_REPEAT] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_SLICE] = GTK_CSS_VALUE_GROUP_BORDER,
+  [GTK_CSS_PROPERTY_BORDER_IMAGE_WIDTH] = GTK_CSS_VALUE_GROUP_BORDER,
+
+  [GTK_CSS_PROPERTY_OUTLINE_STYLE] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_WIDTH] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_OFFSET] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_TOP_LEFT_RADIUS] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_TOP_RIGHT_RADIUS] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_BOTTOM_RIGHT_RADIUS] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_BOTTOM_LEFT_RADIUS] = GTK_CSS_VALUE_GROUP_OUTLINE,
+  [GTK_CSS_PROPERTY_OUTLINE_COLOR] = GTK_CSS_VALUE_GROUP_OUTLINE,
+
+  [GTK_CSS_PROPERTY_TRANSITION_PROPERTY] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_TRANSITION_DURATION] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_TRANSITION_TIMING_FUNCTION] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_TRANSITION_DELAY] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_NAME] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_DURATION] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_TIMING_FUNCTION] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_ITERATION_COUNT] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_DIRECTION] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_PLAY_STATE] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_DELAY] = GTK_CSS_VALUE_GROUP_ANIMATION,
+  [GTK_CSS_PROPERTY_ANIMATION_FILL_MODE] = GTK_CSS_VALUE_GROUP_ANIMATION,
+};
+
+/* Position of each property in its group, and the size of the groups.
+ * Filled in by class_init. */
+static guint8 property_indexes[GTK_CSS_PROPERTY_N_PROPERTIES];
+static guint group_sizes[GTK_CSS_VALUE_N_GROUPS];
+
+/* All sealed groups, so styles with identical values share them. The
+ * table holds no references; groups remove themselves when they die. */
+static GHashTable *group_table;
+static GMutex group_lock;
+
+static GtkCssValueGroup *
+gtk_css_value_group_new (GtkCssValueGroupType type)
+{
+  GtkCssValueGroup *group;
+
+  group = g_malloc0 (sizeof (GtkCssValueGroup) + group_sizes[type] * sizeof (GtkCssValue *));
+  group->ref_count = 1;
+  group->type = type;
+
+  return group;
+}
+
+static GtkCssValueGroup *
+gtk_css_value_group_ref (GtkCssValueGroup *group)
+{
+  g_atomic_int_inc (&group->ref_count);
+
+  return group;
+}
+
+static void
+gtk_css_value_group_unref (GtkCssValueGroup *group)
+{
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&group->ref_count))
+    return;
+
+  if (group->sealed)
+    {
+      g_mutex_lock (&group_lock);
+      /* An equal group might have taken our place already */
+      if (g_hash_table_lookup (group_table, group) == group)
+        g_hash_table_remove (group_table, group);
+      g_mutex_unlock (&group_lock);
+    }
+
+  for (i = 0; i < group_sizes[group->type]; i++)
+    {
+      if (group->values[i])
+        _gtk_css_value_unref (group->values[i]);
+    }
+
+  g_free (group);
+}
+
+static gboolean
+gtk_css_value_group_equal_values (const GtkCssValueGroup *group1,
+                                  const GtkCssValueGroup *group2)
+{
+  /* Values are compared by identity. That is cheap and catches the
+   * common cases: inherited values and values computed from the same
+   * declaration are the same instance. */
+  return group1->type == group2->type &&
+         memcmp (group1->values, group2->values, group_sizes[group1->type] * sizeof (GtkCssValue *)) == 0;
+}
+
+static guint
+gtk_css_value_group_hash (gconstpointer data)
+{
+  const GtkCssValueGroup *group = data;
+
+  return group->hash;
+}
+
+static gboolean
+gtk_css_value_group_equal (gconstpointer data1,
+                           gconstpointer data2)
+{
+  return gtk_css_value_group_equal_values (data1, data2);
+}
+
+/* Makes @group immutable and returns the group that should be used in
+ * its place, which is an existing equal group if there is one. */
+static GtkCssValueGroup *
+gtk_css_value_group_seal (GtkCssValueGroup *group,
+                          GtkCssValueGroup *parent_group)
+{
+  GtkCssValueGroup *existing;
+  guint i, hash;
+
+  /* Children that don't set any property of a group end up with the
+   * same values as their parent, no need to go to the table for that */
+  if (parent_group && gtk_css_value_group_equal_values (group, parent_group))
+    {
+      gtk_css_value_group_unref (group);
+      return gtk_css_value_group_ref (parent_group);
+    }
+
+  hash = group->type;
+  for (i = 0; i < group_sizes[group->type]; i++)
+    hash = (hash << 5) - hash + GPOINTER_TO_UINT (group->values[i]);
+  group->hash = hash;
+
+  g_mutex_lock (&group_lock);
+
+  if (group_table == NULL)
+    group_table = g_hash_table_new (gtk_css_value_group_hash, gtk_css_value_group_equal);
+
+  existing = g_hash_table_lookup (group_table, group);
+  if (existing)
+    {
+      int ref_count;
+
+      /* Don't resurrect a group that is waiting for the lock to
+       * remove itself */
+      do
+        {
+          ref_count = g_atomic_int_get (&existing->ref_count);
+        }
+      while (ref_count > 0 &&
+             !g_atomic_int_compare_and_exchange (&existing->ref_count, ref_count, ref_count + 1));
+
+      if (ref_count > 0)
+        {
+          g_mutex_unlock (&group_lock);
+          gtk_css_value_group_unref (group);
+          return existing;
+        }
+    }
+
+  group->sealed = TRUE;
+  g_hash_table_replace (group_table, group, group);
+
+  g_mutex_unlock (&group_lock);
+
+  return group;
+}
+
 static GtkCssValue *
 gtk_css_static_style_get_value (GtkCssStyle *style,
                                 guint        id)
@@ -48,7 +290,7 @@ gtk_css_static_style_get_value (GtkCssStyle *style,
   /* This is called a lot, so we avoid a dynamic type check here */
   GtkCssStaticStyle *sstyle = (GtkCssStaticStyle *) style;
 
-  return sstyle->values[id];
+  return sstyle->groups[property_groups[id]]->values[property_indexes[id]];
 }
 
 static GtkCssSection *
@@ -70,11 +312,8 @@ gtk_css_static_style_dispose (GObject *object)
   GtkCssStaticStyle *style = GTK_CSS_STATIC_STYLE (object);
   guint i;
 
-  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
-    {
-      if (style->values[i])
-        _gtk_css_value_unref (style->values[i]);
-    }
+  for (i = 0; i < GTK_CSS_VALUE_N_GROUPS; i++)
+    g_clear_pointer (&style->groups[i], gtk_css_value_group_unref);
   if (style->sections)
     {
       g_ptr_array_unref (style->sections);
@@ -89,6 +328,10 @@ gtk_css_static_style_class_init (GtkCssStaticStyleClass *klass)
 {
   GObjectClass *object_class = G_OBJECT_CLASS (klass);
   GtkCssStyleClass *style_class = GTK_CSS_STYLE_CLASS (klass);
+  guint i;
+
+  for (i = 0; i < GTK_CSS_PROPERTY_N_PROPERTIES; i++)
+    property_indexes[i] = group_sizes[property_groups[i]]++;
 
   object_class->dispose = gtk_css_static_style_dispose;
 
@@ -99,6 +342,12 @@ gtk_css_static_style_class_init (GtkCssStaticStyleClass *klass)
 static void
 gtk_css_static_style_init (GtkCssStaticStyle *style)
 {
+  guint i;
+
+  /* Private to the style until it is computed, see
+   * gtk_css_static_style_new_compute() */
+  for (i = 0; i < GTK_CSS_VALUE_N_GROUPS; i++)
+    style->groups[i] = gtk_css_value_group_new (i);
 }
 
 static void
@@ -114,9 +363,14 @@ gtk_css_static_style_set_value (GtkCssStaticStyle *style,
                                 GtkCssValue       *value,
                                 GtkCssSection     *section)
 {
-  if (style->values[id])
-    _gtk_css_value_unref (style->values[id]);
-  style->values[id] = _gtk_css_value_ref (value);
+  GtkCssValueGroup *group = style->groups[property_groups[id]];
+  guint pos = property_indexes[id];
+
+  g_assert (!group->sealed);
+
+  if (group->values[pos])
+    _gtk_css_value_unref (group->values[pos]);
+  group->values[pos] = _gtk_css_value_ref (value);
 
   if (style->sections && style->sections->len > id && g_ptr_array_index (style->sections, id))
     {
@@ -166,6 +420,24 @@ gtk_css_static_style_get_default (void)
   return default_style;
 }
 
+/* Swaps the groups of @style for shared ones where possible */
+static void
+gtk_css_static_style_seal (GtkCssStaticStyle *style,
+                           GtkCssStyle       *parent)
+{
+  GtkCssStaticStyle *parent_style;
+  guint i;
+
+  if (parent && GTK_IS_CSS_STATIC_STYLE (parent))
+    parent_style = GTK_CSS_STATIC_STYLE (parent);
+  else
+    parent_style = NULL;
+
+  for (i = 0; i < GTK_CSS_VALUE_N_GROUPS; i++)
+    style->groups[i] = gtk_css_value_group_seal (style->groups[i],
+                                                 parent_style ? parent_style->groups[i] : NULL);
+}
+
 GtkCssStyle *
 gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
                                   const GtkCssMatcher *matcher,
@@ -194,6 +466,8 @@ gtk_css_static_style_new_compute (GtkStyleProvider    *provider,
 
   _gtk_css_lookup_destroy (&lookup);
 
+  gtk_css_static_style_seal (result, parent);
+
   return GTK_CSS_STYLE (result);
 }
 
@@ -244,3 +518,16 @@ gtk_css_static_style_get_change (GtkCssStaticStyle *style)
 
   return style->change;
 }
+
+/* Checks whether the two styles use the same instance of the group
+ * containing the property @id, so they have the same value for it
+ * without comparing it. */
+gboolean
+gtk_css_static_style_shares_value (GtkCssStaticStyle *style1,
+                                   GtkCssStaticStyle *style2,
+                                   guint              id)
+{
+  guint group = property_groups[id];
+
+  return style1->groups[group] == style2->groups[group];
+}
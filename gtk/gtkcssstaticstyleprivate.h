@@ -34,12 +34,31 @@ G_BEGIN_DECLS
 
 typedef struct _GtkCssStaticStyle           GtkCssStaticStyle;
 typedef struct _GtkCssStaticStyleClass      GtkCssStaticStyleClass;
+typedef struct _GtkCssValueGroup            GtkCssValueGroup;
+
+/* The values of a style are split into groups of related properties.
+ * Groups are immutable once the style is computed and get shared by all
+ * styles with identical values for them - most importantly, a child that
+ * doesn't set any font property shares the font group of its parent.
+ */
+typedef enum {
+  GTK_CSS_VALUE_GROUP_OTHER,
+  GTK_CSS_VALUE_GROUP_FONT,
+  GTK_CSS_VALUE_GROUP_TEXT,
+  GTK_CSS_VALUE_GROUP_ICON,
+  GTK_CSS_VALUE_GROUP_BACKGROUND,
+  GTK_CSS_VALUE_GROUP_BORDER,
+  GTK_CSS_VALUE_GROUP_OUTLINE,
+  GTK_CSS_VALUE_GROUP_ANIMATION,
+  /* add more */
+  GTK_CSS_VALUE_N_GROUPS
+} GtkCssValueGroupType;
 
 struct _GtkCssStaticStyle
 {
   GtkCssStyle parent;
 
-  GtkCssValue           *values[GTK_CSS_PROPERTY_N_PROPERTIES]; /* the values */
+  GtkCssValueGroup      *groups[GTK_CSS_VALUE_N_GROUPS]; /* the values */
   GPtrArray             *sections;             /* sections the values are defined in */
 
   GtkCssChange           change;               /* change as returned by value lookup */
@@ -65,6 +84,9 @@ void                    gtk_css_static_style_compute_value      (GtkCssStaticSty
                                                                  GtkCssSection          *section);
 
 GtkCssChange            gtk_css_static_style_get_change         (GtkCssStaticStyle      *style);
+gboolean                gtk_css_static_style_shares_value       (GtkCssStaticStyle      *style1,
+                                                                 GtkCssStaticStyle      *style2,
+                                                                 guint                   id);
 
 G_END_DECLS
 
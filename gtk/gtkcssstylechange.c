@@ -19,8 +19,27 @@
 
 #include "gtkcssstylechangeprivate.h"
 
+#include "gtkcssanimatedstyleprivate.h"
+#include "gtkcssstaticstyleprivate.h"
 #include "gtkcssstylepropertyprivate.h"
 
+static GtkCssStyle *
+gtk_css_style_get_base_style (GtkCssStyle *style)
+{
+  if (GTK_IS_CSS_ANIMATED_STYLE (style))
+    return GTK_CSS_ANIMATED_STYLE (style)->style;
+
+  return style;
+}
+
+static gboolean
+gtk_css_style_is_animated_value (GtkCssStyle *style,
+                                 guint        id)
+{
+  return GTK_IS_CSS_ANIMATED_STYLE (style) &&
+         gtk_css_animated_style_has_animated_value (GTK_CSS_ANIMATED_STYLE (style), id);
+}
+
 void
 gtk_css_style_change_init (GtkCssStyleChange *change,
                            GtkCssStyle       *old_style,
@@ -30,6 +49,11 @@ gtk_css_style_change_init (GtkCssStyleChange *change,
   change->new_style = g_object_ref (new_style);
 
   change->n_compared = 0;
+  change->both_static = GTK_IS_CSS_STATIC_STYLE (old_style) && GTK_IS_CSS_STATIC_STYLE (new_style);
+  /* The frames of an animation, and its start and end, all share their
+   * static style */
+  change->same_base = !change->both_static &&
+                      gtk_css_style_get_base_style (old_style) == gtk_css_style_get_base_style (new_style);
 
   change->affects = 0;
   change->changes = _gtk_bitmask_new ();
@@ -59,13 +83,30 @@ gtk_css_style_change_get_new_style (GtkCssStyleChange *change)
   return change->new_style;
 }
 
+static gboolean
+gtk_css_style_change_may_differ (GtkCssStyleChange *change,
+                                 guint              id)
+{
+  if (change->both_static)
+    return !gtk_css_static_style_shares_value ((GtkCssStaticStyle *) change->old_style,
+                                               (GtkCssStaticStyle *) change->new_style,
+                                               id);
+
+  if (change->same_base)
+    return gtk_css_style_is_animated_value (change->old_style, id) ||
+           gtk_css_style_is_animated_value (change->new_style, id);
+
+  return TRUE;
+}
+
 static gboolean
 gtk_css_style_compare_next_value (GtkCssStyleChange *change)
 {
   if (change->n_compared == GTK_CSS_PROPERTY_N_PROPERTIES)
     return FALSE;
 
-  if (!_gtk_css_value_equal (gtk_css_style_get_value (change->old_style, change->n_compared),
+  if (gtk_css_style_change_may_differ (change, change->n_compared) &&
+      !_gtk_css_value_equal (gtk_css_style_get_value (change->old_style, change->n_compared),
                              gtk_css_style_get_value (change->new_style, change->n_compared)))
     {
       change->affects |= _gtk_css_style_property_get_affects (_gtk_css_style_property_lookup_by_id (change->n_compared));
@@ -29,6 +29,8 @@ struct _GtkCssStyleChange {
   GtkCssStyle   *new_style;
 
   guint          n_compared;
+  gboolean       both_static;     /* values in shared groups are known to be equal */
+  gboolean       same_base;       /* only animated values can differ */
 
   GtkCssAffects  affects;
   GtkBitmask    *changes;
@@ -48,7 +48,7 @@ gtk_css_value_ref (GtkCssValue *value)
 {
   gtk_internal_return_val_if_fail (value != NULL, NULL);
 
-  value->ref_count += 1;
+  g_atomic_int_inc (&value->ref_count);
 
   return value;
 }
@@ -59,8 +59,7 @@ gtk_css_value_unref (GtkCssValue *value)
   if (value == NULL)
     return;
 
-  value->ref_count -= 1;
-  if (value->ref_count > 0)
+  if (!g_atomic_int_dec_and_test (&value->ref_count))
     return;
 
   value->class->free (value);
@@ -97,6 +96,42 @@ _gtk_css_value_compute (GtkCssValue      *value,
   return value->class->compute (value, property_id, provider, style, parent_style);
 }
 
+static GPrivate compute_deferred;
+
+/* Styles can be computed on worker threads, see gtkcssnode.c. Between
+ * these two calls, _gtk_css_value_compute_must_defer() returns %TRUE and
+ * sets @deferred.
+ */
+void
+_gtk_css_value_compute_begin_threaded (gboolean *deferred)
+{
+  *deferred = FALSE;
+  g_private_set (&compute_deferred, deferred);
+}
+
+void
+_gtk_css_value_compute_end_threaded (void)
+{
+  g_private_set (&compute_deferred, NULL);
+}
+
+/* Values whose computation has side effects - loading files, emitting
+ * errors, creating objects shared with the main thread - must check this
+ * first. If it returns %TRUE, they must return without doing any of that,
+ * and the style will be computed again on the main thread.
+ */
+gboolean
+_gtk_css_value_compute_must_defer (void)
+{
+  gboolean *deferred = g_private_get (&compute_deferred);
+
+  if (deferred == NULL)
+    return FALSE;
+
+  *deferred = TRUE;
+  return TRUE;
+}
+
 gboolean
 _gtk_css_value_equal (const GtkCssValue *value1,
                       const GtkCssValue *value2)
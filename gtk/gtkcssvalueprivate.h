@@ -74,6 +74,9 @@ GtkCssValue *_gtk_css_value_compute                   (GtkCssValue
                                                        GtkStyleProvider           *provider,
                                                        GtkCssStyle                *style,
                                                        GtkCssStyle                *parent_style);
+void         _gtk_css_value_compute_begin_threaded    (gboolean                   *deferred);
+void         _gtk_css_value_compute_end_threaded      (void);
+gboolean     _gtk_css_value_compute_must_defer        (void);
 gboolean     _gtk_css_value_equal                     (const GtkCssValue          *value1,
                                                        const GtkCssValue          *value2);
 gboolean     _gtk_css_value_equal0                    (const GtkCssValue          *value1,
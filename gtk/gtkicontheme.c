@@ -168,18 +168,6 @@ typedef struct {
   GtkIconLookupFlags flags;
 } IconInfoKey;
 
-typedef struct _SymbolicPixbufCache SymbolicPixbufCache;
-
-struct _SymbolicPixbufCache {
-  GdkPixbuf *pixbuf;
-  GdkPixbuf *proxy_pixbuf;
-  GdkRGBA  fg;
-  GdkRGBA  success_color;
-  GdkRGBA  warning_color;
-  GdkRGBA  error_color;
-  SymbolicPixbufCache *next;
-};
-
 struct _GtkIconInfoClass
 {
   GObjectClass parent_class;
@@ -224,16 +212,16 @@ struct _GtkIconInfo
    * the icon.
    */
   GdkPixbuf *pixbuf;
+  /* pixbuf before the emblems were applied, symbolic icons are
+   * recolored from this so the emblems keep their own colors
+   */
+  GdkPixbuf *unemblemed_pixbuf;
   GdkPixbuf *proxy_pixbuf;
   GdkTexture *texture;
   GError *load_error;
   gdouble unscaled_scale;
   gdouble scale;
 
-  SymbolicPixbufCache *symbolic_pixbuf_cache;
-
-  gint symbolic_width;
-  gint symbolic_height;
 };
 
 typedef struct
@@ -1500,85 +1488,6 @@ remove_from_lru_cache (GtkIconTheme *icon_theme,
     }
 }
 
-static SymbolicPixbufCache *
-symbolic_pixbuf_cache_new (GdkPixbuf           *pixbuf,
-                           const GdkRGBA       *fg,
-                           const GdkRGBA       *success_color,
-                           const GdkRGBA       *warning_color,
-                           const GdkRGBA       *error_color,
-                           SymbolicPixbufCache *next)
-{
-  SymbolicPixbufCache *cache;
-
-  cache = g_new0 (SymbolicPixbufCache, 1);
-  cache->pixbuf = g_object_ref (pixbuf);
-  if (fg)
-    cache->fg = *fg;
-  if (success_color)
-    cache->success_color = *success_color;
-  if (warning_color)
-    cache->warning_color = *warning_color;
-  if (error_color)
-    cache->error_color = *error_color;
-  cache->next = next;
-  return cache;
-}
-
-static gboolean
-rgba_matches (const GdkRGBA *a,
-              const GdkRGBA *b)
-{
-  GdkRGBA transparent = { 0 };
-
-  /* For matching we treat unset colors as transparent rather
-     than default, which works as well, because transparent
-     will never be used for real symbolic icon colors */
-  if (a == NULL)
-    a = &transparent;
-
-  return
-    fabs(a->red - b->red) < 0.0001 &&
-    fabs(a->green - b->green) < 0.0001 &&
-    fabs(a->blue - b->blue) < 0.0001 &&
-    fabs(a->alpha - b->alpha) < 0.0001;
-}
-
-static SymbolicPixbufCache *
-symbolic_pixbuf_cache_matches (SymbolicPixbufCache *cache,
-                               const GdkRGBA       *fg,
-                               const GdkRGBA       *success_color,
-                               const GdkRGBA       *warning_color,
-                               const GdkRGBA       *error_color)
-{
-  while (cache != NULL)
-    {
-      if (rgba_matches (fg, &cache->fg) &&
-          rgba_matches (success_color, &cache->success_color) &&
-          rgba_matches (warning_color, &cache->warning_color) &&
-          rgba_matches (error_color, &cache->error_color))
-        return cache;
-
-      cache = cache->next;
-    }
-
-  return NULL;
-}
-
-static void
-symbolic_pixbuf_cache_free (SymbolicPixbufCache *cache)
-{
-  SymbolicPixbufCache *next;
-
-  while (cache != NULL)
-    {
-      next = cache->next;
-      g_object_unref (cache->pixbuf);
-      g_free (cache);
-
-      cache = next;
-    }
-}
-
 static gboolean
 icon_name_is_symbolic (const gchar *icon_name)
 {
@@ -3285,6 +3194,8 @@ icon_info_dup (GtkIconInfo *icon_info)
     dup->loadable = g_object_ref (icon_info->loadable);
   if (icon_info->pixbuf)
     dup->pixbuf = g_object_ref (icon_info->pixbuf);
+  if (icon_info->unemblemed_pixbuf)
+    dup->unemblemed_pixbuf = g_object_ref (icon_info->unemblemed_pixbuf);
 
   for (l = icon_info->emblem_infos; l != NULL; l = l->next)
     {
@@ -3305,8 +3216,6 @@ icon_info_dup (GtkIconInfo *icon_info)
   dup->is_resource = icon_info->is_resource;
   dup->min_size = icon_info->min_size;
   dup->max_size = icon_info->max_size;
-  dup->symbolic_width = icon_info->symbolic_width;
-  dup->symbolic_height = icon_info->symbolic_height;
 
   return dup;
 }
@@ -3327,12 +3236,11 @@ gtk_icon_info_finalize (GObject *object)
   g_clear_object (&icon_info->loadable);
   g_slist_free_full (icon_info->emblem_infos, (GDestroyNotify) g_object_unref);
   g_clear_object (&icon_info->pixbuf);
+  g_clear_object (&icon_info->unemblemed_pixbuf);
   g_clear_object (&icon_info->proxy_pixbuf);
   g_clear_object (&icon_info->cache_pixbuf);
   g_clear_error (&icon_info->load_error);
 
-  symbolic_pixbuf_cache_free (icon_info->symbolic_pixbuf_cache);
-
   G_OBJECT_CLASS (gtk_icon_info_parent_class)->finalize (object);
 }
 
@@ -3530,7 +3438,8 @@ apply_emblems (GtkIconInfo *info)
 
   if (icon)
     {
-      g_object_unref (info->pixbuf);
+      g_clear_object (&info->unemblemed_pixbuf);
+      info->unemblemed_pixbuf = info->pixbuf;
       info->pixbuf = icon;
       info->emblems_applied = TRUE;
     }
@@ -3969,6 +3878,9 @@ gtk_icon_info_load_icon_finish (GtkIconInfo   *icon_info,
       g_clear_object (&icon_info->pixbuf);
       if (dup->pixbuf)
         icon_info->pixbuf = g_object_ref (dup->pixbuf);
+      g_clear_object (&icon_info->unemblemed_pixbuf);
+      if (dup->unemblemed_pixbuf)
+        icon_info->unemblemed_pixbuf = g_object_ref (dup->unemblemed_pixbuf);
       g_clear_error (&icon_info->load_error);
       if (dup->load_error)
         icon_info->load_error = g_error_copy (dup->load_error);
@@ -3980,67 +3892,6 @@ gtk_icon_info_load_icon_finish (GtkIconInfo   *icon_info,
   return gtk_icon_info_load_icon (icon_info, error);
 }
 
-static void
-proxy_symbolic_pixbuf_destroy (guchar   *pixels,
-                               gpointer  data)
-{
-  GtkIconInfo *icon_info = data;
-  GtkIconTheme *icon_theme = icon_info->in_cache;
-  SymbolicPixbufCache *symbolic_cache;
-
-  for (symbolic_cache = icon_info->symbolic_pixbuf_cache;
-       symbolic_cache != NULL;
-       symbolic_cache = symbolic_cache->next)
-    {
-      if (symbolic_cache->proxy_pixbuf != NULL &&
-          gdk_pixbuf_get_pixels (symbolic_cache->proxy_pixbuf) == pixels)
-        break;
-    }
-
-  g_assert (symbolic_cache != NULL);
-  g_assert (symbolic_cache->proxy_pixbuf != NULL);
-
-  symbolic_cache->proxy_pixbuf = NULL;
-
-  /* Keep it alive a bit longer */
-  if (icon_theme != NULL)
-    ensure_in_lru_cache (icon_theme, icon_info);
-
-  g_object_unref (icon_info);
-}
-
-static GdkPixbuf *
-symbolic_cache_get_proxy (SymbolicPixbufCache *symbolic_cache,
-                          GtkIconInfo         *icon_info)
-{
-  if (symbolic_cache->proxy_pixbuf)
-    return g_object_ref (symbolic_cache->proxy_pixbuf);
-
-  symbolic_cache->proxy_pixbuf =
-    gdk_pixbuf_new_from_data (gdk_pixbuf_get_pixels (symbolic_cache->pixbuf),
-                              gdk_pixbuf_get_colorspace (symbolic_cache->pixbuf),
-                              gdk_pixbuf_get_has_alpha (symbolic_cache->pixbuf),
-                              gdk_pixbuf_get_bits_per_sample (symbolic_cache->pixbuf),
-                              gdk_pixbuf_get_width (symbolic_cache->pixbuf),
-                              gdk_pixbuf_get_height (symbolic_cache->pixbuf),
-                              gdk_pixbuf_get_rowstride (symbolic_cache->pixbuf),
-                              proxy_symbolic_pixbuf_destroy,
-                              g_object_ref (icon_info));
-
-  return symbolic_cache->proxy_pixbuf;
-}
-
-static gchar *
-rgba_to_string_noalpha (const GdkRGBA *rgba)
-{
-  GdkRGBA color;
-
-  color = *rgba;
-  color.alpha = 1.0;
-
-  return gdk_rgba_to_string (&color);
-}
-
 static void
 rgba_to_pixel(const GdkRGBA  *rgba,
 	      guint8 pixel[4])
@@ -4135,18 +3986,25 @@ gtk_icon_theme_color_symbolic_pixbuf (GdkPixbuf     *symbolic,
   return colored;
 }
 
+/* Symbolic icons are loaded as masks, with the alpha channel holding
+ * the coverage of the whole icon and the red, green and blue channels
+ * holding the fractions of it that use the success, warning and error
+ * color (see gtk_make_symbolic_pixbuf_from_data()). Those get rendered
+ * once, and every color combination is composited from them.
+ */
 static GdkPixbuf *
-gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
-                                 const GdkRGBA  *fg,
-                                 const GdkRGBA  *success_color,
-                                 const GdkRGBA  *warning_color,
-                                 const GdkRGBA  *error_color,
-                                 GError        **error)
+gtk_icon_info_load_symbolic_internal (GtkIconInfo    *icon_info,
+                                      const GdkRGBA  *fg,
+                                      const GdkRGBA  *success_color,
+                                      const GdkRGBA  *warning_color,
+                                      const GdkRGBA  *error_color,
+                                      GError        **error)
 {
   GdkRGBA fg_default = { 0.7450980392156863, 0.7450980392156863, 0.7450980392156863, 1.0};
   GdkRGBA success_default = { 0.3046921492332342,0.6015716792553597, 0.023437857633325704, 1.0};
   GdkRGBA warning_default = {0.9570458533607996, 0.47266346227206835, 0.2421911955443656, 1.0 };
   GdkRGBA error_default = { 0.796887159533074, 0 ,0, 1.0 };
+  GdkPixbuf *pixbuf, *icon;
 
   if (!icon_info_ensure_scale_and_pixbuf (icon_info))
     {
@@ -4166,220 +4024,29 @@ gtk_icon_info_load_symbolic_png (GtkIconInfo    *icon_info,
       return NULL;
     }
 
-  return gtk_icon_theme_color_symbolic_pixbuf (icon_info->pixbuf,
-                                               fg ? fg : &fg_default,
-                                               success_color ? success_color : &success_default,
-                                               warning_color ? warning_color : &warning_default,
-                                               error_color ? error_color : &error_default);
-}
-
-static GdkPixbuf *
-gtk_icon_info_load_symbolic_svg (GtkIconInfo    *icon_info,
-                                 const GdkRGBA  *fg,
-                                 const GdkRGBA  *success_color,
-                                 const GdkRGBA  *warning_color,
-                                 const GdkRGBA  *error_color,
-                                 GError        **error)
-{
-  GInputStream *stream;
-  GdkPixbuf *pixbuf;
-  gchar *css_fg;
-  gchar *css_success;
-  gchar *css_warning;
-  gchar *css_error;
-  gchar *data;
-  gchar *width;
-  gchar *height;
-  gchar *file_data, *escaped_file_data;
-  gsize file_len;
-  gint symbolic_size;
-  double alpha;
-  gchar alphastr[G_ASCII_DTOSTR_BUF_SIZE];
-
-  alpha = fg->alpha;
-
-  css_fg = rgba_to_string_noalpha (fg);
-
-  css_success = css_warning = css_error = NULL;
-
-  if (warning_color)
-    css_warning = rgba_to_string_noalpha (warning_color);
-  else
-    css_warning = g_strdup ("rgb(245,121,62)");
-
-  if (error_color)
-    css_error = rgba_to_string_noalpha (error_color);
-  else
-    css_error = g_strdup ("rgb(204,0,0)");
-
-  if (success_color)
-    css_success = rgba_to_string_noalpha (success_color);
-  else
-    css_success = g_strdup ("rgb(78,154,6)");
-
-  if (!g_file_load_contents (icon_info->icon_file, NULL, &file_data, &file_len, NULL, error))
-    return NULL;
-
-  if (!icon_info_ensure_scale_and_pixbuf (icon_info))
-    {
-      g_propagate_error (error, icon_info->load_error);
-      icon_info->load_error = NULL;
-      g_free (css_fg);
-      g_free (css_warning);
-      g_free (css_error);
-      g_free (css_success);
-      g_free (file_data);
-      return NULL;
-    }
-
-  if (icon_info->symbolic_width == 0 ||
-      icon_info->symbolic_height == 0)
+  /* Recolor the mask without the emblems, and add those on top */
+  pixbuf = gtk_icon_theme_color_symbolic_pixbuf (icon_info->emblems_applied
+                                                 ? icon_info->unemblemed_pixbuf
+                                                 : icon_info->pixbuf,
+                                                 fg ? fg : &fg_default,
+                                                 success_color ? success_color : &success_default,
+                                                 warning_color ? warning_color : &warning_default,
+                                                 error_color ? error_color : &error_default);
+
+  icon = apply_emblems_to_pixbuf (pixbuf, icon_info);
+  if (icon != NULL)
     {
-      /* Fetch size from the original icon */
-      stream = g_memory_input_stream_new_from_data (file_data, file_len, NULL);
-      pixbuf = gdk_pixbuf_new_from_stream (stream, NULL, error);
-      g_object_unref (stream);
-
-      if (!pixbuf)
-        {
-          g_free (css_fg);
-          g_free (css_warning);
-          g_free (css_error);
-          g_free (css_success);
-          g_free (file_data);
-          return NULL;
-        }
-
-      icon_info->symbolic_width = gdk_pixbuf_get_width (pixbuf);
-      icon_info->symbolic_height = gdk_pixbuf_get_height (pixbuf);
       g_object_unref (pixbuf);
+      pixbuf = icon;
     }
 
-  symbolic_size = MAX (icon_info->symbolic_width, icon_info->symbolic_height);
-
-  GTK_NOTE (ICONTHEME,
-  if (icon_info->dir_type == ICON_THEME_DIR_UNTHEMED)
-    g_message ("Symbolic icon %s is not in an icon theme directory",
-               icon_info->key.icon_names ? icon_info->key.icon_names[0] : icon_info->filename);
-  else if (icon_info->dir_size * icon_info->dir_scale != symbolic_size)
-    g_message ("Symbolic icon %s of size %d is in an icon theme directory of size %d",
-               icon_info->key.icon_names ? icon_info->key.icon_names[0] : icon_info->filename,
-               symbolic_size,
-               icon_info->dir_size * icon_info->dir_scale)
-  );
-
-  width = g_strdup_printf ("%d", icon_info->symbolic_width);
-  height = g_strdup_printf ("%d", icon_info->symbolic_height);
-
-  escaped_file_data = g_markup_escape_text (file_data, file_len);
-  g_free (file_data);
-
-  g_ascii_dtostr (alphastr, G_ASCII_DTOSTR_BUF_SIZE, CLAMP (alpha, 0, 1));
-
-  data = g_strconcat ("<?xml version=\"1.0\" encoding=\"UTF-8\" standalone=\"no\"?>\n"
-                      "<svg version=\"1.1\"\n"
-                      "     xmlns=\"http://www.w3.org/2000/svg\"\n"
-                      "     xmlns:xi=\"http://www.w3.org/2001/XInclude\"\n"
-                      "     width=\"", width, "\"\n"
-                      "     height=\"", height, "\">\n"
-                      "  <style type=\"text/css\">\n"
-                      "    rect,path {\n"
-                      "      fill: ", css_fg," !important;\n"
-                      "    }\n"
-                      "    .warning {\n"
-                      "      fill: ", css_warning, " !important;\n"
-                      "    }\n"
-                      "    .error {\n"
-                      "      fill: ", css_error ," !important;\n"
-                      "    }\n"
-                      "    .success {\n"
-                      "      fill: ", css_success, " !important;\n"
-                      "    }\n"
-                      "  </style>\n"
-                      "  <g opacity=\"", alphastr, "\" ><xi:include href=\"data:text/xml,", escaped_file_data, "\"/></g>\n"
-                      "</svg>",
-                      NULL);
-  g_free (escaped_file_data);
-  g_free (css_fg);
-  g_free (css_warning);
-  g_free (css_error);
-  g_free (css_success);
-  g_free (width);
-  g_free (height);
-
-  stream = g_memory_input_stream_new_from_data (data, -1, g_free);
-  pixbuf = gdk_pixbuf_new_from_stream_at_scale (stream,
-                                                gdk_pixbuf_get_width (icon_info->pixbuf),
-                                                gdk_pixbuf_get_height (icon_info->pixbuf),
-                                                TRUE,
-                                                NULL,
-                                                error);
-  g_object_unref (stream);
+  /* Keep the masks around for the next color change */
+  if (icon_info->in_cache != NULL)
+    ensure_in_lru_cache (icon_info->in_cache, icon_info);
 
   return pixbuf;
 }
 
-
-static GdkPixbuf *
-gtk_icon_info_load_symbolic_internal (GtkIconInfo    *icon_info,
-				      const GdkRGBA  *fg,
-				      const GdkRGBA  *success_color,
-				      const GdkRGBA  *warning_color,
-				      const GdkRGBA  *error_color,
-				      gboolean        use_cache,
-				      GError        **error)
-{
-  GdkPixbuf *pixbuf;
-  SymbolicPixbufCache *symbolic_cache;
-  char *icon_uri;
-
-  if (use_cache)
-    {
-      symbolic_cache = symbolic_pixbuf_cache_matches (icon_info->symbolic_pixbuf_cache,
-						      fg, success_color, warning_color, error_color);
-      if (symbolic_cache)
-	return symbolic_cache_get_proxy (symbolic_cache, icon_info);
-    }
-
-  /* css_fg can't possibly have failed, otherwise
-   * that would mean we have a broken style
-   */
-  g_return_val_if_fail (fg != NULL, NULL);
-
-  icon_uri = g_file_get_uri (icon_info->icon_file);
-  if (g_str_has_suffix (icon_uri, ".symbolic.png"))
-    pixbuf = gtk_icon_info_load_symbolic_png (icon_info, fg, success_color, warning_color, error_color, error);
-  else
-    pixbuf = gtk_icon_info_load_symbolic_svg (icon_info, fg, success_color, warning_color, error_color, error);
-
-  g_free (icon_uri);
-
-  if (pixbuf != NULL)
-    {
-      GdkPixbuf *icon;
-
-      icon = apply_emblems_to_pixbuf (pixbuf, icon_info);
-      if (icon != NULL)
-        {
-          g_object_unref (pixbuf);
-          pixbuf = icon;
-        }
-
-      if (use_cache)
-        {
-          icon_info->symbolic_pixbuf_cache =
-            symbolic_pixbuf_cache_new (pixbuf, fg, success_color, warning_color, error_color,
-                                       icon_info->symbolic_pixbuf_cache);
-          g_object_unref (pixbuf);
-          return symbolic_cache_get_proxy (icon_info->symbolic_pixbuf_cache, icon_info);
-        }
-      else
-        return pixbuf;
-    }
-
-  return NULL;
-}
-
 /**
  * gtk_icon_info_load_symbolic:
  * @icon_info: a #GtkIconInfo
@@ -4440,7 +4107,6 @@ gtk_icon_info_load_symbolic (GtkIconInfo    *icon_info,
   return gtk_icon_info_load_symbolic_internal (icon_info,
                                                fg, success_color,
                                                warning_color, error_color,
-                                               TRUE,
                                                error);
 }
 
@@ -4530,7 +4196,6 @@ gtk_icon_info_load_symbolic_for_context (GtkIconInfo      *icon_info,
   return gtk_icon_info_load_symbolic_internal (icon_info,
                                                &fg, &success_color,
                                                &warning_color, &error_color,
-                                               TRUE,
                                                error);
 }
 
@@ -4589,7 +4254,6 @@ load_symbolic_icon_thread  (GTask        *task,
                                                  data->success_color_set ? &data->success_color : NULL,
                                                  data->warning_color_set ? &data->warning_color : NULL,
                                                  data->error_color_set ? &data->error_color : NULL,
-                                                 FALSE,
                                                  &error);
   if (pixbuf == NULL)
     g_task_return_error (task, error);
@@ -4631,7 +4295,6 @@ gtk_icon_info_load_symbolic_async (GtkIconInfo          *icon_info,
 {
   GTask *task;
   AsyncSymbolicData *data;
-  SymbolicPixbufCache *symbolic_cache;
   GdkPixbuf *pixbuf;
 
   g_return_if_fail (icon_info != NULL);
@@ -4650,11 +4313,13 @@ gtk_icon_info_load_symbolic_async (GtkIconInfo          *icon_info,
     }
   else
     {
-      symbolic_cache = symbolic_pixbuf_cache_matches (icon_info->symbolic_pixbuf_cache,
-                                                      fg, success_color, warning_color, error_color);
-      if (symbolic_cache)
+      if (icon_info->pixbuf)
         {
-          pixbuf = symbolic_cache_get_proxy (symbolic_cache, icon_info);
+          /* The masks are loaded already, coloring them is cheap */
+          pixbuf = gtk_icon_info_load_symbolic_internal (icon_info,
+                                                         fg, success_color,
+                                                         warning_color, error_color,
+                                                         NULL);
           g_task_return_pointer (task, pixbuf, g_object_unref);
         }
       else
@@ -4715,38 +4380,21 @@ gtk_icon_info_load_symbolic_finish (GtkIconInfo   *icon_info,
 {
   GTask *task = G_TASK (result);
   AsyncSymbolicData *data = g_task_get_task_data (task);
-  SymbolicPixbufCache *symbolic_cache;
-  GdkPixbuf *pixbuf;
 
   if (was_symbolic)
     *was_symbolic = data->is_symbolic;
 
-  if (data->dup && !g_task_had_error (task))
+  /* Take over the masks that the thread loaded, so that
+   * loading the icon in other colors does not need to
+   * render it again.
+   */
+  if (data->dup && data->dup->pixbuf && !icon_info->pixbuf)
     {
-      pixbuf = g_task_propagate_pointer (task, NULL);
-
-      g_assert (pixbuf != NULL); /* we checked for !had_error above */
-
-      symbolic_cache = symbolic_pixbuf_cache_matches (icon_info->symbolic_pixbuf_cache,
-                                                      data->fg_set ? &data->fg : NULL,
-                                                      data->success_color_set ? &data->success_color : NULL,
-                                                      data->warning_color_set ? &data->warning_color : NULL,
-                                                      data->error_color_set ? &data->error_color : NULL);
-
-      if (symbolic_cache == NULL)
-        {
-          symbolic_cache = icon_info->symbolic_pixbuf_cache =
-            symbolic_pixbuf_cache_new (pixbuf,
-                                       data->fg_set ? &data->fg : NULL,
-                                       data->success_color_set ? &data->success_color : NULL,
-                                       data->warning_color_set ? &data->warning_color : NULL,
-                                       data->error_color_set ? &data->error_color : NULL,
-                                       icon_info->symbolic_pixbuf_cache);
-        }
-
-      g_object_unref (pixbuf);
-
-      return symbolic_cache_get_proxy (symbolic_cache, icon_info);
+      icon_info->pixbuf = g_object_ref (data->dup->pixbuf);
+      if (data->dup->unemblemed_pixbuf)
+        icon_info->unemblemed_pixbuf = g_object_ref (data->dup->unemblemed_pixbuf);
+      icon_info->scale = data->dup->scale;
+      icon_info->emblems_applied = data->dup->emblems_applied;
     }
 
   return g_task_propagate_pointer (task, error);
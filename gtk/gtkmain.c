@@ -172,7 +172,8 @@ static const GDebugKey gtk_debug_keys[] = {
   { "actions", GTK_DEBUG_ACTIONS },
   { "resize", GTK_DEBUG_RESIZE },
   { "layout", GTK_DEBUG_LAYOUT },
-  { "snapshot", GTK_DEBUG_SNAPSHOT }
+  { "snapshot", GTK_DEBUG_SNAPSHOT },
+  { "no-css-file-cache", GTK_DEBUG_NO_CSS_FILE_CACHE }
 };
 #endif /* G_ENABLE_DEBUG */
 
@@ -33,20 +33,34 @@
 
 #define BATCH_SIZE 500
 
+/* Crawling is mostly bound by the latency of reading directories,
+ * so use more threads than there are processors */
+#define MAX_CRAWLERS 16
+
 typedef struct
 {
   GtkSearchEngineSimple *engine;
   GCancellable *cancellable;
 
+  /* Shared by all crawler threads, protected by lock */
+  GMutex lock;
+  GCond cond;
   GQueue *directories;
-
-  gint n_processed_files;
-  GList *hits;
+  guint n_busy;
+  guint n_crawlers;
 
   GtkQuery *query;
   gboolean recursive;
 } SearchThreadData;
 
+typedef struct
+{
+  SearchThreadData *data;
+
+  gint n_processed_files;
+  GList *hits;
+} Crawler;
+
 
 struct _GtkSearchEngineSimple
 {
@@ -95,7 +109,12 @@ queue_if_local (SearchThreadData *data,
   if (file &&
       !_gtk_file_consider_as_remote (file) &&
       !g_file_has_uri_scheme (file, "recent"))
-    g_queue_push_tail (data->directories, g_object_ref (file));
+    {
+      g_mutex_lock (&data->lock);
+      g_queue_push_tail (data->directories, g_object_ref (file));
+      g_cond_signal (&data->cond);
+      g_mutex_unlock (&data->lock);
+    }
 }
 
 static SearchThreadData *
@@ -107,6 +126,8 @@ search_thread_data_new (GtkSearchEngineSimple *engine,
   data = g_new0 (SearchThreadData, 1);
 
   data->engine = g_object_ref (engine);
+  g_mutex_init (&data->lock);
+  g_cond_init (&data->cond);
   data->directories = g_queue_new ();
   data->query = g_object_ref (query);
   data->recursive = _gtk_search_engine_get_recursive (GTK_SEARCH_ENGINE (engine));
@@ -122,6 +143,8 @@ search_thread_data_free (SearchThreadData *data)
 {
   g_queue_foreach (data->directories, (GFunc)g_object_unref, NULL);
   g_queue_free (data->directories);
+  g_cond_clear (&data->cond);
+  g_mutex_clear (&data->lock);
   g_object_unref (data->cancellable);
   g_object_unref (data->query);
   g_object_unref (data->engine);
@@ -166,25 +189,25 @@ search_thread_add_hits_idle (gpointer user_data)
 }
 
 static void
-send_batch (SearchThreadData *data)
+send_batch (Crawler *crawler)
 {
   Batch *batch;
 
-  data->n_processed_files = 0;
+  crawler->n_processed_files = 0;
 
-  if (data->hits)
+  if (crawler->hits)
     {
       guint id;
 
       batch = g_new (Batch, 1);
-      batch->hits = data->hits;
-      batch->thread_data = data;
+      batch->hits = crawler->hits;
+      batch->thread_data = crawler->data;
 
       id = g_idle_add (search_thread_add_hits_idle, batch);
       g_source_set_name_by_id (id, "[gtk+] search_thread_add_hits_idle");
     }
 
-  data->hits = NULL;
+  crawler->hits = NULL;
 }
 
 static gboolean
@@ -207,8 +230,9 @@ is_indexed (GtkSearchEngineSimple *engine,
 }
 
 static void
-visit_directory (GFile *dir, SearchThreadData *data)
+visit_directory (GFile *dir, Crawler *crawler)
 {
+  SearchThreadData *data = crawler->data;
   GFileEnumerator *enumerator;
   GFileInfo *info;
   GFile *child;
@@ -252,12 +276,12 @@ visit_directory (GFile *dir, SearchThreadData *data)
           hit = g_new (GtkSearchHit, 1);
           hit->file = g_object_ref (child);
           hit->info = g_object_ref (info);
-          data->hits = g_list_prepend (data->hits, hit);
+          crawler->hits = g_list_prepend (crawler->hits, hit);
         }
 
-      data->n_processed_files++;
-      if (data->n_processed_files > BATCH_SIZE)
-        send_batch (data);
+      crawler->n_processed_files++;
+      if (crawler->n_processed_files > BATCH_SIZE)
+        send_batch (crawler);
 
       if (data->recursive &&
           g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
@@ -268,27 +292,74 @@ visit_directory (GFile *dir, SearchThreadData *data)
   g_object_unref (enumerator);
 }
 
+/* Takes the next directory off the shared queue. Waits while the
+ * queue is empty but other crawlers may still add to it, and returns
+ * %NULL once everything was visited or the search got cancelled.
+ */
+static GFile *
+search_thread_next_directory (SearchThreadData *data)
+{
+  GFile *dir;
+
+  g_mutex_lock (&data->lock);
+
+  while (!g_cancellable_is_cancelled (data->cancellable) &&
+         g_queue_is_empty (data->directories) &&
+         data->n_busy > 0)
+    g_cond_wait (&data->cond, &data->lock);
+
+  if (g_cancellable_is_cancelled (data->cancellable))
+    dir = NULL;
+  else
+    dir = g_queue_pop_head (data->directories);
+
+  if (dir)
+    data->n_busy++;
+  else
+    g_cond_broadcast (&data->cond);
+
+  g_mutex_unlock (&data->lock);
+
+  return dir;
+}
+
 static gpointer
 search_thread_func (gpointer user_data)
 {
-  SearchThreadData *data;
+  Crawler crawler = { user_data, 0, NULL };
+  SearchThreadData *data = user_data;
+  gboolean last;
   GFile *dir;
   guint id;
 
-  data = user_data;
-
-  while (!g_cancellable_is_cancelled (data->cancellable) &&
-         (dir = g_queue_pop_head (data->directories)) != NULL)
+  while ((dir = search_thread_next_directory (data)) != NULL)
     {
-      visit_directory (dir, data);
+      visit_directory (dir, &crawler);
       g_object_unref (dir);
+
+      g_mutex_lock (&data->lock);
+      data->n_busy--;
+      if (data->n_busy == 0)
+        g_cond_broadcast (&data->cond);
+      g_mutex_unlock (&data->lock);
     }
 
   if (!g_cancellable_is_cancelled (data->cancellable))
-    send_batch (data);
+    send_batch (&crawler);
+  else
+    g_list_free_full (crawler.hits, (GDestroyNotify)_gtk_search_hit_free);
 
-  id = g_idle_add (search_thread_done_idle, data);
-  g_source_set_name_by_id (id, "[gtk+] search_thread_done_idle");
+  g_mutex_lock (&data->lock);
+  data->n_crawlers--;
+  last = data->n_crawlers == 0;
+  g_mutex_unlock (&data->lock);
+
+  /* The last crawler to finish reports the end of the search */
+  if (last)
+    {
+      id = g_idle_add (search_thread_done_idle, data);
+      g_source_set_name_by_id (id, "[gtk+] search_thread_done_idle");
+    }
 
   return NULL;
 }
@@ -298,6 +369,7 @@ gtk_search_engine_simple_start (GtkSearchEngine *engine)
 {
   GtkSearchEngineSimple *simple;
   SearchThreadData *data;
+  guint n_crawlers, i;
 
   simple = GTK_SEARCH_ENGINE_SIMPLE (engine);
 
@@ -309,7 +381,15 @@ gtk_search_engine_simple_start (GtkSearchEngine *engine)
 
   data = search_thread_data_new (simple, simple->query);
 
-  g_thread_unref (g_thread_new ("file-search", search_thread_func, data));
+  /* A single directory is not worth the threads */
+  if (data->recursive)
+    n_crawlers = MIN (2 * g_get_num_processors (), MAX_CRAWLERS);
+  else
+    n_crawlers = 1;
+
+  data->n_crawlers = n_crawlers;
+  for (i = 0; i < n_crawlers; i++)
+    g_thread_unref (g_thread_new ("file-search", search_thread_func, data));
 
   simple->active_search = data;
 }
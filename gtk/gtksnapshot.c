@@ -64,6 +64,7 @@ gtk_snapshot_dispose (GObject *object)
 
   g_assert (snapshot->state_stack == NULL);
   g_assert (snapshot->nodes == NULL);
+  g_assert (snapshot->arena == NULL);
 
   G_OBJECT_CLASS (gtk_snapshot_parent_class)->dispose (object);
 }
@@ -190,6 +191,8 @@ gtk_snapshot_new (gboolean              record_names,
   snapshot = g_object_new (GTK_TYPE_SNAPSHOT, NULL);
 
   snapshot->record_names = record_names;
+  /* Most of the nodes created from here on are short-lived */
+  snapshot->arena = gsk_render_node_arena_push ();
   snapshot->state_stack = g_array_new (FALSE, TRUE, sizeof (GtkSnapshotState));
   g_array_set_clear_func (snapshot->state_stack, (GDestroyNotify)gtk_snapshot_state_clear);
   snapshot->nodes = g_ptr_array_new_with_free_func ((GDestroyNotify)gsk_render_node_unref);
@@ -1280,6 +1283,8 @@ gtk_snapshot_to_node (GtkSnapshot *snapshot)
   g_ptr_array_free (snapshot->nodes, TRUE);
   snapshot->nodes = NULL;
 
+  g_clear_pointer (&snapshot->arena, gsk_render_node_arena_pop);
+
   return result;
 }
 
@@ -1328,6 +1333,21 @@ gtk_snapshot_pop (GtkSnapshot *snapshot)
     }
 }
 
+/*< private >
+ * gtk_snapshot_pop_collect:
+ * @snapshot: a #GtkSnapshot
+ *
+ * Removes the top element from the stack of render nodes and
+ * returns it, instead of appending it to the node underneath.
+ *
+ * Returns: (transfer full) (nullable): the collected node
+ */
+GskRenderNode *
+gtk_snapshot_pop_collect (GtkSnapshot *snapshot)
+{
+  return gtk_snapshot_pop_internal (snapshot);
+}
+
 /**
  * gtk_snapshot_get_record_names:
  * @snapshot: a #GtkSnapshot
@@ -1641,6 +1661,33 @@ gtk_snapshot_clips_rect (GtkSnapshot                 *snapshot,
   return cairo_region_contains_rectangle (current_state->clip_region, &offset_rect) == CAIRO_REGION_OVERLAP_OUT;
 }
 
+/*< private >
+ * gtk_snapshot_contains_rect:
+ * @snapshot: a #GtkSnapshot
+ * @rect: a rectangle
+ *
+ * Tests whether the rectangle is entirely inside the clip region of @snapshot.
+ *
+ * Returns: %TRUE if @rect is not clipped at all
+ */
+gboolean
+gtk_snapshot_contains_rect (GtkSnapshot                 *snapshot,
+                            const cairo_rectangle_int_t *rect)
+{
+  const GtkSnapshotState *current_state = gtk_snapshot_get_current_state (snapshot);
+  cairo_rectangle_int_t offset_rect;
+
+  if (current_state->clip_region == NULL)
+    return TRUE;
+
+  offset_rect.x = rect->x + current_state->translate_x;
+  offset_rect.y = rect->y + current_state->translate_y;
+  offset_rect.width = rect->width;
+  offset_rect.height = rect->height;
+
+  return cairo_region_contains_rectangle (current_state->clip_region, &offset_rect) == CAIRO_REGION_OVERLAP_IN;
+}
+
 /**
  * gtk_snapshot_render_background:
  * @snapshot: a #GtkSnapshot
@@ -1928,6 +1975,11 @@ gtk_snapshot_append_repeating_linear_gradient (GtkSnapshot            *snapshot,
       g_free (str);
     }
 
+  /* Renderers without support for repeating gradients draw them with
+   * cairo and cache the result per node, so reuse equal nodes from
+   * earlier frames to hit that cache. */
+  node = gsk_render_node_intern (node);
+
   gtk_snapshot_append_node_internal (snapshot, node);
   gsk_render_node_unref (node);
 }
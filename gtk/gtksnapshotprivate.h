@@ -20,6 +20,8 @@
 
 #include "gtksnapshot.h"
 
+#include "gsk/gskrendernodeprivate.h"
+
 G_BEGIN_DECLS
 
 typedef struct _GtkSnapshotState GtkSnapshotState;
@@ -91,6 +93,7 @@ struct _GdkSnapshot {
   gboolean               record_names;
   GArray                *state_stack;
   GPtrArray             *nodes;
+  GskRenderNodeArena    *arena;
 };
 
 struct _GtkSnapshotClass {
@@ -99,6 +102,9 @@ struct _GtkSnapshotClass {
 
 void            gtk_snapshot_append_node_internal       (GtkSnapshot            *snapshot,
                                                          GskRenderNode          *node);
+GskRenderNode * gtk_snapshot_pop_collect                (GtkSnapshot            *snapshot);
+gboolean        gtk_snapshot_contains_rect              (GtkSnapshot            *snapshot,
+                                                         const cairo_rectangle_int_t *rect);
 
 G_END_DECLS
 
@@ -223,6 +223,19 @@ gtk_style_cascade_lookup (GtkStyleProvider    *provider,
   gtk_style_cascade_iter_clear (&iter);
 }
 
+static gboolean
+gtk_style_cascade_change_affects (GtkStyleProvider    *provider,
+                                  const GtkCssMatcher *matcher)
+{
+  GtkStyleCascade *cascade = GTK_STYLE_CASCADE (provider);
+
+  /* Providers were added or removed, or the scale changed */
+  if (cascade->changed_provider == NULL)
+    return TRUE;
+
+  return gtk_style_provider_change_affects (cascade->changed_provider, matcher);
+}
+
 static void
 gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
 {
@@ -231,6 +244,7 @@ gtk_style_cascade_provider_iface_init (GtkStyleProviderInterface *iface)
   iface->get_scale = gtk_style_cascade_get_scale;
   iface->get_keyframes = gtk_style_cascade_get_keyframes;
   iface->lookup = gtk_style_cascade_lookup;
+  iface->change_affects = gtk_style_cascade_change_affects;
 }
 
 G_DEFINE_TYPE_EXTENDED (GtkStyleCascade, _gtk_style_cascade, G_TYPE_OBJECT, 0,
@@ -280,6 +294,19 @@ _gtk_style_cascade_new (void)
   return g_object_new (GTK_TYPE_STYLE_CASCADE, NULL);
 }
 
+/* Forwards ::changed, remembering where it came from, so
+ * gtk_style_provider_change_affects() can ask that provider. */
+static void
+gtk_style_cascade_provider_changed (GtkStyleProvider *provider,
+                                    GtkStyleCascade  *cascade)
+{
+  GtkStyleProvider *changed_provider = cascade->changed_provider;
+
+  cascade->changed_provider = provider;
+  gtk_style_provider_changed (GTK_STYLE_PROVIDER (cascade));
+  cascade->changed_provider = changed_provider;
+}
+
 void
 _gtk_style_cascade_set_parent (GtkStyleCascade *cascade,
                                GtkStyleCascade *parent)
@@ -293,16 +320,16 @@ _gtk_style_cascade_set_parent (GtkStyleCascade *cascade,
   if (parent)
     {
       g_object_ref (parent);
-      g_signal_connect_swapped (parent,
-                                "-gtk-private-changed",
-                                G_CALLBACK (gtk_style_provider_changed),
-                                cascade);
+      g_signal_connect (parent,
+                        "-gtk-private-changed",
+                        G_CALLBACK (gtk_style_cascade_provider_changed),
+                        cascade);
     }
 
   if (cascade->parent)
     {
       g_signal_handlers_disconnect_by_func (cascade->parent, 
-                                            gtk_style_provider_changed,
+                                            gtk_style_cascade_provider_changed,
                                             cascade);
       g_object_unref (cascade->parent);
     }
@@ -324,10 +351,10 @@ _gtk_style_cascade_add_provider (GtkStyleCascade  *cascade,
 
   data.provider = g_object_ref (provider);
   data.priority = priority;
-  data.changed_signal_id = g_signal_connect_swapped (provider,
-                                                     "-gtk-private-changed",
-                                                     G_CALLBACK (gtk_style_provider_changed),
-                                                     cascade);
+  data.changed_signal_id = g_signal_connect (provider,
+                                             "-gtk-private-changed",
+                                             G_CALLBACK (gtk_style_cascade_provider_changed),
+                                             cascade);
 
   /* ensure it gets removed first */
   _gtk_style_cascade_remove_provider (cascade, provider);
@@ -40,6 +40,8 @@ struct _GtkStyleCascade
   GtkStyleCascade *parent;
   GArray *providers;
   int scale;
+
+  GtkStyleProvider *changed_provider;   /* while forwarding its ::changed */
 };
 
 struct _GtkStyleCascadeClass
@@ -123,6 +123,34 @@ gtk_style_provider_changed (GtkStyleProvider *provider)
   g_signal_emit (provider, signals[CHANGED], 0);
 }
 
+/*
+ * gtk_style_provider_change_affects:
+ * @provider: a #GtkStyleProvider
+ * @matcher: the matcher for a node styled by @provider
+ *
+ * While ::-gtk-private-changed is emitted, checks if the change can
+ * affect the style of nodes matched by @matcher. Providers that can't
+ * tell, or calls outside of the emission, return %TRUE.
+ *
+ * Returns: %FALSE if the style for @matcher did not change
+ */
+gboolean
+gtk_style_provider_change_affects (GtkStyleProvider    *provider,
+                                   const GtkCssMatcher *matcher)
+{
+  GtkStyleProviderInterface *iface;
+
+  gtk_internal_return_val_if_fail (GTK_IS_STYLE_PROVIDER (provider), TRUE);
+  gtk_internal_return_val_if_fail (matcher != NULL, TRUE);
+
+  iface = GTK_STYLE_PROVIDER_GET_INTERFACE (provider);
+
+  if (!iface->change_affects)
+    return TRUE;
+
+  return iface->change_affects (provider, matcher);
+}
+
 GtkSettings *
 gtk_style_provider_get_settings (GtkStyleProvider *provider)
 {
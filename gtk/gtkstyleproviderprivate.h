@@ -48,6 +48,8 @@ struct _GtkStyleProviderInterface
   void                  (* emit_error)          (GtkStyleProvider *provider,
                                                  GtkCssSection           *section,
                                                  const GError            *error);
+  gboolean              (* change_affects)      (GtkStyleProvider *provider,
+                                                 const GtkCssMatcher     *matcher);
   /* signal */
   void                  (* changed)             (GtkStyleProvider *provider);
 };
@@ -64,6 +66,8 @@ void                    gtk_style_provider_lookup                (GtkStyleProvid
                                                                   GtkCssChange            *out_change);
 
 void                    gtk_style_provider_changed               (GtkStyleProvider *provider);
+gboolean                gtk_style_provider_change_affects        (GtkStyleProvider *provider,
+                                                                  const GtkCssMatcher     *matcher);
 
 void                    gtk_style_provider_emit_error            (GtkStyleProvider *provider,
                                                                   GtkCssSection           *section,
@@ -97,8 +97,22 @@ struct _GtkTextLayoutPrivate
      direction only influences the direction of the cursor line.
   */
   GtkTextLine *cursor_line;
+
+  /* Recently used line displays. Maps each GtkTextLine to its
+   * link in display_lru, which has the most recent one first.
+   */
+  GHashTable *display_cache;
+  GQueue display_lru;
+  gsize display_cache_size;
+  gsize max_display_cache_size;
 };
 
+/* Line displays contain a fully shaped PangoLayout, so keep a few
+ * megabytes of them around to not reshape every visible line on
+ * every frame.
+ */
+#define DEFAULT_DISPLAY_CACHE_SIZE (4 * 1024 * 1024)
+
 static GtkTextLineData *gtk_text_layout_real_wrap (GtkTextLayout *layout,
                                                    GtkTextLine *line,
                                                    /* may be NULL */
@@ -115,6 +129,7 @@ static void gtk_text_layout_real_invalidate_cursors(GtkTextLayout     *layout,
 static void gtk_text_layout_invalidate_cache       (GtkTextLayout     *layout,
 						    GtkTextLine       *line,
 						    gboolean           cursors_only);
+static void gtk_text_layout_clear_display_cache    (GtkTextLayout     *layout);
 static void gtk_text_layout_invalidate_cursor_line (GtkTextLayout     *layout,
 						    gboolean           cursors_only);
 static void gtk_text_layout_real_free_line_data    (GtkTextLayout     *layout,
@@ -193,12 +208,7 @@ gtk_text_layout_dispose (GObject *object)
   g_clear_object (&layout->ltr_context);
   g_clear_object (&layout->rtl_context);
 
-  if (layout->one_display_cache)
-    {
-      GtkTextLineDisplay *tmp_display = layout->one_display_cache;
-      layout->one_display_cache = NULL;
-      gtk_text_layout_free_line_display (layout, tmp_display);
-    }
+  gtk_text_layout_clear_display_cache (layout);
 
   if (layout->preedit_attrs != NULL)
     {
@@ -213,8 +223,12 @@ static void
 gtk_text_layout_finalize (GObject *object)
 {
   GtkTextLayout *layout;
+  GtkTextLayoutPrivate *priv;
 
   layout = GTK_TEXT_LAYOUT (object);
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_hash_table_unref (priv->display_cache);
 
   g_free (layout->preedit_string);
 
@@ -276,7 +290,13 @@ gtk_text_layout_class_init (GtkTextLayoutClass *klass)
 static void
 gtk_text_layout_init (GtkTextLayout *text_layout)
 {
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (text_layout);
+
   text_layout->cursor_visible = TRUE;
+
+  priv->display_cache = g_hash_table_new (NULL, NULL);
+  g_queue_init (&priv->display_lru);
+  priv->max_display_cache_size = DEFAULT_DISPLAY_CACHE_SIZE;
 }
 
 GtkTextLayout*
@@ -310,6 +330,7 @@ gtk_text_layout_set_buffer (GtkTextLayout *layout,
     return;
 
   free_style_cache (layout);
+  gtk_text_layout_clear_display_cache (layout);
 
   if (layout->buffer)
     {
@@ -628,6 +649,62 @@ gtk_text_layout_emit_changed (GtkTextLayout *layout,
   g_signal_emit (layout, signals[CHANGED], 0, y, old_height, new_height);
 }
 
+/* Invalidates the cached line displays that intersect [y, y + height).
+ *
+ * Changes usually cover a line or two, while the cache can hold thousands
+ * of lines, so look up the lines in the range instead of checking every
+ * cached display. Only if the range has more lines than the cache, check
+ * the cache.
+ */
+static void
+gtk_text_layout_invalidate_cache_yrange (GtkTextLayout *layout,
+                                         gint           y,
+                                         gint           height,
+                                         gboolean       cursors_only)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextBTree *btree = _gtk_text_buffer_get_btree (layout->buffer);
+  GtkTextLine *line;
+  GSList *invalid = NULL, *l;
+  GList *link;
+  guint n_lines, max_lines;
+  gint line_top;
+
+  max_lines = priv->display_lru.length;
+  if (max_lines == 0)
+    return;
+
+  line = _gtk_text_btree_find_line_by_y (btree, layout, y, &line_top);
+  for (n_lines = 0; n_lines < max_lines; n_lines++)
+    {
+      GtkTextLineData *line_data;
+
+      if (line == NULL || line_top >= y + height)
+        return;
+
+      gtk_text_layout_invalidate_cache (layout, line, cursors_only);
+
+      line_data = _gtk_text_line_get_data (line, layout);
+      if (line_data)
+        line_top += line_data->height;
+
+      line = _gtk_text_line_next_excluding_last (line);
+    }
+
+  for (link = priv->display_lru.head; link; link = link->next)
+    {
+      GtkTextLineDisplay *display = link->data;
+      gint cache_y = _gtk_text_btree_find_line_top (btree, display->line, layout);
+
+      if (cache_y + display->height > y && cache_y < y + height)
+        invalid = g_slist_prepend (invalid, display->line);
+    }
+
+  for (l = invalid; l; l = l->next)
+    gtk_text_layout_invalidate_cache (layout, l->data, cursors_only);
+  g_slist_free (invalid);
+}
+
 static void
 text_layout_changed (GtkTextLayout *layout,
                      gint           y,
@@ -635,19 +712,7 @@ text_layout_changed (GtkTextLayout *layout,
                      gint           new_height,
                      gboolean       cursors_only)
 {
-  /* Check if the range intersects our cached line display,
-   * and invalidate the cached line if so.
-   */
-  if (layout->one_display_cache)
-    {
-      GtkTextLine *line = layout->one_display_cache->line;
-      gint cache_y = _gtk_text_btree_find_line_top (_gtk_text_buffer_get_btree (layout->buffer),
-						    line, layout);
-      gint cache_height = layout->one_display_cache->height;
-
-      if (cache_y + cache_height > y && cache_y < y + old_height)
-	gtk_text_layout_invalidate_cache (layout, line, cursors_only);
-    }
+  gtk_text_layout_invalidate_cache_yrange (layout, y, old_height, cursors_only);
 
   gtk_text_layout_emit_changed (layout, y, old_height, new_height);
 }
@@ -813,28 +878,178 @@ gtk_text_layout_invalidate_all (GtkTextLayout *layout)
   gtk_text_layout_invalidate (layout, &start, &end);
 }
 
+static gsize
+line_display_get_cache_size (GtkTextLineDisplay *display)
+{
+  gsize size = sizeof (GtkTextLineDisplay);
+
+  /* A rough estimate of the glyph strings, log attrs
+   * and lines that Pango keeps per byte of text */
+  if (display->layout)
+    size += 64 * strlen (pango_layout_get_text (display->layout));
+
+  return size;
+}
+
+static void
+line_display_free (GtkTextLineDisplay *display)
+{
+  if (display->layout)
+    g_object_unref (display->layout);
+
+  if (display->cursors)
+    g_array_free (display->cursors, TRUE);
+
+  if (display->pg_bg_rgba)
+    gdk_rgba_free (display->pg_bg_rgba);
+
+  g_slice_free (GtkTextLineDisplay, display);
+}
+
+static gboolean
+gtk_text_layout_is_cached_display (GtkTextLayout      *layout,
+                                   GtkTextLineDisplay *display)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GList *link;
+
+  link = g_hash_table_lookup (priv->display_cache, display->line);
+
+  return link != NULL && link->data == display;
+}
+
+static void
+gtk_text_layout_remove_cached_display (GtkTextLayout *layout,
+                                       GtkTextLine   *line)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLineDisplay *display;
+  GList *link;
+
+  link = g_hash_table_lookup (priv->display_cache, line);
+  if (link == NULL)
+    return;
+
+  display = link->data;
+  g_hash_table_remove (priv->display_cache, line);
+  g_queue_delete_link (&priv->display_lru, link);
+  priv->display_cache_size -= line_display_get_cache_size (display);
+
+  line_display_free (display);
+}
+
+static void
+gtk_text_layout_trim_display_cache (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  /* Always keep the most recent display, callers expect
+   * the display they just got to stay alive */
+  while (priv->display_cache_size > priv->max_display_cache_size &&
+         priv->display_lru.length > 1)
+    {
+      GtkTextLineDisplay *display = g_queue_peek_tail (&priv->display_lru);
+
+      gtk_text_layout_remove_cached_display (layout, display->line);
+    }
+}
+
+static void
+gtk_text_layout_add_cached_display (GtkTextLayout      *layout,
+                                    GtkTextLineDisplay *display)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  g_assert (g_hash_table_lookup (priv->display_cache, display->line) == NULL);
+
+  g_queue_push_head (&priv->display_lru, display);
+  g_hash_table_insert (priv->display_cache, display->line, priv->display_lru.head);
+  priv->display_cache_size += line_display_get_cache_size (display);
+
+  gtk_text_layout_trim_display_cache (layout);
+}
+
+static GtkTextLineDisplay *
+gtk_text_layout_lookup_cached_display (GtkTextLayout *layout,
+                                       GtkTextLine   *line)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GList *link;
+
+  link = g_hash_table_lookup (priv->display_cache, line);
+  if (link == NULL)
+    return NULL;
+
+  /* Move it to the front, it's the most recently used one now */
+  g_queue_unlink (&priv->display_lru, link);
+  g_queue_push_head_link (&priv->display_lru, link);
+
+  return link->data;
+}
+
+static void
+gtk_text_layout_clear_display_cache (GtkTextLayout *layout)
+{
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+
+  while (priv->display_lru.tail)
+    {
+      GtkTextLineDisplay *display = priv->display_lru.tail->data;
+
+      gtk_text_layout_remove_cached_display (layout, display->line);
+    }
+
+  g_assert (priv->display_cache_size == 0);
+}
+
+/**
+ * gtk_text_layout_set_display_cache_size:
+ * @layout: a #GtkTextLayout
+ * @max_size: the maximum size of the cache, in bytes
+ *
+ * Sets how much memory @layout may use to keep the line displays of
+ * recently used lines around. The size of a line display is estimated
+ * from its text, and the most recently used line is always kept.
+ */
+void
+gtk_text_layout_set_display_cache_size (GtkTextLayout *layout,
+                                        gsize          max_size)
+{
+  GtkTextLayoutPrivate *priv;
+
+  g_return_if_fail (GTK_IS_TEXT_LAYOUT (layout));
+
+  priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  priv->max_display_cache_size = max_size;
+
+  gtk_text_layout_trim_display_cache (layout);
+}
+
 static void
 gtk_text_layout_invalidate_cache (GtkTextLayout *layout,
                                   GtkTextLine   *line,
 				  gboolean       cursors_only)
 {
-  if (layout->one_display_cache && line == layout->one_display_cache->line)
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GList *link;
+
+  link = g_hash_table_lookup (priv->display_cache, line);
+  if (link == NULL)
+    return;
+
+  if (cursors_only)
     {
-      GtkTextLineDisplay *display = layout->one_display_cache;
+      GtkTextLineDisplay *display = link->data;
 
-      if (cursors_only)
-	{
-          if (display->cursors)
-            g_array_free (display->cursors, TRUE);
-	  display->cursors = NULL;
-	  display->cursors_invalid = TRUE;
-	  display->has_block_cursor = FALSE;
-	}
-      else
-	{
-	  layout->one_display_cache = NULL;
-	  gtk_text_layout_free_line_display (layout, display);
-	}
+      if (display->cursors)
+        g_array_free (display->cursors, TRUE);
+      display->cursors = NULL;
+      display->cursors_invalid = TRUE;
+      display->has_block_cursor = FALSE;
+    }
+  else
+    {
+      gtk_text_layout_remove_cached_display (layout, line);
     }
 }
 
@@ -926,27 +1141,50 @@ gtk_text_layout_real_invalidate_cursors (GtkTextLayout     *layout,
 					 const GtkTextIter *start,
 					 const GtkTextIter *end)
 {
-  /* Check if the range intersects our cached line display,
-   * and invalidate the cached line if so.
+  GtkTextLayoutPrivate *priv = GTK_TEXT_LAYOUT_GET_PRIVATE (layout);
+  GtkTextLine *line, *last_line;
+  guint n_lines, max_lines;
+  GList *link;
+
+  if (gtk_text_iter_compare (start, end) > 0)
+    {
+      const GtkTextIter *tmp = start;
+      start = end;
+      end = tmp;
+    }
+
+  /* Invalidate the cached displays of the lines in the range, or check
+   * every cached display if the range has more lines than the cache,
+   * see gtk_text_layout_invalidate_cache_yrange().
    */
-  if (layout->one_display_cache)
+  line = _gtk_text_iter_get_text_line (start);
+  last_line = _gtk_text_iter_get_text_line (end);
+  max_lines = priv->display_lru.length;
+
+  for (n_lines = 0; line != NULL && n_lines < max_lines; n_lines++)
+    {
+      gtk_text_layout_invalidate_cache (layout, line, TRUE);
+
+      if (line == last_line)
+        {
+          gtk_text_layout_invalidated (layout);
+          return;
+        }
+
+      line = _gtk_text_line_next_excluding_last (line);
+    }
+
+  for (link = priv->display_lru.head; link; link = link->next)
     {
       GtkTextIter line_start, line_end;
-      GtkTextLine *line = layout->one_display_cache->line;
 
+      line = ((GtkTextLineDisplay *) link->data)->line;
       gtk_text_layout_get_iter_at_line (layout, &line_start, line, 0);
 
       line_end = line_start;
       if (!gtk_text_iter_ends_line (&line_end))
 	gtk_text_iter_forward_to_line_end (&line_end);
 
-      if (gtk_text_iter_compare (start, end) > 0)
-	{
-	  const GtkTextIter *tmp = start;
-	  start = end;
-	  end = tmp;
-	}
-
       if (gtk_text_iter_compare (&line_start, end) <= 0 &&
 	  gtk_text_iter_compare (start, &line_end) <= 0)
 	{
@@ -2268,24 +2506,22 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   
   g_return_val_if_fail (line != NULL, NULL);
 
-  if (layout->one_display_cache)
+  display = gtk_text_layout_lookup_cached_display (layout, line);
+  if (display)
     {
-      if (line == layout->one_display_cache->line &&
-          (size_only || !layout->one_display_cache->size_only))
+      if (size_only || !display->size_only)
 	{
 	  if (!size_only)
-            update_text_display_cursors (layout, line, layout->one_display_cache);
-	  return layout->one_display_cache;
+            update_text_display_cursors (layout, line, display);
+	  return display;
 	}
       else
         {
-          GtkTextLineDisplay *tmp_display = layout->one_display_cache;
-          layout->one_display_cache = NULL;
-          gtk_text_layout_free_line_display (layout, tmp_display);
+          gtk_text_layout_remove_cached_display (layout, line);
         }
     }
 
-  DV (g_print ("creating one line display cache (%s)\n", G_STRLOC));
+  DV (g_print ("creating line display cache entry (%s)\n", G_STRLOC));
 
   display = g_slice_new0 (GtkTextLineDisplay);
 
@@ -2607,7 +2843,7 @@ gtk_text_layout_get_line_display (GtkTextLayout *layout,
   if (tags != NULL)
     g_ptr_array_free (tags, TRUE);
 
-  layout->one_display_cache = display;
+  gtk_text_layout_add_cached_display (layout, display);
 
   if (saw_widget)
     allocate_child_widgets (layout, display);
@@ -2619,19 +2855,8 @@ void
 gtk_text_layout_free_line_display (GtkTextLayout      *layout,
                                    GtkTextLineDisplay *display)
 {
-  if (display != layout->one_display_cache)
-    {
-      if (display->layout)
-        g_object_unref (display->layout);
-
-      if (display->cursors)
-        g_array_free (display->cursors, TRUE);
-
-      if (display->pg_bg_rgba)
-        gdk_rgba_free (display->pg_bg_rgba);
-
-      g_slice_free (GtkTextLineDisplay, display);
-    }
+  if (!gtk_text_layout_is_cached_display (layout, display))
+    line_display_free (display);
 }
 
 /* Functions to convert iter <=> index for the line of a GtkTextLineDisplay
@@ -138,11 +138,6 @@ struct _GtkTextLayout
    * over long runs with the same style. */
   GtkTextAttributes *one_style_cache;
 
-  /* A cache of one line display. Getting the same line
-   * many times in a row is the most common case.
-   */
-  GtkTextLineDisplay *one_display_cache;
-
   /* Whether we are allowed to wrap right now */
   gint wrap_loop_count;
   
@@ -291,6 +286,10 @@ void gtk_text_layout_set_preedit_string     (GtkTextLayout     *layout,
  					     PangoAttrList     *preedit_attrs,
  					     gint               cursor_pos);
 
+GDK_AVAILABLE_IN_ALL
+void gtk_text_layout_set_display_cache_size (GtkTextLayout     *layout,
+                                             gsize              max_size);
+
 GDK_AVAILABLE_IN_ALL
 void     gtk_text_layout_set_cursor_visible (GtkTextLayout     *layout,
                                              gboolean           cursor_visible);
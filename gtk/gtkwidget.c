@@ -60,7 +60,7 @@
 #include "gtkselection.h"
 #include "gtksettingsprivate.h"
 #include "gtksizegroup-private.h"
-#include "gtksnapshot.h"
+#include "gtksnapshotprivate.h"
 #include "gtkstylecontextprivate.h"
 #include "gtktooltipprivate.h"
 #include "gtktypebuiltins.h"
@@ -626,6 +626,7 @@ static void     	gtk_widget_update_pango_context		(GtkWidget	  *widget);
 static void             gtk_widget_propagate_state              (GtkWidget          *widget,
                                                                  const GtkStateData *data);
 static void             gtk_widget_update_alpha                 (GtkWidget        *widget);
+static void             gtk_widget_invalidate_render_node       (GtkWidget        *widget);
 
 static gint		gtk_widget_event_internal		(GtkWidget	  *widget,
                                                                  const GdkEvent   *event);
@@ -3218,6 +3219,8 @@ gtk_widget_unparent (GtkWidget *widget)
   if (gtk_widget_get_focus_child (priv->parent) == widget)
     gtk_widget_set_focus_child (priv->parent, NULL);
 
+  gtk_widget_invalidate_render_node (priv->parent);
+
   if (_gtk_widget_is_drawable (priv->parent))
     gtk_widget_queue_draw_area (priv->parent,
 				priv->clip.x,
@@ -3539,6 +3542,8 @@ gtk_widget_map (GtkWidget *widget)
     {
       gtk_widget_push_verify_invariants (widget);
 
+      gtk_widget_invalidate_render_node (widget);
+
       if (!_gtk_widget_get_realized (widget))
         gtk_widget_realize (widget);
 
@@ -3570,6 +3575,8 @@ gtk_widget_unmap (GtkWidget *widget)
       g_object_ref (widget);
       gtk_widget_push_verify_invariants (widget);
 
+      gtk_widget_invalidate_render_node (widget);
+
       if (!_gtk_widget_get_has_surface (widget))
 	gtk_widget_queue_draw (widget);
       _gtk_tooltip_hide (widget);
@@ -4020,6 +4027,16 @@ gtk_widget_queue_draw_area (GtkWidget *widget,
   cairo_region_destroy (region);
 }
 
+/* Drops the render nodes cached by gtk_widget_snapshot() for @widget
+ * and its ancestors, as all of them contain the contents of @widget.
+ */
+static void
+gtk_widget_invalidate_render_node (GtkWidget *widget)
+{
+  for (; widget != NULL; widget = _gtk_widget_get_parent (widget))
+    g_clear_pointer (&widget->priv->render_node, gsk_render_node_unref);
+}
+
 /**
  * gtk_widget_queue_draw:
  * @widget: a #GtkWidget
@@ -4035,6 +4052,8 @@ gtk_widget_queue_draw (GtkWidget *widget)
 
   g_return_if_fail (GTK_IS_WIDGET (widget));
 
+  gtk_widget_invalidate_render_node (widget);
+
   parent = _gtk_widget_get_parent (widget);
   rect = &widget->priv->clip;
 
@@ -4284,6 +4303,8 @@ gtk_widget_queue_draw_region (GtkWidget            *widget,
   if (cairo_region_is_empty (region))
     return;
 
+  gtk_widget_invalidate_render_node (widget);
+
   /* Just return if the widget isn't mapped */
   if (!_gtk_widget_get_mapped (widget))
     return;
@@ -4569,6 +4590,8 @@ gtk_widget_size_allocate (GtkWidget           *widget,
       goto check_clip;
     }
 
+  gtk_widget_invalidate_render_node (widget);
+
   /* Since gtk_widget_measure does it for us, we can be sure here that
    * the given alloaction is large enough for the css margin/bordder/padding */
   real_allocation.x = 0;
@@ -4613,6 +4636,10 @@ check_clip:
   position_changed |= (old_clip.x != priv->clip.x ||
                       old_clip.y != priv->clip.y);
 
+  /* The parent's cached render node has us at the old position */
+  if (position_changed || size_changed || baseline_changed)
+    gtk_widget_invalidate_render_node (_gtk_widget_get_parent (widget));
+
   if (_gtk_widget_get_mapped (widget))
     {
       if (position_changed || size_changed || baseline_changed)
@@ -7245,6 +7272,9 @@ gtk_widget_reposition_after (GtkWidget *widget,
 
   priv->parent = parent;
 
+  /* The stacking order of the children changed */
+  gtk_widget_invalidate_render_node (parent);
+
   if (previous_sibling)
     {
       if (previous_sibling->priv->next_sibling)
@@ -9071,6 +9101,8 @@ gtk_widget_finalize (GObject *object)
 
   g_free (priv->name);
 
+  g_clear_pointer (&priv->render_node, gsk_render_node_unref);
+
   g_clear_object (&priv->accessible);
 
   gtk_widget_clear_path (widget);
@@ -13811,12 +13843,12 @@ gtk_widget_maybe_add_debug_render_nodes (GtkWidget             *widget,
 #endif
 }
 
-void
-gtk_widget_snapshot (GtkWidget   *widget,
-                     GtkSnapshot *snapshot)
+static void
+gtk_widget_do_snapshot (GtkWidget   *widget,
+                        GtkSnapshot *snapshot)
 {
   GtkWidgetClass *klass = GTK_WIDGET_GET_CLASS (widget);
-  GtkWidgetPrivate *priv;
+  GtkWidgetPrivate *priv = widget->priv;
   GtkCssValue *filter_value;
   RenderMode mode;
   double opacity;
@@ -13825,26 +13857,11 @@ gtk_widget_snapshot (GtkWidget   *widget,
   GtkAllocation allocation;
   GtkBorder margin, border, padding;
 
-  if (!_gtk_widget_is_drawable (widget))
-    return;
-
-  if (_gtk_widget_get_alloc_needed (widget))
-    {
-      g_warning ("Trying to snapshot %s %p without a current allocation", G_OBJECT_TYPE_NAME (widget), widget);
-      return;
-    }
-
-  priv = widget->priv;
   offset_clip = priv->clip;
   offset_clip.x -= priv->allocation.x;
   offset_clip.y -= priv->allocation.y;
 
-  if (gtk_snapshot_clips_rect (snapshot, &offset_clip))
-    return;
-
-  opacity = widget->priv->alpha / 255.0;
-  if (opacity <= 0.0)
-    return;
+  opacity = priv->alpha / 255.0;
 
   /* Compatibility mode: if the widget does not have a render node, we draw
    * using gtk_widget_draw() on a temporary node
@@ -13951,6 +13968,58 @@ gtk_widget_snapshot (GtkWidget   *widget,
     gtk_snapshot_pop (snapshot);
 }
 
+void
+gtk_widget_snapshot (GtkWidget   *widget,
+                     GtkSnapshot *snapshot)
+{
+  GtkWidgetPrivate *priv;
+  cairo_rectangle_int_t offset_clip;
+
+  if (!_gtk_widget_is_drawable (widget))
+    return;
+
+  if (_gtk_widget_get_alloc_needed (widget))
+    {
+      g_warning ("Trying to snapshot %s %p without a current allocation", G_OBJECT_TYPE_NAME (widget), widget);
+      return;
+    }
+
+  priv = widget->priv;
+  offset_clip = priv->clip;
+  offset_clip.x -= priv->allocation.x;
+  offset_clip.y -= priv->allocation.y;
+
+  if (gtk_snapshot_clips_rect (snapshot, &offset_clip))
+    return;
+
+  if (priv->alpha == 0)
+    return;
+
+  if (priv->render_node)
+    {
+      gtk_snapshot_append_node (snapshot, priv->render_node);
+      return;
+    }
+
+  /* Only keep the result around if nothing got clipped away, as it
+   * may be needed in a place where more of the widget is visible.
+   * The recording happens without any clip and at offset 0, so it
+   * can be appended anywhere.
+   */
+  if (!gtk_snapshot_contains_rect (snapshot, &offset_clip))
+    {
+      gtk_widget_do_snapshot (widget, snapshot);
+      return;
+    }
+
+  gtk_snapshot_push (snapshot, FALSE, "Cache<%s>", G_OBJECT_TYPE_NAME (widget));
+  gtk_widget_do_snapshot (widget, snapshot);
+  priv->render_node = gtk_snapshot_pop_collect (snapshot);
+
+  if (priv->render_node)
+    gtk_snapshot_append_node (snapshot, priv->render_node);
+}
+
 static gboolean
 should_record_names (GtkWidget   *widget,
                      GskRenderer *renderer)
@@ -164,6 +164,10 @@ struct _GtkWidgetPrivate
 
   /* Pointer cursor */
   GdkCursor *cursor;
+
+  /* The render node of the last snapshot, reused until
+   * the widget or one of its children queues a draw */
+  GskRenderNode *render_node;
 };
 
 GtkCssNode *  gtk_widget_get_css_node       (GtkWidget *widget);
@@ -697,9 +697,15 @@ render_node_save_response (GtkWidget     *dialog,
 
   if (response == GTK_RESPONSE_ACCEPT)
     {
-      GBytes *bytes = gsk_render_node_serialize (node);
+      GBytes *bytes;
       GError *error = NULL;
 
+      /* The binary format loads faster, but older versions can't read it */
+      if (g_strcmp0 (gtk_file_chooser_get_choice (GTK_FILE_CHOOSER (dialog), "binary"), "true") == 0)
+        bytes = gsk_render_node_serialize_binary (node);
+      else
+        bytes = gsk_render_node_serialize (node);
+
       if (!g_file_replace_contents (gtk_file_chooser_get_file (GTK_FILE_CHOOSER (dialog)),
                                     g_bytes_get_data (bytes, NULL),
                                     g_bytes_get_size (bytes),
@@ -758,6 +764,8 @@ render_node_save (GtkButton            *button,
   gtk_dialog_set_default_response (GTK_DIALOG (dialog), GTK_RESPONSE_ACCEPT);
   gtk_window_set_modal (GTK_WINDOW (dialog), TRUE);
   gtk_file_chooser_set_do_overwrite_confirmation (GTK_FILE_CHOOSER (dialog), TRUE);
+  gtk_file_chooser_add_choice (GTK_FILE_CHOOSER (dialog), "binary", _("Use binary format"), NULL, NULL);
+  gtk_file_chooser_set_choice (GTK_FILE_CHOOSER (dialog), "binary", "false");
   g_signal_connect (dialog, "response", G_CALLBACK (render_node_save_response), node);
   gtk_widget_show (dialog);
 }
@@ -1,4 +1,5 @@
 #include <gtk/gtk.h>
+#include <string.h>
 
 static gboolean benchmark = FALSE;
 static gboolean dump_variant = FALSE;
@@ -13,6 +14,30 @@ static GOptionEntry options[] = {
   { NULL }
 };
 
+/* The magic at the start of data from gsk_render_node_serialize_binary() */
+#define BINARY_MAGIC "\211GSKNODE"
+
+static gboolean
+is_binary (GBytes *bytes)
+{
+  gsize size;
+  const char *data = g_bytes_get_data (bytes, &size);
+
+  return size >= strlen (BINARY_MAGIC) && memcmp (data, BINARY_MAGIC, strlen (BINARY_MAGIC)) == 0;
+}
+
+static void
+dump (GBytes *bytes)
+{
+  GVariant *variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(suuv)"), bytes, FALSE);
+  char *s;
+
+  s = g_variant_print (variant, FALSE);
+  g_print ("%s\n", s);
+  g_free (s);
+  g_variant_unref (variant);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -20,9 +45,8 @@ main(int argc, char **argv)
   GskRenderNode *node;
   GError *error = NULL;
   GBytes *bytes;
+  GMappedFile *mapped;
   gint64 start, end;
-  char *contents;
-  gsize len;
   int run;
   GOptionContext *context;
 
@@ -47,23 +71,17 @@ main(int argc, char **argv)
       return 1;
     }
 
-  if (!g_file_get_contents (argv[1], &contents, &len, &error))
+  mapped = g_mapped_file_new (argv[1], FALSE, &error);
+  if (mapped == NULL)
     {
       g_printerr ("Could not open node file: %s\n", error->message);
       return 1;
     }
 
-  bytes = g_bytes_new_take (contents, len);
-  if (dump_variant)
-    {
-      GVariant *variant = g_variant_new_from_bytes (G_VARIANT_TYPE ("(suuv)"), bytes, FALSE);
-      char *s;
-
-      s = g_variant_print (variant, FALSE);
-      g_print ("%s\n", s);
-      g_free (s);
-      g_variant_unref (variant);
-    }
+  bytes = g_mapped_file_get_bytes (mapped);
+  g_mapped_file_unref (mapped);
+  if (dump_variant && !is_binary (bytes))
+    dump (bytes);
 
   start = g_get_monotonic_time ();
   node = gsk_render_node_deserialize (bytes, &error);
@@ -74,7 +92,6 @@ main(int argc, char **argv)
       g_print ("Loaded %s in %.4gs\n", bytes_string, (double) (end - start) / G_USEC_PER_SEC);
       g_free (bytes_string);
     }
-  g_bytes_unref (bytes);
 
   if (node == NULL)
     {
@@ -83,6 +100,18 @@ main(int argc, char **argv)
       return 1;
     }
 
+  /* Binary files have no GVariant structure, so dump
+   * what the loaded tree serializes to instead.
+   */
+  if (dump_variant && is_binary (bytes))
+    {
+      GBytes *serialized = gsk_render_node_serialize (node);
+
+      dump (serialized);
+      g_bytes_unref (serialized);
+    }
+  g_bytes_unref (bytes);
+
   if (fallback)
     {
       graphene_rect_t bounds;
@@ -114,9 +114,6 @@ main (int argc, char **argv)
 {
   GtkWidget *window;
   GtkWidget *nodeview;
-  char *contents;
-  gsize len;
-  GBytes *bytes;
   graphene_rect_t node_bounds;
   GOptionContext *option_context;
   GError *error = NULL;
@@ -145,16 +142,7 @@ main (int argc, char **argv)
 
   gtk_window_set_decorated (GTK_WINDOW (window), FALSE);
 
-  g_file_get_contents (argv[1], &contents, &len, &error);
-  if (error)
-    {
-      g_warning ("%s", error->message);
-      return -1;
-    }
-
-  bytes = g_bytes_new_take (contents, len);
-  GTK_NODE_VIEW (nodeview)->node = gsk_render_node_deserialize (bytes, &error);
-  g_bytes_unref (bytes);
+  GTK_NODE_VIEW (nodeview)->node = gsk_render_node_load_from_file (argv[1], &error);
 
   if (GTK_NODE_VIEW (nodeview)->node == NULL)
     {
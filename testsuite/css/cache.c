@@ -0,0 +1,461 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <glib/gstdio.h>
+#include <string.h>
+#ifdef _MSC_VER
+#include <sys/utime.h>
+#else
+#include <utime.h>
+#endif
+
+/* Style sheets loaded from files are cached in $XDG_CACHE_HOME/gtk-4.0/css.
+ * These tests check that a provider loaded from the cache prints the same
+ * as one that parsed the file, and that the cache is not used when it
+ * doesn't match the files anymore.
+ *
+ * The cache file is rewritten with g_file_set_contents() after every
+ * parse, which gives it a new inode, so the inode tells us if the last
+ * load used the cache.
+ */
+
+static char *tmpdir;
+
+static GFile *
+write_file (const char *name,
+            const char *contents)
+{
+  GError *error = NULL;
+  char *path;
+  GFile *file;
+
+  path = g_build_filename (tmpdir, name, NULL);
+  g_file_set_contents (path, contents, -1, &error);
+  g_assert_no_error (error);
+  file = g_file_new_for_path (path);
+  g_free (path);
+
+  return file;
+}
+
+/* Must match gtk_css_provider_get_cache_path() */
+static char *
+get_cache_path (GFile *file)
+{
+  char *uri, *checksum, *basename, *path;
+
+  uri = g_file_get_uri (file);
+  checksum = g_compute_checksum_for_string (G_CHECKSUM_SHA256, uri, -1);
+  basename = g_strconcat (checksum, ".cache", NULL);
+  path = g_build_filename (g_get_user_cache_dir (), "gtk-4.0", "css", basename, NULL);
+
+  g_free (basename);
+  g_free (checksum);
+  g_free (uri);
+
+  return path;
+}
+
+/* Returns 0 if there is no cache for @file */
+static guint64
+get_cache_inode (GFile *file)
+{
+  GStatBuf buf;
+  char *path;
+  guint64 inode;
+
+  path = get_cache_path (file);
+  if (g_stat (path, &buf) == 0)
+    inode = buf.st_ino;
+  else
+    inode = 0;
+  g_free (path);
+
+  return inode;
+}
+
+static void
+remove_cache (GFile *file)
+{
+  char *path;
+
+  path = get_cache_path (file);
+  g_remove (path);
+  g_free (path);
+}
+
+static char *
+load_file (GFile *file)
+{
+  GtkCssProvider *provider;
+  char *result;
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_file (provider, file);
+  result = gtk_css_provider_to_string (provider);
+  g_object_unref (provider);
+
+  return result;
+}
+
+/* Loads @file twice, parsing it the first time and using the cache the
+ * second time, and returns what both printed */
+static char *
+load_file_cached (GFile *file)
+{
+  char *parsed, *cached;
+  guint64 inode;
+
+  remove_cache (file);
+  parsed = load_file (file);
+  inode = get_cache_inode (file);
+  g_assert_cmpuint (inode, !=, 0);
+
+  cached = load_file (file);
+  g_assert_cmpuint (get_cache_inode (file), ==, inode);
+  g_assert_cmpstr (cached, ==, parsed);
+
+  g_free (cached);
+
+  return parsed;
+}
+
+static void
+test_selectors (void)
+{
+  GFile *file;
+  char *result;
+
+  /* Every kind of simple selector and combinator */
+  file = write_file ("selectors.css",
+                     "* { color: red; }\n"
+                     "label { color: red; }\n"
+                     ":not(label) { color: red; }\n"
+                     ".a { color: red; }\n"
+                     ":not(.a) { color: red; }\n"
+                     "#id { color: red; }\n"
+                     ":not(#id) { color: red; }\n"
+                     "button:hover:active { color: red; }\n"
+                     "button:not(:disabled):checked { color: red; }\n"
+                     "entry:backdrop:focus:selected:indeterminate { color: red; }\n"
+                     "row:first-child { color: red; }\n"
+                     "row:last-child { color: red; }\n"
+                     "row:only-child { color: red; }\n"
+                     "row:nth-child(3n+1) { color: red; }\n"
+                     "row:nth-last-child(-n+3) { color: red; }\n"
+                     "row:not(:nth-child(even)) { color: red; }\n"
+                     "box label { color: red; }\n"
+                     "box > label { color: red; }\n"
+                     "label ~ label { color: red; }\n"
+                     "label + label { color: red; }\n"
+                     "window.background box#outer > .a.b:not(.c) ~ label:hover + *:first-child { color: red; }\n"
+                     "a, b.c, d > e { padding: 1px 2px; margin-left: -3px; }\n");
+
+  result = load_file_cached (file);
+  g_assert_nonnull (strstr (result, "row:nth-child(3n+1)"));
+  g_assert_nonnull (strstr (result, "window.background box#outer"));
+
+  g_free (result);
+  g_object_unref (file);
+}
+
+static void
+test_definitions (void)
+{
+  GFile *file;
+  char *result;
+
+  file = write_file ("definitions.css",
+                     "@define-color accent #3465a4;\n"
+                     "@define-color shade shade(@accent, 0.8);\n"
+                     "@keyframes pulse { from { opacity: 1; } 50% { opacity: 0.5; } to { opacity: 1; } }\n"
+                     "label { color: @shade; animation: pulse 1s infinite; }\n"
+                     "box { background-color: alpha(@accent, 0.5); }\n");
+
+  result = load_file_cached (file);
+  g_assert_nonnull (strstr (result, "@keyframes pulse"));
+
+  g_free (result);
+  g_object_unref (file);
+}
+
+static void
+test_import_changed (void)
+{
+  GFile *file, *imported;
+  char *before, *after;
+  guint64 inode;
+
+  imported = write_file ("imported.css", "box { padding-left: 1px; }\n");
+  file = write_file ("main.css",
+                     "@import url(\"imported.css\");\n"
+                     "label { padding-left: 2px; }\n");
+
+  before = load_file_cached (file);
+  g_assert_nonnull (strstr (before, "padding-left: 1px"));
+  inode = get_cache_inode (file);
+
+  /* The main file is unchanged, but the cache must not be used */
+  g_object_unref (write_file ("imported.css", "box { padding-left: 3px; }\n"));
+  after = load_file (file);
+  g_assert_cmpuint (get_cache_inode (file), !=, inode);
+  g_assert_null (strstr (after, "padding-left: 1px"));
+  g_assert_nonnull (strstr (after, "padding-left: 3px"));
+  g_free (after);
+
+  /* The new cache is used again */
+  after = load_file_cached (file);
+  g_assert_nonnull (strstr (after, "padding-left: 3px"));
+
+  g_free (before);
+  g_free (after);
+  g_object_unref (imported);
+  g_object_unref (file);
+}
+
+static void
+assert_broken_cache_ignored (GFile        *file,
+                             const char   *expected,
+                             const guint8 *data,
+                             gsize         size)
+{
+  GError *error = NULL;
+  char *path, *result;
+  guint64 inode;
+
+  path = get_cache_path (file);
+  g_file_set_contents (path, (const char *) data, size, &error);
+  g_assert_no_error (error);
+  g_free (path);
+  inode = get_cache_inode (file);
+
+  /* The file is parsed again and a new cache written */
+  result = load_file (file);
+  g_assert_cmpstr (result, ==, expected);
+  g_assert_cmpuint (get_cache_inode (file), !=, inode);
+
+  g_free (result);
+}
+
+static void
+test_broken_cache (void)
+{
+  GError *error = NULL;
+  GFile *file;
+  char *expected, *path, *data;
+  guint8 *garbage;
+  gsize size, i;
+
+  file = write_file ("broken.css",
+                     "@define-color accent red;\n"
+                     "box > label.a:hover { color: @accent; padding: 1px; }\n"
+                     "entry:not(:focus) ~ button { margin: 2px; }\n");
+  expected = load_file_cached (file);
+
+  path = get_cache_path (file);
+  g_file_get_contents (path, &data, &size, &error);
+  g_assert_no_error (error);
+  g_free (path);
+  g_assert_cmpuint (size, >, 16);
+
+  /* Truncated */
+  assert_broken_cache_ignored (file, expected, (guint8 *) data, 0);
+  assert_broken_cache_ignored (file, expected, (guint8 *) data, 8);
+  assert_broken_cache_ignored (file, expected, (guint8 *) data, size / 2);
+  assert_broken_cache_ignored (file, expected, (guint8 *) data, size - 1);
+
+  /* Overwritten with random data */
+  garbage = g_new (guint8, size);
+  for (i = 0; i < size; i++)
+    garbage[i] = g_test_rand_int_range (0, 256);
+  assert_broken_cache_ignored (file, expected, garbage, size);
+
+  /* Valid header, but the data after it overwritten */
+  memcpy (garbage, data, size / 4);
+  assert_broken_cache_ignored (file, expected, garbage, size);
+
+  g_free (garbage);
+  g_free (data);
+  g_free (expected);
+  g_object_unref (file);
+}
+
+static void
+set_mtime (const char *path,
+           gint64      age)
+{
+  struct utimbuf buf;
+
+  buf.actime = buf.modtime = g_get_real_time () / G_USEC_PER_SEC - age;
+  g_assert_cmpint (g_utime (path, &buf), ==, 0);
+}
+
+static gint64
+get_mtime (const char *path)
+{
+  GStatBuf buf;
+
+  g_assert_cmpint (g_stat (path, &buf), ==, 0);
+
+  return buf.st_mtime;
+}
+
+static char *
+create_cache_file (const char *dir,
+                   const char *name,
+                   gint64      age)
+{
+  GError *error = NULL;
+  char *path;
+
+  path = g_build_filename (dir, name, NULL);
+  g_file_set_contents (path, "", 0, &error);
+  g_assert_no_error (error);
+  set_mtime (path, age);
+
+  return path;
+}
+
+static guint
+count_cache_files (const char *dir)
+{
+  const char *name;
+  guint n_files = 0;
+  GDir *gdir;
+
+  gdir = g_dir_open (dir, 0, NULL);
+  g_assert_nonnull (gdir);
+  while ((name = g_dir_read_name (gdir)))
+    {
+      if (g_str_has_suffix (name, ".cache"))
+        n_files++;
+    }
+  g_dir_close (gdir);
+
+  return n_files;
+}
+
+#define DAY (24 * 60 * 60)
+
+static void
+test_prune (void)
+{
+  GFile *file;
+  char *result, *path, *dir, *stale, *other;
+  char *recent[70];
+  guint i;
+
+  file = write_file ("used.css", "label { color: red; }\n");
+  result = load_file_cached (file);
+  g_free (result);
+  path = get_cache_path (file);
+  dir = g_path_get_dirname (path);
+
+  /* Using the cache marks it as recently used */
+  set_mtime (path, 40 * DAY);
+  result = load_file (file);
+  g_free (result);
+  g_assert_cmpint (get_mtime (path), >, g_get_real_time () / G_USEC_PER_SEC - DAY);
+
+  /* Writing a cache removes the ones that weren't used in a month,
+   * but only cache files */
+  stale = create_cache_file (dir, "stale.cache", 40 * DAY);
+  other = create_cache_file (dir, "other", 40 * DAY);
+  g_object_unref (file);
+  file = write_file ("new.css", "label { color: blue; }\n");
+  result = load_file (file);
+  g_free (result);
+  g_assert_false (g_file_test (stale, G_FILE_TEST_EXISTS));
+  g_assert_true (g_file_test (other, G_FILE_TEST_EXISTS));
+  g_assert_true (g_file_test (path, G_FILE_TEST_EXISTS));
+
+  /* If there are too many, the least recently used ones go */
+  for (i = 0; i < G_N_ELEMENTS (recent); i++)
+    {
+      char *name = g_strdup_printf ("recent-%u.cache", i);
+      recent[i] = create_cache_file (dir, name, 60 + i * 60);
+      g_free (name);
+    }
+  g_object_unref (file);
+  file = write_file ("newest.css", "label { color: green; }\n");
+  result = load_file (file);
+  g_free (result);
+  g_assert_cmpuint (count_cache_files (dir), ==, 64);
+  g_assert_true (g_file_test (recent[0], G_FILE_TEST_EXISTS));
+  g_assert_false (g_file_test (recent[G_N_ELEMENTS (recent) - 1], G_FILE_TEST_EXISTS));
+
+  for (i = 0; i < G_N_ELEMENTS (recent); i++)
+    {
+      g_remove (recent[i]);
+      g_free (recent[i]);
+    }
+  g_free (other);
+  g_free (stale);
+  g_free (dir);
+  g_free (path);
+  g_object_unref (file);
+}
+
+static void
+remove_recursively (const char *path)
+{
+  GDir *dir;
+  const char *name;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (dir)
+    {
+      while ((name = g_dir_read_name (dir)))
+        {
+          char *child = g_build_filename (path, name, NULL);
+          remove_recursively (child);
+          g_free (child);
+        }
+      g_dir_close (dir);
+    }
+
+  g_remove (path);
+}
+
+int
+main (int argc, char *argv[])
+{
+  GError *error = NULL;
+  char *cachedir;
+  int result;
+
+  /* Must be set before anything asks for the cache dir */
+  tmpdir = g_dir_make_tmp ("gtk-css-cache-XXXXXX", &error);
+  g_assert_no_error (error);
+  cachedir = g_build_filename (tmpdir, "cache", NULL);
+  g_setenv ("XDG_CACHE_HOME", cachedir, TRUE);
+  g_free (cachedir);
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/cache/selectors", test_selectors);
+  g_test_add_func ("/cache/definitions", test_definitions);
+  g_test_add_func ("/cache/import-changed", test_import_changed);
+  g_test_add_func ("/cache/broken", test_broken_cache);
+  g_test_add_func ("/cache/prune", test_prune);
+
+  result = g_test_run ();
+
+  remove_recursively (tmpdir);
+  g_free (tmpdir);
+
+  return result;
+}
@@ -0,0 +1,260 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+/* Styles computed while validating a tree use the ancestor filter to
+ * skip descendant and child rules early. Styles that are looked up
+ * outside of a validation run are matched without it. These tests
+ * compare the two for the same tree, so the filter must never change
+ * the result. */
+
+static const char *css =
+  "box.a label { padding-left: 1px; }\n"
+  "box.a > label { padding-top: 2px; }\n"
+  "#outer box label.x { padding-right: 3px; }\n"
+  "box.b > box > label { padding-bottom: 4px; }\n"
+  "box.b > box.a > box label { margin-left: 5px; }\n"
+  "box.missing label { margin-top: 6px; }\n"
+  "#missing label.x { margin-top: 7px; }\n"
+  "box.a label + label { margin-right: 8px; }\n"
+  "box.a label.x ~ label { margin-bottom: 9px; }\n"
+  "box.b label.x + label.y { min-width: 10px; }\n"
+  "box.missing label.x ~ label { min-width: 11px; }\n"
+  "box.stale label { min-height: 12px; }\n"
+  "box.stale > label.x + label { border-top-width: 13px; }\n"
+  "#renamed label { border-left-width: 14px; }\n"
+  "#renamed box.a > label ~ label.y { border-right-width: 15px; }\n";
+
+static GtkCssProvider *provider;
+
+static GtkWidget *
+add_box (GtkWidget  *parent,
+         const char *class_name)
+{
+  GtkWidget *box;
+
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  if (class_name)
+    gtk_style_context_add_class (gtk_widget_get_style_context (box), class_name);
+  gtk_container_add (GTK_CONTAINER (parent), box);
+
+  return box;
+}
+
+/* Every third label has class "x" and the ones after it class "y" */
+static void
+add_labels (GtkWidget *box,
+            guint      n_labels)
+{
+  guint i;
+
+  for (i = 0; i < n_labels; i++)
+    {
+      GtkWidget *label = gtk_label_new ("Label");
+
+      if (i % 3 == 0)
+        gtk_style_context_add_class (gtk_widget_get_style_context (label), "x");
+      else if (i % 3 == 1)
+        gtk_style_context_add_class (gtk_widget_get_style_context (label), "y");
+      gtk_container_add (GTK_CONTAINER (box), label);
+    }
+}
+
+/* window > box#outer.b > { box.a > { labels, box > labels }, box > box.a > labels } */
+static GtkWidget *
+create_window (guint       n_labels,
+               GtkWidget **outer,
+               GtkWidget **inner)
+{
+  GtkWidget *window, *box, *a;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+
+  box = add_box (window, "b");
+  gtk_widget_set_name (box, "outer");
+  if (outer)
+    *outer = box;
+
+  a = add_box (box, "a");
+  add_labels (a, n_labels);
+  add_labels (add_box (a, NULL), 4);
+
+  a = add_box (add_box (box, NULL), "a");
+  add_labels (a, n_labels);
+  if (inner)
+    *inner = a;
+
+  return window;
+}
+
+static char *
+get_styles (GtkWidget *window)
+{
+  return gtk_style_context_to_string (gtk_widget_get_style_context (window),
+                                      GTK_STYLE_CONTEXT_PRINT_RECURSE |
+                                      GTK_STYLE_CONTEXT_PRINT_SHOW_STYLE);
+}
+
+/* Compares the styles from the last validation of @window with
+ * the ones that are computed for it without the filter */
+static void
+assert_styles_without_filter (GtkWidget *window)
+{
+  GtkCssProvider *empty;
+  char *validated, *unfiltered;
+
+  validated = get_styles (window);
+
+  /* Adding a provider invalidates all the styles, printing
+   * them then recomputes them outside of a validation run */
+  empty = gtk_css_provider_new ();
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (empty),
+                                              GTK_STYLE_PROVIDER_PRIORITY_FALLBACK);
+  unfiltered = get_styles (window);
+
+  g_assert_cmpstr (validated, ==, unfiltered);
+
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (empty));
+  g_object_unref (empty);
+  g_free (validated);
+  g_free (unfiltered);
+}
+
+static void
+test_descendants (void)
+{
+  GtkWidget *window;
+
+  /* Enough labels for them to be styled in parallel too */
+  window = create_window (20, NULL, NULL);
+  gtk_widget_show (window);
+
+  assert_styles_without_filter (window);
+
+  gtk_widget_destroy (window);
+}
+
+static void
+test_siblings (void)
+{
+  GtkWidget *window, *inner, *child;
+
+  window = create_window (5, NULL, &inner);
+  gtk_widget_show (window);
+  assert_styles_without_filter (window);
+
+  /* Shuffle the siblings under the same ancestors */
+  child = gtk_widget_get_first_child (inner);
+  g_object_ref (child);
+  gtk_container_remove (GTK_CONTAINER (inner), child);
+  gtk_container_add (GTK_CONTAINER (inner), child);
+  g_object_unref (child);
+  while (g_main_context_iteration (NULL, FALSE));
+
+  assert_styles_without_filter (window);
+
+  gtk_widget_destroy (window);
+}
+
+typedef struct {
+  GtkWidget *ancestor;
+  const char *class_name;
+  const char *name;
+  gboolean changed;
+} ChangeData;
+
+static void
+change_ancestor (GtkStyleContext *context,
+                 ChangeData      *data)
+{
+  if (data->changed)
+    return;
+
+  data->changed = TRUE;
+
+  if (data->class_name)
+    gtk_style_context_add_class (gtk_widget_get_style_context (data->ancestor), data->class_name);
+  if (data->name)
+    gtk_widget_set_name (data->ancestor, data->name);
+}
+
+/* Changes @ancestor while the first label below it is validated,
+ * so the labels after it are matched with the filter out of date */
+static void
+run_stale_test (GtkWidget  *window,
+                GtkWidget  *ancestor,
+                GtkWidget  *label,
+                const char *class_name,
+                const char *name)
+{
+  ChangeData data = { ancestor, class_name, name, FALSE };
+
+  g_signal_connect (gtk_widget_get_style_context (label), "changed",
+                    G_CALLBACK (change_ancestor), &data);
+  gtk_widget_show (window);
+  g_assert_true (data.changed);
+
+  assert_styles_without_filter (window);
+
+  g_signal_handlers_disconnect_by_func (gtk_widget_get_style_context (label),
+                                        change_ancestor, &data);
+  gtk_widget_destroy (window);
+}
+
+static void
+test_stale_class (void)
+{
+  GtkWidget *window, *inner;
+
+  window = create_window (20, NULL, &inner);
+  run_stale_test (window, inner, gtk_widget_get_first_child (inner), "stale", NULL);
+
+  window = create_window (20, NULL, &inner);
+  run_stale_test (window, gtk_widget_get_parent (inner), gtk_widget_get_first_child (inner), "stale", NULL);
+}
+
+static void
+test_stale_name (void)
+{
+  GtkWidget *window, *outer, *inner;
+
+  window = create_window (20, &outer, &inner);
+  run_stale_test (window, outer, gtk_widget_get_first_child (inner), NULL, "renamed");
+
+  window = create_window (20, NULL, &inner);
+  run_stale_test (window, gtk_widget_get_parent (inner), gtk_widget_get_first_child (inner), NULL, "renamed");
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  g_test_add_func ("/matching/ancestor-filter/descendants", test_descendants);
+  g_test_add_func ("/matching/ancestor-filter/siblings", test_siblings);
+  g_test_add_func ("/matching/ancestor-filter/stale-class", test_stale_class);
+  g_test_add_func ("/matching/ancestor-filter/stale-name", test_stale_name);
+
+  return g_test_run ();
+}
@@ -0,0 +1,342 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+#include <string.h>
+
+/* Reloading a provider with gtk_css_provider_load_from_data() only
+ * restyles the nodes that rulesets which were added, removed, edited or
+ * moved can match.
+ *
+ * To see which labels got restyled, all of them get a background image
+ * from a rule that never changes. Every reload parses that url() again,
+ * which loads a new texture the next time a style is computed, so all
+ * restyled labels emit GtkStyleContext::changed and the others don't.
+ */
+
+#define N_LABELS 8
+
+/* The class of every label, "x" is not used by any rule */
+static const char label_classes[N_LABELS + 1] = "abcxabcx";
+
+static GtkCssProvider *provider;
+static char *probe;
+
+static GtkWidget *labels[N_LABELS];
+static guint n_changed[N_LABELS];
+
+static void
+count_changed (GtkStyleContext *context,
+               guint           *count)
+{
+  (*count)++;
+}
+
+static void
+load_css (const char *rules)
+{
+  char *css;
+
+  css = g_strconcat (probe, rules, NULL);
+  gtk_css_provider_load_from_data (provider, css, -1);
+  g_free (css);
+}
+
+static void
+quit_loop (GdkFrameClock *clock,
+           GMainLoop     *loop)
+{
+  g_main_loop_quit (loop);
+}
+
+/* Runs a frame of @window, which validates all the styles in it */
+static void
+run_frame (GtkWidget *window)
+{
+  GdkFrameClock *clock;
+  GMainLoop *loop;
+  gulong id;
+
+  clock = gtk_widget_get_frame_clock (window);
+  loop = g_main_loop_new (NULL, FALSE);
+
+  id = g_signal_connect (clock, "after-paint", G_CALLBACK (quit_loop), loop);
+  gdk_frame_clock_request_phase (clock, GDK_FRAME_CLOCK_PHASE_AFTER_PAINT);
+  g_main_loop_run (loop);
+
+  g_signal_handler_disconnect (clock, id);
+  g_main_loop_unref (loop);
+}
+
+/* window > box > labels */
+static GtkWidget *
+create_window (GtkWidget **box_out)
+{
+  GtkWidget *window, *box;
+  char class_name[2] = { 0, };
+  guint i;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  gtk_container_add (GTK_CONTAINER (window), box);
+
+  for (i = 0; i < N_LABELS; i++)
+    {
+      GtkStyleContext *context;
+
+      labels[i] = gtk_label_new ("Label");
+      context = gtk_widget_get_style_context (labels[i]);
+      class_name[0] = label_classes[i];
+      gtk_style_context_add_class (context, class_name);
+      g_signal_connect (context, "changed", G_CALLBACK (count_changed), &n_changed[i]);
+      gtk_container_add (GTK_CONTAINER (box), labels[i]);
+    }
+
+  if (box_out)
+    *box_out = box;
+
+  gtk_widget_show (window);
+  run_frame (window);
+  memset (n_changed, 0, sizeof (n_changed));
+
+  return window;
+}
+
+/* Checks that exactly the labels with one of the classes in
+ * @restyled got restyled */
+static void
+assert_restyled (const char *restyled)
+{
+  guint i;
+
+  for (i = 0; i < N_LABELS; i++)
+    {
+      if (strchr (restyled, label_classes[i]))
+        g_assert_cmpuint (n_changed[i], >, 0);
+      else
+        g_assert_cmpuint (n_changed[i], ==, 0);
+    }
+
+  memset (n_changed, 0, sizeof (n_changed));
+}
+
+/* Returns the window, so the final styles can be checked */
+static GtkWidget *
+run_reload_test (const char *before,
+                 const char *after,
+                 const char *restyled)
+{
+  GtkWidget *window;
+
+  load_css (before);
+  window = create_window (NULL);
+
+  load_css (after);
+  run_frame (window);
+  assert_restyled (restyled);
+
+  return window;
+}
+
+static int
+get_padding_left (GtkWidget *widget)
+{
+  GtkBorder padding;
+
+  gtk_style_context_get_padding (gtk_widget_get_style_context (widget), &padding);
+
+  return padding.left;
+}
+
+static void
+test_unchanged (void)
+{
+  GtkWidget *window;
+
+  window = run_reload_test ("label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 2px; }\n",
+                            "label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 2px; }\n",
+                            "");
+  gtk_widget_destroy (window);
+}
+
+static void
+test_added (void)
+{
+  GtkWidget *window;
+
+  window = run_reload_test ("label.a { padding-left: 1px; }\n",
+                            "label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 2px; }\n",
+                            "b");
+  g_assert_cmpint (get_padding_left (labels[1]), ==, 2);
+  gtk_widget_destroy (window);
+}
+
+static void
+test_removed (void)
+{
+  GtkWidget *window;
+
+  window = run_reload_test ("label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 2px; }\n"
+                            "label.c { padding-left: 3px; }\n",
+                            "label.a { padding-left: 1px; }\n"
+                            "label.c { padding-left: 3px; }\n",
+                            "b");
+  g_assert_cmpint (get_padding_left (labels[1]), ==, get_padding_left (labels[3]));
+  gtk_widget_destroy (window);
+}
+
+static void
+test_edited (void)
+{
+  GtkWidget *window;
+
+  window = run_reload_test ("label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 2px; }\n"
+                            "label.c { padding-left: 3px; }\n",
+                            "label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 4px; }\n"
+                            "label.c { padding-left: 3px; }\n",
+                            "b");
+  g_assert_cmpint (get_padding_left (labels[1]), ==, 4);
+  gtk_widget_destroy (window);
+}
+
+static void
+test_reordered (void)
+{
+  GtkWidget *window;
+
+  /* Only the ruleset for .a moved relative to the others */
+  window = run_reload_test ("label.a { padding-left: 1px; }\n"
+                            "label.b { padding-left: 2px; }\n"
+                            "label.c { padding-left: 3px; }\n",
+                            "label.b { padding-left: 2px; }\n"
+                            "label.c { padding-left: 3px; }\n"
+                            "label.a { padding-left: 1px; }\n",
+                            "a");
+  gtk_widget_destroy (window);
+
+  /* The order decides which of two rules with the same specificity wins */
+  window = run_reload_test ("label { padding-left: 1px; }\n"
+                            "label.a { padding-left: 2px; }\n"
+                            "label.x { padding-left: 3px; }\n"
+                            "label.x { padding-left: 4px; }\n",
+                            "label { padding-left: 1px; }\n"
+                            "label.a { padding-left: 2px; }\n"
+                            "label.x { padding-left: 4px; }\n"
+                            "label.x { padding-left: 3px; }\n",
+                            "x");
+  g_assert_cmpint (get_padding_left (labels[3]), ==, 3);
+  g_assert_cmpint (get_padding_left (labels[0]), ==, 2);
+  gtk_widget_destroy (window);
+}
+
+static void
+test_define_color (void)
+{
+  GtkWidget *window;
+
+  window = run_reload_test ("@define-color accent red;\n"
+                            "label.c { color: @accent; }\n",
+                            "@define-color accent blue;\n"
+                            "label.c { color: @accent; }\n",
+                            "abcx");
+  gtk_widget_destroy (window);
+}
+
+static void
+test_keyframes (void)
+{
+  GtkWidget *window;
+
+  /* Even when no rule uses them */
+  window = run_reload_test ("@keyframes pulse { from { opacity: 1; } to { opacity: 0.5; } }\n"
+                            "label.a { padding-left: 1px; }\n",
+                            "@keyframes pulse { from { opacity: 1; } to { opacity: 0.25; } }\n"
+                            "label.a { padding-left: 1px; }\n",
+                            "abcx");
+  gtk_widget_destroy (window);
+}
+
+static void
+test_new_class (void)
+{
+  GtkWidget *window, *box;
+
+  load_css ("label.a { padding-left: 1px; }\n");
+  window = create_window (&box);
+
+  /* No node has the new classes yet. The .b labels are restyled
+   * because the descendant rule matches them once their parent
+   * changes, so they must start tracking that. */
+  load_css ("label.a { padding-left: 1px; }\n"
+            "label.new { padding-left: 5px; }\n"
+            "box.new label.b { padding-left: 6px; }\n");
+  run_frame (window);
+  assert_restyled ("b");
+
+  /* The rules apply once the nodes get the classes */
+  gtk_style_context_add_class (gtk_widget_get_style_context (labels[3]), "new");
+  run_frame (window);
+  g_assert_cmpuint (n_changed[3], >, 0);
+  g_assert_cmpuint (n_changed[7], ==, 0);
+  g_assert_cmpint (get_padding_left (labels[3]), ==, 5);
+  g_assert_cmpint (get_padding_left (labels[7]), !=, 5);
+
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), "new");
+  run_frame (window);
+  g_assert_cmpint (get_padding_left (labels[1]), ==, 6);
+  g_assert_cmpint (get_padding_left (labels[5]), ==, 6);
+  g_assert_cmpint (get_padding_left (labels[0]), ==, 1);
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char *argv[])
+{
+  char *image;
+  int result;
+
+  gtk_test_init (&argc, &argv, NULL);
+
+  image = g_test_build_filename (G_TEST_DIST, "parser", "test.png", NULL);
+  probe = g_strdup_printf ("label { background-image: url(\"file://%s\"); }\n", image);
+  g_free (image);
+
+  provider = gtk_css_provider_new ();
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  g_test_add_func ("/reload/unchanged", test_unchanged);
+  g_test_add_func ("/reload/added", test_added);
+  g_test_add_func ("/reload/removed", test_removed);
+  g_test_add_func ("/reload/edited", test_edited);
+  g_test_add_func ("/reload/reordered", test_reordered);
+  g_test_add_func ("/reload/define-color", test_define_color);
+  g_test_add_func ("/reload/keyframes", test_keyframes);
+  g_test_add_func ("/reload/new-class", test_new_class);
+
+  result = g_test_run ();
+
+  g_free (probe);
+
+  return result;
+}
@@ -0,0 +1,215 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include "gtk/gtkcssnodeprivate.h"
+#include "gtk/gtkcssnumbervalueprivate.h"
+#include "gtk/gtkcssrgbavalueprivate.h"
+#include "gtk/gtkcssstaticstyleprivate.h"
+#include "gtk/gtkcssstylechangeprivate.h"
+#include "gtk/gtkwidgetprivate.h"
+
+/* Static styles keep their values in groups that are shared with the
+ * parent or, through a global table, with any other style holding the
+ * same values. Values are compared by identity when sealing, so values
+ * computed from the same declaration end up in one group while equal
+ * values from different declarations don't.
+ *
+ * Siblings with the same classes get their style from the node style
+ * cache and don't go through the group table, so the tests give every
+ * widget its own class.
+ */
+
+static const char css[] =
+  ".parent { font-size: 17px; color: rgb(1,2,3); }\n"
+  ".spaced { letter-spacing: 19px; }\n"
+  ".bordered { border-top-style: solid; border-top-width: 11px; }\n"
+  ".a { letter-spacing: 23px; }\n"
+  ".b { letter-spacing: 23px; }\n"
+  ".c { letter-spacing: 23px; color: rgb(4,5,6); }\n";
+
+static GtkCssProvider *provider;
+
+static GtkWidget *
+add_box (GtkWidget  *parent,
+         const char *class1,
+         const char *class2)
+{
+  GtkWidget *box;
+
+  box = gtk_box_new (GTK_ORIENTATION_HORIZONTAL, 0);
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), class1);
+  if (class2)
+    gtk_style_context_add_class (gtk_widget_get_style_context (box), class2);
+  gtk_container_add (GTK_CONTAINER (parent), box);
+
+  return box;
+}
+
+static GtkCssStaticStyle *
+get_static_style (GtkWidget *widget)
+{
+  GtkCssStyle *style;
+
+  style = gtk_css_node_get_style (gtk_widget_get_css_node (widget));
+  g_assert_true (GTK_IS_CSS_STATIC_STYLE (style));
+
+  return GTK_CSS_STATIC_STYLE (style);
+}
+
+static double
+get_number (GtkCssStaticStyle *style,
+            guint              id)
+{
+  return _gtk_css_number_value_get (gtk_css_style_get_value (GTK_CSS_STYLE (style), id), 100);
+}
+
+static void
+assert_color (GtkCssStaticStyle *style,
+              const char        *color)
+{
+  GdkRGBA expected;
+
+  gdk_rgba_parse (&expected, color);
+  g_assert_true (gdk_rgba_equal (_gtk_css_rgba_value_get_rgba (gtk_css_style_get_value (GTK_CSS_STYLE (style),
+                                                                                        GTK_CSS_PROPERTY_COLOR)),
+                                 &expected));
+}
+
+static void
+test_parent_group (void)
+{
+  GtkWidget *window, *parent, *plain, *spaced;
+  GtkCssStaticStyle *parent_style, *plain_style, *spaced_style;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  parent = add_box (window, "parent", NULL);
+  plain = add_box (parent, "plain", NULL);
+  spaced = add_box (parent, "spaced", NULL);
+
+  parent_style = get_static_style (parent);
+  plain_style = get_static_style (plain);
+  spaced_style = get_static_style (spaced);
+
+  /* Nothing in the font and text groups is set on the child,
+   * so it uses the groups of the parent */
+  g_assert_true (gtk_css_static_style_shares_value (parent_style, plain_style, GTK_CSS_PROPERTY_FONT_SIZE));
+  g_assert_true (gtk_css_static_style_shares_value (parent_style, plain_style, GTK_CSS_PROPERTY_COLOR));
+  g_assert_cmpfloat (get_number (plain_style, GTK_CSS_PROPERTY_FONT_SIZE), ==, 17);
+  assert_color (plain_style, "rgb(1,2,3)");
+
+  /* The text group of this one has its own letter-spacing and
+   * the inherited color */
+  g_assert_true (gtk_css_static_style_shares_value (parent_style, spaced_style, GTK_CSS_PROPERTY_FONT_SIZE));
+  g_assert_false (gtk_css_static_style_shares_value (parent_style, spaced_style, GTK_CSS_PROPERTY_COLOR));
+  g_assert_cmpfloat (get_number (spaced_style, GTK_CSS_PROPERTY_FONT_SIZE), ==, 17);
+  g_assert_cmpfloat (get_number (spaced_style, GTK_CSS_PROPERTY_LETTER_SPACING), ==, 19);
+  g_assert_cmpfloat (get_number (parent_style, GTK_CSS_PROPERTY_LETTER_SPACING), ==, 0);
+  assert_color (spaced_style, "rgb(1,2,3)");
+
+  gtk_widget_destroy (window);
+}
+
+static void
+test_sibling_groups (void)
+{
+  GtkWidget *window, *parent, *first, *second;
+  GtkCssStaticStyle *parent_style, *first_style, *second_style;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  parent = add_box (window, "parent", NULL);
+  first = add_box (parent, "spaced", "first");
+  second = add_box (parent, "spaced", "second");
+  gtk_style_context_add_class (gtk_widget_get_style_context (first), "bordered");
+  gtk_style_context_add_class (gtk_widget_get_style_context (second), "bordered");
+
+  parent_style = get_static_style (parent);
+  first_style = get_static_style (first);
+  second_style = get_static_style (second);
+  g_assert_true (first_style != second_style);
+
+  /* Same declarations, so the second style finds the groups of the
+   * first one in the table */
+  g_assert_false (gtk_css_static_style_shares_value (parent_style, first_style, GTK_CSS_PROPERTY_LETTER_SPACING));
+  g_assert_true (gtk_css_static_style_shares_value (first_style, second_style, GTK_CSS_PROPERTY_LETTER_SPACING));
+  g_assert_false (gtk_css_static_style_shares_value (parent_style, first_style, GTK_CSS_PROPERTY_BORDER_TOP_WIDTH));
+  g_assert_true (gtk_css_static_style_shares_value (first_style, second_style, GTK_CSS_PROPERTY_BORDER_TOP_WIDTH));
+
+  g_assert_cmpfloat (get_number (second_style, GTK_CSS_PROPERTY_LETTER_SPACING), ==, 19);
+  g_assert_cmpfloat (get_number (second_style, GTK_CSS_PROPERTY_BORDER_TOP_WIDTH), ==, 11);
+  g_assert_cmpfloat (get_number (second_style, GTK_CSS_PROPERTY_BORDER_LEFT_WIDTH), ==, 0);
+  assert_color (second_style, "rgb(1,2,3)");
+
+  gtk_widget_destroy (window);
+}
+
+static void
+test_change_equal_groups (void)
+{
+  GtkWidget *window, *parent, *a, *b, *c;
+  GtkCssStaticStyle *a_style, *b_style, *c_style;
+  GtkCssStyleChange change;
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  parent = add_box (window, "parent", NULL);
+  a = add_box (parent, "a", NULL);
+  b = add_box (parent, "b", NULL);
+  c = add_box (parent, "c", NULL);
+
+  a_style = get_static_style (a);
+  b_style = get_static_style (b);
+  c_style = get_static_style (c);
+
+  /* Equal values from different declarations, so the groups
+   * can't be told apart by identity */
+  g_assert_false (gtk_css_static_style_shares_value (a_style, b_style, GTK_CSS_PROPERTY_LETTER_SPACING));
+  g_assert_false (gtk_css_static_style_shares_value (a_style, c_style, GTK_CSS_PROPERTY_LETTER_SPACING));
+
+  gtk_css_style_change_init (&change, GTK_CSS_STYLE (a_style), GTK_CSS_STYLE (b_style));
+  g_assert_false (gtk_css_style_change_has_change (&change));
+  gtk_css_style_change_finish (&change);
+
+  /* The color differs in a group that isn't shared, the equal
+   * letter-spacing next to it doesn't count as a change */
+  gtk_css_style_change_init (&change, GTK_CSS_STYLE (a_style), GTK_CSS_STYLE (c_style));
+  g_assert_true (gtk_css_style_change_has_change (&change));
+  g_assert_true (gtk_css_style_change_affects (&change, GTK_CSS_AFFECTS_CONTENT));
+  g_assert_true (gtk_css_style_change_changes_property (&change, GTK_CSS_PROPERTY_COLOR));
+  g_assert_false (gtk_css_style_change_changes_property (&change, GTK_CSS_PROPERTY_LETTER_SPACING));
+  g_assert_false (gtk_css_style_change_changes_property (&change, GTK_CSS_PROPERTY_FONT_SIZE));
+  gtk_css_style_change_finish (&change);
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  g_test_add_func ("/staticstyle/parent-group", test_parent_group);
+  g_test_add_func ("/staticstyle/sibling-groups", test_sibling_groups);
+  g_test_add_func ("/staticstyle/change-equal-groups", test_change_equal_groups);
+
+  return g_test_run ();
+}
@@ -0,0 +1,265 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <gtk/gtk.h>
+
+/* While a transition runs, every frame compares the new style with the
+ * previous one. Frames of the same animation only compare the animated
+ * values, so these tests check that a widget is only resized or
+ * reallocated when the transitioned property affects that, including
+ * on the frames where the animation starts and stops.
+ *
+ * GtkWidget queues a resize for changes affecting the size, an allocation
+ * for changes affecting the clip and a redraw for everything else, so
+ * counting measure(), size_allocate() and snapshot() calls tells what a
+ * change affected.
+ */
+
+typedef struct {
+  GtkWidget parent_instance;
+
+  guint n_measure;
+  guint n_allocate;
+  guint n_snapshot;
+} TestWidget;
+
+typedef GtkWidgetClass TestWidgetClass;
+
+G_DEFINE_TYPE (TestWidget, test_widget, GTK_TYPE_WIDGET)
+
+static void
+test_widget_measure (GtkWidget      *widget,
+                     GtkOrientation  orientation,
+                     int             for_size,
+                     int            *minimum,
+                     int            *natural,
+                     int            *minimum_baseline,
+                     int            *natural_baseline)
+{
+  TestWidget *self = (TestWidget *) widget;
+
+  self->n_measure++;
+  *minimum = *natural = 10;
+}
+
+static void
+test_widget_size_allocate (GtkWidget           *widget,
+                           const GtkAllocation *allocation,
+                           int                  baseline,
+                           GtkAllocation       *out_clip)
+{
+  TestWidget *self = (TestWidget *) widget;
+
+  self->n_allocate++;
+
+  GTK_WIDGET_CLASS (test_widget_parent_class)->size_allocate (widget, allocation, baseline, out_clip);
+}
+
+static void
+test_widget_snapshot (GtkWidget   *widget,
+                      GtkSnapshot *snapshot)
+{
+  TestWidget *self = (TestWidget *) widget;
+
+  self->n_snapshot++;
+}
+
+static void
+test_widget_init (TestWidget *self)
+{
+  gtk_widget_set_has_surface (GTK_WIDGET (self), FALSE);
+}
+
+static void
+test_widget_class_init (TestWidgetClass *klass)
+{
+  GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+
+  widget_class->measure = test_widget_measure;
+  widget_class->size_allocate = test_widget_size_allocate;
+  widget_class->snapshot = test_widget_snapshot;
+
+  gtk_widget_class_set_css_name (widget_class, "transitiontest");
+}
+
+static GtkCssProvider *provider;
+
+static void
+quit_loop (GdkFrameClock *clock,
+           GMainLoop     *loop)
+{
+  g_main_loop_quit (loop);
+}
+
+/* Runs a frame of @window, which advances the animations in it */
+static void
+run_frame (GtkWidget *window)
+{
+  GdkFrameClock *clock;
+  GMainLoop *loop;
+  gulong id;
+
+  clock = gtk_widget_get_frame_clock (window);
+  loop = g_main_loop_new (NULL, FALSE);
+
+  id = g_signal_connect (clock, "after-paint", G_CALLBACK (quit_loop), loop);
+  gdk_frame_clock_request_phase (clock, GDK_FRAME_CLOCK_PHASE_AFTER_PAINT);
+  g_main_loop_run (loop);
+
+  g_signal_handler_disconnect (clock, id);
+  g_main_loop_unref (loop);
+}
+
+static void
+count_style_updated (GtkWidget *widget,
+                     guint     *count)
+{
+  (*count)++;
+}
+
+static int
+get_padding_left (GtkWidget *widget)
+{
+  GtkBorder padding;
+
+  gtk_style_context_get_padding (gtk_widget_get_style_context (widget), &padding);
+
+  return padding.left;
+}
+
+static gboolean
+has_color (GtkWidget  *widget,
+           const char *color)
+{
+  GdkRGBA rgba, expected;
+
+  gdk_rgba_parse (&expected, color);
+  gtk_style_context_get_color (gtk_widget_get_style_context (widget), &rgba);
+
+  return gdk_rgba_equal (&rgba, &expected);
+}
+
+/* Adds the class "changed" to a widget with a transition of @property,
+ * runs frames until the transition ended and returns the widget, with
+ * its counters counting from when the class was added. */
+static TestWidget *
+run_transition (GtkWidget  **window_out,
+                const char  *property,
+                const char  *before,
+                const char  *after,
+                gboolean   (*is_done) (GtkWidget *widget))
+{
+  GtkWidget *window;
+  TestWidget *widget;
+  guint n_style_updated = 0;
+  gulong id;
+  guint i;
+  char *css;
+
+  css = g_strdup_printf ("transitiontest { transition: %s 100ms linear; %s: %s; }\n"
+                         "transitiontest.changed { %s: %s; }\n",
+                         property, property, before, property, after);
+  gtk_css_provider_load_from_data (provider, css, -1);
+  g_free (css);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  widget = g_object_new (test_widget_get_type (), NULL);
+  gtk_container_add (GTK_CONTAINER (window), GTK_WIDGET (widget));
+  id = g_signal_connect (widget, "style-updated", G_CALLBACK (count_style_updated), &n_style_updated);
+  gtk_widget_show (window);
+  run_frame (window);
+  run_frame (window);
+
+  widget->n_measure = 0;
+  widget->n_allocate = 0;
+  widget->n_snapshot = 0;
+  n_style_updated = 0;
+
+  gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (widget)), "changed");
+  for (i = 0; i < 1000 && !is_done (GTK_WIDGET (widget)); i++)
+    run_frame (window);
+  g_assert_true (is_done (GTK_WIDGET (widget)));
+
+  /* The frame after the last one switches back to the static style */
+  run_frame (window);
+  run_frame (window);
+
+  /* Not just the start and the end */
+  g_assert_cmpuint (n_style_updated, >, 2);
+  g_signal_handler_disconnect (widget, id);
+
+  *window_out = window;
+
+  return widget;
+}
+
+static gboolean
+color_done (GtkWidget *widget)
+{
+  return has_color (widget, "rgb(0,0,255)");
+}
+
+static void
+test_color (void)
+{
+  GtkWidget *window;
+  TestWidget *widget;
+
+  widget = run_transition (&window, "color", "rgb(255,0,0)", "rgb(0,0,255)", color_done);
+
+  /* Only redraws */
+  g_assert_cmpuint (widget->n_snapshot, >, 0);
+  g_assert_cmpuint (widget->n_measure, ==, 0);
+  g_assert_cmpuint (widget->n_allocate, ==, 0);
+
+  gtk_widget_destroy (window);
+}
+
+static gboolean
+padding_done (GtkWidget *widget)
+{
+  return get_padding_left (widget) == 20;
+}
+
+static void
+test_padding (void)
+{
+  GtkWidget *window;
+  TestWidget *widget;
+
+  /* Makes sure the counters catch size changes */
+  widget = run_transition (&window, "padding-left", "0", "20px", padding_done);
+
+  g_assert_cmpuint (widget->n_measure, >, 0);
+  g_assert_cmpuint (widget->n_allocate, >, 0);
+
+  gtk_widget_destroy (window);
+}
+
+int
+main (int argc, char *argv[])
+{
+  gtk_test_init (&argc, &argv, NULL);
+
+  provider = gtk_css_provider_new ();
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  g_test_add_func ("/transition/color", test_color);
+  g_test_add_func ("/transition/padding", test_padding);
+
+  return g_test_run ();
+}
@@ -1,6 +1,8 @@
 #include <locale.h>
 #include <gdk/gdk.h>
 
+#include "../../gdk/gdkmemorytextureprivate.h"
+
 /* maximum bytes per pixel */
 #define MAX_BPP 4
 
@@ -29,6 +31,7 @@ typedef struct _MemoryData {
 
 typedef struct _TestData {
   GdkMemoryFormat format;
+  GdkMemoryFormat dest_format;
   Color color;
 } TestData;
 
@@ -71,9 +74,9 @@ compare_textures (GdkTexture *expected,
       for (x = 0; x < width; x++)
         {
           if (ignore_alpha)
-            g_assert_cmphex (*(guint32 *) &expected_data[y * width + x * 4] & 0xFFFFFF, ==, *(guint32 *) &test_data[y * width + x * 4] & 0xFFFFFF);
+            g_assert_cmphex (*(guint32 *) &expected_data[(y * width + x) * 4] & 0xFFFFFF, ==, *(guint32 *) &test_data[(y * width + x) * 4] & 0xFFFFFF);
           else
-            g_assert_cmphex (*(guint32 *) &expected_data[y * width + x * 4], ==, *(guint32 *) &test_data[y * width + x * 4]);
+            g_assert_cmphex (*(guint32 *) &expected_data[(y * width + x) * 4], ==, *(guint32 *) &test_data[(y * width + x) * 4]);
         }
     }
 
@@ -172,12 +175,129 @@ test_download_4x4_with_stride (gconstpointer data)
   g_object_unref (test);
 }
 
+/* Large enough to go through the vectorized conversions, with an odd
+ * width so that the leftover pixels of every row get converted, too.
+ */
+static void
+test_download_large_with_stride (gconstpointer data)
+{
+  const TestData *test_data = data;
+  GdkTexture *expected, *test;
+
+  expected = create_texture (GDK_MEMORY_DEFAULT, test_data->color, 37, 5, 37 * 4);
+  test = create_texture (test_data->format, test_data->color, 37, 5, 40 * MAX_BPP);
+
+  compare_textures (expected, test, tests[test_data->format].opaque);
+
+  g_object_unref (expected);
+  g_object_unref (test);
+}
+
+/* The formats that gdk_memory_convert() can write, with the byte
+ * that holds their alpha value */
+static const struct {
+  GdkMemoryFormat format;
+  guint alpha;
+} dest_formats[] = {
+  { GDK_MEMORY_B8G8R8A8_PREMULTIPLIED, 3 },
+  { GDK_MEMORY_A8R8G8B8_PREMULTIPLIED, 0 },
+};
+
+/* Converts rows of every width up to a few vectors long, so that
+ * every number of leftover pixels goes through the plain converters.
+ */
+static void
+test_convert (gconstpointer data)
+{
+  const TestData *test_data = data;
+  const MemoryData *src = &tests[test_data->format];
+  guchar expected[4], *src_data, *dest_data;
+  gsize src_stride, dest_stride;
+  guint alpha, i;
+  int width, height, x, y;
+  gsize j;
+
+  for (i = 0; i < G_N_ELEMENTS (dest_formats); i++)
+    {
+      if (dest_formats[i].format == test_data->dest_format)
+        break;
+    }
+  g_assert_cmpuint (i, <, G_N_ELEMENTS (dest_formats));
+  alpha = dest_formats[i].alpha;
+
+  memcpy (expected, tests[test_data->dest_format].data[test_data->color], 4);
+  if (src->opaque)
+    expected[alpha] = 0xFF;
+
+  height = 3;
+  for (width = 1; width <= 67; width++)
+    {
+      src_stride = (width + 3) * MAX_BPP;
+      dest_stride = (width + 2) * 4;
+      src_data = g_malloc0 (height * src_stride);
+      dest_data = g_malloc (height * dest_stride);
+      memset (dest_data, 0x5A, height * dest_stride);
+
+      for (y = 0; y < height; y++)
+        for (x = 0; x < width; x++)
+          memcpy (&src_data[y * src_stride + x * src->bytes_per_pixel],
+                  src->data[test_data->color],
+                  src->bytes_per_pixel);
+
+      gdk_memory_convert (dest_data, dest_stride, test_data->dest_format,
+                          src_data, src_stride, test_data->format,
+                          width, height);
+
+      for (y = 0; y < height; y++)
+        {
+          const guchar *row = dest_data + y * dest_stride;
+
+          for (x = 0; x < width; x++)
+            g_assert_cmpmem (row + 4 * x, 4, expected, 4);
+
+          /* Nothing is written past the end of the row */
+          for (j = 4 * width; j < dest_stride; j++)
+            g_assert_cmphex (row[j], ==, 0x5A);
+        }
+
+      g_free (src_data);
+      g_free (dest_data);
+    }
+}
+
+static void
+test_download_performance (gconstpointer data)
+{
+  const TestData *test_data = data;
+  GdkTexture *texture;
+  guchar *pixels;
+  double elapsed;
+  int i;
+
+  /* the size of a 4K video frame */
+  texture = create_texture (test_data->format, test_data->color, 3840, 2160,
+                            3840 * tests[test_data->format].bytes_per_pixel);
+  pixels = g_malloc (3840 * 2160 * 4);
+
+  g_test_timer_start ();
+  for (i = 0; i < 10; i++)
+    gdk_texture_download (texture, pixels, 3840 * 4);
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_maximized_result (10 * 3840 * 2160 / elapsed / 1000000,
+                           "%.2f megapixels/second", 10 * 3840 * 2160 / elapsed / 1000000);
+
+  g_free (pixels);
+  g_object_unref (texture);
+}
+
 int
 main (int argc, char *argv[])
 {
   GdkMemoryFormat format;
   Color color;
   GEnumClass *enum_class;
+  guint i;
 
   g_test_init (&argc, &argv, NULL);
 
@@ -224,6 +344,40 @@ main (int argc, char *argv[])
           test_data->color = color;
           g_test_add_data_func_full (test_name, test_data, test_download_4x4_with_stride, g_free);
           g_free (test_name);
+
+          test_data = g_new (TestData, 1);
+          test_name = g_strdup_printf ("/memorytexture/download_large_with_stride/%s/%s",
+                                       g_enum_get_value (enum_class, format)->value_nick,
+                                       color_names[color]);
+          test_data->format = format;
+          test_data->color = color;
+          g_test_add_data_func_full (test_name, test_data, test_download_large_with_stride, g_free);
+          g_free (test_name);
+
+          for (i = 0; i < G_N_ELEMENTS (dest_formats); i++)
+            {
+              test_data = g_new (TestData, 1);
+              test_name = g_strdup_printf ("/memorytexture/convert/%s/%s/%s",
+                                           g_enum_get_value (enum_class, dest_formats[i].format)->value_nick,
+                                           g_enum_get_value (enum_class, format)->value_nick,
+                                           color_names[color]);
+              test_data->format = format;
+              test_data->dest_format = dest_formats[i].format;
+              test_data->color = color;
+              g_test_add_data_func_full (test_name, test_data, test_convert, g_free);
+              g_free (test_name);
+            }
+        }
+
+      if (g_test_perf ())
+        {
+          TestData *test_data = g_new (TestData, 1);
+          char *test_name = g_strdup_printf ("/memorytexture/download_performance/%s",
+                                             g_enum_get_value (enum_class, format)->value_nick);
+          test_data->format = format;
+          test_data->color = ALMOST_OPAQUE_REBECCAPURPLE;
+          g_test_add_data_func_full (test_name, test_data, test_download_performance, g_free);
+          g_free (test_name);
         }
     }
 
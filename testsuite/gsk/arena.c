@@ -0,0 +1,215 @@
+/* Render node arena tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+
+#include "../../gsk/gskrendernodeprivate.h"
+
+static GskRenderNode *
+color_node (guint i)
+{
+  GdkRGBA color = { (i % 256) / 255., 0.5, 0.25, 1.0 };
+
+  return gsk_color_node_new (&color, &GRAPHENE_RECT_INIT (i, 0, 10, 10));
+}
+
+static void
+assert_color_node (GskRenderNode *node,
+                   guint          i)
+{
+  GdkRGBA color = { (i % 256) / 255., 0.5, 0.25, 1.0 };
+  graphene_rect_t bounds;
+
+  g_assert_cmpint (gsk_render_node_get_node_type (node), ==, GSK_COLOR_NODE);
+  g_assert_true (gdk_rgba_equal (gsk_color_node_peek_color (node), &color));
+  gsk_render_node_get_bounds (node, &bounds);
+  g_assert_true (graphene_rect_equal (&bounds, &GRAPHENE_RECT_INIT (i, 0, 10, 10)));
+  g_assert_null (node->name);
+}
+
+static void
+test_no_arena (void)
+{
+  GskRenderNode *node;
+
+  node = color_node (0);
+  g_assert_null (node->chunk);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_nested (void)
+{
+  GskRenderNodeArena *outer, *inner;
+  GskRenderNode *a, *b, *c;
+
+  outer = gsk_render_node_arena_push ();
+  a = color_node (1);
+  g_assert_nonnull (a->chunk);
+
+  /* A child snapshot keeps filling the chunk of its parent */
+  inner = gsk_render_node_arena_push ();
+  b = color_node (2);
+  g_assert_true (b->chunk == a->chunk);
+  gsk_render_node_arena_pop (inner);
+
+  c = color_node (3);
+  g_assert_true (c->chunk == a->chunk);
+  gsk_render_node_arena_pop (outer);
+
+  gsk_render_node_unref (a);
+  gsk_render_node_unref (b);
+  gsk_render_node_unref (c);
+}
+
+static void
+test_out_of_order (void)
+{
+  GskRenderNodeArena *outer, *inner;
+  GskRenderNode *a, *b;
+
+  outer = gsk_render_node_arena_push ();
+  inner = gsk_render_node_arena_push ();
+  a = color_node (1);
+
+  /* Snapshots don't have to be freed in order, the inner arena
+   * keeps working on its own once the outer one is gone.
+   */
+  gsk_render_node_arena_pop (outer);
+  b = color_node (2);
+  g_assert_nonnull (b->chunk);
+  gsk_render_node_arena_pop (inner);
+
+  assert_color_node (a, 1);
+  assert_color_node (b, 2);
+
+  gsk_render_node_unref (a);
+  gsk_render_node_unref (b);
+
+  a = color_node (3);
+  g_assert_null (a->chunk);
+  gsk_render_node_unref (a);
+}
+
+static void
+test_escape (void)
+{
+  GskRenderNodeArena *arena;
+  GskRenderNode *nodes[4000];
+  GskRenderNode *escaped, *container;
+  GBytes *expected, *result;
+  guint i;
+
+  /* Fill more than one chunk, and keep one node from the first one */
+  arena = gsk_render_node_arena_push ();
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    nodes[i] = color_node (i);
+  escaped = gsk_render_node_ref (nodes[1]);
+  g_assert_false (nodes[0]->chunk == nodes[G_N_ELEMENTS (nodes) - 1]->chunk);
+  gsk_render_node_arena_pop (arena);
+
+  container = gsk_container_node_new (&escaped, 1);
+  expected = gsk_render_node_serialize (container);
+  gsk_render_node_unref (container);
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    gsk_render_node_unref (nodes[i]);
+
+  /* Reuse the memory that was released */
+  arena = gsk_render_node_arena_push ();
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    nodes[i] = color_node (i + 7);
+  gsk_render_node_arena_pop (arena);
+
+  assert_color_node (escaped, 1);
+  container = gsk_container_node_new (&escaped, 1);
+  result = gsk_render_node_serialize (container);
+  g_assert_true (g_bytes_equal (expected, result));
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    gsk_render_node_unref (nodes[i]);
+  gsk_render_node_unref (container);
+  gsk_render_node_unref (escaped);
+  g_bytes_unref (expected);
+  g_bytes_unref (result);
+}
+
+static void
+test_big_nodes (void)
+{
+  GskRenderNodeArena *arena;
+  GskRenderNode *nodes[1000];
+  GskRenderNode *container;
+  guint i;
+
+  arena = gsk_render_node_arena_push ();
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    nodes[i] = color_node (i);
+
+  /* The children don't fit in a chunk, so this goes to the heap */
+  container = gsk_container_node_new (nodes, G_N_ELEMENTS (nodes));
+  g_assert_null (container->chunk);
+  gsk_render_node_arena_pop (arena);
+
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    gsk_render_node_unref (nodes[i]);
+
+  g_assert_cmpint (gsk_container_node_get_n_children (container), ==, G_N_ELEMENTS (nodes));
+  for (i = 0; i < G_N_ELEMENTS (nodes); i++)
+    assert_color_node (gsk_container_node_get_child (container, i), i);
+
+  gsk_render_node_unref (container);
+}
+
+static gpointer
+create_node_thread (gpointer data)
+{
+  return color_node (GPOINTER_TO_UINT (data));
+}
+
+static void
+test_threads (void)
+{
+  GskRenderNodeArena *arena;
+  GskRenderNode *node;
+  GThread *thread;
+
+  /* Arenas belong to the thread that pushed them */
+  arena = gsk_render_node_arena_push ();
+  thread = g_thread_new ("arena", create_node_thread, GUINT_TO_POINTER (5));
+  node = g_thread_join (thread);
+  gsk_render_node_arena_pop (arena);
+
+  g_assert_null (node->chunk);
+  assert_color_node (node, 5);
+  gsk_render_node_unref (node);
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "C");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/arena/no-arena", test_no_arena);
+  g_test_add_func ("/arena/nested", test_nested);
+  g_test_add_func ("/arena/out-of-order", test_out_of_order);
+  g_test_add_func ("/arena/escape", test_escape);
+  g_test_add_func ("/arena/big-nodes", test_big_nodes);
+  g_test_add_func ("/arena/threads", test_threads);
+
+  return g_test_run ();
+}
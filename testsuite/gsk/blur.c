@@ -0,0 +1,260 @@
+/* Cairo blur tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+#include <math.h>
+#include <string.h>
+
+#include "../../gsk/gskcairoblurprivate.h"
+
+/* The blur uses vector kernels on as many columns as they can handle,
+ * plain C for the rest, and threads for big surfaces. All of them have
+ * to give exactly the same result as the original scalar row blur,
+ * which is reproduced here.
+ */
+
+static void
+reference_blur_span (guchar *row,
+                     guchar *tmp_buffer,
+                     int     row_width,
+                     int     d,
+                     int     shift)
+{
+  int offset;
+  int sum = 0;
+  int i;
+
+  if (d % 2 == 1)
+    offset = d / 2;
+  else
+    offset = (d - shift) / 2;
+
+  for (i = -d + offset; i < row_width + offset; i++)
+    {
+      if (i >= 0 && i < row_width)
+        sum += row[i];
+
+      if (i >= offset)
+        {
+          if (i >= d)
+            sum -= row[i - d];
+
+          tmp_buffer[i - offset] = (sum + d / 2) / d;
+        }
+    }
+
+  memcpy (row, tmp_buffer, row_width);
+}
+
+static void
+reference_blur_rows (guchar *buffer,
+                     guchar *tmp_buffer,
+                     int     width,
+                     int     height,
+                     int     d)
+{
+  int i;
+
+  for (i = 0; i < height; i++)
+    {
+      guchar *row = buffer + i * width;
+
+      if (d % 2 == 1)
+        {
+          reference_blur_span (row, tmp_buffer, width, d, 0);
+          reference_blur_span (row, tmp_buffer, width, d, 0);
+          reference_blur_span (row, tmp_buffer, width, d, 0);
+        }
+      else
+        {
+          reference_blur_span (row, tmp_buffer, width, d, 1);
+          reference_blur_span (row, tmp_buffer, width, d, -1);
+          reference_blur_span (row, tmp_buffer, width, d + 1, 0);
+        }
+    }
+}
+
+static void
+reference_flip (guchar *dst,
+                guchar *src,
+                int     width,
+                int     height)
+{
+  int i, j;
+
+  for (i = 0; i < width; i++)
+    for (j = 0; j < height; j++)
+      dst[i * height + j] = src[j * width + i];
+}
+
+static void
+reference_blur (guchar       *buffer,
+                int           width,
+                int           height,
+                int           radius,
+                GskBlurFlags  flags)
+{
+  guchar *flipped_buffer;
+  int d = (int) ((3.0 * sqrt (2 * G_PI) / 4) * radius);
+
+  if (radius <= 1)
+    return;
+
+  flipped_buffer = g_malloc (width * height);
+
+  if (flags & GSK_BLUR_Y)
+    {
+      reference_flip (flipped_buffer, buffer, width, height);
+      reference_blur_rows (flipped_buffer, buffer, height, width, d);
+      reference_flip (buffer, flipped_buffer, height, width);
+    }
+
+  if (flags & GSK_BLUR_X)
+    reference_blur_rows (buffer, flipped_buffer, width, height, d);
+
+  g_free (flipped_buffer);
+}
+
+static void
+assert_blur (int          width,
+             int          height,
+             double       radius,
+             GskBlurFlags flags)
+{
+  cairo_surface_t *surface;
+  guchar *data, *expected;
+  int stride, x, y;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_A8, width, height);
+  stride = cairo_image_surface_get_stride (surface);
+  data = cairo_image_surface_get_data (surface);
+
+  /* Random data, with bright pixels at the edges */
+  for (y = 0; y < height; y++)
+    for (x = 0; x < width; x++)
+      data[y * stride + x] = g_test_rand_int_range (0, 256);
+  data[0] = 255;
+  data[(height - 1) * stride + width - 1] = 255;
+  cairo_surface_mark_dirty (surface);
+
+  /* The blur works on the full stride, like the original did */
+  expected = g_memdup (data, stride * height);
+  reference_blur (expected, stride, height, (int) radius, flags);
+
+  gsk_cairo_blur_surface (surface, radius, flags);
+  cairo_surface_flush (surface);
+
+  if (g_test_verbose ())
+    g_test_message ("%dx%d, radius %g, flags %d", width, height, radius, flags);
+  g_assert_cmpmem (data, stride * height, expected, stride * height);
+
+  g_free (expected);
+  cairo_surface_destroy (surface);
+}
+
+static const GskBlurFlags all_flags[] = {
+  GSK_BLUR_X,
+  GSK_BLUR_Y,
+  GSK_BLUR_X | GSK_BLUR_Y
+};
+
+static void
+test_sizes (void)
+{
+  /* Odd sizes don't fill the vector kernels, which leaves columns
+   * for the plain C kernel in both directions */
+  const int sizes[] = { 1, 2, 3, 5, 15, 16, 17, 31, 33, 47, 63, 65, 101 };
+  guint i, j, k;
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    for (j = 0; j < G_N_ELEMENTS (sizes); j++)
+      for (k = 0; k < G_N_ELEMENTS (all_flags); k++)
+        assert_blur (sizes[i], sizes[j], 4, all_flags[k]);
+}
+
+static void
+test_radii (void)
+{
+  double radius;
+  guint k;
+
+  /* Both odd and even filter sizes, and the unblurred radius 1 */
+  for (radius = 0; radius <= 12; radius += 0.5)
+    for (k = 0; k < G_N_ELEMENTS (all_flags); k++)
+      assert_blur (37, 23, radius, all_flags[k]);
+}
+
+static void
+test_edges (void)
+{
+  const int sizes[] = { 3, 7, 19, 33 };
+  guint i, k;
+  int d;
+
+  /* Filters about as wide as the image, and wider */
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    for (d = sizes[i] - 2; d <= sizes[i] + 3; d++)
+      for (k = 0; k < G_N_ELEMENTS (all_flags); k++)
+        {
+          double radius = ceil (d / (3.0 * sqrt (2 * G_PI) / 4));
+
+          assert_blur (sizes[i], sizes[i] + 2, radius, all_flags[k]);
+          assert_blur (sizes[i] + 2, sizes[i], radius, all_flags[k]);
+        }
+}
+
+static void
+test_threads (void)
+{
+  guint k;
+
+  /* Big enough to be split into column ranges */
+  for (k = 0; k < G_N_ELEMENTS (all_flags); k++)
+    {
+      assert_blur (256, 256, 5, all_flags[k]);
+      assert_blur (301, 257, 8, all_flags[k]);
+      assert_blur (1025, 67, 3, all_flags[k]);
+      assert_blur (67, 1025, 30, all_flags[k]);
+    }
+}
+
+static void
+test_wide_filter (void)
+{
+  guint k;
+
+  /* Filters wider than the vector kernels handle */
+  for (k = 0; k < G_N_ELEMENTS (all_flags); k++)
+    {
+      assert_blur (4500, 3, 4000, all_flags[k]);
+      assert_blur (3, 4500, 4000, all_flags[k]);
+    }
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "C");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/blur/sizes", test_sizes);
+  g_test_add_func ("/blur/radii", test_radii);
+  g_test_add_func ("/blur/edges", test_edges);
+  g_test_add_func ("/blur/threads", test_threads);
+  g_test_add_func ("/blur/wide-filter", test_wide_filter);
+
+  return g_test_run ();
+}
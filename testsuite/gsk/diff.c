@@ -0,0 +1,270 @@
+/* Render node diffing tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+
+#include "../../gsk/gskrendernodeprivate.h"
+
+static GskRenderNode *
+color_node (float x,
+            float y,
+            float width,
+            float height,
+            float red)
+{
+  return gsk_color_node_new (&(GdkRGBA) { red, 0, 0, 1 },
+                             &GRAPHENE_RECT_INIT (x, y, width, height));
+}
+
+/* Takes ownership of the children */
+static GskRenderNode *
+container_node (GskRenderNode *first,
+                ...)
+{
+  GPtrArray *children;
+  GskRenderNode *child, *result;
+  va_list args;
+
+  children = g_ptr_array_new_with_free_func ((GDestroyNotify) gsk_render_node_unref);
+
+  va_start (args, first);
+  for (child = first; child; child = va_arg (args, GskRenderNode *))
+    g_ptr_array_add (children, child);
+  va_end (args);
+
+  result = gsk_container_node_new ((GskRenderNode **) children->pdata, children->len);
+  g_ptr_array_unref (children);
+
+  return result;
+}
+
+/* Takes ownership of @child */
+static GskRenderNode *
+offset_node (GskRenderNode *child,
+             float          x,
+             float          y)
+{
+  GskRenderNode *result;
+
+  result = gsk_offset_node_new (child, x, y);
+  gsk_render_node_unref (child);
+
+  return result;
+}
+
+/* Takes ownership of @child */
+static GskRenderNode *
+clip_node (GskRenderNode *child,
+           float          x,
+           float          y,
+           float          width,
+           float          height)
+{
+  GskRenderNode *result;
+
+  result = gsk_clip_node_new (child, &GRAPHENE_RECT_INIT (x, y, width, height));
+  gsk_render_node_unref (child);
+
+  return result;
+}
+
+/* Takes ownership of @child */
+static GskRenderNode *
+transform_node (GskRenderNode           *child,
+                const graphene_matrix_t *transform)
+{
+  GskRenderNode *result;
+
+  result = gsk_transform_node_new (child, transform);
+  gsk_render_node_unref (child);
+
+  return result;
+}
+
+/* Diffs @node1 with @node2 and checks the damage is exactly the
+ * union of the @n_rects rectangles in @rects. Consumes both nodes. */
+static void
+assert_diff (GskRenderNode               *node1,
+             GskRenderNode               *node2,
+             const cairo_rectangle_int_t *rects,
+             int                          n_rects)
+{
+  cairo_region_t *region, *expected;
+
+  region = cairo_region_create ();
+  gsk_render_node_diff (node1, node2, region);
+  expected = cairo_region_create_rectangles (rects, n_rects);
+
+  if (!cairo_region_equal (region, expected))
+    {
+      cairo_rectangle_int_t extents;
+
+      cairo_region_get_extents (region, &extents);
+      g_test_message ("damage has %d rectangles, extents %d %d %d %d",
+                      cairo_region_num_rectangles (region),
+                      extents.x, extents.y, extents.width, extents.height);
+      g_assert_not_reached ();
+    }
+
+  cairo_region_destroy (expected);
+  cairo_region_destroy (region);
+  gsk_render_node_unref (node1);
+  gsk_render_node_unref (node2);
+}
+
+static GskRenderNode *
+create_tree (void)
+{
+  graphene_matrix_t transform;
+
+  graphene_matrix_init_translate (&transform, &GRAPHENE_POINT3D_INIT (100, 0, 0));
+
+  return container_node (color_node (0, 0, 200, 200, 1),
+                         offset_node (container_node (color_node (0, 0, 10, 10, 0.5),
+                                                      color_node (10, 0, 10, 10, 0.25),
+                                                      NULL),
+                                      20, 20),
+                         clip_node (color_node (0, 100, 50, 50, 0), 0, 100, 25, 25),
+                         transform_node (color_node (0, 0, 30, 30, 0.75), &transform),
+                         NULL);
+}
+
+static void
+test_unchanged (void)
+{
+  GskRenderNode *node;
+
+  /* The same instance */
+  node = create_tree ();
+  assert_diff (gsk_render_node_ref (node), node, NULL, 0);
+
+  /* Equal trees built from scratch, nothing is shared */
+  assert_diff (create_tree (), create_tree (), NULL, 0);
+}
+
+static void
+test_unchanged_subtree (void)
+{
+  GskRenderNode *shared, *node1, *node2;
+
+  shared = create_tree ();
+
+  /* Only the changed leaf counts, no matter if the unchanged
+   * subtree is shared or just equal */
+  node1 = container_node (gsk_render_node_ref (shared),
+                          offset_node (color_node (0, 0, 10, 10, 0), 300, 300),
+                          NULL);
+  node2 = container_node (shared,
+                          offset_node (color_node (0, 0, 10, 10, 1), 300, 300),
+                          NULL);
+  assert_diff (node1, node2, (cairo_rectangle_int_t[]) { { 300, 300, 10, 10 } }, 1);
+
+  node1 = container_node (create_tree (),
+                          offset_node (color_node (0, 0, 10, 10, 0), 300, 300),
+                          NULL);
+  node2 = container_node (create_tree (),
+                          offset_node (color_node (0, 0, 10, 10, 1), 300, 300),
+                          NULL);
+  assert_diff (node1, node2, (cairo_rectangle_int_t[]) { { 300, 300, 10, 10 } }, 1);
+}
+
+static void
+test_moved_child (void)
+{
+  GskRenderNode *background, *child, *node1, *node2;
+  const cairo_rectangle_int_t damage[] = {
+    { 10, 10, 20, 20 },
+    { 50, 60, 20, 20 }
+  };
+
+  background = color_node (0, 0, 100, 100, 1);
+
+  /* Moved by changing the bounds of the child */
+  node1 = container_node (gsk_render_node_ref (background),
+                          color_node (10, 10, 20, 20, 0),
+                          NULL);
+  node2 = container_node (gsk_render_node_ref (background),
+                          color_node (50, 60, 20, 20, 0),
+                          NULL);
+  assert_diff (node1, node2, damage, G_N_ELEMENTS (damage));
+
+  /* Moved by changing the offset of an unchanged child */
+  child = color_node (0, 0, 20, 20, 0);
+  node1 = container_node (gsk_render_node_ref (background),
+                          offset_node (gsk_render_node_ref (child), 10, 10),
+                          NULL);
+  node2 = container_node (gsk_render_node_ref (background),
+                          offset_node (gsk_render_node_ref (child), 50, 60),
+                          NULL);
+  assert_diff (node1, node2, damage, G_N_ELEMENTS (damage));
+
+  gsk_render_node_unref (child);
+  gsk_render_node_unref (background);
+}
+
+static void
+test_changed_clip (void)
+{
+  GskRenderNode *child;
+  const cairo_rectangle_int_t damage[] = {
+    { 0, 0, 50, 50 },
+    { 0, 0, 70, 40 }
+  };
+
+  /* The child is the same, so diffing it finds nothing */
+  child = color_node (0, 0, 100, 100, 0);
+  assert_diff (clip_node (gsk_render_node_ref (child), 0, 0, 50, 50),
+               clip_node (gsk_render_node_ref (child), 0, 0, 70, 40),
+               damage, G_N_ELEMENTS (damage));
+
+  gsk_render_node_unref (child);
+}
+
+static void
+test_changed_transform (void)
+{
+  GskRenderNode *child;
+  graphene_matrix_t translate, scale;
+  const cairo_rectangle_int_t damage[] = {
+    { 10, 0, 20, 20 },
+    { 0, 0, 40, 40 }
+  };
+
+  graphene_matrix_init_translate (&translate, &GRAPHENE_POINT3D_INIT (10, 0, 0));
+  graphene_matrix_init_scale (&scale, 2, 2, 1);
+
+  child = color_node (0, 0, 20, 20, 0);
+  assert_diff (transform_node (gsk_render_node_ref (child), &translate),
+               transform_node (gsk_render_node_ref (child), &scale),
+               damage, G_N_ELEMENTS (damage));
+
+  gsk_render_node_unref (child);
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "C");
+  g_test_init (&argc, &argv, NULL);
+
+  g_test_add_func ("/diff/unchanged", test_unchanged);
+  g_test_add_func ("/diff/unchanged-subtree", test_unchanged_subtree);
+  g_test_add_func ("/diff/moved-child", test_moved_child);
+  g_test_add_func ("/diff/changed-clip", test_changed_clip);
+  g_test_add_func ("/diff/changed-transform", test_changed_transform);
+
+  return g_test_run ();
+}
@@ -0,0 +1,365 @@
+/* Render node hashing and interning tests.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <locale.h>
+#include <string.h>
+
+#include <pango/pangocairo.h>
+
+#include "../../gsk/gskrendernodeprivate.h"
+
+static GdkTexture *texture;
+static PangoFont *font;
+static PangoGlyphString *glyphs;
+
+static void
+setup_resources (void)
+{
+  static const guchar pixels[16] = { 0xff, 0, 0, 0xff, 0, 0xff, 0, 0xff,
+                                     0, 0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff };
+  PangoContext *context;
+  PangoFontDescription *desc;
+  GList *items;
+  PangoItem *item;
+  GBytes *bytes;
+
+  bytes = g_bytes_new_static (pixels, sizeof (pixels));
+  texture = gdk_memory_texture_new (2, 2, GDK_MEMORY_DEFAULT, bytes, 8);
+  g_bytes_unref (bytes);
+
+  context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  desc = pango_font_description_from_string ("Sans 12");
+  pango_context_set_font_description (context, desc);
+  pango_font_description_free (desc);
+
+  items = pango_itemize (context, "Abc", 0, 3, NULL, NULL);
+  item = items->data;
+  font = g_object_ref (item->analysis.font);
+  glyphs = pango_glyph_string_new ();
+  pango_shape ("Abc", 3, &item->analysis, glyphs);
+
+  g_list_free_full (items, (GDestroyNotify) pango_item_free);
+  g_object_unref (context);
+}
+
+static GskRenderNode *
+color_node (guint variant)
+{
+  return gsk_color_node_new (&(GdkRGBA) { 1, variant / 4., 0, 1 },
+                             &GRAPHENE_RECT_INIT (0, 0, 10 + variant, 10));
+}
+
+/* Creates a node of @type. Calls with the same @variant create
+ * equal nodes, different variants create different ones. */
+static GskRenderNode *
+create_node (GskRenderNodeType type,
+             guint             variant)
+{
+  GskColorStop stops[2] = {
+    { 0.0, { 1, 0, 0, 1 } },
+    { 1.0, { 0, 0, 1, variant ? 0.5 : 1 } }
+  };
+  GskShadow shadow = { { 0, 0, 0, 1 }, 1, 2, 3 + variant };
+  GskRoundedRect outline;
+  graphene_matrix_t matrix;
+  graphene_vec4_t offset;
+  GskRenderNode *child, *other, *node;
+  float widths[4] = { 1, 2, 3, 4 + variant };
+  GdkRGBA colors[4] = { { 1, 0, 0, 1 }, { 0, 1, 0, 1 }, { 0, 0, 1, 1 }, { 0, 0, 0, variant ? 0.5 : 1 } };
+
+  gsk_rounded_rect_init_from_rect (&outline, &GRAPHENE_RECT_INIT (0, 0, 20, 20), 3 + variant);
+  child = color_node (variant);
+  other = color_node (1);
+
+  switch (type)
+    {
+    case GSK_CONTAINER_NODE:
+      {
+        GskRenderNode *children[2] = { child, other };
+        node = gsk_container_node_new (children, 2);
+      }
+      break;
+
+    case GSK_CAIRO_NODE:
+      {
+        cairo_t *cr;
+
+        node = gsk_cairo_node_new (&GRAPHENE_RECT_INIT (0, 0, 10 + variant, 10));
+        cr = gsk_cairo_node_get_draw_context (node);
+        cairo_paint (cr);
+        cairo_destroy (cr);
+      }
+      break;
+
+    case GSK_COLOR_NODE:
+      node = color_node (variant);
+      break;
+
+    case GSK_LINEAR_GRADIENT_NODE:
+      node = gsk_linear_gradient_node_new (&GRAPHENE_RECT_INIT (0, 0, 10, 10),
+                                           &GRAPHENE_POINT_INIT (0, 0),
+                                           &GRAPHENE_POINT_INIT (0, 10),
+                                           stops, 2);
+      break;
+
+    case GSK_REPEATING_LINEAR_GRADIENT_NODE:
+      node = gsk_repeating_linear_gradient_node_new (&GRAPHENE_RECT_INIT (0, 0, 10, 10),
+                                                     &GRAPHENE_POINT_INIT (0, 0),
+                                                     &GRAPHENE_POINT_INIT (0, 10),
+                                                     stops, 2);
+      break;
+
+    case GSK_BORDER_NODE:
+      node = gsk_border_node_new (&outline, widths, colors);
+      break;
+
+    case GSK_TEXTURE_NODE:
+      node = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 0, 10 + variant, 10));
+      break;
+
+    case GSK_INSET_SHADOW_NODE:
+      node = gsk_inset_shadow_node_new (&outline, &colors[0], 1, 2, 3, 4 + variant);
+      break;
+
+    case GSK_OUTSET_SHADOW_NODE:
+      node = gsk_outset_shadow_node_new (&outline, &colors[0], 1, 2, 3, 4 + variant);
+      break;
+
+    case GSK_TRANSFORM_NODE:
+      graphene_matrix_init_scale (&matrix, 2, 2 + variant, 1);
+      node = gsk_transform_node_new (child, &matrix);
+      break;
+
+    case GSK_OPACITY_NODE:
+      node = gsk_opacity_node_new (child, 0.5);
+      break;
+
+    case GSK_COLOR_MATRIX_NODE:
+      graphene_matrix_init_identity (&matrix);
+      graphene_vec4_init (&offset, 0, 0, 0, variant);
+      node = gsk_color_matrix_node_new (child, &matrix, &offset);
+      break;
+
+    case GSK_REPEAT_NODE:
+      node = gsk_repeat_node_new (&GRAPHENE_RECT_INIT (0, 0, 100, 100), child, NULL);
+      break;
+
+    case GSK_CLIP_NODE:
+      node = gsk_clip_node_new (child, &GRAPHENE_RECT_INIT (0, 0, 5, 5));
+      break;
+
+    case GSK_ROUNDED_CLIP_NODE:
+      node = gsk_rounded_clip_node_new (child, &outline);
+      break;
+
+    case GSK_SHADOW_NODE:
+      node = gsk_shadow_node_new (child, &shadow, 1);
+      break;
+
+    case GSK_BLEND_NODE:
+      node = gsk_blend_node_new (other, child, GSK_BLEND_MODE_MULTIPLY);
+      break;
+
+    case GSK_CROSS_FADE_NODE:
+      node = gsk_cross_fade_node_new (other, child, 0.25);
+      break;
+
+    case GSK_TEXT_NODE:
+      node = gsk_text_node_new (font, glyphs, &colors[3], 0, 20);
+      break;
+
+    case GSK_BLUR_NODE:
+      node = gsk_blur_node_new (child, 2 + variant);
+      break;
+
+    case GSK_OFFSET_NODE:
+      node = gsk_offset_node_new (child, 1, 2 + variant);
+      break;
+
+    case GSK_NOT_A_RENDER_NODE:
+    default:
+      g_assert_not_reached ();
+    }
+
+  gsk_render_node_unref (child);
+  gsk_render_node_unref (other);
+
+  return node;
+}
+
+static void
+test_hash_equal (void)
+{
+  GskRenderNodeType type, other_type;
+
+  for (type = GSK_CONTAINER_NODE; type <= GSK_OFFSET_NODE; type++)
+    {
+      GskRenderNode *a, *b, *c;
+
+      a = create_node (type, 0);
+      b = create_node (type, 0);
+      c = create_node (type, 1);
+      g_assert_nonnull (a);
+
+      g_assert_true (gsk_render_node_equal (a, a));
+      g_assert_cmpuint (gsk_render_node_hash (a), ==, gsk_render_node_hash (a));
+
+      /* Cairo nodes compare by surface, and each has its own */
+      if (type == GSK_CAIRO_NODE)
+        g_assert_false (gsk_render_node_equal (a, b));
+      else
+        {
+          g_assert_true (gsk_render_node_equal (a, b));
+          g_assert_true (gsk_render_node_equal (b, a));
+          g_assert_cmpuint (gsk_render_node_hash (a), ==, gsk_render_node_hash (b));
+        }
+
+      g_assert_false (gsk_render_node_equal (a, c));
+      g_assert_false (gsk_render_node_equal (c, a));
+
+      for (other_type = GSK_CONTAINER_NODE; other_type <= GSK_OFFSET_NODE; other_type++)
+        {
+          GskRenderNode *d;
+
+          if (other_type == type)
+            continue;
+
+          d = create_node (other_type, 0);
+          g_assert_false (gsk_render_node_equal (a, d));
+          gsk_render_node_unref (d);
+        }
+
+      gsk_render_node_unref (a);
+      gsk_render_node_unref (b);
+      gsk_render_node_unref (c);
+    }
+}
+
+static void
+test_intern (void)
+{
+  GskRenderNode *a, *b, *c;
+
+  a = gsk_render_node_intern (create_node (GSK_BORDER_NODE, 0));
+  b = gsk_render_node_intern (create_node (GSK_BORDER_NODE, 0));
+  c = gsk_render_node_intern (create_node (GSK_BORDER_NODE, 1));
+
+  g_assert_true (a == b);
+  g_assert_false (a == c);
+  g_assert_cmpint (a->ref_count, ==, 2);
+
+  gsk_render_node_unref (a);
+  gsk_render_node_unref (b);
+  gsk_render_node_unref (c);
+
+  /* Parents and named nodes are left alone */
+  a = gsk_render_node_intern (create_node (GSK_OPACITY_NODE, 0));
+  b = gsk_render_node_intern (create_node (GSK_OPACITY_NODE, 0));
+  g_assert_false (a == b);
+  gsk_render_node_unref (a);
+  gsk_render_node_unref (b);
+
+  a = create_node (GSK_COLOR_NODE, 2);
+  gsk_render_node_set_name (a, "named");
+  a = gsk_render_node_intern (a);
+  b = gsk_render_node_intern (create_node (GSK_COLOR_NODE, 2));
+  g_assert_false (a == b);
+  gsk_render_node_unref (a);
+  gsk_render_node_unref (b);
+}
+
+static void
+test_intern_dead (void)
+{
+  GskRenderNode *a, *b, *c;
+
+  a = gsk_render_node_intern (create_node (GSK_TEXTURE_NODE, 0));
+  gsk_render_node_unref (a);
+
+  /* A finalized node is gone from the table */
+  b = gsk_render_node_intern (create_node (GSK_TEXTURE_NODE, 0));
+  g_assert_cmpint (b->ref_count, ==, 1);
+
+  /* Pretend the last reference to b was just dropped on another thread,
+   * which is now waiting for the lock to remove b from the table. */
+  b->ref_count = 0;
+  c = gsk_render_node_intern (create_node (GSK_TEXTURE_NODE, 0));
+  g_assert_false (c == b);
+  g_assert_cmpint (b->ref_count, ==, 0);
+
+  b->ref_count = 1;
+  gsk_render_node_unref (b);
+
+  /* b must not have taken c out of the table */
+  a = gsk_render_node_intern (create_node (GSK_TEXTURE_NODE, 0));
+  g_assert_true (a == c);
+
+  gsk_render_node_unref (a);
+  gsk_render_node_unref (c);
+}
+
+#define N_THREADS 4
+#define N_ROUNDS 10000
+
+static gpointer
+intern_thread (gpointer data)
+{
+  guint i;
+
+  for (i = 0; i < N_ROUNDS; i++)
+    {
+      GskRenderNode *node, *expected;
+
+      expected = create_node (GSK_COLOR_NODE, i % 3);
+      node = gsk_render_node_intern (gsk_render_node_ref (expected));
+      g_assert_cmpint (node->ref_count, >, 0);
+      g_assert_true (gsk_render_node_equal (node, expected));
+
+      gsk_render_node_unref (node);
+      gsk_render_node_unref (expected);
+    }
+
+  return NULL;
+}
+
+static void
+test_intern_threads (void)
+{
+  GThread *threads[N_THREADS];
+  guint i;
+
+  for (i = 0; i < N_THREADS; i++)
+    threads[i] = g_thread_new ("intern", intern_thread, NULL);
+
+  for (i = 0; i < N_THREADS; i++)
+    g_thread_join (threads[i]);
+}
+
+int
+main (int argc, char *argv[])
+{
+  setlocale (LC_ALL, "C");
+  g_test_init (&argc, &argv, NULL);
+
+  setup_resources ();
+
+  g_test_add_func ("/intern/hash-equal", test_hash_equal);
+  g_test_add_func ("/intern/intern", test_intern);
+  g_test_add_func ("/intern/dead", test_intern_dead);
+  g_test_add_func ("/intern/threads", test_intern_threads);
+
+  return g_test_run ();
+}
@@ -780,6 +780,241 @@ test_node_file (GFile *file)
   load_node_file (file, FALSE);
 }
 
+static void
+test_binary_roundtrip (void)
+{
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (functions); i++)
+    {
+      GskRenderNode *node, *loaded;
+      GBytes *binary, *expected, *result;
+      GError *error = NULL;
+
+      node = functions[i].func ();
+      binary = gsk_render_node_serialize_binary (node);
+      loaded = gsk_render_node_deserialize (binary, &error);
+      g_assert_no_error (error);
+      g_assert_nonnull (loaded);
+
+      expected = gsk_render_node_serialize (node);
+      result = gsk_render_node_serialize (loaded);
+      g_assert_true (g_bytes_equal (expected, result));
+
+      g_bytes_unref (result);
+      g_bytes_unref (expected);
+      g_bytes_unref (binary);
+      gsk_render_node_unref (loaded);
+      gsk_render_node_unref (node);
+    }
+}
+
+/* Offsets into the header of the binary format */
+#define ROOT_OFFSET 12
+#define N_NODES_OFFSET 16
+#define NODES_OFFSET 32
+
+static guint32
+get_uint32 (const guchar *data,
+            gsize         offset)
+{
+  guint32 value;
+
+  memcpy (&value, data + offset, sizeof (value));
+
+  return GUINT32_FROM_LE (value);
+}
+
+static void
+set_uint32 (guchar  *data,
+            gsize    offset,
+            guint32  value)
+{
+  value = GUINT32_TO_LE (value);
+  memcpy (data + offset, &value, sizeof (value));
+}
+
+/* Returns the offset of the payload of the first node of the given type */
+static gsize
+find_node_payload (const guchar      *data,
+                   GskRenderNodeType  type)
+{
+  guint64 nodes_offset;
+  guint32 i, n_nodes;
+
+  n_nodes = get_uint32 (data, N_NODES_OFFSET);
+  memcpy (&nodes_offset, data + NODES_OFFSET, sizeof (nodes_offset));
+  nodes_offset = GUINT64_FROM_LE (nodes_offset);
+
+  for (i = 0; i < n_nodes; i++)
+    {
+      gsize entry = nodes_offset + i * 16;
+
+      if (get_uint32 (data, entry) == type)
+        {
+          guint64 offset;
+
+          memcpy (&offset, data + entry + 8, sizeof (offset));
+
+          return GUINT64_FROM_LE (offset);
+        }
+    }
+
+  g_assert_not_reached ();
+}
+
+static GskRenderNode *
+malformed_source (void)
+{
+  static const guchar pixels[] = {
+    0xff, 0x00, 0x00, 0xff,  0x00, 0xff, 0x00, 0xff,
+    0x00, 0x00, 0xff, 0xff,  0xff, 0xff, 0xff, 0xff
+  };
+  GskRenderNode *nodes[2];
+  GskRenderNode *container;
+  GdkTexture *texture;
+  GBytes *bytes;
+
+  bytes = g_bytes_new_static (pixels, sizeof (pixels));
+  texture = gdk_memory_texture_new (2, 2, GDK_MEMORY_DEFAULT, bytes, 8);
+  g_bytes_unref (bytes);
+
+  nodes[0] = gsk_texture_node_new (texture, &GRAPHENE_RECT_INIT (0, 0, 20, 20));
+  nodes[1] = gsk_color_node_new (&(GdkRGBA) { 1, 0, 0, 1 }, &GRAPHENE_RECT_INIT (20, 0, 20, 20));
+  container = gsk_container_node_new (nodes, 2);
+
+  gsk_render_node_unref (nodes[0]);
+  gsk_render_node_unref (nodes[1]);
+  g_object_unref (texture);
+
+  return container;
+}
+
+/* Deserializes data that must be rejected */
+static void
+assert_malformed (const guchar *data,
+                  gsize         size)
+{
+  GskRenderNode *node;
+  GError *error = NULL;
+  GBytes *bytes;
+
+  bytes = g_bytes_new (data, size);
+  node = gsk_render_node_deserialize (bytes, &error);
+  g_assert_null (node);
+  g_assert_nonnull (error);
+
+  g_clear_error (&error);
+  g_bytes_unref (bytes);
+}
+
+static void
+test_binary_truncated (void)
+{
+  GskRenderNode *node;
+  GBytes *binary;
+  GError *error = NULL;
+  const guchar *data;
+  gsize size, i;
+
+  node = malformed_source ();
+  binary = gsk_render_node_serialize_binary (node);
+  data = g_bytes_get_data (binary, &size);
+
+  /* Anything shorter than the header is not even detected as binary */
+  assert_malformed (data, 32);
+
+  /* Every other truncation must either fail cleanly or, when only
+   * padding got cut off, still load the tree.
+   */
+  for (i = 64; i < size; i++)
+    {
+      GskRenderNode *loaded;
+      GBytes *bytes;
+
+      bytes = g_bytes_new (data, i);
+      loaded = gsk_render_node_deserialize (bytes, &error);
+      g_assert_true ((loaded == NULL) != (error == NULL));
+
+      g_clear_pointer (&loaded, gsk_render_node_unref);
+      g_clear_error (&error);
+      g_bytes_unref (bytes);
+    }
+
+  g_bytes_unref (binary);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_binary_bad_indexes (void)
+{
+  GskRenderNode *node;
+  GBytes *binary;
+  guchar *data;
+  gsize size, payload;
+  guint32 n_nodes;
+
+  node = malformed_source ();
+  binary = gsk_render_node_serialize_binary (node);
+  data = g_bytes_unref_to_data (binary, &size);
+  n_nodes = get_uint32 (data, N_NODES_OFFSET);
+
+  /* The root node does not exist */
+  set_uint32 (data, ROOT_OFFSET, n_nodes);
+  assert_malformed (data, size);
+  set_uint32 (data, ROOT_OFFSET, n_nodes - 1);
+
+  /* A container refers to itself, which has not been decoded yet */
+  payload = find_node_payload (data, GSK_CONTAINER_NODE);
+  set_uint32 (data, payload + 4, n_nodes - 1);
+  assert_malformed (data, size);
+  set_uint32 (data, payload + 4, G_MAXUINT32);
+  assert_malformed (data, size);
+  set_uint32 (data, payload + 4, 0);
+
+  /* A texture refers to an image that does not exist */
+  payload = find_node_payload (data, GSK_TEXTURE_NODE);
+  set_uint32 (data, payload + 16, 1);
+  assert_malformed (data, size);
+  set_uint32 (data, payload + 16, G_MAXUINT32);
+  assert_malformed (data, size);
+
+  g_free (data);
+  gsk_render_node_unref (node);
+}
+
+static void
+test_binary_oversized_counts (void)
+{
+  GskRenderNode *node;
+  GBytes *binary;
+  guchar *data;
+  gsize size, payload;
+  guint32 n_nodes;
+
+  node = malformed_source ();
+  binary = gsk_render_node_serialize_binary (node);
+  data = g_bytes_unref_to_data (binary, &size);
+  n_nodes = get_uint32 (data, N_NODES_OFFSET);
+
+  /* More nodes than the node table has room for */
+  set_uint32 (data, N_NODES_OFFSET, G_MAXUINT32);
+  assert_malformed (data, size);
+  set_uint32 (data, N_NODES_OFFSET, n_nodes);
+
+  /* More children than the container payload holds, this must
+   * fail without allocating room for them first.
+   */
+  payload = find_node_payload (data, GSK_CONTAINER_NODE);
+  set_uint32 (data, payload, G_MAXUINT32);
+  assert_malformed (data, size);
+  set_uint32 (data, payload, 3);
+  assert_malformed (data, size);
+
+  g_free (data);
+  gsk_render_node_unref (node);
+}
+
 static void
 add_test_for_file (GFile *file)
 {
@@ -904,6 +1139,11 @@ main (int argc, char **argv)
       add_tests_for_files_in_directory (dir);
 
       g_object_unref (dir);
+
+      g_test_add_func ("/node/binary-roundtrip", test_binary_roundtrip);
+      g_test_add_func ("/node/binary-truncated", test_binary_truncated);
+      g_test_add_func ("/node/binary-bad-indexes", test_binary_bad_indexes);
+      g_test_add_func ("/node/binary-oversized-counts", test_binary_oversized_counts);
     }
   else if (strcmp (argv[1], "--generate") == 0)
     {
@@ -310,6 +310,174 @@ test_style_classes (void)
   g_object_unref (context);
 }
 
+static GtkWidget *
+create_label_box (guint n_labels)
+{
+  GtkWidget *box;
+  guint i;
+
+  box = gtk_box_new (GTK_ORIENTATION_VERTICAL, 0);
+  for (i = 0; i < n_labels; i++)
+    {
+      GtkWidget *label = gtk_label_new ("Label");
+
+      if (i % 2)
+        gtk_style_context_add_class (gtk_widget_get_style_context (label), "odd");
+      gtk_container_add (GTK_CONTAINER (box), label);
+    }
+
+  return box;
+}
+
+static char *
+get_style_string (GtkWidget *widget)
+{
+  return gtk_style_context_to_string (gtk_widget_get_style_context (widget),
+                                      GTK_STYLE_CONTEXT_PRINT_SHOW_STYLE);
+}
+
+/* Compares the styles of the labels in @box with the ones of the middle
+ * labels in @reference, which has too few children to use the thread pool */
+static void
+assert_label_styles (GtkWidget *box,
+                     GtkWidget *reference)
+{
+  GtkWidget *even, *odd, *child;
+  char *even_style, *odd_style, *style;
+  guint i;
+
+  odd = gtk_widget_get_next_sibling (gtk_widget_get_first_child (reference));
+  even = gtk_widget_get_next_sibling (odd);
+  even_style = get_style_string (even);
+  odd_style = get_style_string (odd);
+
+  for (child = gtk_widget_get_first_child (box), i = 0;
+       child;
+       child = gtk_widget_get_next_sibling (child), i++)
+    {
+      if (child == gtk_widget_get_first_child (box) ||
+          child == gtk_widget_get_last_child (box))
+        continue;
+
+      style = get_style_string (child);
+      g_assert_cmpstr (style, ==, i % 2 ? odd_style : even_style);
+      g_free (style);
+    }
+
+  g_free (even_style);
+  g_free (odd_style);
+}
+
+static void
+test_style_prefetch_images (void)
+{
+  GtkCssProvider *provider;
+  GtkWidget *window, *box, *reference_window, *reference;
+  char *image, *css;
+
+  image = g_test_build_filename (G_TEST_DIST, "icons", "16-22", "size-test.png", NULL);
+  css = g_strdup_printf ("label { background-image: url(\"file://%s\"); }\n"
+                         "label.odd { -gtk-icon-source: -gtk-recolor(url(\"file:///does/not/exist.svg\")); }\n"
+                         "box.changed label { background-image: url(\"file:///does/not/exist.png\"); }\n"
+                         "box.changed label.odd { -gtk-icon-source: -gtk-recolor(url(\"file://%s\")); }\n",
+                         image, image);
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider, css, -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  reference_window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  reference = create_label_box (4);
+  gtk_container_add (GTK_CONTAINER (reference_window), reference);
+  gtk_widget_show (reference_window);
+
+  /* Showing the window validates the styles of all the new labels */
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = create_label_box (64);
+  gtk_container_add (GTK_CONTAINER (window), box);
+  gtk_widget_show (window);
+
+  assert_label_styles (box, reference);
+
+  /* Restyle all the labels at once */
+  gtk_style_context_add_class (gtk_widget_get_style_context (reference), "changed");
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), "changed");
+  while (g_main_context_iteration (NULL, FALSE));
+
+  assert_label_styles (box, reference);
+
+  gtk_widget_destroy (window);
+  gtk_widget_destroy (reference_window);
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+  g_free (css);
+  g_free (image);
+}
+
+static GThread *main_thread;
+
+static void
+assert_on_main_thread (GObject    *object,
+                       GParamSpec *pspec,
+                       gpointer    data)
+{
+  g_assert_true (g_thread_self () == main_thread);
+}
+
+static void
+test_style_prefetch_font_sizes (void)
+{
+  GtkCssProvider *provider;
+  GtkSettings *settings;
+  GtkWidget *window, *box, *reference_window, *reference;
+
+  main_thread = g_thread_self ();
+
+  /* Keyword sizes and rem are relative to the default font size, which
+   * comes from GtkSettings. Reading it may update the settings. */
+  settings = gtk_settings_get_default ();
+  g_signal_connect (settings, "notify", G_CALLBACK (assert_on_main_thread), NULL);
+
+  provider = gtk_css_provider_new ();
+  gtk_css_provider_load_from_data (provider,
+                                   "label { font-size: small; padding-left: 2rem; }\n"
+                                   "label.odd { font-size: x-large; }\n"
+                                   "box.changed label { font-size: medium; }\n"
+                                   "box.changed label.odd { font-size: initial; margin-left: 1rem; }\n",
+                                   -1);
+  gtk_style_context_add_provider_for_display (gdk_display_get_default (),
+                                              GTK_STYLE_PROVIDER (provider),
+                                              GTK_STYLE_PROVIDER_PRIORITY_USER);
+
+  reference_window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  reference = create_label_box (4);
+  gtk_container_add (GTK_CONTAINER (reference_window), reference);
+  gtk_widget_show (reference_window);
+
+  window = gtk_window_new (GTK_WINDOW_TOPLEVEL);
+  box = create_label_box (64);
+  gtk_container_add (GTK_CONTAINER (window), box);
+  gtk_widget_show (window);
+
+  assert_label_styles (box, reference);
+
+  gtk_style_context_add_class (gtk_widget_get_style_context (reference), "changed");
+  gtk_style_context_add_class (gtk_widget_get_style_context (box), "changed");
+  while (g_main_context_iteration (NULL, FALSE));
+
+  assert_label_styles (box, reference);
+
+  gtk_widget_destroy (window);
+  gtk_widget_destroy (reference_window);
+  gtk_style_context_remove_provider_for_display (gdk_display_get_default (),
+                                                 GTK_STYLE_PROVIDER (provider));
+  g_object_unref (provider);
+  g_signal_handlers_disconnect_by_func (settings, assert_on_main_thread, NULL);
+}
+
 static void
 test_style_priorities_setup (PrioritiesFixture *f,
                              gconstpointer      unused)
@@ -516,6 +684,8 @@ main (int argc, char *argv[])
   g_test_add_func ("/style/basic", test_basic_properties);
   g_test_add_func ("/style/widget-path-parent", test_widget_path_parent);
   g_test_add_func ("/style/classes", test_style_classes);
+  g_test_add_func ("/style/prefetch/images", test_style_prefetch_images);
+  g_test_add_func ("/style/prefetch/font-sizes", test_style_prefetch_font_sizes);
 
 #define ADD_PRIORITIES_TEST(path, func) \
   g_test_add ("/style/priorities/" path, PrioritiesFixture, NULL, test_style_priorities_setup, \
@@ -0,0 +1,246 @@
+/* textlayout.c
+ * Copyright (C) 2018 Red Hat, Inc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "config.h"
+
+#include <gtk/gtk.h>
+#include "gtk/gtktextlayoutprivate.h" /* Private header, for the display cache */
+
+#define N_LINES 10
+
+typedef struct {
+  GtkTextBuffer *buffer;
+  GtkTextLayout *layout;
+  GtkTextLine *lines[N_LINES];
+  /* Cleared when the cached display of the line is freed */
+  PangoLayout *layouts[N_LINES];
+} Fixture;
+
+static void
+fixture_setup (Fixture       *fixture,
+               gconstpointer  data)
+{
+  const GdkRGBA black = { 0, 0, 0, 1 };
+  const GdkRGBA white = { 1, 1, 1, 1 };
+  GtkTextAttributes *style;
+  PangoContext *context;
+  GtkTextIter iter;
+  GSList *lines, *l;
+  int i;
+
+  fixture->buffer = gtk_text_buffer_new (NULL);
+  gtk_text_buffer_set_text (fixture->buffer,
+                            "zero\none\ntwo\nthree\nfour\n"
+                            "five\nsix\nseven\neight\nnine", -1);
+  gtk_text_buffer_get_start_iter (fixture->buffer, &iter);
+  gtk_text_buffer_place_cursor (fixture->buffer, &iter);
+
+  fixture->layout = gtk_text_layout_new ();
+  gtk_text_layout_set_buffer (fixture->layout, fixture->buffer);
+
+  context = pango_font_map_create_context (pango_cairo_font_map_get_default ());
+  gtk_text_layout_set_contexts (fixture->layout, context, context);
+  g_object_unref (context);
+
+  style = gtk_text_attributes_new ();
+  style->font = pango_font_description_from_string ("Sans 10");
+  style->appearance.fg_rgba = gdk_rgba_copy (&black);
+  style->appearance.bg_rgba = gdk_rgba_copy (&white);
+  gtk_text_layout_set_default_style (fixture->layout, style);
+  gtk_text_attributes_unref (style);
+
+  gtk_text_layout_set_screen_width (fixture->layout, 400);
+  gtk_text_layout_validate (fixture->layout, G_MAXINT);
+
+  lines = gtk_text_layout_get_lines (fixture->layout, 0, G_MAXINT, NULL);
+  g_assert_cmpint (g_slist_length (lines), ==, N_LINES);
+  for (l = lines, i = 0; l; l = l->next, i++)
+    fixture->lines[i] = l->data;
+  g_slist_free (lines);
+}
+
+static void
+fixture_teardown (Fixture       *fixture,
+                  gconstpointer  data)
+{
+  int i;
+
+  for (i = 0; i < N_LINES; i++)
+    {
+      if (fixture->layouts[i])
+        g_object_remove_weak_pointer (G_OBJECT (fixture->layouts[i]),
+                                      (gpointer *) &fixture->layouts[i]);
+    }
+
+  g_object_unref (fixture->layout);
+  g_object_unref (fixture->buffer);
+}
+
+/* Builds the displays of the lines in [first, last] and
+ * watches for them being dropped from the cache.
+ */
+static void
+cache_lines (Fixture *fixture,
+             int      first,
+             int      last)
+{
+  int i;
+
+  for (i = first; i <= last; i++)
+    {
+      GtkTextLineDisplay *display;
+
+      display = gtk_text_layout_get_line_display (fixture->layout, fixture->lines[i], FALSE);
+      g_assert_false (display->cursors_invalid);
+
+      fixture->layouts[i] = display->layout;
+      g_object_add_weak_pointer (G_OBJECT (display->layout),
+                                 (gpointer *) &fixture->layouts[i]);
+      gtk_text_layout_free_line_display (fixture->layout, display);
+    }
+}
+
+static void
+assert_cached_lines (Fixture    *fixture,
+                     int         first,
+                     int         last,
+                     const char *cached)
+{
+  int i;
+
+  for (i = first; i <= last; i++)
+    {
+      if (cached[i - first] == '+')
+        g_assert_nonnull (fixture->layouts[i]);
+      else
+        g_assert_null (fixture->layouts[i]);
+    }
+}
+
+static void
+apply_tag_to_lines (Fixture    *fixture,
+                    const char *property,
+                    const char *value,
+                    int         first,
+                    int         last)
+{
+  GtkTextTag *tag;
+  GtkTextIter start, end;
+
+  tag = gtk_text_buffer_create_tag (fixture->buffer, NULL, property, value, NULL);
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &start, first);
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &end, last);
+  gtk_text_iter_forward_to_line_end (&end);
+  gtk_text_buffer_apply_tag (fixture->buffer, tag, &start, &end);
+}
+
+static void
+test_invalidate_tag (Fixture       *fixture,
+                     gconstpointer  data)
+{
+  cache_lines (fixture, 0, N_LINES - 1);
+
+  /* Goes through gtk_text_layout_changed() */
+  apply_tag_to_lines (fixture, "foreground", "red", 3, 4);
+  assert_cached_lines (fixture, 0, N_LINES - 1, "+++--+++++");
+}
+
+static void
+test_invalidate_edit (Fixture       *fixture,
+                      gconstpointer  data)
+{
+  GtkTextIter iter, start, end;
+
+  cache_lines (fixture, 0, N_LINES - 1);
+
+  gtk_text_buffer_get_iter_at_line_offset (fixture->buffer, &iter, 5, 2);
+  gtk_text_buffer_insert (fixture->buffer, &iter, "x", -1);
+  assert_cached_lines (fixture, 0, N_LINES - 1, "+++++-++++");
+
+  gtk_text_buffer_get_iter_at_line_offset (fixture->buffer, &start, 7, 1);
+  gtk_text_buffer_get_iter_at_line_offset (fixture->buffer, &end, 7, 3);
+  gtk_text_buffer_delete (fixture->buffer, &start, &end);
+  assert_cached_lines (fixture, 0, N_LINES - 1, "+++++-+-++");
+}
+
+static void
+test_invalidate_cursor (Fixture       *fixture,
+                        gconstpointer  data)
+{
+  GtkTextIter iter;
+  int i;
+
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &iter, 1);
+  gtk_text_buffer_place_cursor (fixture->buffer, &iter);
+
+  cache_lines (fixture, 0, N_LINES - 1);
+
+  gtk_text_buffer_get_iter_at_line (fixture->buffer, &iter, 8);
+  gtk_text_buffer_place_cursor (fixture->buffer, &iter);
+
+  /* Cursor moves keep the layouts and only drop the cursors */
+  assert_cached_lines (fixture, 0, N_LINES - 1, "++++++++++");
+  for (i = 0; i < N_LINES; i++)
+    {
+      GtkTextLineDisplay *display;
+      gboolean cursors_invalid;
+
+      display = gtk_text_layout_get_line_display (fixture->layout, fixture->lines[i], TRUE);
+      cursors_invalid = display->cursors_invalid;
+      gtk_text_layout_free_line_display (fixture->layout, display);
+
+      if (i == 1 || i == 8)
+        g_assert_true (cursors_invalid);
+      else
+        g_assert_false (cursors_invalid);
+    }
+}
+
+static void
+test_invalidate_more_than_cached (Fixture       *fixture,
+                                  gconstpointer  data)
+{
+  cache_lines (fixture, 0, N_LINES - 1);
+
+  /* Only the most recent display stays in the cache */
+  gtk_text_layout_set_display_cache_size (fixture->layout, 1);
+  assert_cached_lines (fixture, 0, N_LINES - 1, "---------+");
+
+  apply_tag_to_lines (fixture, "foreground", "red", 0, 7);
+  assert_cached_lines (fixture, 0, N_LINES - 1, "---------+");
+
+  /* More lines than cached ones, the cache gets checked instead */
+  apply_tag_to_lines (fixture, "foreground", "blue", 5, 9);
+  assert_cached_lines (fixture, 0, N_LINES - 1, "----------");
+}
+
+int
+main (int argc, char **argv)
+{
+  gtk_test_init (&argc, &argv);
+
+  g_test_add ("/textlayout/invalidate/tag", Fixture, NULL,
+              fixture_setup, test_invalidate_tag, fixture_teardown);
+  g_test_add ("/textlayout/invalidate/edit", Fixture, NULL,
+              fixture_setup, test_invalidate_edit, fixture_teardown);
+  g_test_add ("/textlayout/invalidate/cursor", Fixture, NULL,
+              fixture_setup, test_invalidate_cursor, fixture_teardown);
+  g_test_add ("/textlayout/invalidate/more-than-cached", Fixture, NULL,
+              fixture_setup, test_invalidate_more_than_cached, fixture_teardown);
+
+  return g_test_run ();
+}